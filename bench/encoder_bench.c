@@ -0,0 +1,663 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup encoder_bench encoder_bench
+ * @brief Process record encoder benchmark
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file encoder_bench.c
+
+    Process Record Encoder Benchmark
+
+    The encoder_bench application measures the schema generated process
+    record encoders against a printf based baseline, which formats each
+    record with snprintf the way the list response was formatted before
+    the encoders were generated.
+
+    A synthetic procmon process list is loaded into a process table,
+    and each encoder outputs the whole table to a memory sink
+    repeatedly.  The time per record and the output rate are reported
+    for each encoder.
+
+    usage: encoder_bench [-n <records>] [-t <ms per encoder>]
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "encoder.h"
+#include "proctable.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! default number of process records */
+#define BENCH_RECORDS       256
+
+/*! default time each encoder is run for (ms) */
+#define BENCH_TIME_MS       500
+
+/*! size of the memory sink the output is written to */
+#define BENCH_SINK_SIZE     ( 1024 * 1024 )
+
+/*! maximum length of a synthetic procmon process object */
+#define BENCH_RECORD_LEN    256
+
+/*! memory sink the encoded output is written to */
+typedef struct _Sink
+{
+    /*! output buffer */
+    char buf[BENCH_SINK_SIZE];
+
+    /*! number of bytes in the buffer */
+    size_t len;
+
+    /*! total number of bytes output */
+    uint64_t total;
+
+} Sink;
+
+/*! encoder under test */
+typedef struct _Bench
+{
+    /*! encoder name */
+    const char *name;
+
+    /*! function which outputs the whole table once */
+    int (*fn)( const ProcTable *pTable, Sink *pSink );
+
+} Bench;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int LoadTable( ProcTable *pTable, size_t count );
+static void RunBench( const Bench *pBench, const ProcTable *pTable, long ms );
+static int EncodeFormat( const ProcTable *pTable,
+                         Sink *pSink,
+                         EncoderFormat format );
+static int EncodeJSON( const ProcTable *pTable, Sink *pSink );
+static int EncodeCBOR( const ProcTable *pTable, Sink *pSink );
+static int EncodeMsgPack( const ProcTable *pTable, Sink *pSink );
+static int EncodeNDJSON( const ProcTable *pTable, Sink *pSink );
+static int GatherFragments( const ProcTable *pTable, Sink *pSink );
+static int OutputMetrics( const ProcTable *pTable, Sink *pSink );
+static int PrintfJSON( const ProcTable *pTable, Sink *pSink );
+static int SinkWrite( void *arg, const char *buf, size_t len );
+static int SinkWriteV( void *arg, const struct iovec *iov, int iovcnt );
+static double Now( void );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! process table under test */
+static ProcTable table;
+
+/*! output sink */
+static Sink sink;
+
+/*! encoders under test, the baseline first */
+static const Bench benches[] =
+{
+    { "printf json", PrintfJSON },
+    { "json", EncodeJSON },
+    { "json fragments", GatherFragments },
+    { "ndjson", EncodeNDJSON },
+    { "cbor", EncodeCBOR },
+    { "msgpack", EncodeMsgPack },
+    { "metrics", OutputMetrics }
+};
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the encoder_bench application
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval 0 the benchmark was run
+    @retval 1 the process table could not be loaded
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    size_t records = BENCH_RECORDS;
+    long ms = BENCH_TIME_MS;
+    size_t i;
+    int c;
+    int result;
+
+    while ( ( c = getopt( argc, argv, "n:t:" ) ) != -1 )
+    {
+        switch ( c )
+        {
+            case 'n':
+                records = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 't':
+                ms = strtol( optarg, NULL, 0 );
+                break;
+
+            default:
+                fprintf( stderr,
+                         "usage: %s [-n <records>] [-t <ms per encoder>]\n",
+                         argv[0] );
+                break;
+        }
+    }
+
+    result = LoadTable( &table, records );
+    if ( result == EOK )
+    {
+        printf( "%-16s %12s %12s %10s\n",
+                "encoder", "ns/record", "MB/s", "speedup" );
+
+        for ( i = 0; i < sizeof( benches ) / sizeof( benches[0] ); i++ )
+        {
+            RunBench( &benches[i], &table, ms );
+        }
+    }
+    else
+    {
+        fprintf( stderr, "cannot load %zu records: %s\n",
+                 records,
+                 strerror( result ) );
+    }
+
+    return ( result == EOK ) ? 0 : 1;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  LoadTable                                                                 */
+/*!
+    Load a synthetic process list
+
+    The LoadTable function builds a procmon process list with the
+    specified number of processes, and loads it into the process table.
+
+    @param[in]
+        pTable
+            pointer to the process table to load
+
+    @param[in]
+        count
+            number of processes
+
+    @retval EOK the process table was loaded
+    @retval ENOMEM cannot allocate the process list
+    @retval other error from ProcTable_Load
+
+==============================================================================*/
+static int LoadTable( ProcTable *pTable, size_t count )
+{
+    int result = ENOMEM;
+    char *json;
+    size_t len = 0;
+    size_t i;
+
+    json = malloc( ( count + 1 ) * BENCH_RECORD_LEN );
+    if ( json != NULL )
+    {
+        json[len++] = '[';
+        for ( i = 0; i < count; i++ )
+        {
+            len += sprintf( &json[len],
+                            "%s{\"name\": \"worker%zu\",\"pid\": %zu,"
+                            "\"runcount\": %zu,\"since\": \"%zuh%02zum%02zus\","
+                            "\"state\": \"%s\","
+                            "\"exec\": \"/usr/bin/worker -c \\\"%zu\\\"\"}",
+                            ( i > 0 ) ? "," : "",
+                            i,
+                            1000 + i * 7,
+                            i % 13,
+                            i % 24,
+                            i % 60,
+                            ( i * 7 ) % 60,
+                            ( i % 5 == 0 ) ? "stopped" : "running",
+                            i );
+        }
+
+        json[len++] = ']';
+
+        result = ProcTable_Load( pTable, json, len );
+        free( json );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RunBench                                                                  */
+/*!
+    Run an encoder for the specified time and report its rate
+
+    @param[in]
+        pBench
+            pointer to the encoder under test
+
+    @param[in]
+        pTable
+            pointer to the process table to output
+
+    @param[in]
+        ms
+            time to run the encoder for (ms)
+
+==============================================================================*/
+static void RunBench( const Bench *pBench, const ProcTable *pTable, long ms )
+{
+    static double baseline = 0.0;
+    double start;
+    double elapsed;
+    double perRecord;
+    uint64_t passes = 0;
+    int result = EOK;
+
+    sink.len = 0;
+    sink.total = 0;
+
+    start = Now();
+    do
+    {
+        result = pBench->fn( pTable, &sink );
+        passes++;
+        elapsed = Now() - start;
+    } while ( ( result == EOK ) && ( elapsed * 1000.0 < ms ) );
+
+    if ( ( result == EOK ) && ( pTable->count > 0 ) )
+    {
+        perRecord = elapsed * 1e9 / ( passes * pTable->count );
+        if ( baseline == 0.0 )
+        {
+            baseline = perRecord;
+        }
+
+        printf( "%-16s %12.1f %12.1f %9.2fx\n",
+                pBench->name,
+                perRecord,
+                sink.total / elapsed / 1e6,
+                baseline / perRecord );
+    }
+    else
+    {
+        printf( "%-16s failed: %s\n", pBench->name, strerror( result ) );
+    }
+}
+
+/*============================================================================*/
+/*  EncodeFormat                                                              */
+/*!
+    Output the process table with a structured encoder
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        pSink
+            pointer to the output sink
+
+    @param[in]
+        format
+            output format
+
+    @retval EOK the table was output
+    @retval other error from the encoder
+
+==============================================================================*/
+static int EncodeFormat( const ProcTable *pTable,
+                         Sink *pSink,
+                         EncoderFormat format )
+{
+    Encoder encoder;
+
+    Encoder_Init( &encoder, format, SinkWrite, pSink );
+
+    return ProcTable_Encode( pTable, 0, pTable->count, false, &encoder );
+}
+
+/*============================================================================*/
+/*  EncodeJSON                                                                */
+/*!
+    Output the process table with the JSON encoder
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        pSink
+            pointer to the output sink
+
+    @retval EOK the table was output
+    @retval other error from the encoder
+
+==============================================================================*/
+static int EncodeJSON( const ProcTable *pTable, Sink *pSink )
+{
+    return EncodeFormat( pTable, pSink, ENCODER_JSON );
+}
+
+/*============================================================================*/
+/*  EncodeCBOR                                                                */
+/*!
+    Output the process table with the CBOR encoder
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        pSink
+            pointer to the output sink
+
+    @retval EOK the table was output
+    @retval other error from the encoder
+
+==============================================================================*/
+static int EncodeCBOR( const ProcTable *pTable, Sink *pSink )
+{
+    return EncodeFormat( pTable, pSink, ENCODER_CBOR );
+}
+
+/*============================================================================*/
+/*  EncodeMsgPack                                                             */
+/*!
+    Output the process table with the MessagePack encoder
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        pSink
+            pointer to the output sink
+
+    @retval EOK the table was output
+    @retval other error from the encoder
+
+==============================================================================*/
+static int EncodeMsgPack( const ProcTable *pTable, Sink *pSink )
+{
+    return EncodeFormat( pTable, pSink, ENCODER_MSGPACK );
+}
+
+/*============================================================================*/
+/*  EncodeNDJSON                                                              */
+/*!
+    Output the process table with the NDJSON encoder
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        pSink
+            pointer to the output sink
+
+    @retval EOK the table was output
+    @retval other error from the encoder
+
+==============================================================================*/
+static int EncodeNDJSON( const ProcTable *pTable, Sink *pSink )
+{
+    return EncodeFormat( pTable, pSink, ENCODER_NDJSON );
+}
+
+/*============================================================================*/
+/*  GatherFragments                                                           */
+/*!
+    Output the process table from its pre-rendered JSON fragments
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        pSink
+            pointer to the output sink
+
+    @retval EOK the table was output
+    @retval other error from ProcTable_Gather
+
+==============================================================================*/
+static int GatherFragments( const ProcTable *pTable, Sink *pSink )
+{
+    return ProcTable_Gather( pTable,
+                             0,
+                             pTable->count,
+                             false,
+                             false,
+                             SinkWriteV,
+                             pSink );
+}
+
+/*============================================================================*/
+/*  OutputMetrics                                                             */
+/*!
+    Output the process table as metrics
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        pSink
+            pointer to the output sink
+
+    @retval EOK the table was output
+    @retval other error from ProcTable_Metrics
+
+==============================================================================*/
+static int OutputMetrics( const ProcTable *pTable, Sink *pSink )
+{
+    return ProcTable_Metrics( pTable, SinkWrite, pSink );
+}
+
+/*============================================================================*/
+/*  PrintfJSON                                                                */
+/*!
+    Output the process table as JSON with snprintf
+
+    The PrintfJSON function is the baseline the encoders are measured
+    against.  It formats each record with a single snprintf call, and
+    does not escape the strings, so it does less work than the JSON
+    encoder.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        pSink
+            pointer to the output sink
+
+    @retval EOK the table was output
+
+==============================================================================*/
+static int PrintfJSON( const ProcTable *pTable, Sink *pSink )
+{
+    char buf[PROCTABLE_FRAGMENT_LEN];
+    const ProcRecord *pRecord;
+    size_t i;
+    int n;
+
+    SinkWrite( pSink, "[", 1 );
+
+    for ( i = 0; i < pTable->count; i++ )
+    {
+        pRecord = &pTable->records[i];
+        n = snprintf( buf,
+                      sizeof( buf ),
+                      "%s{\"name\": \"%s\",\"pid\": %d,\"runcount\": %u,"
+                      "\"since\": %llu,\"state\": \"%s\",\"exec\": \"%s\","
+                      "\"flapping\": %s,\"restartRate\": %u}",
+                      ( i > 0 ) ? "," : "",
+                      pRecord->name,
+                      pRecord->pid,
+                      pRecord->runcount,
+                      (unsigned long long)pRecord->since,
+                      pRecord->state,
+                      pRecord->exec,
+                      ( pRecord->flapping == true ) ? "true" : "false",
+                      pRecord->restartRate );
+        if ( ( n > 0 ) && ( (size_t)n < sizeof( buf ) ) )
+        {
+            SinkWrite( pSink, buf, (size_t)n );
+        }
+    }
+
+    return SinkWrite( pSink, "]", 1 );
+}
+
+/*============================================================================*/
+/*  SinkWrite                                                                 */
+/*!
+    Write output to the memory sink
+
+    The SinkWrite function copies the output to the sink buffer, and
+    starts the buffer again when it is full.
+
+    @param[in]
+        arg
+            pointer to the sink
+
+    @param[in]
+        buf
+            pointer to the output
+
+    @param[in]
+        len
+            length of the output
+
+    @retval EOK the output was written
+
+==============================================================================*/
+static int SinkWrite( void *arg, const char *buf, size_t len )
+{
+    Sink *pSink = arg;
+
+    if ( len > BENCH_SINK_SIZE - pSink->len )
+    {
+        pSink->len = 0;
+    }
+
+    if ( len <= BENCH_SINK_SIZE )
+    {
+        memcpy( &pSink->buf[pSink->len], buf, len );
+        pSink->len += len;
+    }
+
+    pSink->total += len;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*  SinkWriteV                                                                */
+/*!
+    Write a gathered list of buffers to the memory sink
+
+    @param[in]
+        arg
+            pointer to the sink
+
+    @param[in]
+        iov
+            array of buffers
+
+    @param[in]
+        iovcnt
+            number of buffers
+
+    @retval EOK the output was written
+
+==============================================================================*/
+static int SinkWriteV( void *arg, const struct iovec *iov, int iovcnt )
+{
+    int i;
+
+    for ( i = 0; i < iovcnt; i++ )
+    {
+        SinkWrite( arg, iov[i].iov_base, iov[i].iov_len );
+    }
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*  Now                                                                       */
+/*!
+    Get the monotonic time in seconds
+
+    @retval current time in seconds
+
+==============================================================================*/
+static double Now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*! @}
+ * end of encoder_bench group */
@@ -0,0 +1,636 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup io_bench io_bench
+ * @brief Event loop benchmark
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file io_bench.c
+
+    Event Loop Benchmark
+
+    The io_bench application measures the coroutine event loop waiting
+    for file descriptors with epoll against waiting with io_uring.
+
+    A client thread keeps one request in flight on each of a number of
+    socket pairs.  A request carries the time it was sent, and a server
+    coroutine for each connection waits for it to become readable,
+    reads it and writes it back.  The client records the round trip
+    time of each request.
+
+    The system calls the server makes are counted: its own reads and
+    writes, and those the event loop makes, by wrapping epoll_wait,
+    epoll_ctl and syscall at link time.  Each interface runs in its own
+    process, since the event loop can be initialized only once.
+
+    usage: io_bench [-n <requests>] [-c <connections>]
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include "coro.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! default number of requests */
+#define BENCH_REQUESTS      ( 100 * 1000 )
+
+/*! default number of connections */
+#define BENCH_CONNECTIONS   64
+
+/*! server side of a connection */
+typedef struct _Conn
+{
+    /*! coroutine serving the connection */
+    Coro coro;
+
+    /*! server end of the socket pair */
+    int fd;
+
+    /*! request being served */
+    uint64_t request;
+
+} Conn;
+
+/*! client side of the benchmark */
+typedef struct _Client
+{
+    /*! client ends of the socket pairs */
+    struct pollfd *fds;
+
+    /*! number of connections */
+    size_t connections;
+
+    /*! number of requests to send */
+    size_t requests;
+
+    /*! round trip time of each request in nanoseconds */
+    uint64_t *latencies;
+
+    /*! number of round trips completed */
+    size_t completed;
+
+} Client;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int RunBench( CoroIo io, size_t requests, size_t connections );
+static void *ClientThread( void *arg );
+static int Serve( Coro *pCoro );
+static int CompareLatency( const void *a, const void *b );
+static uint64_t NowNs( void );
+
+int __real_epoll_wait( int epfd,
+                       struct epoll_event *events,
+                       int maxevents,
+                       int timeout );
+int __real_epoll_ctl( int epfd, int op, int fd, struct epoll_event *event );
+long __real_syscall( long number, ... );
+
+int __wrap_epoll_wait( int epfd,
+                       struct epoll_event *events,
+                       int maxevents,
+                       int timeout );
+int __wrap_epoll_ctl( int epfd, int op, int fd, struct epoll_event *event );
+long __wrap_syscall( long number, ... );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! interface names, indexed by CoroIo */
+static const char *ioNames[] = { "epoll", "io_uring" };
+
+/*! number of system calls the server has made */
+static size_t nSyscalls = 0;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the io_bench application
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval 0 the benchmark was run
+    @retval 1 the benchmark could not be run
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    size_t requests = BENCH_REQUESTS;
+    size_t connections = BENCH_CONNECTIONS;
+    CoroIo io;
+    pid_t pid;
+    int status;
+    int c;
+    int result = EOK;
+
+    while ( ( c = getopt( argc, argv, "n:c:" ) ) != -1 )
+    {
+        switch ( c )
+        {
+            case 'n':
+                requests = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'c':
+                connections = strtoul( optarg, NULL, 0 );
+                break;
+
+            default:
+                fprintf( stderr,
+                         "usage: %s [-n <requests>] [-c <connections>]\n",
+                         argv[0] );
+                break;
+        }
+    }
+
+    if ( ( requests < connections ) || ( connections == 0 ) )
+    {
+        result = EINVAL;
+    }
+    else
+    {
+        printf( "%10s %12s %14s %10s %10s %10s\n",
+                "io", "requests/s", "syscalls/req",
+                "p50 us", "p99 us", "p99.9 us" );
+        fflush( stdout );
+    }
+
+    for ( io = CORO_IO_EPOLL;
+          ( io <= CORO_IO_URING ) && ( result == EOK );
+          io++ )
+    {
+        pid = fork();
+        if ( pid == 0 )
+        {
+            result = RunBench( io, requests, connections );
+            fflush( stdout );
+            _exit( result );
+        }
+        else if ( ( pid == -1 ) ||
+                  ( waitpid( pid, &status, 0 ) == -1 ) ||
+                  ( WIFEXITED( status ) == false ) )
+        {
+            result = ECHILD;
+        }
+        else if ( WEXITSTATUS( status ) != EOK )
+        {
+            result = WEXITSTATUS( status );
+        }
+    }
+
+    if ( result != EOK )
+    {
+        fprintf( stderr,
+                 "cannot run %zu requests on %zu connections: %s\n",
+                 requests,
+                 connections,
+                 strerror( result ) );
+    }
+
+    return ( result == EOK ) ? 0 : 1;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  RunBench                                                                  */
+/*!
+    Serve requests with one event loop interface and report the results
+
+    The RunBench function creates the connections, starts a server
+    coroutine for each of them and the client thread, and runs the
+    event loop until the client has closed every connection.
+
+    @param[in]
+        io
+            interface the event loop waits for file descriptors with
+
+    @param[in]
+        requests
+            number of requests to send
+
+    @param[in]
+        connections
+            number of connections to send them on
+
+    @retval EOK the results were reported, or the interface is not
+            available
+    @retval ENOMEM cannot allocate the connections
+    @retval other error from socketpair, pthread_create or the event loop
+
+==============================================================================*/
+static int RunBench( CoroIo io, size_t requests, size_t connections )
+{
+    Client client;
+    Conn *conns;
+    pthread_t thread;
+    uint64_t start;
+    double elapsed;
+    int sv[2];
+    size_t i;
+    int result;
+
+    memset( &client, 0, sizeof( Client ) );
+    client.connections = connections;
+    client.requests = requests;
+    client.fds = calloc( connections, sizeof( struct pollfd ) );
+    client.latencies = calloc( requests, sizeof( uint64_t ) );
+    conns = calloc( connections, sizeof( Conn ) );
+
+    result = ( ( client.fds != NULL ) &&
+               ( client.latencies != NULL ) &&
+               ( conns != NULL ) ) ? Coro_Init( connections, io )
+                                   : ENOMEM;
+
+    for ( i = 0; ( i < connections ) && ( result == EOK ); i++ )
+    {
+        if ( socketpair( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv ) == 0 )
+        {
+            fcntl( sv[1], F_SETFL, O_NONBLOCK );
+            client.fds[i].fd = sv[0];
+            client.fds[i].events = POLLIN;
+            conns[i].fd = sv[1];
+            result = Coro_Start( &conns[i].coro, Serve, &conns[i] );
+        }
+        else
+        {
+            result = errno;
+        }
+    }
+
+    if ( ( result == EOK ) && ( Coro_GetIo() != io ) )
+    {
+        printf( "%10s %12s\n", ioNames[io], "unavailable" );
+    }
+    else if ( result == EOK )
+    {
+        nSyscalls = 0;
+        start = NowNs();
+        result = pthread_create( &thread, NULL, ClientThread, &client );
+        if ( result == EOK )
+        {
+            result = Coro_Run();
+            pthread_join( thread, NULL );
+        }
+
+        elapsed = ( NowNs() - start ) / 1e9;
+
+        if ( ( result == EOK ) && ( client.completed == requests ) )
+        {
+            qsort( client.latencies,
+                   requests,
+                   sizeof( uint64_t ),
+                   CompareLatency );
+
+            printf( "%10s %12.0f %14.2f %10.1f %10.1f %10.1f\n",
+                    ioNames[io],
+                    requests / elapsed,
+                    (double)nSyscalls / requests,
+                    client.latencies[requests / 2] / 1e3,
+                    client.latencies[requests * 99 / 100] / 1e3,
+                    client.latencies[requests * 999 / 1000] / 1e3 );
+        }
+        else if ( result == EOK )
+        {
+            result = EIO;
+        }
+    }
+
+    free( conns );
+    free( client.latencies );
+    free( client.fds );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ClientThread                                                              */
+/*!
+    Send the requests and time their round trips
+
+    The ClientThread function sends a request on every connection, then
+    sends the next request on a connection as soon as the previous one
+    comes back, until all of the requests have been sent.  It closes
+    each connection once its last request has come back, which ends
+    the server coroutine for the connection.
+
+    @param[in]
+        arg
+            pointer to the Client
+
+    @retval NULL
+
+==============================================================================*/
+static void *ClientThread( void *arg )
+{
+    Client *pClient = (Client *)arg;
+    size_t sent = 0;
+    size_t open = pClient->connections;
+    uint64_t request;
+    size_t i;
+
+    for ( i = 0; i < pClient->connections; i++ )
+    {
+        request = NowNs();
+        if ( write( pClient->fds[i].fd, &request, sizeof( request ) ) ==
+             sizeof( request ) )
+        {
+            sent++;
+        }
+    }
+
+    while ( ( open > 0 ) &&
+            ( poll( pClient->fds, pClient->connections, -1 ) > 0 ) )
+    {
+        for ( i = 0; i < pClient->connections; i++ )
+        {
+            if ( ( pClient->fds[i].revents & POLLIN ) &&
+                 ( read( pClient->fds[i].fd, &request, sizeof( request ) ) ==
+                   sizeof( request ) ) )
+            {
+                pClient->latencies[pClient->completed++] = NowNs() - request;
+
+                request = NowNs();
+                if ( ( sent < pClient->requests ) &&
+                     ( write( pClient->fds[i].fd,
+                              &request,
+                              sizeof( request ) ) == sizeof( request ) ) )
+                {
+                    sent++;
+                }
+                else
+                {
+                    close( pClient->fds[i].fd );
+                    pClient->fds[i].fd = -1;
+                    open--;
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  Serve                                                                     */
+/*!
+    Serve the requests on one connection
+
+    The Serve coroutine waits for each request, reads it and writes it
+    back, until the client closes the connection.
+
+    @param[in]
+        pCoro
+            pointer to the coroutine of the Conn
+
+    @retval CORO_SUSPENDED the coroutine is waiting for a request
+    @retval CORO_DONE the connection was closed
+
+==============================================================================*/
+static int Serve( Coro *pCoro )
+{
+    Conn *pConn = (Conn *)pCoro->arg;
+    ssize_t n;
+
+    CORO_BEGIN( pCoro );
+
+    while ( Coro_WaitFd( pCoro, pConn->fd, EPOLLIN, 0 ) == EOK )
+    {
+        CORO_SUSPEND( pCoro );
+
+        nSyscalls++;
+        n = read( pConn->fd, &pConn->request, sizeof( pConn->request ) );
+        if ( n != sizeof( pConn->request ) )
+        {
+            break;
+        }
+
+        nSyscalls++;
+        if ( write( pConn->fd, &pConn->request, sizeof( pConn->request ) ) !=
+             sizeof( pConn->request ) )
+        {
+            break;
+        }
+    }
+
+    close( pConn->fd );
+
+    CORO_END( pCoro );
+}
+
+/*============================================================================*/
+/*  CompareLatency                                                            */
+/*!
+    Compare two round trip times for qsort
+
+    @param[in]
+        a
+            pointer to the first round trip time
+
+    @param[in]
+        b
+            pointer to the second round trip time
+
+    @retval <0 the first is shorter
+    @retval 0 they are equal
+    @retval >0 the first is longer
+
+==============================================================================*/
+static int CompareLatency( const void *a, const void *b )
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return ( x > y ) - ( x < y );
+}
+
+/*============================================================================*/
+/*  NowNs                                                                     */
+/*!
+    Get the monotonic time in nanoseconds
+
+    @retval monotonic time in nanoseconds
+
+==============================================================================*/
+static uint64_t NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*============================================================================*/
+/*  __wrap_epoll_wait                                                         */
+/*!
+    Count an epoll_wait call made by the event loop
+
+    @param[in]
+        epfd
+            epoll descriptor
+
+    @param[out]
+        events
+            array to store the ready events in
+
+    @param[in]
+        maxevents
+            size of the events array
+
+    @param[in]
+        timeout
+            maximum time to wait in milliseconds, or -1 for no limit
+
+    @retval result of epoll_wait
+
+==============================================================================*/
+int __wrap_epoll_wait( int epfd,
+                       struct epoll_event *events,
+                       int maxevents,
+                       int timeout )
+{
+    nSyscalls++;
+
+    return __real_epoll_wait( epfd, events, maxevents, timeout );
+}
+
+/*============================================================================*/
+/*  __wrap_epoll_ctl                                                          */
+/*!
+    Count an epoll_ctl call made by the event loop
+
+    @param[in]
+        epfd
+            epoll descriptor
+
+    @param[in]
+        op
+            operation, eg EPOLL_CTL_ADD
+
+    @param[in]
+        fd
+            file descriptor to operate on
+
+    @param[in]
+        event
+            events to wait for
+
+    @retval result of epoll_ctl
+
+==============================================================================*/
+int __wrap_epoll_ctl( int epfd, int op, int fd, struct epoll_event *event )
+{
+    nSyscalls++;
+
+    return __real_epoll_ctl( epfd, op, fd, event );
+}
+
+/*============================================================================*/
+/*  __wrap_syscall                                                            */
+/*!
+    Count a system call the io_uring interface makes with syscall
+
+    @param[in]
+        number
+            system call number, eg SYS_io_uring_enter
+
+    @param[in]
+        ...
+            up to six system call arguments
+
+    @retval result of syscall
+
+==============================================================================*/
+long __wrap_syscall( long number, ... )
+{
+    va_list ap;
+    long args[6];
+    int i;
+
+    va_start( ap, number );
+    for ( i = 0; i < 6; i++ )
+    {
+        args[i] = va_arg( ap, long );
+    }
+    va_end( ap );
+
+    nSyscalls++;
+
+    return __real_syscall( number,
+                           args[0],
+                           args[1],
+                           args[2],
+                           args[3],
+                           args[4],
+                           args[5] );
+}
+
+/*! @}
+ * end of io_bench group */
@@ -0,0 +1,680 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup queue_bench queue_bench
+ * @brief Hand-off queue benchmark
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file queue_bench.c
+
+    Hand-off Queue Benchmark
+
+    The queue_bench application measures the lock-free hand-off queue
+    used by the batch executor against a baseline queue guarded by a
+    mutex, with condition variables for full and empty waits.
+
+    For each thread count from 1 up to the maximum, doubling each time,
+    that many producer threads and that many consumer threads pass a
+    fixed number of items through each queue.  The hand-off rate is
+    reported for each queue.
+
+    usage: queue_bench [-n <items>] [-p <max threads>] [-c <capacity>]
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "queue.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! default number of items passed through a queue at each thread count */
+#define BENCH_ITEMS         ( 1024 * 1024 )
+
+/*! default maximum number of producer (and of consumer) threads */
+#define BENCH_MAX_THREADS   64
+
+/*! default queue capacity */
+#define BENCH_CAPACITY      256
+
+/*! time in milliseconds a consumer waits for an item before retrying */
+#define BENCH_POP_MS        1000
+
+/*! queue guarded by a mutex, the baseline */
+typedef struct _LockedQueue
+{
+    /*! mutex guarding the queue */
+    pthread_mutex_t lock;
+
+    /*! signalled when an item is added */
+    pthread_cond_t notEmpty;
+
+    /*! signalled when an item is removed */
+    pthread_cond_t notFull;
+
+    /*! queued items */
+    void **items;
+
+    /*! maximum number of queued items */
+    size_t capacity;
+
+    /*! index of the next item to remove */
+    size_t head;
+
+    /*! number of queued items */
+    size_t count;
+
+    /*! true once the queue is closed */
+    bool closed;
+
+} LockedQueue;
+
+/*! queue under test */
+typedef struct _Bench
+{
+    /*! queue name */
+    const char *name;
+
+    /*! function which initializes the queue */
+    int (*init)( size_t capacity );
+
+    /*! function which adds an item, waiting while the queue is full */
+    void (*push)( void *item );
+
+    /*! function which removes an item, waiting while the queue is empty */
+    int (*pop)( void **pItem );
+
+    /*! function which closes the queue */
+    void (*close)( void );
+
+    /*! function which releases the queue */
+    void (*destroy)( void );
+
+} Bench;
+
+/*! arguments of a producer or consumer thread */
+typedef struct _Worker
+{
+    /*! queue under test */
+    const Bench *pBench;
+
+    /*! number of items to produce, or the number of items consumed */
+    size_t items;
+
+    /*! thread identifier */
+    pthread_t thread;
+
+} Worker;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static double RunBench( const Bench *pBench,
+                        size_t threads,
+                        size_t items,
+                        size_t capacity );
+static void *Producer( void *arg );
+static void *Consumer( void *arg );
+static int LockFreeInit( size_t capacity );
+static void LockFreePush( void *item );
+static int LockFreePop( void **pItem );
+static void LockFreeClose( void );
+static void LockFreeDestroy( void );
+static int LockedInit( size_t capacity );
+static void LockedPush( void *item );
+static int LockedPop( void **pItem );
+static void LockedClose( void );
+static void LockedDestroy( void );
+static double Now( void );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! lock-free queue under test */
+static Queue lockFree;
+
+/*! mutex queue under test */
+static LockedQueue locked;
+
+/*! queues under test, the baseline first */
+static const Bench benches[] =
+{
+    { "mutex", LockedInit, LockedPush, LockedPop, LockedClose, LockedDestroy },
+    { "lock-free",
+      LockFreeInit,
+      LockFreePush,
+      LockFreePop,
+      LockFreeClose,
+      LockFreeDestroy }
+};
+
+/*! producer and consumer threads */
+static Worker *workers;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the queue_bench application
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval 0 the benchmark was run
+    @retval 1 the benchmark could not be run
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    size_t items = BENCH_ITEMS;
+    size_t maxThreads = BENCH_MAX_THREADS;
+    size_t capacity = BENCH_CAPACITY;
+    double rates[sizeof( benches ) / sizeof( benches[0] )];
+    size_t threads;
+    size_t i;
+    int c;
+    int result = EOK;
+
+    while ( ( c = getopt( argc, argv, "n:p:c:" ) ) != -1 )
+    {
+        switch ( c )
+        {
+            case 'n':
+                items = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'p':
+                maxThreads = strtoul( optarg, NULL, 0 );
+                break;
+
+            case 'c':
+                capacity = strtoul( optarg, NULL, 0 );
+                break;
+
+            default:
+                fprintf( stderr,
+                         "usage: %s [-n <items>] [-p <max threads>] "
+                         "[-c <capacity>]\n",
+                         argv[0] );
+                break;
+        }
+    }
+
+    workers = calloc( 2 * maxThreads, sizeof( Worker ) );
+    if ( workers == NULL )
+    {
+        result = ENOMEM;
+    }
+
+    if ( result == EOK )
+    {
+        printf( "%8s %14s %14s %10s\n",
+                "threads", "mutex Mops/s", "lock-free", "speedup" );
+    }
+
+    for ( threads = 1;
+          ( threads <= maxThreads ) && ( result == EOK );
+          threads *= 2 )
+    {
+        for ( i = 0; i < sizeof( benches ) / sizeof( benches[0] ); i++ )
+        {
+            rates[i] = RunBench( &benches[i], threads, items, capacity );
+            if ( rates[i] == 0.0 )
+            {
+                result = EINVAL;
+                break;
+            }
+        }
+
+        if ( result == EOK )
+        {
+            printf( "%8zu %14.2f %14.2f %9.2fx\n",
+                    threads,
+                    rates[0] / 1e6,
+                    rates[1] / 1e6,
+                    rates[1] / rates[0] );
+        }
+    }
+
+    if ( result != EOK )
+    {
+        fprintf( stderr,
+                 "cannot run the benchmark with capacity %zu: %s\n",
+                 capacity,
+                 strerror( result ) );
+    }
+
+    free( workers );
+
+    return ( result == EOK ) ? 0 : 1;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  RunBench                                                                  */
+/*!
+    Pass items through a queue and measure the hand-off rate
+
+    The RunBench function starts the producer and consumer threads,
+    waits for the producers to add all of the items, then closes the
+    queue so the consumers finish once they have removed them all.
+
+    @param[in]
+        pBench
+            pointer to the queue under test
+
+    @param[in]
+        threads
+            number of producer threads, and of consumer threads
+
+    @param[in]
+        items
+            total number of items to pass through the queue
+
+    @param[in]
+        capacity
+            queue capacity, a power of two
+
+    @retval items handed off per second
+    @retval 0.0 the queue could not be initialized, or items were lost
+
+==============================================================================*/
+static double RunBench( const Bench *pBench,
+                        size_t threads,
+                        size_t items,
+                        size_t capacity )
+{
+    double rate = 0.0;
+    double start;
+    size_t consumed = 0;
+    size_t i;
+
+    if ( pBench->init( capacity ) == EOK )
+    {
+        start = Now();
+
+        for ( i = 0; i < threads; i++ )
+        {
+            workers[i].pBench = pBench;
+            workers[i].items = items / threads +
+                               ( ( i < items % threads ) ? 1 : 0 );
+            pthread_create( &workers[i].thread, NULL, Producer, &workers[i] );
+
+            workers[threads + i].pBench = pBench;
+            workers[threads + i].items = 0;
+            pthread_create( &workers[threads + i].thread,
+                            NULL,
+                            Consumer,
+                            &workers[threads + i] );
+        }
+
+        for ( i = 0; i < threads; i++ )
+        {
+            pthread_join( workers[i].thread, NULL );
+        }
+
+        pBench->close();
+
+        for ( i = 0; i < threads; i++ )
+        {
+            pthread_join( workers[threads + i].thread, NULL );
+            consumed += workers[threads + i].items;
+        }
+
+        if ( consumed == items )
+        {
+            rate = items / ( Now() - start );
+        }
+
+        pBench->destroy();
+    }
+
+    return rate;
+}
+
+/*============================================================================*/
+/*  Producer                                                                  */
+/*!
+    Add items to the queue under test
+
+    @param[in]
+        arg
+            pointer to the Worker
+
+    @retval NULL
+
+==============================================================================*/
+static void *Producer( void *arg )
+{
+    Worker *pWorker = (Worker *)arg;
+    size_t i;
+
+    for ( i = 0; i < pWorker->items; i++ )
+    {
+        /* the item is never dereferenced, so any non-NULL value will do */
+        pWorker->pBench->push( (void *)( i + 1 ) );
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  Consumer                                                                  */
+/*!
+    Remove items from the queue under test until it is closed and empty
+
+    @param[in]
+        arg
+            pointer to the Worker
+
+    @retval NULL
+
+==============================================================================*/
+static void *Consumer( void *arg )
+{
+    Worker *pWorker = (Worker *)arg;
+    void *item;
+
+    while ( pWorker->pBench->pop( &item ) == EOK )
+    {
+        pWorker->items++;
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  LockFreeInit                                                              */
+/*!
+    Initialize the lock-free queue
+
+    @param[in]
+        capacity
+            queue capacity
+
+    @retval EOK the queue was initialized
+    @retval other error from Queue_Init
+
+==============================================================================*/
+static int LockFreeInit( size_t capacity )
+{
+    return Queue_Init( &lockFree, capacity );
+}
+
+/*============================================================================*/
+/*  LockFreePush                                                              */
+/*!
+    Add an item to the lock-free queue
+
+    The LockFreePush function yields while the queue is full, so the
+    producers wait for space like those of the mutex queue.  The
+    executor runs a task itself instead when its queue is full.
+
+    @param[in]
+        item
+            item to add
+
+==============================================================================*/
+static void LockFreePush( void *item )
+{
+    while ( Queue_Push( &lockFree, item ) == EAGAIN )
+    {
+        sched_yield();
+    }
+}
+
+/*============================================================================*/
+/*  LockFreePop                                                               */
+/*!
+    Remove an item from the lock-free queue
+
+    @param[out]
+        pItem
+            pointer to a location to store the item
+
+    @retval EOK an item was removed
+    @retval ECANCELED the queue is closed and empty
+
+==============================================================================*/
+static int LockFreePop( void **pItem )
+{
+    int result;
+
+    do
+    {
+        result = Queue_Pop( &lockFree, pItem, BENCH_POP_MS );
+    } while ( result == ETIMEDOUT );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  LockFreeClose                                                             */
+/*!
+    Close the lock-free queue
+
+==============================================================================*/
+static void LockFreeClose( void )
+{
+    Queue_Close( &lockFree );
+}
+
+/*============================================================================*/
+/*  LockFreeDestroy                                                           */
+/*!
+    Release the lock-free queue
+
+==============================================================================*/
+static void LockFreeDestroy( void )
+{
+    Queue_Destroy( &lockFree );
+}
+
+/*============================================================================*/
+/*  LockedInit                                                                */
+/*!
+    Initialize the mutex queue
+
+    @param[in]
+        capacity
+            queue capacity
+
+    @retval EOK the queue was initialized
+    @retval ENOMEM cannot allocate the queue
+    @retval EINVAL invalid capacity
+
+==============================================================================*/
+static int LockedInit( size_t capacity )
+{
+    int result = EINVAL;
+
+    if ( capacity > 0 )
+    {
+        memset( &locked, 0, sizeof( LockedQueue ) );
+        locked.items = calloc( capacity, sizeof( void * ) );
+        if ( locked.items != NULL )
+        {
+            pthread_mutex_init( &locked.lock, NULL );
+            pthread_cond_init( &locked.notEmpty, NULL );
+            pthread_cond_init( &locked.notFull, NULL );
+            locked.capacity = capacity;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  LockedPush                                                                */
+/*!
+    Add an item to the mutex queue, waiting while it is full
+
+    @param[in]
+        item
+            item to add
+
+==============================================================================*/
+static void LockedPush( void *item )
+{
+    pthread_mutex_lock( &locked.lock );
+
+    while ( locked.count == locked.capacity )
+    {
+        pthread_cond_wait( &locked.notFull, &locked.lock );
+    }
+
+    locked.items[( locked.head + locked.count ) % locked.capacity] = item;
+    locked.count++;
+
+    pthread_cond_signal( &locked.notEmpty );
+    pthread_mutex_unlock( &locked.lock );
+}
+
+/*============================================================================*/
+/*  LockedPop                                                                 */
+/*!
+    Remove an item from the mutex queue, waiting while it is empty
+
+    @param[out]
+        pItem
+            pointer to a location to store the item
+
+    @retval EOK an item was removed
+    @retval ECANCELED the queue is closed and empty
+
+==============================================================================*/
+static int LockedPop( void **pItem )
+{
+    int result = ECANCELED;
+
+    pthread_mutex_lock( &locked.lock );
+
+    while ( ( locked.count == 0 ) && ( locked.closed == false ) )
+    {
+        pthread_cond_wait( &locked.notEmpty, &locked.lock );
+    }
+
+    if ( locked.count > 0 )
+    {
+        *pItem = locked.items[locked.head];
+        locked.head = ( locked.head + 1 ) % locked.capacity;
+        locked.count--;
+        pthread_cond_signal( &locked.notFull );
+        result = EOK;
+    }
+
+    pthread_mutex_unlock( &locked.lock );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  LockedClose                                                               */
+/*!
+    Close the mutex queue, waking the waiting consumers
+
+==============================================================================*/
+static void LockedClose( void )
+{
+    pthread_mutex_lock( &locked.lock );
+    locked.closed = true;
+    pthread_cond_broadcast( &locked.notEmpty );
+    pthread_mutex_unlock( &locked.lock );
+}
+
+/*============================================================================*/
+/*  LockedDestroy                                                             */
+/*!
+    Release the mutex queue
+
+==============================================================================*/
+static void LockedDestroy( void )
+{
+    pthread_cond_destroy( &locked.notFull );
+    pthread_cond_destroy( &locked.notEmpty );
+    pthread_mutex_destroy( &locked.lock );
+    free( locked.items );
+    locked.items = NULL;
+}
+
+/*============================================================================*/
+/*  Now                                                                       */
+/*!
+    Get the monotonic time in seconds
+
+    @retval current time in seconds
+
+==============================================================================*/
+static double Now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*! @}
+ * end of queue_bench group */
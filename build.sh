@@ -1,6 +1,6 @@
 #!/bin/sh
 
-sudo apt-get install gcc make m4 autoconf automake libtool lighttpd -y
+sudo apt-get install gcc make m4 autoconf automake libtool lighttpd zlib1g-dev -y
 
 basedir=`pwd`
 
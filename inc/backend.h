@@ -0,0 +1,74 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef BACKEND_H
+#define BACKEND_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include "output.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum number of procmon backends */
+#define BACKEND_MAX             8
+
+/*! maximum length of a backend instance name */
+#define BACKEND_NAME_LEN        32
+
+/*! maximum number of arguments in a backend command */
+#define BACKEND_MAX_ARGS        8
+
+/*! maximum length of a backend specification */
+#define BACKEND_SPEC_LEN        256
+
+/*! size of an argument vector for a backend action, including the
+    action option, process name and terminating NULL */
+#define BACKEND_ARGV_LEN        ( BACKEND_MAX_ARGS + 3 )
+
+/*! time in milliseconds to wait for all backends to list their processes */
+#define BACKEND_DEADLINE        2000
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int Backend_Add( const char *spec );
+int Backend_Init( size_t capacity );
+size_t Backend_Count( void );
+const char *Backend_Name( size_t instance );
+int Backend_Find( const char *procname, size_t *pInstance );
+int Backend_Command( size_t instance,
+                     char *option,
+                     char *procname,
+                     char *argv[],
+                     size_t len );
+int Backend_List( OutputFn fn, void *arg, int *pExitStatus );
+
+#endif
@@ -0,0 +1,116 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <zlib.h>
+
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! minimum body length in bytes worth compressing */
+#define COMPRESS_MIN_LENGTH     1024
+
+/*! response content encodings */
+typedef enum _CompressEncoding
+{
+    /*! no compression */
+    COMPRESS_IDENTITY = 0,
+
+    /*! gzip (RFC 1952) */
+    COMPRESS_GZIP,
+
+    /*! deflate in the zlib format (RFC 1950) */
+    COMPRESS_DEFLATE,
+
+    /*! zstd (RFC 8878), available when built with libzstd */
+    COMPRESS_ZSTD,
+
+    /*! number of content encodings */
+    COMPRESS_MAX
+
+} CompressEncoding;
+
+/*! reusable compression streams, one per encoding */
+typedef struct _Compressor
+{
+    /*! encoding of the current stream */
+    CompressEncoding encoding;
+
+    /*! gzip stream */
+    z_stream gzip;
+
+    /*! deflate stream */
+    z_stream deflate;
+
+    /*! true once the gzip stream has been initialized */
+    bool gzipInit;
+
+    /*! true once the deflate stream has been initialized */
+    bool deflateInit;
+
+#if defined(HAVE_ZSTD)
+    /*! zstd compression context */
+    ZSTD_CCtx *zstd;
+#endif
+
+} Compressor;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+CompressEncoding Compress_Negotiate( const char *acceptEncoding );
+const char *Compress_Name( CompressEncoding encoding );
+size_t Compress_Bound( CompressEncoding encoding, size_t len );
+int Compress_Begin( Compressor *pCompressor, CompressEncoding encoding );
+int Compress_Run( Compressor *pCompressor,
+                  const char *in,
+                  size_t inLen,
+                  size_t *pConsumed,
+                  char *out,
+                  size_t outSize,
+                  size_t *pProduced,
+                  bool finish );
+int Compress_Buffer( Compressor *pCompressor,
+                     CompressEncoding encoding,
+                     const char *in,
+                     size_t inLen,
+                     char *out,
+                     size_t outSize,
+                     size_t *pOutLen );
+
+#endif
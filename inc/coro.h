@@ -0,0 +1,229 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef CORO_H
+#define CORO_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <poll.h>
+#include <ucontext.h>
+#include <sys/epoll.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! coroutine function result: the coroutine is waiting */
+#define CORO_SUSPENDED      0
+
+/*! coroutine function result: the coroutine has completed */
+#define CORO_DONE           1
+
+/*! start the body of a coroutine function */
+#define CORO_BEGIN( pCoro ) \
+    switch ( ( pCoro )->resume ) { case 0:
+
+/*! suspend the coroutine until the wait it started completes.  Local
+    variables of the coroutine function do not survive the suspension */
+#define CORO_SUSPEND( pCoro ) \
+    do { \
+        ( pCoro )->resume = __LINE__; \
+        return CORO_SUSPENDED; \
+        case __LINE__:; \
+    } while ( 0 )
+
+/*! end the body of a coroutine function */
+#define CORO_END( pCoro ) \
+    } ( pCoro )->resume = -1; \
+    return CORO_DONE
+
+/*! stack size of a task */
+#define CORO_STACK_SIZE     ( 256 * 1024 )
+
+/*! maximum number of file descriptors a task polls at once */
+#define CORO_POLL_MAX       16
+
+/*! interface the event loop waits for file descriptors with */
+typedef enum _CoroIo
+{
+    /*! epoll */
+    CORO_IO_EPOLL,
+
+    /*! io_uring, with epoll as the fallback */
+    CORO_IO_URING
+
+} CoroIo;
+
+/*! reason a coroutine was resumed */
+typedef enum _CoroWake
+{
+    /*! the coroutine was started */
+    CORO_WAKE_START,
+
+    /*! the file descriptor is ready */
+    CORO_WAKE_FD,
+
+    /*! the event was signalled */
+    CORO_WAKE_EVENT,
+
+    /*! the wait timed out */
+    CORO_WAKE_TIMEOUT,
+
+    /*! the wait was cancelled */
+    CORO_WAKE_CANCEL
+
+} CoroWake;
+
+struct _Coro;
+
+/*! event coroutines can wait for, eg a state change */
+typedef struct _CoroEvent
+{
+    /*! first waiting coroutine */
+    struct _Coro *pHead;
+
+} CoroEvent;
+
+/*! stackless coroutine */
+typedef struct _Coro
+{
+    /*! coroutine function, returning CORO_SUSPENDED or CORO_DONE */
+    int (*fn)( struct _Coro *pCoro );
+
+    /*! coroutine function argument */
+    void *arg;
+
+    /*! resume point in the coroutine function */
+    int resume;
+
+    /*! reason the coroutine was resumed */
+    CoroWake wake;
+
+    /*! file descriptor the coroutine is waiting for, or -1 */
+    int fd;
+
+    /*! events the file descriptor was ready for when it woke the
+        coroutine */
+    uint32_t revents;
+
+    /*! file descriptor the coroutine last registered with epoll, which
+        may still be registered, or -1 */
+    int lastFd;
+
+    /*! monotonic time the wait times out in milliseconds, or 0 */
+    uint64_t deadlineMs;
+
+    /*! position in the timer heap plus one, or 0 */
+    size_t timer;
+
+    /*! event the coroutine is waiting for, or NULL */
+    CoroEvent *pEvent;
+
+    /*! previous coroutine waiting for the event */
+    struct _Coro *pPrev;
+
+    /*! next coroutine waiting for the event, or ready to run */
+    struct _Coro *pNext;
+
+} Coro;
+
+struct _CoroTask;
+
+/*! wait for one file descriptor of a task's poll */
+typedef struct _CoroPollWait
+{
+    /*! coroutine waiting for the descriptor */
+    Coro coro;
+
+    /*! task polling the descriptor */
+    struct _CoroTask *pTask;
+
+    /*! poll entry of the descriptor */
+    struct pollfd *pFd;
+
+} CoroPollWait;
+
+/*! task: a coroutine with its own stack, which can wait anywhere in
+    the functions it calls */
+typedef struct _CoroTask
+{
+    /*! coroutine resuming the task from the event loop */
+    Coro coro;
+
+    /*! task function */
+    void (*fn)( void *arg );
+
+    /*! task function argument */
+    void *arg;
+
+    /*! task stack, allocated when the task is first started */
+    void *pStack;
+
+    /*! saved context of the task while it waits */
+    ucontext_t context;
+
+    /*! true while the task function has not returned */
+    bool running;
+
+    /*! waits of a poll of several file descriptors */
+    CoroPollWait waits[CORO_POLL_MAX];
+
+    /*! number of waits of the poll which have not completed */
+    size_t polling;
+
+    /*! event signalled as the waits of the poll complete */
+    CoroEvent polled;
+
+} CoroTask;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int Coro_Init( size_t capacity, CoroIo io );
+CoroIo Coro_GetIo( void );
+int Coro_Start( Coro *pCoro, int (*fn)( Coro *pCoro ), void *arg );
+int Coro_WaitFd( Coro *pCoro,
+                 int fd,
+                 uint32_t events,
+                 unsigned int timeoutMs );
+int Coro_Sleep( Coro *pCoro, unsigned int timeoutMs );
+int Coro_WaitEvent( Coro *pCoro,
+                    CoroEvent *pEvent,
+                    unsigned int timeoutMs );
+void Coro_Signal( CoroEvent *pEvent );
+void Coro_Cancel( Coro *pCoro );
+int Coro_StartTask( CoroTask *pTask, void (*fn)( void *arg ), void *arg );
+Coro *Coro_Self( void );
+CoroWake Coro_Yield( void );
+int Coro_Poll( struct pollfd *fds, nfds_t nfds, int timeoutMs );
+int Coro_Run( void );
+
+#endif
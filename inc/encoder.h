@@ -0,0 +1,123 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef ENCODER_H
+#define ENCODER_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "output.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum nesting depth of encoded maps and arrays */
+#define ENCODER_MAX_DEPTH   8
+
+/*! buffer size which holds any formatted 64 bit integer */
+#define ENCODER_INT_LEN     24
+
+/*! structured output formats */
+typedef enum _EncoderFormat
+{
+    /*! JSON (RFC 8259) */
+    ENCODER_JSON = 0,
+
+    /*! CBOR (RFC 8949) */
+    ENCODER_CBOR,
+
+    /*! MessagePack */
+    ENCODER_MSGPACK,
+
+    /*! newline delimited JSON, a top level array is output one item
+        per line */
+    ENCODER_NDJSON,
+
+    /*! number of output formats */
+    ENCODER_MAX
+
+} EncoderFormat;
+
+/*! an open map or array */
+typedef struct _EncoderLevel
+{
+    /*! true for a map, false for an array */
+    bool map;
+
+    /*! number of items (keys and values for a map) in the container */
+    size_t items;
+
+    /*! number of items encoded so far */
+    size_t count;
+
+} EncoderLevel;
+
+/*! structured output encoder */
+typedef struct _Encoder
+{
+    /*! output format */
+    EncoderFormat format;
+
+    /*! output function */
+    OutputFn fn;
+
+    /*! opaque argument passed to the output function */
+    void *arg;
+
+    /*! first error returned by the output function */
+    int result;
+
+    /*! number of open containers */
+    int depth;
+
+    /*! open containers */
+    EncoderLevel stack[ENCODER_MAX_DEPTH];
+
+} Encoder;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+EncoderFormat Encoder_Negotiate( const char *accept );
+void Encoder_Init( Encoder *pEncoder,
+                   EncoderFormat format,
+                   OutputFn fn,
+                   void *arg );
+int Encoder_Map( Encoder *pEncoder, size_t pairs );
+int Encoder_Array( Encoder *pEncoder, size_t count );
+int Encoder_String( Encoder *pEncoder, const char *s );
+int Encoder_Uint( Encoder *pEncoder, uint64_t value );
+int Encoder_Int( Encoder *pEncoder, int64_t value );
+int Encoder_Bool( Encoder *pEncoder, bool value );
+size_t Encoder_FormatUint( char *buf, uint64_t value );
+size_t Encoder_FormatInt( char *buf, int64_t value );
+
+#endif
@@ -0,0 +1,98 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum number of executor worker threads */
+#define EXECUTOR_MAX_WORKERS    32
+
+/*! capacity of a worker task deque, a power of two */
+#define EXECUTOR_DEQUE_LEN      256
+
+/*! capacity of the shared submission queue, a power of two */
+#define EXECUTOR_QUEUE_LEN      256
+
+/*! maximum number of tasks a worker moves from the submission queue
+    to its own deque at once */
+#define EXECUTOR_GRAB           4
+
+/*! set of tasks which are waited for together.  A batch must be
+    zeroed, with its fd set, before its first task is submitted */
+typedef struct _ExecutorBatch
+{
+    /*! number of submitted tasks which have not completed, also used
+        as the futex word the waiting thread parks on */
+    uint32_t pending;
+
+    /*! number of tasks submitted to the batch */
+    uint32_t submitted;
+
+    /*! number of completed tasks which no longer touch the batch */
+    uint32_t released;
+
+    /*! eventfd written when the batch completes, or -1 to wake the
+        waiting thread through the futex */
+    int fd;
+
+} ExecutorBatch;
+
+/*! task run by the executor */
+typedef struct _ExecutorTask
+{
+    /*! function to run */
+    void (*fn)( void *arg );
+
+    /*! argument of the function */
+    void *arg;
+
+    /*! batch the task belongs to */
+    ExecutorBatch *pBatch;
+
+} ExecutorTask;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int Executor_Init( size_t numWorkers );
+int Executor_Submit( ExecutorBatch *pBatch, ExecutorTask *pTask );
+int Executor_Wait( ExecutorBatch *pBatch );
+bool Executor_Done( ExecutorBatch *pBatch );
+bool Executor_IsRunning( void );
+void Executor_Shutdown( void );
+
+#endif
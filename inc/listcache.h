@@ -0,0 +1,54 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef LISTCACHE_H
+#define LISTCACHE_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "compress.h"
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int ListCache_Init( size_t capacity, unsigned int ttlMs );
+int ListCache_Share( const char *name );
+int ListCache_Get( uint64_t nowUs,
+                   CompressEncoding encoding,
+                   const char **pData,
+                   size_t *pLen,
+                   CompressEncoding *pEncoding );
+int ListCache_Store( uint64_t nowUs, const char *data, size_t len );
+void ListCache_Release( void );
+void ListCache_Invalidate( void );
+uint64_t ListCache_Generation( void );
+bool ListCache_IsCurrent( uint64_t nowUs );
+
+#endif
@@ -0,0 +1,109 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "output.h"
+#include "encoder.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! request classes which metrics are accounted against */
+typedef enum _RequestClass
+{
+    /*! requests which do not match any query action */
+    REQ_CLASS_OTHER = 0,
+
+    /*! process list requests */
+    REQ_CLASS_LIST,
+
+    /*! process start requests */
+    REQ_CLASS_START,
+
+    /*! process stop requests */
+    REQ_CLASS_STOP,
+
+    /*! process restart requests */
+    REQ_CLASS_RESTART,
+
+    /*! profiler requests */
+    REQ_CLASS_PROFILE,
+
+    /*! metrics requests */
+    REQ_CLASS_METRICS,
+
+    /*! internal status requests */
+    REQ_CLASS_STATUS,
+
+    /*! health and readiness probes */
+    REQ_CLASS_HEALTH,
+
+    /*! single process requests */
+    REQ_CLASS_GET,
+
+    /*! number of request classes */
+    REQ_CLASS_MAX
+
+} RequestClass;
+
+/*! per-request measurements */
+typedef struct _RequestMetrics
+{
+    /*! request processing time in microseconds */
+    uint64_t durationUs;
+
+    /*! number of heap allocation calls made by the request */
+    uint64_t allocCalls;
+
+    /*! number of heap bytes requested by the request */
+    uint64_t allocBytes;
+
+    /*! number of write system calls made to send the response */
+    uint64_t writes;
+
+    /*! true if the request failed */
+    bool failed;
+
+} RequestMetrics;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+void Metrics_Record( RequestClass reqClass, RequestMetrics *pMetrics );
+uint64_t Metrics_GetRequestCount( RequestClass reqClass );
+const char *Metrics_ClassName( RequestClass reqClass );
+int Metrics_Output( OutputFn fn, void *arg );
+int Metrics_Encode( Encoder *pEncoder );
+
+#endif
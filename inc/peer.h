@@ -0,0 +1,62 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef PEER_H
+#define PEER_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include "output.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum number of peer fcgi_proc instances */
+#define PEER_MAX                16
+
+/*! maximum length of a peer name */
+#define PEER_NAME_LEN           32
+
+/*! default time in milliseconds to wait for the peers of a request */
+#define PEER_DEFAULT_DEADLINE   500
+
+/*! default time in milliseconds to keep a peer process list */
+#define PEER_DEFAULT_TTL        1000
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int Peer_Add( const char *spec );
+int Peer_Init( size_t capacity, unsigned int deadlineMs, unsigned int ttlMs );
+size_t Peer_Count( void );
+void Peer_Begin( void );
+void Peer_Collect( void );
+int Peer_Output( OutputFn fn, void *arg );
+
+#endif
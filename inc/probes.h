@@ -0,0 +1,96 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef PROBES_H
+#define PROBES_H
+
+/*==============================================================================
+        Static tracepoints
+
+    USDT probes in the "fcgi_proc" provider.  Each probe compiles to a
+    single nop when sys/sdt.h is available, and to nothing otherwise.
+    The probes can be listed with "bpftrace -l 'usdt:<path>:fcgi_proc:*'"
+
+    request__accept     (reqid, method)
+    query__dispatch     (reqid, action, procname)
+    spawn__start        (reqid, action, command)
+    spawn__end          (reqid, action, exit status)
+    output__first       (reqid, action)
+    request__done       (reqid, result)
+    cache__hit          (reqid, action)
+    cache__miss         (reqid, action)
+
+==============================================================================*/
+
+#if defined(HAVE_SYS_SDT_H)
+
+#include <sys/sdt.h>
+
+#define PROBE_REQUEST_ACCEPT( id, method ) \
+    DTRACE_PROBE2( fcgi_proc, request__accept, id, method )
+
+#define PROBE_QUERY_DISPATCH( id, action, procname ) \
+    DTRACE_PROBE3( fcgi_proc, query__dispatch, id, action, procname )
+
+#define PROBE_SPAWN_START( id, action, cmd ) \
+    DTRACE_PROBE3( fcgi_proc, spawn__start, id, action, cmd )
+
+#define PROBE_SPAWN_END( id, action, status ) \
+    DTRACE_PROBE3( fcgi_proc, spawn__end, id, action, status )
+
+#define PROBE_OUTPUT_FIRST( id, action ) \
+    DTRACE_PROBE2( fcgi_proc, output__first, id, action )
+
+#define PROBE_REQUEST_DONE( id, result ) \
+    DTRACE_PROBE2( fcgi_proc, request__done, id, result )
+
+#define PROBE_CACHE_HIT( id, action ) \
+    DTRACE_PROBE2( fcgi_proc, cache__hit, id, action )
+
+#define PROBE_CACHE_MISS( id, action ) \
+    DTRACE_PROBE2( fcgi_proc, cache__miss, id, action )
+
+#else
+
+/* arguments are evaluated as void so probe-only values stay "used" */
+#define PROBE_REQUEST_ACCEPT( id, method ) \
+    ( (void)(id), (void)(method) )
+#define PROBE_QUERY_DISPATCH( id, action, procname ) \
+    ( (void)(id), (void)(action), (void)(procname) )
+#define PROBE_SPAWN_START( id, action, cmd ) \
+    ( (void)(id), (void)(action), (void)(cmd) )
+#define PROBE_SPAWN_END( id, action, status ) \
+    ( (void)(id), (void)(action), (void)(status) )
+#define PROBE_OUTPUT_FIRST( id, action ) \
+    ( (void)(id), (void)(action) )
+#define PROBE_REQUEST_DONE( id, result ) \
+    ( (void)(id), (void)(result) )
+#define PROBE_CACHE_HIT( id, action ) \
+    ( (void)(id), (void)(action) )
+#define PROBE_CACHE_MISS( id, action ) \
+    ( (void)(id), (void)(action) )
+
+#endif
+
+#endif
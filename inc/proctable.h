@@ -0,0 +1,211 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef PROCTABLE_H
+#define PROCTABLE_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "encoder.h"
+#include "output.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! number of records a process table is first allocated for.  The
+    table grows as needed to hold the whole process list */
+#define PROCTABLE_INITIAL_RECORDS   64
+
+/*! maximum length of a process name */
+#define PROCTABLE_NAME_LEN      64
+
+/*! maximum length of a procmon instance name */
+#define PROCTABLE_INSTANCE_LEN  32
+
+/*! maximum length of a process state */
+#define PROCTABLE_STATE_LEN     16
+
+/*! maximum length of a process command line */
+#define PROCTABLE_EXEC_LEN      256
+
+/*! maximum length of a list cursor, the hexadecimal encoding of a
+    process name */
+#define PROCTABLE_CURSOR_LEN    ( 2 * PROCTABLE_NAME_LEN + 1 )
+
+/*! maximum length of the JSON fragment of a process record, allowing
+    for every string character to be escaped */
+#define PROCTABLE_FRAGMENT_LEN  ( 6 * ( PROCTABLE_INSTANCE_LEN + \
+                                        PROCTABLE_NAME_LEN + \
+                                        PROCTABLE_STATE_LEN + \
+                                        PROCTABLE_EXEC_LEN ) + 128 )
+
+/*! a process managed by procmon */
+typedef struct _ProcRecord
+{
+    /*! procmon instance which manages the process, or empty if fcgi_proc
+        has no backends */
+    char instance[PROCTABLE_INSTANCE_LEN];
+
+    /*! process name */
+    char name[PROCTABLE_NAME_LEN];
+
+    /*! process identifier, or 0 if the process is not running */
+    int32_t pid;
+
+    /*! number of times the process has been started */
+    uint32_t runcount;
+
+    /*! seconds since the process last changed state */
+    uint64_t since;
+
+    /*! process state, eg "running" or "stopped" */
+    char state[PROCTABLE_STATE_LEN];
+
+    /*! process command line */
+    char exec[PROCTABLE_EXEC_LEN];
+
+    /*! true if the process is restarting repeatedly */
+    bool flapping;
+
+    /*! restarts per hour over the flapping detection window */
+    uint32_t restartRate;
+
+} ProcRecord;
+
+/*! process record schema, in output order.  Each entry is
+    X( field, kind, help ) where kind is STRING, TAG (a string which is
+    left out of the record when it is empty), INT, UINT or DURATION
+    (a procmon duration string held as seconds), or FLAG or RATE for
+    fields computed by fcgi_proc rather than reported by procmon, which
+    must follow the procmon fields.  help describes the field when it is
+    output as a metric.  The parser, the structured encoders, the JSON
+    fragments and the metrics are generated from it */
+#define PROCTABLE_SCHEMA( X ) \
+    X( instance,    TAG,      "procmon instance managing the process" ) \
+    X( name,        STRING,   "Process name" ) \
+    X( pid,         INT,      "Process identifier, 0 if not running" ) \
+    X( runcount,    UINT,     "Number of times the process was started" ) \
+    X( since,       DURATION, "Seconds since the process changed state" ) \
+    X( state,       STRING,   "Process state" ) \
+    X( exec,        STRING,   "Process command line" ) \
+    X( flapping,    FLAG,     "1 if the process is restarting repeatedly" ) \
+    X( restartRate, RATE,     "Restarts per hour over the flapping window" )
+
+/*! count a process record field */
+#define PROCTABLE_COUNT_FIELD( field, kind, help )  + 1
+
+/*! number of fields in the process record schema */
+#define PROCTABLE_NUM_FIELDS    ( 0 PROCTABLE_SCHEMA( PROCTABLE_COUNT_FIELD ) )
+
+/*! pre-rendered JSON object of a process record.  The since value
+    changes on every load, so it is formatted when the fragment is
+    output, between the since start and since end offsets.  The computed
+    fields and the closing brace are appended on output */
+typedef struct _ProcFragment
+{
+    /*! JSON object text */
+    char json[PROCTABLE_FRAGMENT_LEN];
+
+    /*! length of the JSON object text */
+    size_t len;
+
+    /*! offset of the since value placeholder */
+    size_t sinceStart;
+
+    /*! offset following the since value placeholder */
+    size_t sinceEnd;
+
+    /*! true if the record has changed since the fragment was rendered */
+    bool dirty;
+
+} ProcFragment;
+
+/*! typed process table.  A zero initialized table is empty, and its
+    arrays are allocated when records are first loaded into it */
+typedef struct _ProcTable
+{
+    /*! number of records in the table */
+    size_t count;
+
+    /*! number of records the arrays of the table can hold */
+    size_t capacity;
+
+    /*! process records */
+    ProcRecord *records;
+
+    /*! JSON fragments of the process records */
+    ProcFragment *fragments;
+
+    /*! record indexes in process name order */
+    uint32_t *order;
+
+    /*! true for each record which changed in the most recent load */
+    bool *changed;
+
+    /*! true if the most recent load added, removed or renamed processes */
+    bool reindexed;
+
+    /*! number of loads, successful or not */
+    uint64_t loads;
+
+} ProcTable;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int ProcTable_Load( ProcTable *pTable, const char *json, size_t len );
+int ProcTable_Copy( ProcTable *pDest, const ProcTable *pSrc );
+const ProcRecord *ProcTable_Find( const ProcTable *pTable, const char *name );
+int ProcTable_EncodeRecord( const ProcRecord *pRecord,
+                            size_t extra,
+                            Encoder *pEncoder );
+int ProcTable_Encode( const ProcTable *pTable,
+                      size_t first,
+                      size_t count,
+                      bool sorted,
+                      Encoder *pEncoder );
+int ProcTable_Gather( const ProcTable *pTable,
+                      size_t first,
+                      size_t count,
+                      bool sorted,
+                      bool lines,
+                      OutputVFn fn,
+                      void *arg );
+int ProcTable_Seek( const ProcTable *pTable,
+                    const char *cursor,
+                    size_t *pPosition );
+int ProcTable_Cursor( const ProcTable *pTable,
+                      size_t position,
+                      char *buf,
+                      size_t len );
+int ProcTable_Metrics( const ProcTable *pTable, OutputFn fn, void *arg );
+
+#endif
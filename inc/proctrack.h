@@ -0,0 +1,82 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef PROCTRACK_H
+#define PROCTRACK_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdint.h>
+#include "proctable.h"
+#include "encoder.h"
+#include "output.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! number of minutes of restart history kept for the summary */
+#define PROCTRACK_WINDOW_MINUTES    60
+
+/*! default number of minutes of recent restarts in the summary */
+#define PROCTRACK_DEFAULT_MINUTES   10
+
+/*! maximum number of distinct process states which are counted
+    separately, further states are counted as "other" */
+#define PROCTRACK_MAX_STATES        8
+
+/*! number of minutes over which restarts are counted to detect flapping */
+#define PROCTRACK_FLAP_MINUTES      10
+
+/*! number of restarts within the flapping window at which a process is
+    considered to be flapping */
+#define PROCTRACK_FLAP_RESTARTS     5
+
+/*! maximum number of start and restart actions awaiting a transition
+    to running */
+#define PROCTRACK_MAX_PENDING       64
+
+/*! time in seconds after which an action is no longer matched to a
+    transition to running */
+#define PROCTRACK_PENDING_TIMEOUT   600
+
+/*! number of start latency histogram buckets, including +Inf */
+#define PROCTRACK_LATENCY_BUCKETS   12
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int ProcTrack_Update( ProcTable *pTable, uint64_t nowUs );
+int ProcTrack_EncodeSummary( unsigned int minutes,
+                             uint64_t nowUs,
+                             Encoder *pEncoder );
+int ProcTrack_EncodeFlapping( const ProcTable *pTable, Encoder *pEncoder );
+void ProcTrack_Action( const char *name, uint64_t nowUs );
+int ProcTrack_EncodeLatency( const char *name, Encoder *pEncoder );
+int ProcTrack_Metrics( OutputFn fn, void *arg );
+
+#endif
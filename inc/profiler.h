@@ -0,0 +1,63 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "output.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! default profiling duration in seconds */
+#define PROFILER_DEFAULT_SECONDS    10
+
+/*! maximum profiling duration in seconds */
+#define PROFILER_MAX_SECONDS        300
+
+/*! default sampling frequency in Hz of consumed CPU time */
+#define PROFILER_DEFAULT_HZ         99
+
+/*! maximum sampling frequency in Hz */
+#define PROFILER_MAX_HZ             1000
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int Profiler_RegisterThread( void );
+void Profiler_SetStack( const void *pStack, size_t size );
+int Profiler_Start( unsigned int seconds, unsigned int hz );
+int Profiler_Stop( void );
+bool Profiler_IsRunning( unsigned int *remaining );
+int Profiler_Fold( OutputFn fn, void *arg );
+
+#endif
@@ -0,0 +1,94 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! size of a cache line, used to keep the queue positions apart */
+#define QUEUE_CACHE_LINE    64
+
+/*! queue cell */
+typedef struct _QueueCell
+{
+    /*! sequence number of the cell */
+    size_t seq;
+
+    /*! queued item */
+    void *item;
+
+} QueueCell;
+
+/*! bounded multi-producer, multi-consumer queue */
+typedef struct _Queue
+{
+    /*! queue cells */
+    QueueCell *cells;
+
+    /*! number of cells less one */
+    size_t mask;
+
+    /*! position of the next item to enqueue */
+    size_t enqueuePos __attribute__(( aligned( QUEUE_CACHE_LINE ) ));
+
+    /*! position of the next item to dequeue */
+    size_t dequeuePos __attribute__(( aligned( QUEUE_CACHE_LINE ) ));
+
+    /*! futex word, changed whenever parked consumers must wake */
+    uint32_t signal __attribute__(( aligned( QUEUE_CACHE_LINE ) ));
+
+    /*! number of parked, or parking, consumers */
+    uint32_t waiters;
+
+    /*! number of times a consumer polls the empty queue before parking */
+    uint32_t spins;
+
+    /*! true once the queue is closed */
+    bool closed;
+
+} Queue;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int Queue_Init( Queue *pQueue, size_t capacity );
+void Queue_Destroy( Queue *pQueue );
+int Queue_Push( Queue *pQueue, void *item );
+int Queue_TryPop( Queue *pQueue, void **pItem );
+int Queue_Pop( Queue *pQueue, void **pItem, unsigned int timeoutMs );
+void Queue_Close( Queue *pQueue );
+
+#endif
@@ -0,0 +1,119 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <fcgiapp.h>
+#include "compress.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! default size of the response assembly buffer */
+#define RESPONSE_BUFFER_SIZE    ( 256 * 1024 )
+
+/*! response assembly state */
+typedef struct _Response
+{
+    /*! preallocated response buffer */
+    char *buf;
+
+    /*! size of the response buffer */
+    size_t size;
+
+    /*! number of bytes in the response buffer */
+    size_t len;
+
+    /*! largest number of bytes held in the response buffer */
+    size_t highWater;
+
+    /*! FCGI request the response belongs to */
+    FCGX_Request *pRequest;
+
+    /*! number of write system calls made for the response */
+    uint64_t writes;
+
+    /*! number of bytes sent for the response */
+    uint64_t sent;
+
+    /*! length of the response header at the start of the buffer */
+    size_t headerLen;
+
+    /*! content encoding the body may be compressed with */
+    CompressEncoding encoding;
+
+    /*! true while the body is being compressed */
+    bool compressing;
+
+    /*! compression streams */
+    Compressor compressor;
+
+    /*! compressed output buffer */
+    char *zbuf;
+
+    /*! size of the compressed output buffer */
+    size_t zsize;
+
+    /*! true once the end of request record has been sent */
+    bool finished;
+
+} Response;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int Response_Init( Response *pResponse, size_t size );
+void Response_Begin( Response *pResponse, FCGX_Request *pRequest );
+void Response_SetEncoding( Response *pResponse, CompressEncoding encoding );
+int Response_Header( Response *pResponse,
+                     const char *header,
+                     size_t len,
+                     CompressEncoding bodyEncoding );
+const char *Response_Body( Response *pResponse, size_t *pLen );
+int Response_Write( void *arg, const char *buf, size_t len );
+int Response_WriteV( void *arg, const struct iovec *iov, int iovcnt );
+int Response_Printf( Response *pResponse, const char *format, ... )
+    __attribute__(( format( printf, 2, 3 ) ));
+char *Response_Reserve( Response *pResponse, size_t *pAvailable );
+void Response_Commit( Response *pResponse, size_t len );
+int Response_Flush( Response *pResponse );
+int Response_Splice( Response *pResponse,
+                     int fd,
+                     size_t len,
+                     size_t *pMoved );
+int Response_Finish( Response *pResponse, int appStatus );
+int Response_Discard( Response *pResponse );
+int Response_Abort( Response *pResponse );
+
+#endif
@@ -0,0 +1,80 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum number of concurrent readers */
+#define SNAPSHOT_MAX_READERS    16
+
+/*! maximum number of objects awaiting reuse */
+#define SNAPSHOT_MAX_RETIRED    4
+
+/*! an object published to lock-free readers */
+typedef struct _Snapshot
+{
+    /*! the published object */
+    void *current;
+
+    /*! publication epoch, starting at 1 */
+    uint64_t epoch;
+
+    /*! epoch announced by each reader, or 0 if the reader is idle */
+    uint64_t readers[SNAPSHOT_MAX_READERS];
+
+    /*! objects awaiting reuse */
+    void *retired[SNAPSHOT_MAX_RETIRED];
+
+    /*! epoch in which each retired object was last published */
+    uint64_t retiredEpoch[SNAPSHOT_MAX_RETIRED];
+
+    /*! number of objects awaiting reuse */
+    size_t numRetired;
+
+} Snapshot;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+void Snapshot_Init( Snapshot *pSnapshot, void *current );
+int Snapshot_Add( Snapshot *pSnapshot, void *spare );
+const void *Snapshot_Enter( Snapshot *pSnapshot, size_t reader );
+void Snapshot_Exit( Snapshot *pSnapshot, size_t reader );
+void *Snapshot_Current( Snapshot *pSnapshot );
+void *Snapshot_Reclaim( Snapshot *pSnapshot );
+void Snapshot_Publish( Snapshot *pSnapshot, void *next );
+
+#endif
@@ -0,0 +1,74 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef STATUS_H
+#define STATUS_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "output.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! preallocated buffers whose high-water marks are reported */
+typedef enum _StatusBuffer
+{
+    /*! POST data buffer */
+    STATUS_BUFFER_POST = 0,
+
+    /*! query splitting buffer */
+    STATUS_BUFFER_QUERY,
+
+    /*! response assembly buffer */
+    STATUS_BUFFER_RESPONSE,
+
+    /*! number of tracked buffers */
+    STATUS_BUFFER_MAX
+
+} StatusBuffer;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int Status_Init( size_t numWorkers );
+void Status_SetBufferSize( StatusBuffer buffer, size_t size );
+void Status_BufferUsed( StatusBuffer buffer, size_t used );
+void Status_WorkerBusy( size_t worker, uint64_t reqid );
+void Status_WorkerAction( size_t worker,
+                          const char *action,
+                          const char *procname );
+void Status_WorkerIdle( size_t worker );
+void Status_ChildStart( pid_t pid, char * const argv[] );
+void Status_ChildEnd( pid_t pid );
+int Status_Output( OutputFn fn, void *arg );
+
+#endif
@@ -0,0 +1,390 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup allocstats allocstats
+ * @brief Heap allocation accounting
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file allocstats.c
+
+    Heap Allocation Accounting
+
+    When built with ALLOC_STATS defined (the FCGI_PROC_ALLOC_STATS
+    CMake option), this module interposes malloc, calloc, realloc,
+    free and the aligned allocation functions (memalign, posix_memalign,
+    aligned_alloc, valloc and pvalloc), and counts the allocation calls
+    and requested bytes made by each thread between AllocStats_Begin and
+    AllocStats_End.
+
+    The wrappers forward to the glibc allocator entry points, so they
+    never allocate themselves, and only touch thread-local counters.
+
+    Without ALLOC_STATS the module reports no allocations.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <errno.h>
+#include "allocstats.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#if defined(ALLOC_STATS)
+
+/* glibc allocator entry points */
+extern void *__libc_malloc( size_t size );
+extern void *__libc_calloc( size_t nmemb, size_t size );
+extern void *__libc_realloc( void *ptr, size_t size );
+extern void __libc_free( void *ptr );
+extern void *__libc_memalign( size_t alignment, size_t size );
+extern void *__libc_valloc( size_t size );
+extern void *__libc_pvalloc( size_t size );
+
+#endif
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! number of allocation calls made by the calling thread */
+static __thread uint64_t allocCalls;
+
+/*! number of bytes requested by the calling thread */
+static __thread uint64_t allocBytes;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  AllocStats_Enabled                                                        */
+/*!
+    Check if allocation accounting is compiled in
+
+    @retval true allocations are being counted
+    @retval false allocations are not being counted
+
+==============================================================================*/
+bool AllocStats_Enabled( void )
+{
+#if defined(ALLOC_STATS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*============================================================================*/
+/*  AllocStats_Begin                                                          */
+/*!
+    Start counting the allocations of the calling thread
+
+    The AllocStats_Begin function resets the allocation counters
+    of the calling thread.
+
+==============================================================================*/
+void AllocStats_Begin( void )
+{
+    allocCalls = 0;
+    allocBytes = 0;
+}
+
+/*============================================================================*/
+/*  AllocStats_End                                                            */
+/*!
+    Get the allocations of the calling thread
+
+    The AllocStats_End function gets the number of allocation calls and
+    bytes requested by the calling thread since AllocStats_Begin.
+
+    @param[out]
+        pCalls
+            pointer to a location to store the number of allocation calls
+
+    @param[out]
+        pBytes
+            pointer to a location to store the number of bytes requested
+
+==============================================================================*/
+void AllocStats_End( uint64_t *pCalls, uint64_t *pBytes )
+{
+    if ( pCalls != NULL )
+    {
+        *pCalls = allocCalls;
+    }
+
+    if ( pBytes != NULL )
+    {
+        *pBytes = allocBytes;
+    }
+}
+
+#if defined(ALLOC_STATS)
+
+/*============================================================================*/
+/*  malloc                                                                    */
+/*!
+    Counting malloc wrapper
+
+    @param[in]
+        size
+            number of bytes to allocate
+
+    @retval pointer to the allocated memory
+    @retval NULL the memory could not be allocated
+
+==============================================================================*/
+void *malloc( size_t size )
+{
+    allocCalls++;
+    allocBytes += size;
+
+    return __libc_malloc( size );
+}
+
+/*============================================================================*/
+/*  calloc                                                                    */
+/*!
+    Counting calloc wrapper
+
+    @param[in]
+        nmemb
+            number of elements to allocate
+
+    @param[in]
+        size
+            size of each element
+
+    @retval pointer to the allocated memory
+    @retval NULL the memory could not be allocated
+
+==============================================================================*/
+void *calloc( size_t nmemb, size_t size )
+{
+    allocCalls++;
+    allocBytes += nmemb * size;
+
+    return __libc_calloc( nmemb, size );
+}
+
+/*============================================================================*/
+/*  realloc                                                                   */
+/*!
+    Counting realloc wrapper
+
+    @param[in]
+        ptr
+            pointer to the memory to resize
+
+    @param[in]
+        size
+            new size of the memory
+
+    @retval pointer to the reallocated memory
+    @retval NULL the memory could not be reallocated
+
+==============================================================================*/
+void *realloc( void *ptr, size_t size )
+{
+    allocCalls++;
+    allocBytes += size;
+
+    return __libc_realloc( ptr, size );
+}
+
+/*============================================================================*/
+/*  free                                                                      */
+/*!
+    free wrapper
+
+    Frees are not counted, but free must be interposed together with
+    the allocation functions.
+
+    @param[in]
+        ptr
+            pointer to the memory to free
+
+==============================================================================*/
+void free( void *ptr )
+{
+    __libc_free( ptr );
+}
+
+/*============================================================================*/
+/*  memalign                                                                  */
+/*!
+    Counting memalign wrapper
+
+    @param[in]
+        alignment
+            alignment of the memory, a power of two
+
+    @param[in]
+        size
+            number of bytes to allocate
+
+    @retval pointer to the allocated memory
+    @retval NULL the memory could not be allocated
+
+==============================================================================*/
+void *memalign( size_t alignment, size_t size )
+{
+    allocCalls++;
+    allocBytes += size;
+
+    return __libc_memalign( alignment, size );
+}
+
+/*============================================================================*/
+/*  posix_memalign                                                            */
+/*!
+    Counting posix_memalign wrapper
+
+    @param[out]
+        memptr
+            pointer to a location to store the allocated memory
+
+    @param[in]
+        alignment
+            alignment of the memory, a power of two multiple of the size
+            of a pointer
+
+    @param[in]
+        size
+            number of bytes to allocate
+
+    @retval 0 the memory was allocated
+    @retval EINVAL invalid alignment
+    @retval ENOMEM the memory could not be allocated
+
+==============================================================================*/
+int posix_memalign( void **memptr, size_t alignment, size_t size )
+{
+    int result = EINVAL;
+    void *p;
+
+    if ( ( alignment % sizeof( void * ) == 0 ) &&
+         ( alignment != 0 ) &&
+         ( ( alignment & ( alignment - 1 ) ) == 0 ) )
+    {
+        allocCalls++;
+        allocBytes += size;
+
+        p = __libc_memalign( alignment, size );
+        if ( p != NULL )
+        {
+            *memptr = p;
+            result = 0;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  aligned_alloc                                                             */
+/*!
+    Counting aligned_alloc wrapper
+
+    @param[in]
+        alignment
+            alignment of the memory, a power of two
+
+    @param[in]
+        size
+            number of bytes to allocate
+
+    @retval pointer to the allocated memory
+    @retval NULL the memory could not be allocated
+
+==============================================================================*/
+void *aligned_alloc( size_t alignment, size_t size )
+{
+    allocCalls++;
+    allocBytes += size;
+
+    return __libc_memalign( alignment, size );
+}
+
+/*============================================================================*/
+/*  valloc                                                                    */
+/*!
+    Counting valloc wrapper
+
+    @param[in]
+        size
+            number of bytes to allocate, aligned to a page
+
+    @retval pointer to the allocated memory
+    @retval NULL the memory could not be allocated
+
+==============================================================================*/
+void *valloc( size_t size )
+{
+    allocCalls++;
+    allocBytes += size;
+
+    return __libc_valloc( size );
+}
+
+/*============================================================================*/
+/*  pvalloc                                                                   */
+/*!
+    Counting pvalloc wrapper
+
+    @param[in]
+        size
+            number of bytes to allocate, rounded up to whole pages
+
+    @retval pointer to the allocated memory
+    @retval NULL the memory could not be allocated
+
+==============================================================================*/
+void *pvalloc( size_t size )
+{
+    allocCalls++;
+    allocBytes += size;
+
+    return __libc_pvalloc( size );
+}
+
+#endif
+
+/*! @}
+ * end of allocstats group */
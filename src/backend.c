@@ -0,0 +1,1364 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup backend backend
+ * @brief Multiple procmon backends
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file backend.c
+
+    procmon Backends
+
+    The backend module allows fcgi_proc to manage the processes of
+    several procmon instances on the same host, for example one per
+    tenant container.  Each backend has an instance name and the
+    procmon command line used to reach it.
+
+    The process list is requested from all backends in parallel, so a
+    list takes as long as the slowest backend rather than the sum of
+    them.  The lists are merged into one JSON array in which each
+    process is tagged with the name of its instance.  The merge also
+    rebuilds an index from process name to instance, which is used to
+    route start, stop and restart actions to the owning backend.  A
+    list which cannot be parsed is left out as a whole.
+
+    A name listed by several instances is ambiguous, so an action on it
+    must qualify the name with the instance as <instance>/<name>.
+
+    The output buffers are allocated when the module is initialized,
+    and grow to hold the largest list.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "backend.h"
+#include "proctable.h"
+#include "status.h"
+#include "health.h"
+#include "spawn.h"
+#include "coro.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! initial number of slots in the process name index */
+#define BACKEND_INDEX_SLOTS     ( 2 * PROCTABLE_INITIAL_RECORDS )
+
+/*! maximum length of the instance tag inserted in each process record */
+#define BACKEND_TAG_LEN         ( BACKEND_NAME_LEN + 32 )
+
+/*! a procmon backend */
+typedef struct _Backend
+{
+    /*! instance name */
+    char name[BACKEND_NAME_LEN];
+
+    /*! storage for the command arguments */
+    char command[BACKEND_SPEC_LEN];
+
+    /*! NULL terminated command arguments */
+    char *args[BACKEND_MAX_ARGS + 1];
+
+    /*! number of command arguments */
+    size_t numArgs;
+
+    /*! process list output buffer */
+    char *buf;
+
+    /*! size of the output buffer */
+    size_t size;
+
+    /*! length of the process list output */
+    size_t len;
+
+    /*! true if the output buffer could not be grown to hold the output */
+    bool truncated;
+
+    /*! read end of the output pipe, or -1 */
+    int fd;
+
+    /*! process id of the procmon child, or 0 */
+    pid_t pid;
+
+    /*! exit status of the procmon child, or -1 */
+    int exitStatus;
+
+} Backend;
+
+/*! a process name index entry */
+typedef struct _IndexEntry
+{
+    /*! process name, or empty if the slot is free */
+    char name[PROCTABLE_NAME_LEN];
+
+    /*! first instance listing the process */
+    size_t instance;
+
+    /*! set of the instances listing the process, one bit per instance */
+    uint32_t instances;
+
+} IndexEntry;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int Spawn( Backend *pBackend );
+static void Drain( void );
+static void Reap( Backend *pBackend );
+static int GrowBuffer( Backend *pBackend );
+static int Merge( size_t instance, OutputFn fn, void *arg, bool *pFirst );
+static int Walk( size_t instance, OutputFn fn, void *arg, bool *pFirst );
+static size_t Qualifier( const char *procname );
+static int ScanRecord( const char **pp,
+                       const char *end,
+                       char *name,
+                       size_t len );
+static const char *SkipSpace( const char *p, const char *end );
+static IndexEntry *FindEntry( const char *name, bool *pFound );
+static int GrowIndex( void );
+static uint64_t NowUs( void );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! configured backends */
+static Backend backends[BACKEND_MAX];
+
+/*! number of configured backends */
+static size_t numBackends = 0;
+
+/*! initial size of each backend output buffer */
+static size_t bufSize = 0;
+
+/*! process name to instance index built from the most recent list */
+static IndexEntry *procIndex = NULL;
+
+/*! number of slots in the process name index */
+static size_t indexSlots = 0;
+
+/*! number of processes in the index */
+static size_t numIndexed = 0;
+
+/*! true while the backends are being listed */
+static bool listing = false;
+
+/*! event signalled when a list of the backends completes */
+static CoroEvent listed;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Backend_Add                                                               */
+/*!
+    Add a procmon backend
+
+    The Backend_Add function adds a backend from a specification of the
+    form <instance>=<procmon command>, where the command is the path of
+    the procmon utility followed by any space separated arguments needed
+    to reach the instance, eg tenant1=/usr/local/bin/procmon.  Instance
+    names may only contain alphanumeric characters, '-' and '_'.
+
+    @param[in]
+        spec
+            pointer to the backend specification
+
+    @retval EOK the backend was added
+    @retval ENOSPC too many backends
+    @retval E2BIG the specification is too long
+    @retval EINVAL invalid specification
+
+==============================================================================*/
+int Backend_Add( const char *spec )
+{
+    int result = EINVAL;
+    Backend *pBackend;
+    const char *command;
+    size_t nameLen;
+    char *saveptr;
+    char *arg;
+    size_t i;
+
+    command = ( spec != NULL ) ? strchr( spec, '=' ) : NULL;
+    if ( command != NULL )
+    {
+        nameLen = command - spec;
+        command++;
+
+        result = EOK;
+        for ( i = 0; i < nameLen; i++ )
+        {
+            if ( !isalnum( (unsigned char)spec[i] ) &&
+                 ( spec[i] != '-' ) &&
+                 ( spec[i] != '_' ) )
+            {
+                result = EINVAL;
+            }
+        }
+
+        if ( ( nameLen == 0 ) || ( *command == '\0' ) )
+        {
+            result = EINVAL;
+        }
+        else if ( ( nameLen >= BACKEND_NAME_LEN ) ||
+                  ( strlen( command ) >= BACKEND_SPEC_LEN ) )
+        {
+            result = E2BIG;
+        }
+        else if ( numBackends == BACKEND_MAX )
+        {
+            result = ENOSPC;
+        }
+
+        if ( result == EOK )
+        {
+            pBackend = &backends[numBackends];
+            memset( pBackend, 0, sizeof( Backend ) );
+            memcpy( pBackend->name, spec, nameLen );
+            strcpy( pBackend->command, command );
+
+            for ( arg = strtok_r( pBackend->command, " ", &saveptr );
+                  ( arg != NULL ) && ( result == EOK );
+                  arg = strtok_r( NULL, " ", &saveptr ) )
+            {
+                if ( pBackend->numArgs == BACKEND_MAX_ARGS )
+                {
+                    result = E2BIG;
+                }
+                else
+                {
+                    pBackend->args[pBackend->numArgs++] = arg;
+                }
+            }
+
+            if ( pBackend->numArgs == 0 )
+            {
+                result = EINVAL;
+            }
+
+            if ( result == EOK )
+            {
+                pBackend->fd = -1;
+                numBackends++;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Backend_Init                                                              */
+/*!
+    Initialize the procmon backends
+
+    The Backend_Init function allocates an output buffer for each
+    configured backend.  Nothing is allocated if no backends are
+    configured.
+
+    @param[in]
+        capacity
+            initial size of each backend output buffer
+
+    @retval EOK the backends were initialized
+    @retval ENOMEM cannot allocate the output buffers
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Backend_Init( size_t capacity )
+{
+    int result = EINVAL;
+    size_t i;
+
+    if ( capacity > 0 )
+    {
+        result = EOK;
+        bufSize = capacity;
+
+        for ( i = 0; ( i < numBackends ) && ( result == EOK ); i++ )
+        {
+            backends[i].buf = malloc( capacity );
+            if ( backends[i].buf != NULL )
+            {
+                backends[i].size = capacity;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Backend_Count                                                             */
+/*!
+    Get the number of procmon backends
+
+    @retval number of configured backends.  Zero means the single
+            default procmon instance is used.
+
+==============================================================================*/
+size_t Backend_Count( void )
+{
+    return numBackends;
+}
+
+/*============================================================================*/
+/*  Backend_Name                                                              */
+/*!
+    Get the instance name of a backend
+
+    @param[in]
+        instance
+            index of the backend
+
+    @retval pointer to the instance name
+    @retval NULL invalid instance
+
+==============================================================================*/
+const char *Backend_Name( size_t instance )
+{
+    return ( instance < numBackends ) ? backends[instance].name : NULL;
+}
+
+/*============================================================================*/
+/*  Backend_Find                                                              */
+/*!
+    Find the backend which owns a process
+
+    The Backend_Find function looks up a process in the index built from
+    the most recent process list.  The name may be qualified with the
+    instance as <instance>/<name>, which is required if several
+    instances list the name.
+
+    @param[in]
+        procname
+            name of the process, optionally qualified with the instance
+
+    @param[out]
+        pInstance
+            pointer to the location to store the backend index
+
+    @retval EOK the process was found
+    @retval ENOENT the process was not in the most recent list
+    @retval EEXIST several instances list the unqualified name
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Backend_Find( const char *procname, size_t *pInstance )
+{
+    int result = EINVAL;
+    IndexEntry *pEntry;
+    size_t instance = BACKEND_MAX;
+    size_t i;
+    size_t n;
+    bool found;
+
+    if ( ( procname != NULL ) && ( pInstance != NULL ) )
+    {
+        result = ENOENT;
+
+        n = Qualifier( procname );
+        if ( n > 0 )
+        {
+            for ( i = 0; i < numBackends; i++ )
+            {
+                if ( ( strncmp( backends[i].name, procname, n ) == 0 ) &&
+                     ( backends[i].name[n] == '\0' ) )
+                {
+                    instance = i;
+                    break;
+                }
+            }
+
+            procname += n + 1;
+        }
+
+        pEntry = FindEntry( procname, &found );
+        if ( found == false )
+        {
+            result = ENOENT;
+        }
+        else if ( n > 0 )
+        {
+            if ( ( instance < numBackends ) &&
+                 ( ( pEntry->instances & ( 1U << instance ) ) != 0 ) )
+            {
+                *pInstance = instance;
+                result = EOK;
+            }
+        }
+        else if ( ( pEntry->instances & ( pEntry->instances - 1 ) ) != 0 )
+        {
+            /* the name is listed by several instances */
+            result = EEXIST;
+        }
+        else
+        {
+            *pInstance = pEntry->instance;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Backend_Command                                                           */
+/*!
+    Build the command line of a backend action
+
+    The Backend_Command function builds the argument vector which runs
+    procmon with the specified action option and process name against
+    a backend.  An instance qualifier is removed from the name.
+
+    @param[in]
+        instance
+            index of the backend
+
+    @param[in]
+        option
+            procmon action option, eg -s
+
+    @param[in]
+        procname
+            name of the process
+
+    @param[out]
+        argv
+            array to receive the NULL terminated argument vector
+
+    @param[in]
+        len
+            number of entries in the argv array
+
+    @retval EOK the command line was built
+    @retval E2BIG the argv array is too small
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Backend_Command( size_t instance,
+                     char *option,
+                     char *procname,
+                     char *argv[],
+                     size_t len )
+{
+    int result = EINVAL;
+    Backend *pBackend;
+    size_t i;
+
+    if ( ( instance < numBackends ) &&
+         ( option != NULL ) &&
+         ( procname != NULL ) &&
+         ( argv != NULL ) )
+    {
+        pBackend = &backends[instance];
+        if ( len < pBackend->numArgs + 3 )
+        {
+            result = E2BIG;
+        }
+        else
+        {
+            for ( i = 0; i < pBackend->numArgs; i++ )
+            {
+                argv[i] = pBackend->args[i];
+            }
+
+            argv[i++] = option;
+            argv[i++] = ( Qualifier( procname ) > 0 )
+                            ? procname + Qualifier( procname ) + 1
+                            : procname;
+            argv[i] = NULL;
+
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Backend_List                                                              */
+/*!
+    List the processes of all backends
+
+    The Backend_List function runs procmon against every backend at the
+    same time and waits for all of them to complete.  The process lists
+    are then merged into a single JSON array, with an "instance" field
+    added to each process, and the process name index is rebuilt.
+
+    The list of a backend which fails, or whose output is too large or
+    cannot be parsed, is left out of the array.
+
+    The output buffers are shared, so a task which finds the backends
+    being listed by another task waits for that list to complete first.
+
+    @param[in]
+        fn
+            output function
+
+    @param[in]
+        arg
+            output function argument
+
+    @param[out]
+        pExitStatus
+            set to zero if every backend was listed, otherwise to the
+            first non-zero procmon exit status, or -1 if the failure
+            was not a procmon exit status
+
+    @retval EOK the merged list was output
+    @retval EBUSY the backends are being listed, and cannot be waited for
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int Backend_List( OutputFn fn, void *arg, int *pExitStatus )
+{
+    int result = EINVAL;
+    int exitStatus = 0;
+    bool first = true;
+    size_t i;
+
+    while ( ( listing == true ) &&
+            ( Coro_WaitEvent( Coro_Self(), &listed, 0 ) == EOK ) )
+    {
+        (void)Coro_Yield();
+    }
+
+    if ( listing == true )
+    {
+        result = EBUSY;
+    }
+    else if ( ( fn != NULL ) && ( pExitStatus != NULL ) && ( bufSize > 0 ) )
+    {
+        listing = true;
+
+        for ( i = 0; i < numBackends; i++ )
+        {
+            Spawn( &backends[i] );
+        }
+
+        Drain();
+
+        if ( procIndex != NULL )
+        {
+            memset( procIndex, 0, indexSlots * sizeof( IndexEntry ) );
+        }
+
+        numIndexed = 0;
+
+        result = fn( arg, "[", 1 );
+
+        for ( i = 0; i < numBackends; i++ )
+        {
+            Reap( &backends[i] );
+
+            if ( ( result == EOK ) &&
+                 ( backends[i].exitStatus == 0 ) &&
+                 ( backends[i].truncated == false ) )
+            {
+                result = Merge( i, fn, arg, &first );
+                if ( result == EBADMSG )
+                {
+                    /* the list could not be parsed */
+                    backends[i].exitStatus = -1;
+                    result = EOK;
+                }
+            }
+            else if ( backends[i].exitStatus == 0 )
+            {
+                /* the output did not fit in the buffer */
+                backends[i].exitStatus = -1;
+            }
+
+            if ( ( exitStatus == 0 ) && ( backends[i].exitStatus != 0 ) )
+            {
+                exitStatus = backends[i].exitStatus;
+            }
+        }
+
+        if ( result == EOK )
+        {
+            result = fn( arg, "]", 1 );
+        }
+
+        *pExitStatus = exitStatus;
+
+        listing = false;
+        Coro_Signal( &listed );
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Spawn                                                                     */
+/*!
+    Start listing the processes of a backend
+
+    The Spawn function runs procmon against a backend with its output
+    connected to a non-blocking pipe, so that the output of all backends
+    can be read as it arrives.
+
+    @param[in]
+        pBackend
+            pointer to the backend
+
+    @retval EOK procmon was started
+    @retval ENOENT procmon could not be started
+
+==============================================================================*/
+static int Spawn( Backend *pBackend )
+{
+    int result;
+    char *argv[BACKEND_MAX_ARGS + 3];
+    size_t i;
+
+    pBackend->len = 0;
+    pBackend->truncated = false;
+    pBackend->fd = -1;
+    pBackend->pid = 0;
+    pBackend->exitStatus = -1;
+
+    for ( i = 0; i < pBackend->numArgs; i++ )
+    {
+        argv[i] = pBackend->args[i];
+    }
+
+    argv[i++] = "-o";
+    argv[i++] = "json";
+    argv[i] = NULL;
+
+    /* let procmon write a full list without waiting for it to be read */
+    result = Spawn_Command( argv,
+                            (int)bufSize,
+                            &pBackend->pid,
+                            &pBackend->fd );
+    if ( result == EOK )
+    {
+        Status_ChildStart( pBackend->pid, argv );
+        fcntl( pBackend->fd, F_SETFL, O_NONBLOCK );
+    }
+    else
+    {
+        Health_BackendResult( false );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Drain                                                                     */
+/*!
+    Read the output of all running backends
+
+    The Drain function waits for output from every backend which is
+    being listed and reads it into the backend output buffers until all
+    of the pipes are closed.  Inside a task the wait yields to the event
+    loop (see Coro_Poll).  A full buffer is grown to hold more
+    output.  Output which still does not fit, because the buffer cannot
+    be grown, is discarded so procmon can run to completion.  A backend
+    which has not closed its pipe within BACKEND_DEADLINE milliseconds
+    is killed, so that one stuck procmon cannot hold up the list.
+
+==============================================================================*/
+static void Drain( void )
+{
+    struct pollfd fds[BACKEND_MAX];
+    Backend *owners[BACKEND_MAX];
+    char discard[512];
+    Backend *pBackend;
+    uint64_t expiresUs = NowUs() + BACKEND_DEADLINE * 1000ULL;
+    uint64_t nowUs;
+    size_t nfds;
+    size_t i;
+    ssize_t n;
+    char *p;
+    size_t available;
+    int timeoutMs;
+    int rc;
+
+    do
+    {
+        nfds = 0;
+        for ( i = 0; i < numBackends; i++ )
+        {
+            if ( backends[i].fd != -1 )
+            {
+                fds[nfds].fd = backends[i].fd;
+                fds[nfds].events = POLLIN;
+                fds[nfds].revents = 0;
+                owners[nfds++] = &backends[i];
+            }
+        }
+
+        if ( nfds == 0 )
+        {
+            break;
+        }
+
+        /* poll at least once after the deadline for output which has
+           already arrived */
+        nowUs = NowUs();
+        timeoutMs = ( nowUs < expiresUs )
+                        ? (int)( ( expiresUs - nowUs + 999 ) / 1000 )
+                        : 0;
+
+        rc = Coro_Poll( fds, nfds, timeoutMs );
+        if ( rc > 0 )
+        {
+            for ( i = 0; i < nfds; i++ )
+            {
+                if ( fds[i].revents == 0 )
+                {
+                    continue;
+                }
+
+                pBackend = owners[i];
+                if ( ( pBackend->len == pBackend->size ) &&
+                     ( pBackend->truncated == false ) )
+                {
+                    GrowBuffer( pBackend );
+                }
+
+                available = pBackend->size - pBackend->len;
+                if ( available > 0 )
+                {
+                    p = &pBackend->buf[pBackend->len];
+                }
+                else
+                {
+                    p = discard;
+                    available = sizeof( discard );
+                }
+
+                n = read( pBackend->fd, p, available );
+                if ( n > 0 )
+                {
+                    if ( p == discard )
+                    {
+                        pBackend->truncated = true;
+                    }
+                    else
+                    {
+                        pBackend->len += n;
+                    }
+                }
+                else if ( ( n == 0 ) ||
+                          ( ( errno != EINTR ) && ( errno != EAGAIN ) ) )
+                {
+                    close( pBackend->fd );
+                    pBackend->fd = -1;
+                }
+            }
+        }
+        else if ( ( rc < 0 ) && ( errno == EINTR ) )
+        {
+            continue;
+        }
+
+        if ( ( rc <= 0 ) || ( NowUs() >= expiresUs ) )
+        {
+            /* the deadline has passed or the output cannot be waited
+               for, so give up on the backends which are still running.
+               Reap collects the killed children and records them as
+               failed */
+            for ( i = 0; i < nfds; i++ )
+            {
+                pBackend = owners[i];
+                if ( pBackend->fd != -1 )
+                {
+                    close( pBackend->fd );
+                    pBackend->fd = -1;
+
+                    if ( pBackend->pid > 0 )
+                    {
+                        kill( pBackend->pid, SIGKILL );
+                    }
+                }
+            }
+        }
+
+    } while ( nfds > 0 );
+}
+
+/*============================================================================*/
+/*  Reap                                                                      */
+/*!
+    Wait for the procmon child of a backend
+
+    The Reap function waits for the procmon child of a backend to exit
+    and records its exit status.
+
+    @param[in]
+        pBackend
+            pointer to the backend
+
+==============================================================================*/
+static void Reap( Backend *pBackend )
+{
+    int status;
+
+    if ( pBackend->pid > 0 )
+    {
+        status = Spawn_Wait( pBackend->pid );
+
+        Status_ChildEnd( pBackend->pid );
+
+        if ( WIFEXITED( status ) )
+        {
+            pBackend->exitStatus = WEXITSTATUS( status );
+        }
+
+        /* an exec failure or a crash is a backend failure */
+        Health_BackendResult( WIFEXITED( status ) &&
+                              ( WEXITSTATUS( status ) != 127 ) );
+
+        pBackend->pid = 0;
+    }
+}
+
+/*============================================================================*/
+/*  GrowBuffer                                                                */
+/*!
+    Double the size of a backend output buffer
+
+    @param[in]
+        pBackend
+            pointer to the backend
+
+    @retval EOK the buffer was grown
+    @retval ENOMEM cannot allocate the larger buffer
+
+==============================================================================*/
+static int GrowBuffer( Backend *pBackend )
+{
+    int result = ENOMEM;
+    size_t size = 2 * pBackend->size;
+    char *buf;
+
+    buf = realloc( pBackend->buf, size );
+    if ( buf != NULL )
+    {
+        pBackend->buf = buf;
+        pBackend->size = size;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Merge                                                                     */
+/*!
+    Merge the process list of a backend
+
+    The Merge function outputs each process record in the JSON array
+    listed by a backend, with an "instance" field naming the backend
+    inserted at the start of the record, and adds the process to the
+    name index.  The records are otherwise passed through unchanged.
+
+    The whole list is checked before any record is output, so a list
+    which cannot be parsed leaves both the merged array and the name
+    index as they were.
+
+    @param[in]
+        instance
+            index of the backend
+
+    @param[in]
+        fn
+            output function
+
+    @param[in]
+        arg
+            output function argument
+
+    @param[in,out]
+        pFirst
+            pointer to a flag which is true until the first record of
+            the merged array has been output
+
+    @retval EOK the records were output
+    @retval EBADMSG the list could not be parsed
+    @retval other output error
+
+==============================================================================*/
+static int Merge( size_t instance, OutputFn fn, void *arg, bool *pFirst )
+{
+    int result;
+
+    result = Walk( instance, NULL, NULL, NULL );
+    if ( result == EOK )
+    {
+        result = Walk( instance, fn, arg, pFirst );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Walk                                                                      */
+/*!
+    Visit the process records listed by a backend
+
+    The Walk function scans each process record in the JSON array
+    listed by a backend.  Without an output function it only checks
+    that the list can be parsed.  Otherwise it outputs and indexes each
+    record (see Merge).
+
+    @param[in]
+        instance
+            index of the backend
+
+    @param[in]
+        fn
+            output function, or NULL to only check the list
+
+    @param[in]
+        arg
+            output function argument
+
+    @param[in,out]
+        pFirst
+            pointer to a flag which is true until the first record of
+            the merged array has been output
+
+    @retval EOK the records were visited
+    @retval EBADMSG the list could not be parsed
+    @retval other output error
+
+==============================================================================*/
+static int Walk( size_t instance, OutputFn fn, void *arg, bool *pFirst )
+{
+    int result = EBADMSG;
+    Backend *pBackend = &backends[instance];
+    const char *end = &pBackend->buf[pBackend->len];
+    const char *p = SkipSpace( pBackend->buf, end );
+    const char *start;
+    const char *body;
+    char name[PROCTABLE_NAME_LEN];
+    char tag[BACKEND_TAG_LEN];
+    IndexEntry *pEntry;
+    bool found;
+    int n;
+
+    if ( ( p < end ) && ( *p == '[' ) )
+    {
+        p = SkipSpace( p + 1, end );
+        result = ( ( p < end ) && ( *p == ']' ) ) ? EOK : EAGAIN;
+
+        while ( result == EAGAIN )
+        {
+            start = p;
+            result = ScanRecord( &p, end, name, sizeof name );
+            if ( ( result == EOK ) && ( fn != NULL ) )
+            {
+                /* insert the instance tag after the opening brace */
+                body = SkipSpace( start + 1, p );
+                n = snprintf( tag,
+                              sizeof tag,
+                              "%s{\"instance\": \"%s\"%s",
+                              ( *pFirst == true ) ? "" : ", ",
+                              pBackend->name,
+                              ( *body == '}' ) ? "" : ", " );
+                *pFirst = false;
+
+                result = fn( arg, tag, n );
+                if ( result == EOK )
+                {
+                    result = fn( arg, body, p - body );
+                }
+
+                /* keep the index at most half full */
+                if ( 2 * ( numIndexed + 1 ) > indexSlots )
+                {
+                    GrowIndex();
+                }
+
+                pEntry = FindEntry( name, &found );
+                if ( ( pEntry != NULL ) && ( found == false ) )
+                {
+                    strcpy( pEntry->name, name );
+                    pEntry->instance = instance;
+                    numIndexed++;
+                }
+
+                if ( pEntry != NULL )
+                {
+                    pEntry->instances |= ( 1U << instance );
+                }
+            }
+
+            if ( result != EOK )
+            {
+                break;
+            }
+
+            p = SkipSpace( p, end );
+            if ( ( p < end ) && ( *p == ',' ) )
+            {
+                p = SkipSpace( p + 1, end );
+                result = EAGAIN;
+            }
+            else if ( ( p >= end ) || ( *p != ']' ) )
+            {
+                result = EBADMSG;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Qualifier                                                                 */
+/*!
+    Get the length of the instance qualifier of a process name
+
+    @param[in]
+        procname
+            process name, optionally qualified as <instance>/<name>
+
+    @retval length of the instance name
+    @retval 0 the name is not qualified
+
+==============================================================================*/
+static size_t Qualifier( const char *procname )
+{
+    const char *p = strchr( procname, '/' );
+
+    return ( p != NULL ) ? (size_t)( p - procname ) : 0;
+}
+
+/*============================================================================*/
+/*  ScanRecord                                                                */
+/*!
+    Scan a JSON process record
+
+    The ScanRecord function finds the end of the JSON object at the
+    current position, taking nested values and strings into account,
+    and extracts the value of its "name" field.
+
+    @param[in,out]
+        pp
+            pointer to the current position, which must be the opening
+            brace of the object.  It is advanced past the closing brace.
+
+    @param[in]
+        end
+            end of the JSON text
+
+    @param[out]
+        name
+            buffer to receive the process name, which is empty if the
+            record has no name or the name is too long
+
+    @param[in]
+        len
+            size of the name buffer
+
+    @retval EOK the record was scanned
+    @retval EBADMSG the record is not a complete JSON object
+
+==============================================================================*/
+static int ScanRecord( const char **pp,
+                       const char *end,
+                       char *name,
+                       size_t len )
+{
+    int result = EBADMSG;
+    const char *p = *pp;
+    const char *s;
+    size_t depth = 0;
+    bool expectKey = false;
+    bool isName = false;
+
+    name[0] = '\0';
+
+    while ( ( p < end ) && ( result == EBADMSG ) )
+    {
+        if ( ( depth == 0 ) && ( *p != '{' ) )
+        {
+            /* not an object */
+            break;
+        }
+        else if ( *p == '"' )
+        {
+            /* find the end of the string */
+            for ( s = ++p; ( p < end ) && ( *p != '"' ); p++ )
+            {
+                if ( ( *p == '\\' ) && ( p + 1 < end ) )
+                {
+                    p++;
+                }
+            }
+
+            if ( ( p < end ) && ( depth == 1 ) )
+            {
+                if ( expectKey == true )
+                {
+                    isName = ( p - s == 4 ) && ( memcmp( s, "name", 4 ) == 0 );
+                }
+                else if ( ( isName == true ) && ( (size_t)( p - s ) < len ) )
+                {
+                    memcpy( name, s, p - s );
+                    name[p - s] = '\0';
+                }
+            }
+        }
+        else if ( ( *p == '{' ) || ( *p == '[' ) )
+        {
+            if ( ++depth == 1 )
+            {
+                expectKey = true;
+            }
+        }
+        else if ( ( *p == '}' ) || ( *p == ']' ) )
+        {
+            if ( --depth == 0 )
+            {
+                *pp = p + 1;
+                result = EOK;
+            }
+        }
+        else if ( depth == 1 )
+        {
+            if ( *p == ',' )
+            {
+                expectKey = true;
+                isName = false;
+            }
+            else if ( *p == ':' )
+            {
+                expectKey = false;
+            }
+        }
+
+        p++;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SkipSpace                                                                 */
+/*!
+    Skip JSON whitespace
+
+    @param[in]
+        p
+            current position
+
+    @param[in]
+        end
+            end of the JSON text
+
+    @retval position of the next non-whitespace character, or end
+
+==============================================================================*/
+static const char *SkipSpace( const char *p, const char *end )
+{
+    while ( ( p < end ) &&
+            ( ( *p == ' ' ) || ( *p == '\t' ) ||
+              ( *p == '\n' ) || ( *p == '\r' ) ) )
+    {
+        p++;
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*  FindEntry                                                                 */
+/*!
+    Find a process in the name index
+
+    The FindEntry function uses linear probing from the FNV-1a hash of
+    the process name to find its index entry, or the free slot where
+    it would be added.
+
+    @param[in]
+        name
+            process name
+
+    @param[out]
+        pFound
+            set to true if the process is indexed, false if the returned
+            slot is free
+
+    @retval pointer to the index entry, or a free slot for it
+    @retval NULL the name is empty, or the index is full
+
+==============================================================================*/
+static IndexEntry *FindEntry( const char *name, bool *pFound )
+{
+    IndexEntry *pEntry = NULL;
+    uint32_t hash = 2166136261U;
+    const char *p;
+    size_t i;
+    size_t n;
+
+    *pFound = false;
+
+    if ( name[0] != '\0' )
+    {
+        for ( p = name; *p != '\0'; p++ )
+        {
+            hash = ( hash ^ (unsigned char)*p ) * 16777619U;
+        }
+
+        /* the index is grown to twice as many slots as processes, so
+           a free slot is found unless it could not be grown */
+        for ( n = 0, i = ( indexSlots > 0 ) ? hash % indexSlots : 0;
+              n < indexSlots;
+              n++, i = ( i + 1 ) % indexSlots )
+        {
+            if ( procIndex[i].name[0] == '\0' )
+            {
+                pEntry = &procIndex[i];
+                break;
+            }
+
+            if ( strcmp( procIndex[i].name, name ) == 0 )
+            {
+                pEntry = &procIndex[i];
+                *pFound = true;
+                break;
+            }
+        }
+    }
+
+    return pEntry;
+}
+
+/*============================================================================*/
+/*  GrowIndex                                                                 */
+/*!
+    Double the number of slots in the process name index
+
+    The GrowIndex function reallocates the name index and adds the
+    indexed processes to it again.  The index is unchanged if it cannot
+    be grown.
+
+    @retval EOK the index was grown
+    @retval ENOMEM cannot allocate the larger index
+
+==============================================================================*/
+static int GrowIndex( void )
+{
+    int result = ENOMEM;
+    IndexEntry *oldIndex = procIndex;
+    size_t oldSlots = indexSlots;
+    IndexEntry *pEntry;
+    size_t slots;
+    bool found;
+    size_t i;
+
+    slots = ( indexSlots > 0 ) ? 2 * indexSlots : BACKEND_INDEX_SLOTS;
+    procIndex = calloc( slots, sizeof( IndexEntry ) );
+    if ( procIndex != NULL )
+    {
+        indexSlots = slots;
+
+        for ( i = 0; i < oldSlots; i++ )
+        {
+            if ( oldIndex[i].name[0] != '\0' )
+            {
+                pEntry = FindEntry( oldIndex[i].name, &found );
+                *pEntry = oldIndex[i];
+            }
+        }
+
+        free( oldIndex );
+        result = EOK;
+    }
+    else
+    {
+        procIndex = oldIndex;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  NowUs                                                                     */
+/*!
+    Get the monotonic time
+
+    @retval monotonic time in microseconds
+
+==============================================================================*/
+static uint64_t NowUs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/*! @}
+ * end of backend group */
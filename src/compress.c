@@ -0,0 +1,695 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup compress compress
+ * @brief Response compression
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file compress.c
+
+    Response Compression
+
+    The compress module negotiates a content encoding from the client's
+    Accept-Encoding header, and compresses response bodies with zlib
+    (gzip and deflate) or libzstd (zstd, when available at build time).
+
+    Compression streams are created the first time an encoding is used
+    and are reset, rather than recreated, for each response, so that
+    compressing a response does not allocate memory once warmed up.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "compress.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! zlib window bits for the deflate (zlib) format */
+#define COMPRESS_DEFLATE_WINDOW     15
+
+/*! zlib window bits for the gzip format */
+#define COMPRESS_GZIP_WINDOW        ( 15 + 16 )
+
+/*! zlib memory level */
+#define COMPRESS_MEM_LEVEL          8
+
+/*! zstd compression level */
+#define COMPRESS_ZSTD_LEVEL         3
+
+/*! size of the gzip header and trailer */
+#define COMPRESS_GZIP_OVERHEAD      18
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int BeginZlib( z_stream *pStream, bool *pInit, int windowBits );
+static int RunZlib( z_stream *pStream,
+                    const char *in,
+                    size_t inLen,
+                    size_t *pConsumed,
+                    char *out,
+                    size_t outSize,
+                    size_t *pProduced,
+                    bool finish );
+static bool IsAccepted( const char *acceptEncoding, const char *name );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! content encoding names */
+static const char *encodingNames[COMPRESS_MAX] =
+{
+    "identity",
+    "gzip",
+    "deflate",
+    "zstd"
+};
+
+/*! supported encodings in order of preference */
+static const CompressEncoding preferred[] =
+{
+#if defined(HAVE_ZSTD)
+    COMPRESS_ZSTD,
+#endif
+    COMPRESS_GZIP,
+    COMPRESS_DEFLATE
+};
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Compress_Negotiate                                                        */
+/*!
+    Select a content encoding
+
+    The Compress_Negotiate function selects the preferred supported
+    content encoding which the client accepts.  Encodings with a
+    quality value of zero are not accepted.
+
+    @param[in]
+        acceptEncoding
+            pointer to the Accept-Encoding request header, or NULL
+
+    @retval the content encoding to use
+
+==============================================================================*/
+CompressEncoding Compress_Negotiate( const char *acceptEncoding )
+{
+    CompressEncoding encoding = COMPRESS_IDENTITY;
+    size_t i;
+
+    if ( acceptEncoding != NULL )
+    {
+        for ( i = 0; i < sizeof( preferred ) / sizeof( preferred[0] ); i++ )
+        {
+            if ( IsAccepted( acceptEncoding,
+                             encodingNames[preferred[i]] ) == true )
+            {
+                encoding = preferred[i];
+                break;
+            }
+        }
+    }
+
+    return encoding;
+}
+
+/*============================================================================*/
+/*  Compress_Name                                                             */
+/*!
+    Get the name of a content encoding
+
+    @param[in]
+        encoding
+            the content encoding
+
+    @retval the Content-Encoding name of the encoding
+
+==============================================================================*/
+const char *Compress_Name( CompressEncoding encoding )
+{
+    return ( encoding < COMPRESS_MAX ) ? encodingNames[encoding] : "identity";
+}
+
+/*============================================================================*/
+/*  Compress_Bound                                                            */
+/*!
+    Get the largest compressed size of a buffer
+
+    @param[in]
+        encoding
+            the content encoding
+
+    @param[in]
+        len
+            uncompressed length
+
+    @retval the largest possible compressed length
+
+==============================================================================*/
+size_t Compress_Bound( CompressEncoding encoding, size_t len )
+{
+    size_t bound = len;
+
+    switch( encoding )
+    {
+        case COMPRESS_GZIP:
+        case COMPRESS_DEFLATE:
+            bound = compressBound( len ) + COMPRESS_GZIP_OVERHEAD;
+            break;
+
+#if defined(HAVE_ZSTD)
+        case COMPRESS_ZSTD:
+            bound = ZSTD_compressBound( len );
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    return bound;
+}
+
+/*============================================================================*/
+/*  Compress_Begin                                                            */
+/*!
+    Start a compression stream
+
+    The Compress_Begin function starts a new compression stream in the
+    specified encoding.  The stream for each encoding is created on
+    first use and reset afterwards.
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+    @param[in]
+        encoding
+            the content encoding to produce
+
+    @retval EOK the stream was started
+    @retval ENOTSUP the encoding is not supported
+    @retval ENOMEM the stream could not be created
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Compress_Begin( Compressor *pCompressor, CompressEncoding encoding )
+{
+    int result = EINVAL;
+
+    if ( pCompressor != NULL )
+    {
+        switch( encoding )
+        {
+            case COMPRESS_GZIP:
+                result = BeginZlib( &pCompressor->gzip,
+                                    &pCompressor->gzipInit,
+                                    COMPRESS_GZIP_WINDOW );
+                break;
+
+            case COMPRESS_DEFLATE:
+                result = BeginZlib( &pCompressor->deflate,
+                                    &pCompressor->deflateInit,
+                                    COMPRESS_DEFLATE_WINDOW );
+                break;
+
+#if defined(HAVE_ZSTD)
+            case COMPRESS_ZSTD:
+                if ( pCompressor->zstd == NULL )
+                {
+                    pCompressor->zstd = ZSTD_createCCtx();
+                    if ( pCompressor->zstd != NULL )
+                    {
+                        ZSTD_CCtx_setParameter( pCompressor->zstd,
+                                                ZSTD_c_compressionLevel,
+                                                COMPRESS_ZSTD_LEVEL );
+                    }
+                }
+                else
+                {
+                    ZSTD_CCtx_reset( pCompressor->zstd,
+                                     ZSTD_reset_session_only );
+                }
+
+                result = ( pCompressor->zstd != NULL ) ? EOK : ENOMEM;
+                break;
+#endif
+
+            default:
+                result = ENOTSUP;
+                break;
+        }
+
+        if ( result == EOK )
+        {
+            pCompressor->encoding = encoding;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Compress_Run                                                              */
+/*!
+    Compress data into an output buffer
+
+    The Compress_Run function compresses as much input as possible into
+    the output buffer.  When finish is true the stream is ended once all
+    the input has been consumed.
+
+    @param[in]
+        pCompressor
+            pointer to the compressor started with Compress_Begin
+
+    @param[in]
+        in
+            pointer to the input data
+
+    @param[in]
+        inLen
+            number of input bytes
+
+    @param[out]
+        pConsumed
+            pointer to a location to store the number of bytes consumed
+
+    @param[in]
+        out
+            pointer to the output buffer
+
+    @param[in]
+        outSize
+            size of the output buffer
+
+    @param[out]
+        pProduced
+            pointer to a location to store the number of bytes produced
+
+    @param[in]
+        finish
+            true to end the stream after this input
+
+    @retval EOK all the input was consumed (and the stream ended)
+    @retval EAGAIN the output buffer is full, call again
+    @retval EIO compression error
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Compress_Run( Compressor *pCompressor,
+                  const char *in,
+                  size_t inLen,
+                  size_t *pConsumed,
+                  char *out,
+                  size_t outSize,
+                  size_t *pProduced,
+                  bool finish )
+{
+    int result = EINVAL;
+#if defined(HAVE_ZSTD)
+    ZSTD_inBuffer zin;
+    ZSTD_outBuffer zout;
+    size_t rc;
+#endif
+
+    if ( ( pCompressor != NULL ) &&
+         ( ( in != NULL ) || ( inLen == 0 ) ) &&
+         ( pConsumed != NULL ) &&
+         ( out != NULL ) &&
+         ( pProduced != NULL ) )
+    {
+        switch( pCompressor->encoding )
+        {
+            case COMPRESS_GZIP:
+                result = RunZlib( &pCompressor->gzip,
+                                  in, inLen, pConsumed,
+                                  out, outSize, pProduced,
+                                  finish );
+                break;
+
+            case COMPRESS_DEFLATE:
+                result = RunZlib( &pCompressor->deflate,
+                                  in, inLen, pConsumed,
+                                  out, outSize, pProduced,
+                                  finish );
+                break;
+
+#if defined(HAVE_ZSTD)
+            case COMPRESS_ZSTD:
+                zin.src = in;
+                zin.size = inLen;
+                zin.pos = 0;
+                zout.dst = out;
+                zout.size = outSize;
+                zout.pos = 0;
+
+                rc = ZSTD_compressStream2( pCompressor->zstd,
+                                           &zout,
+                                           &zin,
+                                           finish ? ZSTD_e_end
+                                                  : ZSTD_e_continue );
+                *pConsumed = zin.pos;
+                *pProduced = zout.pos;
+
+                if ( ZSTD_isError( rc ) )
+                {
+                    result = EIO;
+                }
+                else if ( finish == true )
+                {
+                    result = ( rc == 0 ) ? EOK : EAGAIN;
+                }
+                else
+                {
+                    result = ( zin.pos == zin.size ) ? EOK : EAGAIN;
+                }
+                break;
+#endif
+
+            default:
+                result = ENOTSUP;
+                break;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Compress_Buffer                                                           */
+/*!
+    Compress a complete buffer
+
+    The Compress_Buffer function compresses a complete buffer in
+    a single pass.
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+    @param[in]
+        encoding
+            the content encoding to produce
+
+    @param[in]
+        in
+            pointer to the input data
+
+    @param[in]
+        inLen
+            number of input bytes
+
+    @param[in]
+        out
+            pointer to the output buffer
+
+    @param[in]
+        outSize
+            size of the output buffer
+
+    @param[out]
+        pOutLen
+            pointer to a location to store the compressed length
+
+    @retval EOK the buffer was compressed
+    @retval E2BIG the output buffer is too small
+    @retval EINVAL invalid arguments
+    @retval other compression error
+
+==============================================================================*/
+int Compress_Buffer( Compressor *pCompressor,
+                     CompressEncoding encoding,
+                     const char *in,
+                     size_t inLen,
+                     char *out,
+                     size_t outSize,
+                     size_t *pOutLen )
+{
+    int result;
+    size_t consumed = 0;
+
+    result = Compress_Begin( pCompressor, encoding );
+    if ( result == EOK )
+    {
+        result = Compress_Run( pCompressor,
+                               in,
+                               inLen,
+                               &consumed,
+                               out,
+                               outSize,
+                               pOutLen,
+                               true );
+        if ( result == EAGAIN )
+        {
+            result = E2BIG;
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  BeginZlib                                                                 */
+/*!
+    Start a zlib compression stream
+
+    @param[in]
+        pStream
+            pointer to the zlib stream
+
+    @param[in,out]
+        pInit
+            pointer to the stream initialized flag
+
+    @param[in]
+        windowBits
+            zlib window bits selecting the gzip or zlib format
+
+    @retval EOK the stream was started
+    @retval ENOMEM the stream could not be initialized
+
+==============================================================================*/
+static int BeginZlib( z_stream *pStream, bool *pInit, int windowBits )
+{
+    int rc;
+
+    if ( *pInit == false )
+    {
+        memset( pStream, 0, sizeof( z_stream ) );
+        rc = deflateInit2( pStream,
+                           Z_DEFAULT_COMPRESSION,
+                           Z_DEFLATED,
+                           windowBits,
+                           COMPRESS_MEM_LEVEL,
+                           Z_DEFAULT_STRATEGY );
+        *pInit = ( rc == Z_OK );
+    }
+    else
+    {
+        rc = deflateReset( pStream );
+    }
+
+    return ( rc == Z_OK ) ? EOK : ENOMEM;
+}
+
+/*============================================================================*/
+/*  RunZlib                                                                   */
+/*!
+    Run a zlib compression stream
+
+    @param[in]
+        pStream
+            pointer to the zlib stream
+
+    @param[in]
+        in
+            pointer to the input data
+
+    @param[in]
+        inLen
+            number of input bytes
+
+    @param[out]
+        pConsumed
+            pointer to a location to store the number of bytes consumed
+
+    @param[in]
+        out
+            pointer to the output buffer
+
+    @param[in]
+        outSize
+            size of the output buffer
+
+    @param[out]
+        pProduced
+            pointer to a location to store the number of bytes produced
+
+    @param[in]
+        finish
+            true to end the stream after this input
+
+    @retval EOK all the input was consumed (and the stream ended)
+    @retval EAGAIN the output buffer is full, call again
+    @retval EIO compression error
+
+==============================================================================*/
+static int RunZlib( z_stream *pStream,
+                    const char *in,
+                    size_t inLen,
+                    size_t *pConsumed,
+                    char *out,
+                    size_t outSize,
+                    size_t *pProduced,
+                    bool finish )
+{
+    int result = EIO;
+    int rc;
+
+    pStream->next_in = (Bytef *)in;
+    pStream->avail_in = (uInt)inLen;
+    pStream->next_out = (Bytef *)out;
+    pStream->avail_out = (uInt)outSize;
+
+    rc = deflate( pStream, finish ? Z_FINISH : Z_NO_FLUSH );
+
+    *pConsumed = inLen - pStream->avail_in;
+    *pProduced = outSize - pStream->avail_out;
+
+    if ( rc == Z_STREAM_END )
+    {
+        result = EOK;
+    }
+    else if ( ( rc == Z_OK ) || ( rc == Z_BUF_ERROR ) )
+    {
+        if ( ( finish == false ) && ( pStream->avail_in == 0 ) )
+        {
+            result = EOK;
+        }
+        else if ( pStream->avail_out == 0 )
+        {
+            result = EAGAIN;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  IsAccepted                                                                */
+/*!
+    Check if a content encoding is accepted
+
+    The IsAccepted function searches an Accept-Encoding header for the
+    named encoding (or the "*" wildcard) with a non-zero quality value.
+
+    @param[in]
+        acceptEncoding
+            pointer to the Accept-Encoding header
+
+    @param[in]
+        name
+            name of the content encoding
+
+    @retval true the encoding is accepted
+    @retval false the encoding is not accepted
+
+==============================================================================*/
+static bool IsAccepted( const char *acceptEncoding, const char *name )
+{
+    bool accepted = false;
+    const char *p = acceptEncoding;
+    const char *q;
+    size_t namelen = strlen( name );
+    size_t n;
+
+    while ( *p != '\0' )
+    {
+        /* skip separators and whitespace */
+        p += strspn( p, " \t," );
+
+        /* get the length of the coding name */
+        n = strcspn( p, " \t,;" );
+        if ( ( ( n == namelen ) && ( strncasecmp( p, name, n ) == 0 ) ) ||
+             ( ( n == 1 ) && ( *p == '*' ) ) )
+        {
+            /* check for a zero quality value in the parameters */
+            q = p + n + strspn( p + n, " \t" );
+            accepted = true;
+            while ( *q == ';' )
+            {
+                q++;
+                q += strspn( q, " \t" );
+                if ( ( ( q[0] == 'q' ) || ( q[0] == 'Q' ) ) &&
+                     ( q[1] == '=' ) )
+                {
+                    accepted = ( strtod( &q[2], NULL ) > 0.0 );
+                }
+
+                q += strcspn( q, ",;" );
+            }
+
+            if ( n == namelen )
+            {
+                /* an explicit entry overrides the wildcard */
+                break;
+            }
+        }
+
+        p += n;
+        p += strcspn( p, "," );
+    }
+
+    return accepted;
+}
+
+/*! @}
+ * end of compress group */
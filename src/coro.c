@@ -0,0 +1,1424 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup coro coro
+ * @brief Stackless coroutines over an epoll or io_uring event loop
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file coro.c
+
+    Coroutine Runtime
+
+    The coro module runs many concurrent activities, such as requests
+    parked until a process changes state, on a single thread.  Each
+    activity is a stackless coroutine: a function which is re-entered
+    at the point it last suspended (see CORO_SUSPEND), with its state
+    held in a structure embedding the Coro rather than on a stack.  A
+    parked coroutine therefore costs only its structure, and thousands
+    of them fit in a few megabytes.
+
+    A coroutine starts one wait before it suspends: for a file
+    descriptor to become ready, for a timeout, or for an event to be
+    signalled, optionally with a timeout.  File descriptors are
+    registered with epoll as one-shot, timeouts are kept in a binary
+    heap ordered by deadline, and the coroutines waiting for an event
+    are kept in a list, so a wake-up costs the same however many
+    coroutines are parked.
+
+    Coro_Run is the event loop.  It resumes ready coroutines in the
+    order they became ready, then waits in epoll_wait until the next
+    descriptor is ready or the earliest timeout.
+
+    When io_uring is selected (see Coro_Init), a descriptor wait is
+    queued as a one-shot poll request instead, and the requests queued
+    while the ready coroutines ran are submitted by the same system
+    call which waits for the next completion (see uring.c).  A wait
+    which times out is removed from the ring, and its coroutine is
+    resumed when the removed request completes, so a stale completion
+    can never resume the coroutine's next wait.
+
+    A task is a coroutine with its own stack (see Coro_StartTask), for
+    work which waits deep inside the functions it calls, eg a request
+    handler running a command.  The task's coroutine switches to the
+    task's stack when it is resumed, and the task switches back to the
+    event loop when it waits (see Coro_Yield), so a task waits in the
+    same loop as the stackless coroutines.  Coro_Poll is a drop-in for
+    poll which waits this way inside a task.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <ucontext.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include "coro.h"
+#include "uring.h"
+#include "profiler.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! maximum number of epoll events handled per wait */
+#define CORO_MAX_EVENTS     64
+
+/*! number of io_uring submission ring entries */
+#define CORO_RING_ENTRIES   256
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int SetTimer( Coro *pCoro, unsigned int timeoutMs );
+static void ClearTimer( Coro *pCoro );
+static void HeapSwap( size_t a, size_t b );
+static void HeapUp( size_t i );
+static void HeapDown( size_t i );
+static void Unlink( Coro *pCoro );
+static void Ready( Coro *pCoro, CoroWake wake );
+static uint64_t NowMs( void );
+static int WaitEpoll( int timeoutMs );
+static int WaitRing( int timeoutMs );
+static void CancelFd( Coro *pCoro, CoroWake wake );
+static void InitCoro( Coro *pCoro, int (*fn)( Coro *pCoro ), void *arg );
+static int TaskStep( Coro *pCoro );
+static void TaskEntry( void );
+static int PollMany( CoroTask *pTask,
+                     struct pollfd *fds,
+                     nfds_t nfds,
+                     unsigned int timeoutMs );
+static int PollDone( Coro *pCoro );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! epoll instance of the event loop */
+static int epfd = -1;
+
+/*! interface the event loop waits for file descriptors with */
+static CoroIo coroIo = CORO_IO_EPOLL;
+
+/*! timer heap of waiting coroutines, earliest deadline first */
+static Coro **pTimers = NULL;
+
+/*! number of coroutines in the timer heap */
+static size_t nTimers = 0;
+
+/*! capacity of the timer heap */
+static size_t maxTimers = 0;
+
+/*! number of started coroutines which have not completed */
+static size_t nCoros = 0;
+
+/*! number of coroutines waiting for a file descriptor */
+static size_t nFdWaiters = 0;
+
+/*! first coroutine ready to run */
+static Coro *pReadyHead = NULL;
+
+/*! last coroutine ready to run */
+static Coro *pReadyTail = NULL;
+
+/*! task running on its own stack, or NULL while the event loop runs */
+static CoroTask *pRunningTask = NULL;
+
+/*! context of the event loop while a task runs */
+static ucontext_t loopContext;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Coro_Init                                                                 */
+/*!
+    Initialize the coroutine runtime
+
+    The Coro_Init function initializes the coroutine runtime.  If
+    io_uring is requested but not available, the runtime uses epoll,
+    which the caller can check with Coro_GetIo.
+
+    @param[in]
+        capacity
+            maximum number of coroutines waiting with a timeout at once
+
+    @param[in]
+        io
+            interface to wait for file descriptors with
+
+    @retval EOK the runtime was initialized
+    @retval ENOMEM cannot allocate the timer heap
+    @retval EINVAL invalid arguments
+    @retval other error from epoll_create1
+
+==============================================================================*/
+int Coro_Init( size_t capacity, CoroIo io )
+{
+    int result = EINVAL;
+
+    if ( ( epfd == -1 ) && ( capacity > 0 ) )
+    {
+        pTimers = calloc( capacity, sizeof( Coro * ) );
+        if ( pTimers != NULL )
+        {
+            maxTimers = capacity;
+            epfd = epoll_create1( EPOLL_CLOEXEC );
+            result = ( epfd != -1 ) ? EOK : errno;
+            if ( ( result == EOK ) &&
+                 ( io == CORO_IO_URING ) &&
+                 ( Uring_Init( CORO_RING_ENTRIES ) == EOK ) )
+            {
+                coroIo = CORO_IO_URING;
+            }
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Coro_GetIo                                                                */
+/*!
+    Get the interface the event loop waits for file descriptors with
+
+    @retval CORO_IO_EPOLL the event loop uses epoll
+    @retval CORO_IO_URING the event loop uses io_uring
+
+==============================================================================*/
+CoroIo Coro_GetIo( void )
+{
+    return coroIo;
+}
+
+/*============================================================================*/
+/*  Coro_Start                                                                */
+/*!
+    Start a coroutine
+
+    The Coro_Start function makes a coroutine ready to run from the
+    start of its function.  The coroutine structure must remain valid
+    until the function returns CORO_DONE.
+
+    @param[in]
+        pCoro
+            pointer to the coroutine
+
+    @param[in]
+        fn
+            coroutine function
+
+    @param[in]
+        arg
+            coroutine function argument
+
+    @retval EOK the coroutine was started
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Coro_Start( Coro *pCoro, int (*fn)( Coro *pCoro ), void *arg )
+{
+    int result = EINVAL;
+
+    if ( ( pCoro != NULL ) && ( fn != NULL ) )
+    {
+        InitCoro( pCoro, fn, arg );
+
+        nCoros++;
+        Ready( pCoro, CORO_WAKE_START );
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Coro_WaitFd                                                               */
+/*!
+    Wait for a file descriptor to become ready
+
+    The Coro_WaitFd function starts a wait for a file descriptor, which
+    takes effect when the coroutine suspends.  If the descriptor cannot
+    be waited for, eg it is a regular file, the coroutine should not
+    suspend, and can use the descriptor directly.  With io_uring such a
+    descriptor is reported ready as soon as the coroutine suspends.
+
+    @param[in]
+        pCoro
+            pointer to the waiting coroutine
+
+    @param[in]
+        fd
+            file descriptor
+
+    @param[in]
+        events
+            epoll events to wait for, eg EPOLLIN
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or 0 for no limit
+
+    @retval EOK the wait was started
+    @retval ENOSPC too many coroutines are waiting with a timeout
+    @retval EINVAL invalid arguments
+    @retval other error from epoll_ctl, eg EPERM, or from queueing the
+            io_uring request
+
+==============================================================================*/
+int Coro_WaitFd( Coro *pCoro,
+                 int fd,
+                 uint32_t events,
+                 unsigned int timeoutMs )
+{
+    int result = EINVAL;
+    struct epoll_event ev;
+    int op;
+
+    if ( ( pCoro != NULL ) &&
+         ( fd >= 0 ) &&
+         ( epfd != -1 ) &&
+         ( coroIo == CORO_IO_URING ) )
+    {
+        result = SetTimer( pCoro, timeoutMs );
+        if ( result == EOK )
+        {
+            /* the poll events share their values with the epoll events */
+            result = Uring_PollAdd( fd,
+                                    events & ~EPOLLONESHOT,
+                                    (uint64_t)(uintptr_t)pCoro );
+            if ( result != EOK )
+            {
+                ClearTimer( pCoro );
+            }
+        }
+
+        if ( result == EOK )
+        {
+            /* a timeout changes the reason the wait completes with */
+            pCoro->wake = CORO_WAKE_FD;
+            pCoro->revents = 0;
+            pCoro->fd = fd;
+            nFdWaiters++;
+        }
+    }
+    else if ( ( pCoro != NULL ) && ( fd >= 0 ) && ( epfd != -1 ) )
+    {
+        ev.events = events | EPOLLONESHOT;
+        ev.data.ptr = pCoro;
+
+        /* the descriptor this coroutine waited for last is usually
+           still registered, and any other usually is not.  A closed
+           descriptor is no longer registered, and a descriptor may be
+           registered by another coroutine, so the other operation is
+           tried if the first fails (see WaitEpoll) */
+        op = ( pCoro->lastFd == fd ) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        result = ( epoll_ctl( epfd, op, fd, &ev ) == 0 ) ? EOK : errno;
+        if ( ( result == ENOENT ) || ( result == EEXIST ) )
+        {
+            op = ( op == EPOLL_CTL_MOD ) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            result = ( epoll_ctl( epfd, op, fd, &ev ) == 0 ) ? EOK : errno;
+        }
+
+        pCoro->lastFd = ( result == EOK ) ? fd : -1;
+
+        if ( result == EOK )
+        {
+            result = SetTimer( pCoro, timeoutMs );
+        }
+
+        if ( result == EOK )
+        {
+            pCoro->revents = 0;
+            pCoro->fd = fd;
+            nFdWaiters++;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Coro_Sleep                                                                */
+/*!
+    Wait for a time
+
+    @param[in]
+        pCoro
+            pointer to the waiting coroutine
+
+    @param[in]
+        timeoutMs
+            time to wait in milliseconds
+
+    @retval EOK the wait was started
+    @retval ENOSPC too many coroutines are waiting with a timeout
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Coro_Sleep( Coro *pCoro, unsigned int timeoutMs )
+{
+    return ( ( pCoro != NULL ) && ( timeoutMs > 0 ) )
+            ? SetTimer( pCoro, timeoutMs )
+            : EINVAL;
+}
+
+/*============================================================================*/
+/*  Coro_WaitEvent                                                            */
+/*!
+    Wait for an event to be signalled
+
+    @param[in]
+        pCoro
+            pointer to the waiting coroutine
+
+    @param[in]
+        pEvent
+            pointer to the event
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or 0 for no limit
+
+    @retval EOK the wait was started
+    @retval ENOSPC too many coroutines are waiting with a timeout
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Coro_WaitEvent( Coro *pCoro,
+                    CoroEvent *pEvent,
+                    unsigned int timeoutMs )
+{
+    int result = EINVAL;
+
+    if ( ( pCoro != NULL ) && ( pEvent != NULL ) )
+    {
+        result = SetTimer( pCoro, timeoutMs );
+        if ( result == EOK )
+        {
+            pCoro->pEvent = pEvent;
+            pCoro->pPrev = NULL;
+            pCoro->pNext = pEvent->pHead;
+            if ( pEvent->pHead != NULL )
+            {
+                pEvent->pHead->pPrev = pCoro;
+            }
+
+            pEvent->pHead = pCoro;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Coro_Signal                                                               */
+/*!
+    Signal an event
+
+    The Coro_Signal function makes every coroutine waiting for the event
+    ready to run.
+
+    @param[in]
+        pEvent
+            pointer to the event
+
+==============================================================================*/
+void Coro_Signal( CoroEvent *pEvent )
+{
+    Coro *pCoro;
+
+    while ( ( pEvent != NULL ) && ( pEvent->pHead != NULL ) )
+    {
+        pCoro = pEvent->pHead;
+        Unlink( pCoro );
+        ClearTimer( pCoro );
+        Ready( pCoro, CORO_WAKE_EVENT );
+    }
+}
+
+/*============================================================================*/
+/*  Coro_Cancel                                                               */
+/*!
+    Cancel the wait of a coroutine
+
+    The Coro_Cancel function ends the wait of a coroutine early, and
+    resumes it with CORO_WAKE_CANCEL.  A coroutine which is not waiting,
+    eg it is ready to run, is not affected.  With io_uring a descriptor
+    wait is removed from the ring, and the coroutine is resumed when the
+    removed request completes.
+
+    @param[in]
+        pCoro
+            pointer to the coroutine
+
+==============================================================================*/
+void Coro_Cancel( Coro *pCoro )
+{
+    if ( pCoro != NULL )
+    {
+        if ( pCoro->fd != -1 )
+        {
+            ClearTimer( pCoro );
+            CancelFd( pCoro, CORO_WAKE_CANCEL );
+        }
+        else if ( ( pCoro->pEvent != NULL ) || ( pCoro->timer > 0 ) )
+        {
+            Unlink( pCoro );
+            ClearTimer( pCoro );
+            Ready( pCoro, CORO_WAKE_CANCEL );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Coro_StartTask                                                            */
+/*!
+    Start a task
+
+    The Coro_StartTask function makes a task ready to run its function
+    on the task's own stack of CORO_STACK_SIZE bytes.  The stack is
+    allocated when the task is first started, below a guard page, and
+    is kept to restart the task once its function has returned.  The
+    task structure must remain valid until its function returns.
+
+    @param[in]
+        pTask
+            pointer to the task
+
+    @param[in]
+        fn
+            task function
+
+    @param[in]
+        arg
+            task function argument
+
+    @retval EOK the task was started
+    @retval EBUSY the task function has not returned
+    @retval ENOMEM cannot allocate the task stack
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Coro_StartTask( CoroTask *pTask, void (*fn)( void *arg ), void *arg )
+{
+    int result = EINVAL;
+    void *pStack;
+
+    if ( ( pTask != NULL ) && ( fn != NULL ) )
+    {
+        result = ( pTask->running == false ) ? EOK : EBUSY;
+        if ( ( result == EOK ) && ( pTask->pStack == NULL ) )
+        {
+            pStack = mmap( NULL,
+                           CORO_STACK_SIZE,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+                           -1,
+                           0 );
+            if ( pStack != MAP_FAILED )
+            {
+                /* the stack grows down, towards the guard page */
+                (void)mprotect( pStack, getpagesize(), PROT_NONE );
+                pTask->pStack = pStack;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+
+        if ( ( result == EOK ) && ( getcontext( &pTask->context ) != 0 ) )
+        {
+            result = errno;
+        }
+
+        if ( result == EOK )
+        {
+            /* returning from the task function resumes the event loop */
+            pTask->context.uc_stack.ss_sp = pTask->pStack;
+            pTask->context.uc_stack.ss_size = CORO_STACK_SIZE;
+            pTask->context.uc_link = &loopContext;
+            makecontext( &pTask->context, TaskEntry, 0 );
+
+            pTask->fn = fn;
+            pTask->arg = arg;
+            pTask->running = true;
+            pTask->polling = 0;
+            pTask->polled.pHead = NULL;
+
+            result = Coro_Start( &pTask->coro, TaskStep, pTask );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Coro_Self                                                                 */
+/*!
+    Get the coroutine of the running task
+
+    The waits of a task are started on the coroutine of the task, and
+    take effect when the task yields (see Coro_Yield).
+
+    @retval pointer to the coroutine of the running task
+    @retval NULL no task is running
+
+==============================================================================*/
+Coro *Coro_Self( void )
+{
+    return ( pRunningTask != NULL ) ? &pRunningTask->coro : NULL;
+}
+
+/*============================================================================*/
+/*  Coro_Yield                                                                */
+/*!
+    Wait in a task
+
+    The Coro_Yield function switches from the running task to the event
+    loop until the wait started on the task's coroutine completes.  The
+    other coroutines and tasks run meanwhile.
+
+    @retval reason the task was resumed
+    @retval CORO_WAKE_CANCEL no task is running
+
+==============================================================================*/
+CoroWake Coro_Yield( void )
+{
+    CoroWake wake = CORO_WAKE_CANCEL;
+    CoroTask *pTask = pRunningTask;
+
+    if ( pTask != NULL )
+    {
+        swapcontext( &pTask->context, &loopContext );
+        wake = pTask->coro.wake;
+    }
+
+    return wake;
+}
+
+/*============================================================================*/
+/*  Coro_Poll                                                                 */
+/*!
+    Wait for file descriptors like poll
+
+    The Coro_Poll function waits for some of a set of file descriptors
+    to become ready, like poll.  Inside a task the task yields while it
+    waits, so the event loop goes on running.  Outside a task, with a
+    zero timeout, with more than CORO_POLL_MAX descriptors, or if a
+    descriptor cannot be waited for, it calls poll.
+
+    @param[in,out]
+        fds
+            poll entries of the descriptors, whose revents are set to
+            the events each descriptor is ready for
+
+    @param[in]
+        nfds
+            number of poll entries
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, 0 not to wait, or -1
+            for no limit
+
+    @retval number of descriptors which are ready
+    @retval 0 the wait timed out
+    @retval -1 the wait failed, with errno EINTR if it was cancelled
+
+==============================================================================*/
+int Coro_Poll( struct pollfd *fds, nfds_t nfds, int timeoutMs )
+{
+    int result = -1;
+    CoroTask *pTask = pRunningTask;
+    unsigned int waitMs = ( timeoutMs > 0 ) ? (unsigned int)timeoutMs : 0;
+    CoroWake wake;
+    bool waited = false;
+
+    if ( ( pTask != NULL ) &&
+         ( timeoutMs != 0 ) &&
+         ( nfds == 1 ) &&
+         ( fds[0].fd >= 0 ) )
+    {
+        fds[0].revents = 0;
+        if ( Coro_WaitFd( &pTask->coro,
+                          fds[0].fd,
+                          (uint32_t)fds[0].events,
+                          waitMs ) == EOK )
+        {
+            waited = true;
+            wake = Coro_Yield();
+            if ( wake == CORO_WAKE_FD )
+            {
+                fds[0].revents = (short)( pTask->coro.revents &
+                                          ( fds[0].events |
+                                            POLLERR | POLLHUP | POLLNVAL ) );
+                result = 1;
+            }
+            else if ( wake == CORO_WAKE_TIMEOUT )
+            {
+                result = 0;
+            }
+            else
+            {
+                errno = EINTR;
+            }
+        }
+    }
+    else if ( ( pTask != NULL ) &&
+              ( timeoutMs != 0 ) &&
+              ( nfds > 1 ) &&
+              ( nfds <= CORO_POLL_MAX ) )
+    {
+        result = PollMany( pTask, fds, nfds, waitMs );
+        waited = ( result != -1 ) || ( errno != EAGAIN );
+    }
+
+    if ( waited == false )
+    {
+        result = poll( fds, nfds, timeoutMs );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Coro_Run                                                                  */
+/*!
+    Run the coroutine event loop
+
+    The Coro_Run function runs the started coroutines until all of them
+    have completed.
+
+    @retval EOK every coroutine completed
+    @retval EDEADLK the remaining coroutines wait for events which no
+            coroutine can signal
+    @retval EINVAL the runtime is not initialized
+    @retval other error from epoll_wait or io_uring_enter
+
+==============================================================================*/
+int Coro_Run( void )
+{
+    int result = ( epfd != -1 ) ? EOK : EINVAL;
+    Coro *pCoro;
+    uint64_t nowMs;
+    int timeoutMs;
+
+    while ( ( result == EOK ) && ( nCoros > 0 ) )
+    {
+        while ( pReadyHead != NULL )
+        {
+            pCoro = pReadyHead;
+            pReadyHead = pCoro->pNext;
+            pCoro->pNext = NULL;
+            if ( pReadyHead == NULL )
+            {
+                pReadyTail = NULL;
+            }
+
+            if ( pCoro->fn( pCoro ) == CORO_DONE )
+            {
+                nCoros--;
+            }
+        }
+
+        if ( ( nCoros > 0 ) && ( nTimers == 0 ) && ( nFdWaiters == 0 ) )
+        {
+            result = EDEADLK;
+        }
+        else if ( nCoros > 0 )
+        {
+            timeoutMs = -1;
+            if ( nTimers > 0 )
+            {
+                nowMs = NowMs();
+                timeoutMs = ( pTimers[0]->deadlineMs > nowMs )
+                            ? (int)( pTimers[0]->deadlineMs - nowMs )
+                            : 0;
+            }
+
+            result = ( coroIo == CORO_IO_URING ) ? WaitRing( timeoutMs )
+                                                 : WaitEpoll( timeoutMs );
+
+            nowMs = NowMs();
+            while ( ( nTimers > 0 ) && ( pTimers[0]->deadlineMs <= nowMs ) )
+            {
+                pCoro = pTimers[0];
+                ClearTimer( pCoro );
+
+                if ( pCoro->fd != -1 )
+                {
+                    CancelFd( pCoro, CORO_WAKE_TIMEOUT );
+                }
+                else
+                {
+                    Unlink( pCoro );
+                    Ready( pCoro, CORO_WAKE_TIMEOUT );
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  SetTimer                                                                  */
+/*!
+    Add a coroutine to the timer heap
+
+    @param[in]
+        pCoro
+            pointer to the coroutine
+
+    @param[in]
+        timeoutMs
+            time until the wait times out in milliseconds, or 0 for no
+            timeout
+
+    @retval EOK the timer was set
+    @retval ENOSPC the timer heap is full
+
+==============================================================================*/
+static int SetTimer( Coro *pCoro, unsigned int timeoutMs )
+{
+    int result = EOK;
+
+    if ( timeoutMs > 0 )
+    {
+        if ( nTimers < maxTimers )
+        {
+            pCoro->deadlineMs = NowMs() + timeoutMs;
+            pTimers[nTimers++] = pCoro;
+            pCoro->timer = nTimers;
+            HeapUp( nTimers - 1 );
+        }
+        else
+        {
+            result = ENOSPC;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ClearTimer                                                                */
+/*!
+    Remove a coroutine from the timer heap, if it is in it
+
+    @param[in]
+        pCoro
+            pointer to the coroutine
+
+==============================================================================*/
+static void ClearTimer( Coro *pCoro )
+{
+    size_t i;
+
+    if ( pCoro->timer > 0 )
+    {
+        i = pCoro->timer - 1;
+        nTimers--;
+        if ( i != nTimers )
+        {
+            HeapSwap( i, nTimers );
+            HeapDown( i );
+            HeapUp( i );
+        }
+
+        pCoro->timer = 0;
+        pCoro->deadlineMs = 0;
+    }
+}
+
+/*============================================================================*/
+/*  HeapSwap                                                                  */
+/*!
+    Swap two entries of the timer heap
+
+    @param[in]
+        a
+            index of the first entry
+
+    @param[in]
+        b
+            index of the second entry
+
+==============================================================================*/
+static void HeapSwap( size_t a, size_t b )
+{
+    Coro *pCoro = pTimers[a];
+
+    pTimers[a] = pTimers[b];
+    pTimers[b] = pCoro;
+    pTimers[a]->timer = a + 1;
+    pTimers[b]->timer = b + 1;
+}
+
+/*============================================================================*/
+/*  HeapUp                                                                    */
+/*!
+    Move a timer heap entry towards the root until the heap is ordered
+
+    @param[in]
+        i
+            index of the entry
+
+==============================================================================*/
+static void HeapUp( size_t i )
+{
+    while ( ( i > 0 ) &&
+            ( pTimers[i]->deadlineMs < pTimers[( i - 1 ) / 2]->deadlineMs ) )
+    {
+        HeapSwap( i, ( i - 1 ) / 2 );
+        i = ( i - 1 ) / 2;
+    }
+}
+
+/*============================================================================*/
+/*  HeapDown                                                                  */
+/*!
+    Move a timer heap entry away from the root until the heap is ordered
+
+    @param[in]
+        i
+            index of the entry
+
+==============================================================================*/
+static void HeapDown( size_t i )
+{
+    size_t child;
+    bool ordered = false;
+
+    while ( ( ordered == false ) && ( ( 2 * i ) + 1 < nTimers ) )
+    {
+        child = ( 2 * i ) + 1;
+        if ( ( child + 1 < nTimers ) &&
+             ( pTimers[child + 1]->deadlineMs < pTimers[child]->deadlineMs ) )
+        {
+            child++;
+        }
+
+        if ( pTimers[child]->deadlineMs < pTimers[i]->deadlineMs )
+        {
+            HeapSwap( i, child );
+            i = child;
+        }
+        else
+        {
+            ordered = true;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Unlink                                                                    */
+/*!
+    Remove a coroutine from the list of its event, if it is waiting for
+    one
+
+    @param[in]
+        pCoro
+            pointer to the coroutine
+
+==============================================================================*/
+static void Unlink( Coro *pCoro )
+{
+    if ( pCoro->pEvent != NULL )
+    {
+        if ( pCoro->pPrev != NULL )
+        {
+            pCoro->pPrev->pNext = pCoro->pNext;
+        }
+        else
+        {
+            pCoro->pEvent->pHead = pCoro->pNext;
+        }
+
+        if ( pCoro->pNext != NULL )
+        {
+            pCoro->pNext->pPrev = pCoro->pPrev;
+        }
+
+        pCoro->pEvent = NULL;
+        pCoro->pPrev = NULL;
+        pCoro->pNext = NULL;
+    }
+}
+
+/*============================================================================*/
+/*  Ready                                                                     */
+/*!
+    Add a coroutine to the end of the ready list
+
+    @param[in]
+        pCoro
+            pointer to the coroutine
+
+    @param[in]
+        wake
+            reason the coroutine is resumed
+
+==============================================================================*/
+static void Ready( Coro *pCoro, CoroWake wake )
+{
+    pCoro->wake = wake;
+    pCoro->pNext = NULL;
+
+    if ( pReadyTail != NULL )
+    {
+        pReadyTail->pNext = pCoro;
+    }
+    else
+    {
+        pReadyHead = pCoro;
+    }
+
+    pReadyTail = pCoro;
+}
+
+/*============================================================================*/
+/*  WaitEpoll                                                                 */
+/*!
+    Wait for file descriptors with epoll
+
+    The WaitEpoll function waits until a descriptor is ready or the
+    timeout expires, and makes the coroutines of the ready descriptors
+    ready to run.
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or -1 for no limit
+
+    @retval EOK the wait completed, timed out, or was interrupted
+    @retval other error from epoll_wait
+
+==============================================================================*/
+static int WaitEpoll( int timeoutMs )
+{
+    int result = EOK;
+    struct epoll_event events[CORO_MAX_EVENTS];
+    Coro *pCoro;
+    int n;
+    int i;
+
+    n = epoll_wait( epfd, events, CORO_MAX_EVENTS, timeoutMs );
+    if ( ( n < 0 ) && ( errno != EINTR ) )
+    {
+        result = errno;
+    }
+
+    for ( i = 0; i < n; i++ )
+    {
+        pCoro = events[i].data.ptr;
+        if ( pCoro->fd != -1 )
+        {
+            pCoro->revents = events[i].events;
+
+            /* a descriptor which has hung up is usually closed next */
+            if ( ( events[i].events & ( EPOLLHUP | EPOLLERR ) ) != 0 )
+            {
+                pCoro->lastFd = -1;
+            }
+
+            pCoro->fd = -1;
+            nFdWaiters--;
+            ClearTimer( pCoro );
+            Ready( pCoro, CORO_WAKE_FD );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WaitRing                                                                  */
+/*!
+    Wait for file descriptors with io_uring
+
+    The WaitRing function submits the queued poll requests, waits until
+    one completes or the timeout expires, and makes the coroutines of
+    the completed requests ready to run.  A request removed because its
+    wait timed out completes with -ECANCELED, and resumes its coroutine
+    with CORO_WAKE_TIMEOUT.
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or -1 for no limit
+
+    @retval EOK the wait completed, timed out, or was interrupted
+    @retval other error from io_uring_enter
+
+==============================================================================*/
+static int WaitRing( int timeoutMs )
+{
+    int result;
+    uint64_t userData;
+    int32_t res;
+    Coro *pCoro;
+
+    result = Uring_Wait( timeoutMs );
+
+    while ( Uring_Reap( &userData, &res ) == EOK )
+    {
+        /* removals complete with user data 0 */
+        pCoro = (Coro *)(uintptr_t)userData;
+        if ( ( pCoro != NULL ) && ( pCoro->fd != -1 ) )
+        {
+            pCoro->revents = ( res > 0 ) ? (uint32_t)res : 0;
+            pCoro->fd = -1;
+            nFdWaiters--;
+            ClearTimer( pCoro );
+            Ready( pCoro, pCoro->wake );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CancelFd                                                                  */
+/*!
+    Cancel the file descriptor wait of a coroutine which timed out or
+    was cancelled
+
+    With epoll the descriptor is removed, so a late readiness cannot
+    resume the coroutine, and the coroutine is made ready to run.  With
+    io_uring the poll request is removed, and the coroutine stays
+    waiting until the removed request completes.
+
+    @param[in]
+        pCoro
+            pointer to the coroutine
+
+    @param[in]
+        wake
+            reason the coroutine is resumed
+
+==============================================================================*/
+static void CancelFd( Coro *pCoro, CoroWake wake )
+{
+    if ( coroIo == CORO_IO_URING )
+    {
+        pCoro->wake = wake;
+        (void)Uring_PollRemove( (uint64_t)(uintptr_t)pCoro );
+    }
+    else
+    {
+        epoll_ctl( epfd, EPOLL_CTL_DEL, pCoro->fd, NULL );
+        pCoro->fd = -1;
+        pCoro->lastFd = -1;
+        nFdWaiters--;
+        Ready( pCoro, wake );
+    }
+}
+
+/*============================================================================*/
+/*  InitCoro                                                                  */
+/*!
+    Initialize a coroutine to run from the start of its function
+
+    @param[in]
+        pCoro
+            pointer to the coroutine
+
+    @param[in]
+        fn
+            coroutine function
+
+    @param[in]
+        arg
+            coroutine function argument
+
+==============================================================================*/
+static void InitCoro( Coro *pCoro, int (*fn)( Coro *pCoro ), void *arg )
+{
+    pCoro->fn = fn;
+    pCoro->arg = arg;
+    pCoro->resume = 0;
+    pCoro->fd = -1;
+    pCoro->lastFd = -1;
+    pCoro->revents = 0;
+    pCoro->deadlineMs = 0;
+    pCoro->timer = 0;
+    pCoro->pEvent = NULL;
+    pCoro->pPrev = NULL;
+    pCoro->pNext = NULL;
+}
+
+/*============================================================================*/
+/*  TaskStep                                                                  */
+/*!
+    Run a task until it waits
+
+    The TaskStep coroutine switches to the stack of its task, and back
+    to the event loop when the task waits or its function returns.  The
+    profiler follows the frames of the task's stack while it runs.
+
+    @param[in]
+        pCoro
+            pointer to the coroutine, with the CoroTask as its argument
+
+    @retval CORO_SUSPENDED the task is waiting
+    @retval CORO_DONE the task function has returned
+
+==============================================================================*/
+static int TaskStep( Coro *pCoro )
+{
+    CoroTask *pTask = pCoro->arg;
+
+    pRunningTask = pTask;
+    Profiler_SetStack( pTask->pStack, CORO_STACK_SIZE );
+
+    swapcontext( &loopContext, &pTask->context );
+
+    Profiler_SetStack( NULL, 0 );
+    pRunningTask = NULL;
+
+    return ( pTask->running == true ) ? CORO_SUSPENDED : CORO_DONE;
+}
+
+/*============================================================================*/
+/*  TaskEntry                                                                 */
+/*!
+    Run the function of the running task on its stack
+
+    The event loop resumes when TaskEntry returns (see Coro_StartTask).
+
+==============================================================================*/
+static void TaskEntry( void )
+{
+    CoroTask *pTask = pRunningTask;
+
+    pTask->fn( pTask->arg );
+    pTask->running = false;
+}
+
+/*============================================================================*/
+/*  PollMany                                                                  */
+/*!
+    Wait in a task for some of several file descriptors to become ready
+
+    The PollMany function starts a wait for each descriptor, with a
+    coroutine of the task which records the events its descriptor is
+    ready for, and waits until one of them completes or the timeout
+    expires.  The waits which have not completed are then cancelled.
+
+    @param[in]
+        pTask
+            pointer to the running task
+
+    @param[in,out]
+        fds
+            poll entries of the descriptors
+
+    @param[in]
+        nfds
+            number of poll entries, up to CORO_POLL_MAX
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or 0 for no limit
+
+    @retval number of descriptors which are ready
+    @retval 0 the wait timed out
+    @retval -1 the wait was cancelled (errno EINTR), or a descriptor
+            cannot be waited for (errno EAGAIN)
+
+==============================================================================*/
+static int PollMany( CoroTask *pTask,
+                     struct pollfd *fds,
+                     nfds_t nfds,
+                     unsigned int timeoutMs )
+{
+    int result = 0;
+    CoroPollWait *pWait;
+    CoroWake wake = CORO_WAKE_TIMEOUT;
+    bool armed = true;
+    size_t n = 0;
+    nfds_t i;
+
+    for ( i = 0; ( i < nfds ) && ( armed == true ); i++ )
+    {
+        fds[i].revents = 0;
+        if ( fds[i].fd >= 0 )
+        {
+            pWait = &pTask->waits[n];
+            pWait->pTask = pTask;
+            pWait->pFd = &fds[i];
+            InitCoro( &pWait->coro, PollDone, pWait );
+            armed = ( Coro_WaitFd( &pWait->coro,
+                                   fds[i].fd,
+                                   (uint32_t)fds[i].events,
+                                   0 ) == EOK );
+            if ( armed == true )
+            {
+                nCoros++;
+                pTask->polling++;
+                n++;
+            }
+        }
+    }
+
+    if ( ( armed == true ) && ( n > 0 ) )
+    {
+        if ( Coro_WaitEvent( &pTask->coro, &pTask->polled, timeoutMs ) == EOK )
+        {
+            wake = Coro_Yield();
+        }
+    }
+    else if ( ( armed == true ) && ( timeoutMs > 0 ) )
+    {
+        if ( Coro_Sleep( &pTask->coro, timeoutMs ) == EOK )
+        {
+            wake = Coro_Yield();
+        }
+    }
+
+    /* end the waits which have not completed.  A removed epoll wait
+       can never complete, so it ends at once */
+    for ( i = 0; i < n; i++ )
+    {
+        pWait = &pTask->waits[i];
+        if ( ( pWait->coro.fd != -1 ) && ( coroIo == CORO_IO_EPOLL ) )
+        {
+            epoll_ctl( epfd, EPOLL_CTL_DEL, pWait->coro.fd, NULL );
+            pWait->coro.fd = -1;
+            nFdWaiters--;
+            nCoros--;
+            pTask->polling--;
+        }
+        else if ( pWait->coro.fd != -1 )
+        {
+            Coro_Cancel( &pWait->coro );
+        }
+    }
+
+    while ( pTask->polling > 0 )
+    {
+        if ( Coro_WaitEvent( &pTask->coro, &pTask->polled, 0 ) == EOK )
+        {
+            (void)Coro_Yield();
+        }
+    }
+
+    for ( i = 0; i < nfds; i++ )
+    {
+        if ( fds[i].revents != 0 )
+        {
+            result++;
+        }
+    }
+
+    if ( armed == false )
+    {
+        errno = EAGAIN;
+        result = -1;
+    }
+    else if ( ( result == 0 ) && ( wake == CORO_WAKE_CANCEL ) )
+    {
+        errno = EINTR;
+        result = -1;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  PollDone                                                                  */
+/*!
+    Complete the wait for one file descriptor of a task's poll
+
+    The PollDone coroutine records the events its descriptor is ready
+    for, and wakes the polling task.
+
+    @param[in]
+        pCoro
+            pointer to the coroutine, with the CoroPollWait as its
+            argument
+
+    @retval CORO_DONE the wait is complete
+
+==============================================================================*/
+static int PollDone( Coro *pCoro )
+{
+    CoroPollWait *pWait = pCoro->arg;
+
+    pWait->pFd->revents = (short)( pCoro->revents &
+                                   ( pWait->pFd->events |
+                                     POLLERR | POLLHUP | POLLNVAL ) );
+    pWait->pTask->polling--;
+    Coro_Signal( &pWait->pTask->polled );
+
+    return CORO_DONE;
+}
+
+/*============================================================================*/
+/*  NowMs                                                                     */
+/*!
+    Get the monotonic time in milliseconds
+
+    @retval current monotonic time in milliseconds
+
+==============================================================================*/
+static uint64_t NowMs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( (uint64_t)ts.tv_sec * 1000ULL ) +
+           ( (uint64_t)ts.tv_nsec / 1000000ULL );
+}
+
+/*! @}
+ * end of coro group */
@@ -0,0 +1,1079 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup encoder encoder
+ * @brief Structured output encoder
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file encoder.c
+
+    Structured Output Encoder
+
+    The encoder module writes maps, arrays, strings and integers in JSON,
+    CBOR or MessagePack, so that a record is described once and can be
+    output in any of the formats.
+
+    The NDJSON format is JSON in which the items of a top level array
+    are output one per line, without the enclosing brackets, so that
+    a client can process each record as soon as its line arrives.
+
+    Containers are declared with their number of items, as CBOR and
+    MessagePack require.  The JSON encoder uses the counts to place the
+    separators and to close each container after its last item.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "encoder.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! CBOR major types */
+#define CBOR_UINT       0
+#define CBOR_NEGINT     1
+#define CBOR_TEXT       3
+#define CBOR_ARRAY      4
+#define CBOR_MAP        5
+
+/*! CBOR simple values */
+#define CBOR_FALSE      0xf4
+#define CBOR_TRUE       0xf5
+
+/*! MessagePack boolean values */
+#define MSGPACK_FALSE   0xc2
+#define MSGPACK_TRUE    0xc3
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! media type of an output format */
+typedef struct _MediaType
+{
+    /*! media type name */
+    const char *name;
+
+    /*! output format */
+    EncoderFormat format;
+
+} MediaType;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void Put( Encoder *pEncoder, const void *buf, size_t len );
+static bool IsJSON( Encoder *pEncoder );
+static bool IsLines( Encoder *pEncoder, EncoderLevel *pLevel );
+static void BeginItem( Encoder *pEncoder );
+static void EndItem( Encoder *pEncoder );
+static void Open( Encoder *pEncoder, bool map, size_t items );
+static void PutCBORHead( Encoder *pEncoder, int major, uint64_t value );
+static void PutMsgPackHead( Encoder *pEncoder,
+                            uint8_t fix,
+                            uint8_t fixMax,
+                            uint8_t code8,
+                            uint8_t code16,
+                            uint8_t code32,
+                            uint64_t value );
+static void PutBigEndian( Encoder *pEncoder,
+                          uint8_t code,
+                          uint64_t value,
+                          size_t len );
+static void PutJSONString( Encoder *pEncoder, const char *s );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! media types which select an output format */
+static const MediaType mediaTypes[] =
+{
+    { "application/json", ENCODER_JSON },
+    { "application/cbor", ENCODER_CBOR },
+    { "application/msgpack", ENCODER_MSGPACK },
+    { "application/x-msgpack", ENCODER_MSGPACK },
+    { "application/vnd.msgpack", ENCODER_MSGPACK },
+    { "application/x-ndjson", ENCODER_NDJSON },
+    { "application/ndjson", ENCODER_NDJSON }
+};
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Encoder_Negotiate                                                         */
+/*!
+    Select an output format
+
+    The Encoder_Negotiate function selects the output format with the
+    highest quality value in an Accept header.  JSON is selected if no
+    supported binary format is preferred.
+
+    @param[in]
+        accept
+            pointer to the Accept request header, or NULL
+
+    @retval the output format to use
+
+==============================================================================*/
+EncoderFormat Encoder_Negotiate( const char *accept )
+{
+    EncoderFormat format = ENCODER_JSON;
+    const char *p = accept;
+    const char *q;
+    double best = 0.0;
+    double quality;
+    size_t n;
+    size_t i;
+
+    while ( ( p != NULL ) && ( *p != '\0' ) )
+    {
+        p += strspn( p, " \t," );
+        n = strcspn( p, " \t,;" );
+
+        /* get the quality value of the media range */
+        quality = 1.0;
+        q = p + n;
+        while ( ( *q != '\0' ) && ( *q != ',' ) )
+        {
+            q += strspn( q, " \t;" );
+            if ( ( ( q[0] == 'q' ) || ( q[0] == 'Q' ) ) && ( q[1] == '=' ) )
+            {
+                quality = strtod( &q[2], NULL );
+            }
+
+            q += strcspn( q, ",;" );
+        }
+
+        for ( i = 0; i < sizeof( mediaTypes ) / sizeof( MediaType ); i++ )
+        {
+            if ( ( strlen( mediaTypes[i].name ) == n ) &&
+                 ( strncasecmp( p, mediaTypes[i].name, n ) == 0 ) &&
+                 ( quality > best ) )
+            {
+                best = quality;
+                format = mediaTypes[i].format;
+            }
+        }
+
+        p = q;
+    }
+
+    return format;
+}
+
+/*============================================================================*/
+/*  Encoder_Init                                                              */
+/*!
+    Initialize an encoder
+
+    @param[in]
+        pEncoder
+            pointer to the encoder to initialize
+
+    @param[in]
+        format
+            output format
+
+    @param[in]
+        fn
+            output function to send the encoded data to
+
+    @param[in]
+        arg
+            opaque argument passed to the output function
+
+==============================================================================*/
+void Encoder_Init( Encoder *pEncoder,
+                   EncoderFormat format,
+                   OutputFn fn,
+                   void *arg )
+{
+    if ( pEncoder != NULL )
+    {
+        memset( pEncoder, 0, sizeof( Encoder ) );
+        pEncoder->format = ( format < ENCODER_MAX ) ? format : ENCODER_JSON;
+        pEncoder->fn = fn;
+        pEncoder->arg = arg;
+        pEncoder->result = ( fn != NULL ) ? EOK : EINVAL;
+    }
+}
+
+/*============================================================================*/
+/*  Encoder_Map                                                               */
+/*!
+    Start a map
+
+    The Encoder_Map function starts a map of the specified number of
+    key/value pairs.  Each key is encoded with Encoder_String, followed
+    by its value.
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        pairs
+            number of key/value pairs in the map
+
+    @retval EOK the map was started
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int Encoder_Map( Encoder *pEncoder, size_t pairs )
+{
+    int result = EINVAL;
+
+    if ( pEncoder != NULL )
+    {
+        BeginItem( pEncoder );
+
+        switch( pEncoder->format )
+        {
+            case ENCODER_CBOR:
+                PutCBORHead( pEncoder, CBOR_MAP, pairs );
+                break;
+
+            case ENCODER_MSGPACK:
+                PutMsgPackHead( pEncoder, 0x80, 15, 0, 0xde, 0xdf, pairs );
+                break;
+
+            default:
+                Put( pEncoder, "{", 1 );
+                break;
+        }
+
+        Open( pEncoder, true, pairs * 2 );
+        result = pEncoder->result;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Encoder_Array                                                             */
+/*!
+    Start an array
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        count
+            number of items in the array
+
+    @retval EOK the array was started
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int Encoder_Array( Encoder *pEncoder, size_t count )
+{
+    int result = EINVAL;
+
+    if ( pEncoder != NULL )
+    {
+        BeginItem( pEncoder );
+
+        switch( pEncoder->format )
+        {
+            case ENCODER_CBOR:
+                PutCBORHead( pEncoder, CBOR_ARRAY, count );
+                break;
+
+            case ENCODER_MSGPACK:
+                PutMsgPackHead( pEncoder, 0x90, 15, 0, 0xdc, 0xdd, count );
+                break;
+
+            default:
+                if ( ( pEncoder->format != ENCODER_NDJSON ) ||
+                     ( pEncoder->depth > 0 ) )
+                {
+                    Put( pEncoder, "[", 1 );
+                }
+                break;
+        }
+
+        Open( pEncoder, false, count );
+        result = pEncoder->result;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Encoder_String                                                            */
+/*!
+    Encode a string
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        s
+            pointer to the NUL terminated UTF-8 string
+
+    @retval EOK the string was encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int Encoder_String( Encoder *pEncoder, const char *s )
+{
+    int result = EINVAL;
+    size_t len;
+
+    if ( ( pEncoder != NULL ) && ( s != NULL ) )
+    {
+        BeginItem( pEncoder );
+
+        len = strlen( s );
+
+        switch( pEncoder->format )
+        {
+            case ENCODER_CBOR:
+                PutCBORHead( pEncoder, CBOR_TEXT, len );
+                Put( pEncoder, s, len );
+                break;
+
+            case ENCODER_MSGPACK:
+                PutMsgPackHead( pEncoder, 0xa0, 31, 0xd9, 0xda, 0xdb, len );
+                Put( pEncoder, s, len );
+                break;
+
+            default:
+                PutJSONString( pEncoder, s );
+                break;
+        }
+
+        EndItem( pEncoder );
+        result = pEncoder->result;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Encoder_Bool                                                              */
+/*!
+    Encode a boolean
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        value
+            the value to encode
+
+    @retval EOK the value was encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int Encoder_Bool( Encoder *pEncoder, bool value )
+{
+    int result = EINVAL;
+    uint8_t code;
+
+    if ( pEncoder != NULL )
+    {
+        BeginItem( pEncoder );
+
+        switch( pEncoder->format )
+        {
+            case ENCODER_CBOR:
+                code = value ? CBOR_TRUE : CBOR_FALSE;
+                Put( pEncoder, &code, 1 );
+                break;
+
+            case ENCODER_MSGPACK:
+                code = value ? MSGPACK_TRUE : MSGPACK_FALSE;
+                Put( pEncoder, &code, 1 );
+                break;
+
+            default:
+                if ( value )
+                {
+                    Put( pEncoder, "true", 4 );
+                }
+                else
+                {
+                    Put( pEncoder, "false", 5 );
+                }
+                break;
+        }
+
+        EndItem( pEncoder );
+        result = pEncoder->result;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Encoder_Uint                                                              */
+/*!
+    Encode an unsigned integer
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        value
+            the value to encode
+
+    @retval EOK the value was encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int Encoder_Uint( Encoder *pEncoder, uint64_t value )
+{
+    int result = EINVAL;
+    char buf[ENCODER_INT_LEN];
+
+    if ( pEncoder != NULL )
+    {
+        BeginItem( pEncoder );
+
+        switch( pEncoder->format )
+        {
+            case ENCODER_CBOR:
+                PutCBORHead( pEncoder, CBOR_UINT, value );
+                break;
+
+            case ENCODER_MSGPACK:
+                if ( value <= 0x7f )
+                {
+                    PutBigEndian( pEncoder, (uint8_t)value, 0, 0 );
+                }
+                else if ( value <= 0xff )
+                {
+                    PutBigEndian( pEncoder, 0xcc, value, 1 );
+                }
+                else if ( value <= 0xffff )
+                {
+                    PutBigEndian( pEncoder, 0xcd, value, 2 );
+                }
+                else if ( value <= 0xffffffffULL )
+                {
+                    PutBigEndian( pEncoder, 0xce, value, 4 );
+                }
+                else
+                {
+                    PutBigEndian( pEncoder, 0xcf, value, 8 );
+                }
+                break;
+
+            default:
+                Put( pEncoder, buf, Encoder_FormatUint( buf, value ) );
+                break;
+        }
+
+        EndItem( pEncoder );
+        result = pEncoder->result;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Encoder_Int                                                               */
+/*!
+    Encode a signed integer
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        value
+            the value to encode
+
+    @retval EOK the value was encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int Encoder_Int( Encoder *pEncoder, int64_t value )
+{
+    int result = EINVAL;
+    char buf[ENCODER_INT_LEN];
+
+    if ( pEncoder != NULL )
+    {
+        if ( value >= 0 )
+        {
+            result = Encoder_Uint( pEncoder, (uint64_t)value );
+        }
+        else
+        {
+            BeginItem( pEncoder );
+
+            switch( pEncoder->format )
+            {
+                case ENCODER_CBOR:
+                    PutCBORHead( pEncoder,
+                                 CBOR_NEGINT,
+                                 (uint64_t)( -( value + 1 ) ) );
+                    break;
+
+                case ENCODER_MSGPACK:
+                    if ( value >= -32 )
+                    {
+                        PutBigEndian( pEncoder, (uint8_t)value, 0, 0 );
+                    }
+                    else if ( value >= INT8_MIN )
+                    {
+                        PutBigEndian( pEncoder, 0xd0, (uint8_t)value, 1 );
+                    }
+                    else if ( value >= INT16_MIN )
+                    {
+                        PutBigEndian( pEncoder, 0xd1, (uint16_t)value, 2 );
+                    }
+                    else if ( value >= INT32_MIN )
+                    {
+                        PutBigEndian( pEncoder, 0xd2, (uint32_t)value, 4 );
+                    }
+                    else
+                    {
+                        PutBigEndian( pEncoder, 0xd3, (uint64_t)value, 8 );
+                    }
+                    break;
+
+                default:
+                    Put( pEncoder, buf, Encoder_FormatInt( buf, value ) );
+                    break;
+            }
+
+            EndItem( pEncoder );
+            result = pEncoder->result;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Encoder_FormatUint                                                        */
+/*!
+    Format an unsigned integer as decimal text
+
+    The Encoder_FormatUint function formats an integer without the
+    locale and format string handling of the printf family.
+
+    @param[out]
+        buf
+            buffer of at least ENCODER_INT_LEN bytes to receive the NUL
+            terminated text
+
+    @param[in]
+        value
+            the value to format
+
+    @retval the length of the formatted text
+
+==============================================================================*/
+size_t Encoder_FormatUint( char *buf, uint64_t value )
+{
+    char digits[ENCODER_INT_LEN];
+    size_t n = 0;
+    size_t len = 0;
+
+    do
+    {
+        digits[n++] = (char)( '0' + ( value % 10 ) );
+        value /= 10;
+    } while ( value != 0 );
+
+    while ( n > 0 )
+    {
+        buf[len++] = digits[--n];
+    }
+
+    buf[len] = '\0';
+
+    return len;
+}
+
+/*============================================================================*/
+/*  Encoder_FormatInt                                                         */
+/*!
+    Format a signed integer as decimal text
+
+    @param[out]
+        buf
+            buffer of at least ENCODER_INT_LEN bytes to receive the NUL
+            terminated text
+
+    @param[in]
+        value
+            the value to format
+
+    @retval the length of the formatted text
+
+==============================================================================*/
+size_t Encoder_FormatInt( char *buf, int64_t value )
+{
+    size_t len;
+
+    if ( value < 0 )
+    {
+        buf[0] = '-';
+        len = 1 + Encoder_FormatUint( &buf[1], -(uint64_t)value );
+    }
+    else
+    {
+        len = Encoder_FormatUint( buf, (uint64_t)value );
+    }
+
+    return len;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Put                                                                       */
+/*!
+    Output encoded bytes
+
+    The Put function sends encoded bytes to the output function, unless
+    an earlier output has failed.
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        buf
+            pointer to the bytes to output
+
+    @param[in]
+        len
+            number of bytes to output
+
+==============================================================================*/
+static void Put( Encoder *pEncoder, const void *buf, size_t len )
+{
+    if ( ( pEncoder->result == EOK ) && ( len > 0 ) )
+    {
+        pEncoder->result = pEncoder->fn( pEncoder->arg, buf, len );
+    }
+}
+
+/*============================================================================*/
+/*  IsJSON                                                                    */
+/*!
+    Check if the encoder outputs JSON text
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @retval true the output format is JSON or NDJSON
+    @retval false the output format is binary
+
+==============================================================================*/
+static bool IsJSON( Encoder *pEncoder )
+{
+    return ( pEncoder->format == ENCODER_JSON ) ||
+           ( pEncoder->format == ENCODER_NDJSON );
+}
+
+/*============================================================================*/
+/*  IsLines                                                                   */
+/*!
+    Check if a container is output one item per line
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        pLevel
+            pointer to the container
+
+    @retval true the container is the top level array of NDJSON output
+    @retval false the container is output normally
+
+==============================================================================*/
+static bool IsLines( Encoder *pEncoder, EncoderLevel *pLevel )
+{
+    return ( pEncoder->format == ENCODER_NDJSON ) &&
+           ( pLevel == &pEncoder->stack[0] ) &&
+           ( pLevel->map == false );
+}
+
+/*============================================================================*/
+/*  BeginItem                                                                 */
+/*!
+    Output the JSON separator ahead of an item
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+==============================================================================*/
+static void BeginItem( Encoder *pEncoder )
+{
+    EncoderLevel *pLevel;
+
+    if ( ( IsJSON( pEncoder ) ) && ( pEncoder->depth > 0 ) )
+    {
+        pLevel = &pEncoder->stack[pEncoder->depth - 1];
+        if ( ( pLevel->map == true ) && ( pLevel->count % 2 == 1 ) )
+        {
+            Put( pEncoder, ": ", 2 );
+        }
+        else if ( ( pLevel->count > 0 ) &&
+                  ( IsLines( pEncoder, pLevel ) == false ) )
+        {
+            Put( pEncoder, ", ", 2 );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  EndItem                                                                   */
+/*!
+    Account for a completed item
+
+    The EndItem function counts a completed item in its container, and
+    closes each container which is complete.
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+==============================================================================*/
+static void EndItem( Encoder *pEncoder )
+{
+    EncoderLevel *pLevel;
+
+    while ( pEncoder->depth > 0 )
+    {
+        pLevel = &pEncoder->stack[pEncoder->depth - 1];
+        if ( pLevel->count < pLevel->items )
+        {
+            pLevel->count++;
+        }
+
+        if ( IsLines( pEncoder, pLevel ) == true )
+        {
+            /* end the line of a top level NDJSON item */
+            Put( pEncoder, "\n", 1 );
+        }
+
+        if ( pLevel->count < pLevel->items )
+        {
+            break;
+        }
+
+        /* the container is complete */
+        if ( ( IsJSON( pEncoder ) ) && ( IsLines( pEncoder, pLevel ) == false ) )
+        {
+            Put( pEncoder, pLevel->map ? "}" : "]", 1 );
+        }
+
+        pEncoder->depth--;
+    }
+}
+
+/*============================================================================*/
+/*  Open                                                                      */
+/*!
+    Open a container
+
+    The Open function pushes a started container.  An empty container
+    is complete immediately.
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        map
+            true for a map, false for an array
+
+    @param[in]
+        items
+            number of items in the container
+
+==============================================================================*/
+static void Open( Encoder *pEncoder, bool map, size_t items )
+{
+    EncoderLevel *pLevel;
+
+    if ( pEncoder->depth < ENCODER_MAX_DEPTH )
+    {
+        pLevel = &pEncoder->stack[pEncoder->depth++];
+        pLevel->map = map;
+        pLevel->items = items;
+        pLevel->count = 0;
+
+        if ( items == 0 )
+        {
+            /* complete the empty container and count it in its parent */
+            if ( ( IsJSON( pEncoder ) ) &&
+                 ( IsLines( pEncoder, pLevel ) == false ) )
+            {
+                Put( pEncoder, map ? "}" : "]", 1 );
+            }
+
+            pEncoder->depth--;
+            EndItem( pEncoder );
+        }
+    }
+    else
+    {
+        pEncoder->result = E2BIG;
+    }
+}
+
+/*============================================================================*/
+/*  PutCBORHead                                                               */
+/*!
+    Output a CBOR data item head
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        major
+            CBOR major type
+
+    @param[in]
+        value
+            argument of the head (value, length or count)
+
+==============================================================================*/
+static void PutCBORHead( Encoder *pEncoder, int major, uint64_t value )
+{
+    uint8_t mt = (uint8_t)( major << 5 );
+
+    if ( value < 24 )
+    {
+        PutBigEndian( pEncoder, mt | (uint8_t)value, 0, 0 );
+    }
+    else if ( value <= 0xff )
+    {
+        PutBigEndian( pEncoder, mt | 24, value, 1 );
+    }
+    else if ( value <= 0xffff )
+    {
+        PutBigEndian( pEncoder, mt | 25, value, 2 );
+    }
+    else if ( value <= 0xffffffffULL )
+    {
+        PutBigEndian( pEncoder, mt | 26, value, 4 );
+    }
+    else
+    {
+        PutBigEndian( pEncoder, mt | 27, value, 8 );
+    }
+}
+
+/*============================================================================*/
+/*  PutMsgPackHead                                                            */
+/*!
+    Output a MessagePack string, array or map head
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        fix
+            fix format code for small lengths
+
+    @param[in]
+        fixMax
+            largest length of the fix format
+
+    @param[in]
+        code8
+            8 bit length format code, or 0 if there is none
+
+    @param[in]
+        code16
+            16 bit length format code
+
+    @param[in]
+        code32
+            32 bit length format code
+
+    @param[in]
+        value
+            length or count
+
+==============================================================================*/
+static void PutMsgPackHead( Encoder *pEncoder,
+                            uint8_t fix,
+                            uint8_t fixMax,
+                            uint8_t code8,
+                            uint8_t code16,
+                            uint8_t code32,
+                            uint64_t value )
+{
+    if ( value <= fixMax )
+    {
+        PutBigEndian( pEncoder, fix | (uint8_t)value, 0, 0 );
+    }
+    else if ( ( code8 != 0 ) && ( value <= 0xff ) )
+    {
+        PutBigEndian( pEncoder, code8, value, 1 );
+    }
+    else if ( value <= 0xffff )
+    {
+        PutBigEndian( pEncoder, code16, value, 2 );
+    }
+    else
+    {
+        PutBigEndian( pEncoder, code32, value, 4 );
+    }
+}
+
+/*============================================================================*/
+/*  PutBigEndian                                                              */
+/*!
+    Output a type code followed by a big-endian value
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        code
+            type code byte
+
+    @param[in]
+        value
+            value to follow the type code
+
+    @param[in]
+        len
+            number of value bytes (0, 1, 2, 4 or 8)
+
+==============================================================================*/
+static void PutBigEndian( Encoder *pEncoder,
+                          uint8_t code,
+                          uint64_t value,
+                          size_t len )
+{
+    uint8_t buf[9];
+    size_t i;
+
+    buf[0] = code;
+    for ( i = 0; i < len; i++ )
+    {
+        buf[len - i] = (uint8_t)( value >> ( 8 * i ) );
+    }
+
+    Put( pEncoder, buf, len + 1 );
+}
+
+/*============================================================================*/
+/*  PutJSONString                                                             */
+/*!
+    Output a quoted and escaped JSON string
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @param[in]
+        s
+            pointer to the NUL terminated string
+
+==============================================================================*/
+static void PutJSONString( Encoder *pEncoder, const char *s )
+{
+    char esc[8];
+    size_t n;
+
+    Put( pEncoder, "\"", 1 );
+
+    while ( *s != '\0' )
+    {
+        /* output the run of characters which need no escaping */
+        n = 0;
+        while ( ( s[n] != '\0' ) &&
+                ( s[n] != '"' ) &&
+                ( s[n] != '\\' ) &&
+                ( (unsigned char)s[n] >= 0x20 ) )
+        {
+            n++;
+        }
+
+        Put( pEncoder, s, n );
+        s += n;
+
+        if ( *s != '\0' )
+        {
+            if ( ( *s == '"' ) || ( *s == '\\' ) )
+            {
+                esc[0] = '\\';
+                esc[1] = *s;
+                Put( pEncoder, esc, 2 );
+            }
+            else
+            {
+                n = snprintf( esc, sizeof( esc ), "\\u%04x", *s );
+                Put( pEncoder, esc, n );
+            }
+
+            s++;
+        }
+    }
+
+    Put( pEncoder, "\"", 1 );
+}
+
+/*! @}
+ * end of encoder group */
@@ -0,0 +1,780 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup executor executor
+ * @brief Work-stealing task executor
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file executor.c
+
+    Work-Stealing Executor
+
+    The executor module runs batches of independent tasks, such as the
+    procmon calls of a batch action, on a small pool of worker threads.
+    The tasks of a batch can take very different times, eg a start
+    completes in milliseconds while a stop may wait seconds for a slow
+    shutdown, so the pool balances them by work stealing.
+
+    Each worker owns a fixed size Chase-Lev deque.  The owner pushes and
+    pops tasks at the bottom without contention, and idle workers steal
+    from the top.  Tasks submitted from outside the pool go through the
+    shared lock-free submission queue (see queue.c).  A worker taking a
+    task from the queue moves a few more to its own deque, so a worker
+    held up by a long task never holds up the tasks behind it: another
+    worker steals them.
+
+    Workers with nothing to run park on a futex, and are only woken
+    when there is new work.  A thread blocked waiting for a batch runs
+    queued tasks itself until the batch completes.  A batch may instead
+    signal its completion through an eventfd, so an event loop can wait
+    for it with its other descriptors (see Executor_Done).  If the pool
+    has no workers, tasks are run as they are submitted.
+
+    The batch is usually on the stack of the waiting thread, so it may
+    be released as soon as it completes.  The task completing the batch
+    wakes the waiting thread first, and only then counts itself out,
+    and the batch is not complete until every task is counted out.
+
+    Executor_Shutdown stops and joins the workers, so per-thread state
+    they leave behind, eg their trace rings, can be safely written out
+    at exit.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "queue.h"
+#include "profiler.h"
+#include "executor.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! Chase-Lev work-stealing deque */
+typedef struct _Deque
+{
+    /*! index of the next task to steal */
+    int64_t top __attribute__(( aligned( QUEUE_CACHE_LINE ) ));
+
+    /*! index following the most recently pushed task */
+    int64_t bottom __attribute__(( aligned( QUEUE_CACHE_LINE ) ));
+
+    /*! task ring */
+    ExecutorTask *tasks[EXECUTOR_DEQUE_LEN];
+
+} Deque;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void *Worker( void *arg );
+static void WorkerExit( void *arg );
+static ExecutorTask *FindTask( int self );
+static void Run( ExecutorTask *pTask );
+static bool DequePush( Deque *pDeque, ExecutorTask *pTask );
+static ExecutorTask *DequePop( Deque *pDeque );
+static ExecutorTask *DequeSteal( Deque *pDeque );
+static void Notify( void );
+static void Futex( uint32_t *pWord, int op, uint32_t value );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! worker deques */
+static Deque *pDeques = NULL;
+
+/*! number of worker threads */
+static size_t nWorkers = 0;
+
+/*! worker threads */
+static pthread_t workers[EXECUTOR_MAX_WORKERS];
+
+/*! flag set to stop the worker threads */
+static bool stopping = false;
+
+/*! shared submission queue */
+static Queue submissions;
+
+/*! futex word the idle workers park on, changed when work is added */
+static uint32_t workSignal;
+
+/*! number of parked, or parking, workers */
+static uint32_t idleWorkers;
+
+/*! number of worker threads which have not exited */
+static uint32_t runningWorkers;
+
+/*! index of the worker running on this thread, or -1 */
+static __thread int workerIndex = -1;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Executor_Init                                                             */
+/*!
+    Start the executor worker threads
+
+    @param[in]
+        numWorkers
+            number of worker threads.  With no workers, the tasks of a
+            batch are run by the thread waiting for it.
+
+    @retval EOK the executor was started
+    @retval ENOMEM cannot allocate the worker deques
+    @retval EINVAL invalid arguments
+    @retval other error from pthread_create
+
+==============================================================================*/
+int Executor_Init( size_t numWorkers )
+{
+    int result = EINVAL;
+    size_t i;
+
+    if ( ( pDeques == NULL ) && ( numWorkers <= EXECUTOR_MAX_WORKERS ) )
+    {
+        result = Queue_Init( &submissions, EXECUTOR_QUEUE_LEN );
+        if ( ( result == EOK ) && ( numWorkers > 0 ) )
+        {
+            pDeques = aligned_alloc( QUEUE_CACHE_LINE,
+                                     numWorkers * sizeof( Deque ) );
+            if ( pDeques != NULL )
+            {
+                memset( pDeques, 0, numWorkers * sizeof( Deque ) );
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+
+        for ( i = 0; ( i < numWorkers ) && ( result == EOK ); i++ )
+        {
+            __atomic_add_fetch( &runningWorkers, 1, __ATOMIC_RELAXED );
+            result = pthread_create( &workers[i], NULL, Worker, (void *)i );
+            if ( result == EOK )
+            {
+                nWorkers++;
+            }
+            else
+            {
+                __atomic_sub_fetch( &runningWorkers, 1, __ATOMIC_RELAXED );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Executor_Submit                                                           */
+/*!
+    Submit a task to the executor
+
+    The Executor_Submit function adds a task to a batch.  A task
+    submitted by a worker is pushed to its own deque, and any other
+    task to the shared submission queue.  If there is no room for the
+    task, or no worker to run it, it is run immediately by the calling
+    thread.  The task must remain valid until the batch completes.
+
+    @param[in]
+        pBatch
+            pointer to the batch to add the task to
+
+    @param[in]
+        pTask
+            pointer to the task, with its function and argument set
+
+    @retval EOK the task was submitted
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Executor_Submit( ExecutorBatch *pBatch, ExecutorTask *pTask )
+{
+    int result = EINVAL;
+    bool queued;
+
+    if ( ( pBatch != NULL ) && ( pTask != NULL ) && ( pTask->fn != NULL ) )
+    {
+        pTask->pBatch = pBatch;
+        __atomic_add_fetch( &pBatch->submitted, 1, __ATOMIC_RELAXED );
+        __atomic_add_fetch( &pBatch->pending, 1, __ATOMIC_SEQ_CST );
+
+        queued = ( nWorkers == 0 ) ? false
+                 : ( workerIndex >= 0 )
+                    ? DequePush( &pDeques[workerIndex], pTask )
+                    : ( Queue_Push( &submissions, pTask ) == EOK );
+
+        if ( queued == true )
+        {
+            Notify();
+        }
+        else
+        {
+            Run( pTask );
+        }
+
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Executor_Wait                                                             */
+/*!
+    Wait for the tasks of a batch to complete
+
+    The Executor_Wait function runs queued tasks, of this or any other
+    batch, until every task of the batch has completed, and blocks on
+    the batch, or its eventfd, when there is nothing left to run.
+
+    @param[in]
+        pBatch
+            pointer to the batch to wait for
+
+    @retval EOK every task of the batch has completed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Executor_Wait( ExecutorBatch *pBatch )
+{
+    int result = EINVAL;
+    ExecutorTask *pTask;
+    struct pollfd pfd;
+    uint32_t pending;
+
+    if ( pBatch != NULL )
+    {
+        pfd.fd = pBatch->fd;
+        pfd.events = POLLIN;
+
+        while ( Executor_Done( pBatch ) == false )
+        {
+            pending = __atomic_load_n( &pBatch->pending, __ATOMIC_ACQUIRE );
+            pTask = FindTask( workerIndex );
+            if ( pTask != NULL )
+            {
+                Run( pTask );
+            }
+            else if ( pBatch->fd != -1 )
+            {
+                (void)poll( &pfd, 1, -1 );
+            }
+            else
+            {
+                /* the remaining tasks are running on the workers */
+                Futex( &pBatch->pending, FUTEX_WAIT_PRIVATE, pending );
+            }
+        }
+
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Executor_Done                                                             */
+/*!
+    Check whether the tasks of a batch have completed
+
+    The Executor_Done function checks whether every task of a batch has
+    completed and no longer touches the batch.  It only waits for the
+    task completing the batch to count itself out, after it has written
+    the eventfd.  The eventfd is read first, including any write made
+    while tasks were still being submitted, so a caller waiting for the
+    eventfd to become readable checks the batch each time it does, and
+    the eventfd can be reused for the next batch.
+
+    @param[in]
+        pBatch
+            pointer to the batch
+
+    @retval true the batch has completed, and may be released
+    @retval false tasks of the batch are queued or running
+
+==============================================================================*/
+bool Executor_Done( ExecutorBatch *pBatch )
+{
+    bool done = false;
+    uint64_t count;
+
+    if ( pBatch != NULL )
+    {
+        /* a task completing after this read writes the eventfd again */
+        if ( pBatch->fd != -1 )
+        {
+            (void)read( pBatch->fd, &count, sizeof( count ) );
+        }
+
+        if ( __atomic_load_n( &pBatch->pending, __ATOMIC_ACQUIRE ) == 0 )
+        {
+            while ( __atomic_load_n( &pBatch->released, __ATOMIC_ACQUIRE ) !=
+                    __atomic_load_n( &pBatch->submitted, __ATOMIC_RELAXED ) )
+            {
+                sched_yield();
+            }
+
+            done = true;
+        }
+    }
+
+    return done;
+}
+
+/*============================================================================*/
+/*  Executor_IsRunning                                                        */
+/*!
+    Check that the executor worker threads are running
+
+    @retval true every worker thread started is still running
+    @retval false a worker thread has exited
+
+==============================================================================*/
+bool Executor_IsRunning( void )
+{
+    return __atomic_load_n( &runningWorkers, __ATOMIC_RELAXED ) == nWorkers;
+}
+
+/*============================================================================*/
+/*  Executor_Shutdown                                                         */
+/*!
+    Stop the executor worker threads
+
+    The Executor_Shutdown function wakes every worker and waits for it
+    to exit.  A worker completes the task it is running before it exits,
+    but queued tasks are not run.  No tasks may be submitted once the
+    executor is shut down.
+
+==============================================================================*/
+void Executor_Shutdown( void )
+{
+    size_t i;
+
+    if ( nWorkers > 0 )
+    {
+        __atomic_store_n( &stopping, true, __ATOMIC_SEQ_CST );
+        __atomic_add_fetch( &workSignal, 1, __ATOMIC_SEQ_CST );
+        Futex( &workSignal, FUTEX_WAKE_PRIVATE, INT_MAX );
+
+        for ( i = 0; i < nWorkers; i++ )
+        {
+            pthread_join( workers[i], NULL );
+        }
+
+        nWorkers = 0;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Worker                                                                    */
+/*!
+    Worker thread
+
+    The Worker function runs the tasks it finds, and parks while there
+    are none, until the executor is shut down.
+
+    @param[in]
+        arg
+            index of the worker
+
+    @retval NULL
+
+==============================================================================*/
+static void *Worker( void *arg )
+{
+    ExecutorTask *pTask;
+    uint32_t seen;
+
+    workerIndex = (int)(uintptr_t)arg;
+
+    /* let the profiler walk the stacks of the tasks */
+    Profiler_RegisterThread();
+
+    /* count the worker out however it exits */
+    pthread_cleanup_push( WorkerExit, NULL );
+
+    while ( __atomic_load_n( &stopping, __ATOMIC_SEQ_CST ) == false )
+    {
+        pTask = FindTask( workerIndex );
+        if ( pTask == NULL )
+        {
+            /* read the signal before the last look for work, so work
+               added after the look is guaranteed to change it */
+            seen = __atomic_load_n( &workSignal, __ATOMIC_SEQ_CST );
+            __atomic_add_fetch( &idleWorkers, 1, __ATOMIC_SEQ_CST );
+
+            pTask = FindTask( workerIndex );
+            if ( ( pTask == NULL ) &&
+                 ( __atomic_load_n( &stopping, __ATOMIC_SEQ_CST ) == false ) )
+            {
+                Futex( &workSignal, FUTEX_WAIT_PRIVATE, seen );
+            }
+
+            __atomic_sub_fetch( &idleWorkers, 1, __ATOMIC_SEQ_CST );
+        }
+
+        if ( pTask != NULL )
+        {
+            Run( pTask );
+        }
+    }
+
+    pthread_cleanup_pop( 1 );
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  WorkerExit                                                                */
+/*!
+    Count out an exiting worker thread
+
+    @param[in]
+        arg
+            unused
+
+==============================================================================*/
+static void WorkerExit( void *arg )
+{
+    (void)arg;
+
+    __atomic_sub_fetch( &runningWorkers, 1, __ATOMIC_RELAXED );
+}
+
+/*============================================================================*/
+/*  FindTask                                                                  */
+/*!
+    Find a task to run
+
+    The FindTask function takes a task from the worker's own deque,
+    then from the submission queue, then steals one from another worker.
+    A worker taking a task from the submission queue moves up to
+    EXECUTOR_GRAB more to its own deque, where other workers can steal
+    them.
+
+    @param[in]
+        self
+            index of the calling worker, or -1 if the caller is not a
+            worker
+
+    @retval pointer to the task to run
+    @retval NULL there is no task
+
+==============================================================================*/
+static ExecutorTask *FindTask( int self )
+{
+    ExecutorTask *pTask = NULL;
+    void *item;
+    size_t grabbed = 0;
+    size_t i;
+
+    if ( self >= 0 )
+    {
+        pTask = DequePop( &pDeques[self] );
+    }
+
+    if ( ( pTask == NULL ) &&
+         ( Queue_TryPop( &submissions, &item ) == EOK ) )
+    {
+        pTask = item;
+
+        while ( ( self >= 0 ) &&
+                ( grabbed < EXECUTOR_GRAB ) &&
+                ( Queue_TryPop( &submissions, &item ) == EOK ) )
+        {
+            if ( DequePush( &pDeques[self], item ) == false )
+            {
+                Run( item );
+            }
+
+            grabbed++;
+        }
+
+        if ( grabbed > 0 )
+        {
+            Notify();
+        }
+    }
+
+    for ( i = 1; ( i <= nWorkers ) && ( pTask == NULL ); i++ )
+    {
+        /* start with the next worker so thieves spread out */
+        pTask = DequeSteal( &pDeques[( self + i ) % nWorkers] );
+    }
+
+    return pTask;
+}
+
+/*============================================================================*/
+/*  Run                                                                       */
+/*!
+    Run a task and complete it in its batch
+
+    The task completing the batch wakes the thread waiting for it,
+    through the futex or the batch eventfd, before it counts itself
+    out, so the batch remains valid until it is no longer touched.
+
+    @param[in]
+        pTask
+            pointer to the task to run
+
+==============================================================================*/
+static void Run( ExecutorTask *pTask )
+{
+    ExecutorBatch *pBatch = pTask->pBatch;
+    uint64_t one = 1;
+
+    pTask->fn( pTask->arg );
+
+    /* the task may not be touched once its count is down, and the batch
+       may not be touched once the task is released */
+    if ( __atomic_sub_fetch( &pBatch->pending, 1, __ATOMIC_SEQ_CST ) == 0 )
+    {
+        if ( pBatch->fd != -1 )
+        {
+            (void)write( pBatch->fd, &one, sizeof( one ) );
+        }
+        else
+        {
+            Futex( &pBatch->pending, FUTEX_WAKE_PRIVATE, INT_MAX );
+        }
+    }
+
+    __atomic_add_fetch( &pBatch->released, 1, __ATOMIC_RELEASE );
+}
+
+/*============================================================================*/
+/*  DequePush                                                                 */
+/*!
+    Push a task to the bottom of a deque
+
+    Only the owner of the deque may push to it.
+
+    @param[in]
+        pDeque
+            pointer to the deque
+
+    @param[in]
+        pTask
+            pointer to the task
+
+    @retval true the task was pushed
+    @retval false the deque is full
+
+==============================================================================*/
+static bool DequePush( Deque *pDeque, ExecutorTask *pTask )
+{
+    bool pushed = false;
+    int64_t bottom = __atomic_load_n( &pDeque->bottom, __ATOMIC_RELAXED );
+    int64_t top = __atomic_load_n( &pDeque->top, __ATOMIC_ACQUIRE );
+
+    if ( bottom - top < EXECUTOR_DEQUE_LEN )
+    {
+        __atomic_store_n( &pDeque->tasks[bottom & ( EXECUTOR_DEQUE_LEN - 1 )],
+                          pTask,
+                          __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_RELEASE );
+        __atomic_store_n( &pDeque->bottom, bottom + 1, __ATOMIC_RELAXED );
+        pushed = true;
+    }
+
+    return pushed;
+}
+
+/*============================================================================*/
+/*  DequePop                                                                  */
+/*!
+    Pop a task from the bottom of a deque
+
+    Only the owner of the deque may pop from it.  The last task is
+    raced for against thieves.
+
+    @param[in]
+        pDeque
+            pointer to the deque
+
+    @retval pointer to the task
+    @retval NULL the deque is empty
+
+==============================================================================*/
+static ExecutorTask *DequePop( Deque *pDeque )
+{
+    ExecutorTask *pTask = NULL;
+    int64_t bottom = __atomic_load_n( &pDeque->bottom, __ATOMIC_RELAXED ) - 1;
+    int64_t top;
+
+    __atomic_store_n( &pDeque->bottom, bottom, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    top = __atomic_load_n( &pDeque->top, __ATOMIC_RELAXED );
+
+    if ( top <= bottom )
+    {
+        pTask = __atomic_load_n(
+                    &pDeque->tasks[bottom & ( EXECUTOR_DEQUE_LEN - 1 )],
+                    __ATOMIC_RELAXED );
+
+        if ( ( top == bottom ) &&
+             ( __atomic_compare_exchange_n( &pDeque->top,
+                                            &top,
+                                            top + 1,
+                                            false,
+                                            __ATOMIC_SEQ_CST,
+                                            __ATOMIC_RELAXED ) == false ) )
+        {
+            /* a thief took the last task */
+            pTask = NULL;
+        }
+
+        if ( top == bottom )
+        {
+            __atomic_store_n( &pDeque->bottom, bottom + 1, __ATOMIC_RELAXED );
+        }
+    }
+    else
+    {
+        __atomic_store_n( &pDeque->bottom, bottom + 1, __ATOMIC_RELAXED );
+    }
+
+    return pTask;
+}
+
+/*============================================================================*/
+/*  DequeSteal                                                                */
+/*!
+    Steal a task from the top of a deque
+
+    @param[in]
+        pDeque
+            pointer to the deque
+
+    @retval pointer to the task
+    @retval NULL the deque is empty, or another thread took the task
+
+==============================================================================*/
+static ExecutorTask *DequeSteal( Deque *pDeque )
+{
+    ExecutorTask *pTask = NULL;
+    int64_t top = __atomic_load_n( &pDeque->top, __ATOMIC_ACQUIRE );
+    int64_t bottom;
+
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    bottom = __atomic_load_n( &pDeque->bottom, __ATOMIC_ACQUIRE );
+
+    if ( top < bottom )
+    {
+        pTask = __atomic_load_n(
+                    &pDeque->tasks[top & ( EXECUTOR_DEQUE_LEN - 1 )],
+                    __ATOMIC_RELAXED );
+
+        if ( __atomic_compare_exchange_n( &pDeque->top,
+                                          &top,
+                                          top + 1,
+                                          false,
+                                          __ATOMIC_SEQ_CST,
+                                          __ATOMIC_RELAXED ) == false )
+        {
+            pTask = NULL;
+        }
+    }
+
+    return pTask;
+}
+
+/*============================================================================*/
+/*  Notify                                                                    */
+/*!
+    Wake a parked worker for new work
+
+    The Notify function only makes a system call when a worker is
+    parked, or about to park.
+
+==============================================================================*/
+static void Notify( void )
+{
+    if ( __atomic_load_n( &idleWorkers, __ATOMIC_SEQ_CST ) > 0 )
+    {
+        __atomic_add_fetch( &workSignal, 1, __ATOMIC_SEQ_CST );
+        Futex( &workSignal, FUTEX_WAKE_PRIVATE, 1 );
+    }
+}
+
+/*============================================================================*/
+/*  Futex                                                                     */
+/*!
+    Wait on, or wake the waiters of, a futex word
+
+    @param[in]
+        pWord
+            pointer to the futex word
+
+    @param[in]
+        op
+            FUTEX_WAIT_PRIVATE or FUTEX_WAKE_PRIVATE
+
+    @param[in]
+        value
+            expected value of the word to wait, or number of waiters
+            to wake
+
+==============================================================================*/
+static void Futex( uint32_t *pWord, int op, uint32_t value )
+{
+    (void)syscall( SYS_futex, pWord, op, value, NULL, NULL, 0 );
+}
+
+/*! @}
+ * end of executor group */
@@ -38,6 +38,10 @@ SOFTWARE.
     process management using the procmon CLI application.
     It can be interfaced via a web server such as lighttpd.
 
+    Each response is assembled in a preallocated buffer and sent
+    with a single write together with the FastCGI end of request record
+    (see response.c).
+
 */
 /*============================================================================*/
 
@@ -45,6 +49,10 @@ SOFTWARE.
         Includes
 ==============================================================================*/
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <string.h>
 #include <stdbool.h>
 #include <errno.h>
@@ -54,7 +62,37 @@ SOFTWARE.
 #include <signal.h>
 #include <sys/stat.h>
 #include <ctype.h>
-#include <fcgi_stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <fcgiapp.h>
+#include "profiler.h"
+#include "probes.h"
+#include "trace.h"
+#include "metrics.h"
+#include "allocstats.h"
+#include "status.h"
+#include "health.h"
+#include "spawn.h"
+#include "response.h"
+#include "compress.h"
+#include "listcache.h"
+#include "encoder.h"
+#include "proctable.h"
+#include "snapshot.h"
+#include "executor.h"
+#include "coro.h"
+#include "proctrack.h"
+#include "backend.h"
+#include "peer.h"
 
 /*==============================================================================
         Private definitions
@@ -63,6 +101,83 @@ SOFTWARE.
 /*! Maximum POST content length */
 #define MAX_POST_LENGTH         1024L
 
+/*! Maximum length of a query action name */
+#define MAX_ACTION_LENGTH       16
+
+/*! Maximum query string length */
+#define MAX_QUERY_LENGTH        4096L
+
+/*! procmon command line utility */
+#define PROCMON_PATH            "/usr/local/bin/procmon"
+
+/*! number of processes in a list page if no limit is specified */
+#define LIST_DEFAULT_LIMIT      100
+
+/*! maximum length of a paginated list response header */
+#define LIST_PAGE_HEADER_LEN    ( 256 + PROCTABLE_CURSOR_LEN )
+
+/*! number of typed process tables: the published snapshot, one which
+    may still be read after a refresh, and one to load the next into */
+#define PROCTABLE_SNAPSHOTS     3
+
+/*! maximum number of processes in a batch action */
+#define BATCH_MAX_ACTIONS       32
+
+/*! maximum length of the procmon output kept for each batch action */
+#define BATCH_OUTPUT_LEN        1024
+
+/*! default maximum number of worker threads running batch actions.  One
+    worker is started for each CPU up to this number */
+#define BATCH_DEFAULT_WORKERS   4
+
+/*! maximum number of requests parked waiting for a process state */
+#define WAIT_MAX_WAITERS        10000
+
+/*! file descriptors kept free for other uses than parked requests, eg
+    the listening socket, the request being processed and procmon pipes */
+#define WAIT_RESERVED_FDS       64
+
+/*! default time a wait request is parked for in milliseconds */
+#define WAIT_DEFAULT_TIMEOUT    30000
+
+/*! maximum time a wait request is parked for in milliseconds */
+#define WAIT_MAX_TIMEOUT        300000
+
+/*! interval between process list refreshes while requests are parked,
+    in milliseconds */
+#define WAIT_POLL_INTERVAL      1000
+
+/*! size of the response buffer of the parked requests */
+#define WAIT_RESPONSE_LEN       4096
+
+/*! size of the command output pipe, so a full list fits in the pipe */
+#define COMMAND_PIPE_SIZE       RESPONSE_BUFFER_SIZE
+
+/*! time command output is left to collect in the pipe once some has
+    been read, unless the command closes its output, in milliseconds */
+#define COMMAND_DRAIN_INTERVAL  10
+
+/*! first delay before retrying a failed accept in milliseconds */
+#define ACCEPT_BACKOFF_MIN      10
+
+/*! longest delay before retrying a failed accept in milliseconds */
+#define ACCEPT_BACKOFF_MAX      1000
+
+/*! maximum number of idle connections kept open by the web server,
+    which are watched for their next request */
+#define CONN_MAX_KEPT           32
+
+/*! time an idle kept connection is held open in milliseconds */
+#define CONN_IDLE_TIMEOUT       60000
+
+/*! snapshot reader slot of the parked requests, which check the process
+    table while a request is being processed */
+#define WAIT_SNAPSHOT_READER    1
+
+/*! smallest passthrough output which is spliced to the connection.
+    Smaller output is sent with the closing records in one write */
+#define COMMAND_SPLICE_MIN      ( 64 * 1024 )
+
 /*! FCGIProc state */
 typedef struct _FCGIProcState
 {
@@ -72,11 +187,164 @@ typedef struct _FCGIProcState
     /*! POST buffer */
     char *postBuffer;
 
+    /*! buffer used to split the query string */
+    char *queryBuffer;
+
     /*! verbose flag */
     bool verbose;
 
+    /*! name of the Chrome trace-event output file */
+    char *traceFile;
+
+    /*! abort if a list request allocates after this many warm-up requests */
+    bool allocCheck;
+
+    /*! number of warm-up requests before the allocation check applies */
+    uint64_t allocCheckWarmup;
+
+    /*! number of requests of each class processed, counted towards the
+        allocation check warm-up of the class */
+    uint64_t allocCheckCount[REQ_CLASS_MAX];
+
+    /*! class of the request being processed */
+    RequestClass reqClass;
+
+    /*! enable the internal status endpoint */
+    bool statusEnabled;
+
+    /*! process list snapshot time to live in milliseconds (0 = disabled) */
+    unsigned int listCacheTtl;
+
+    /*! name of the shared memory segment holding the process list */
+    char *sharedCache;
+
+    /*! time to wait for the peers of a cluster list in milliseconds */
+    unsigned int peerDeadline;
+
+    /*! time to keep a peer process list in milliseconds */
+    unsigned int peerTtl;
+
+    /*! number of worker threads running batch actions */
+    unsigned int batchWorkers;
+
+    /*! true if the event loop should wait with io_uring */
+    bool ioUring;
+
+    /*! index of the worker processing requests with this state */
+    size_t worker;
+
+    /*! process table snapshot read by the request being processed */
+    const ProcTable *pTable;
+
+    /*! query string of the request being processed */
+    char *query;
+
+    /*! identifier of the request being processed */
+    uint64_t requestId;
+
+    /*! name of the query action being processed */
+    char action[MAX_ACTION_LENGTH];
+
+    /*! name of the process the query action applies to */
+    char *procname;
+
+    /*! exit status of the last command executed, or -1 */
+    int exitStatus;
+
+    /*! FCGI request being processed */
+    FCGX_Request request;
+
+    /*! response being assembled for the request */
+    Response response;
+
+    /*! buffer collecting command output which is not sent directly */
+    Response capture;
+
+    /*! structured output format negotiated for the request */
+    EncoderFormat format;
+
+    /*! true if the request was parked to be answered later */
+    bool parked;
+
+    /*! result of the most recent attempt to process a request */
+    int acceptResult;
+
+    /*! delay before the next accept after a failed accept, in
+        milliseconds, or 0 */
+    unsigned int acceptBackoff;
+
 } FCGIProcState;
 
+/*! procmon action on one process of a batch action */
+typedef struct _BatchAction
+{
+    /*! executor task running the action */
+    ExecutorTask task;
+
+    /*! name of the process */
+    char *procname;
+
+    /*! true if the process was found in the most recent list */
+    bool routed;
+
+    /*! procmon command line */
+    char *argv[BACKEND_ARGV_LEN];
+
+    /*! exit status of procmon, or -1 */
+    int exitStatus;
+
+    /*! procmon output, NUL terminated and truncated if necessary */
+    char output[BATCH_OUTPUT_LEN];
+
+} BatchAction;
+
+/*! request parked until a process reaches a state */
+typedef struct _Waiter
+{
+    /*! coroutine answering the request */
+    Coro coro;
+
+    /*! coroutine watching for the web server closing the connection */
+    Coro hangup;
+
+    /*! number of the waiter's coroutines which have not completed */
+    unsigned int active;
+
+    /*! connection and identifier of the parked request.  The request
+        is detached from libfcgi, so no other field is used */
+    FCGX_Request request;
+
+    /*! name of the process */
+    char name[PROCTABLE_NAME_LEN];
+
+    /*! state the process must reach */
+    char state[PROCTABLE_STATE_LEN];
+
+    /*! monotonic time to stop waiting in microseconds */
+    uint64_t deadlineUs;
+
+    /*! structured output format negotiated for the request */
+    EncoderFormat format;
+
+    /*! next free waiter */
+    struct _Waiter *pNextFree;
+
+} Waiter;
+
+/*! idle connection kept open by the web server */
+typedef struct _Conn
+{
+    /*! coroutine watching the connection for its next request */
+    Coro coro;
+
+    /*! connection */
+    int fd;
+
+    /*! next connection with a request to read, or next free connection */
+    struct _Conn *pNext;
+
+} Conn;
+
 /*! query processing functions */
 typedef struct _queryFunc
 {
@@ -86,6 +354,9 @@ typedef struct _queryFunc
     /*! pointer to the function to handle the tag data */
     int (*pTagFn)(FCGIProcState *, char *);
 
+    /*! class the request is accounted against */
+    RequestClass reqClass;
+
 } QueryFunc;
 
 /*! Handler function */
@@ -113,9 +384,15 @@ void main(int argc, char **argv);
 static int InitState( FCGIProcState *pState );
 static int ProcessOptions( int argC, char *argV[], FCGIProcState *pState );
 static void usage( char *cmdname );
-static int ProcessRequests( FCGIProcState *pState,
-                            FCGIHandler *pFCGIHandlers,
-                            size_t numHandlers );
+static void InitConnections( FCGIProcState *pState );
+static void ServeRequests( void *arg );
+static int WatchListener( Coro *pCoro );
+static int WatchConnection( Coro *pCoro );
+static void KeepConnection( FCGIProcState *pState );
+static void CloseConnections( void );
+static int ProcessRequest( FCGIProcState *pState,
+                           FCGIHandler *pFCGIHandlers,
+                           size_t numHandlers );
 
 static int ProcessGETRequest( FCGIProcState *pState );
 static int ProcessPOSTRequest( FCGIProcState *pState );
@@ -133,16 +410,96 @@ static int InvokeQueryFunction( FCGIProcState *pState,
                                 QueryFunc *pFns,
                                 int numFuncs );
 
+static int GetQueryParam( FCGIProcState *pState,
+                          char *name,
+                          char *buf,
+                          size_t len );
+
 static int ValidateProcName( char *procname );
 
-static int ExecuteCommand( char *cmd, bool json );
+static int ExecuteCommand( FCGIProcState *pState,
+                           char * const argv[],
+                           bool json );
+
+static int RunCommand( FCGIProcState *pState,
+                       char * const argv[],
+                       Response *pOutput,
+                       const char *header,
+                       size_t headerLen,
+                       bool passthrough );
+
+static size_t ReadOutput( Response *pOutput, int fd, size_t len );
+
+static int FetchList( FCGIProcState *pState,
+                      Response *pOutput,
+                      const char *header,
+                      size_t headerLen,
+                      bool passthrough );
+
+static int ExecuteAction( FCGIProcState *pState,
+                          char *option,
+                          char *procname );
+
+static int RouteAction( FCGIProcState *pState,
+                        char *option,
+                        char *procname,
+                        char *argv[] );
+
+static int ExecuteBatch( FCGIProcState *pState,
+                         char *option,
+                         char *procnames,
+                         bool starts );
+
+static void RunBatchAction( void *arg );
+
+static int GetProcessList( FCGIProcState *pState,
+                           const char **pData,
+                           size_t *pLen,
+                           uint64_t *pGeneration );
+
+static int InitProcTables( void );
+static int LoadProcTable( FCGIProcState *pState );
+static bool TableCurrent( void );
+static int PublishProcTable( FCGIProcState *pState,
+                             const char *data,
+                             size_t len,
+                             uint64_t generation );
+static int ClusterList( FCGIProcState *pState );
+static int ListPage( FCGIProcState *pState, char *limit, char *cursor );
+static int SendEncodedHeader( FCGIProcState *pState );
 
 static int ProcessStartRequest( FCGIProcState *pState, char *query );
 static int ProcessStopRequest( FCGIProcState *pState, char *query );
 static int ProcessRestartRequest( FCGIProcState *pState, char *query );
 static int ProcessListRequest( FCGIProcState *pState, char *query );
+static int ProcessGetRequest( FCGIProcState *pState, char *query );
+static int ProcessProfileRequest( FCGIProcState *pState, char *query );
+static int ProcessMetricsRequest( FCGIProcState *pState, char *query );
+static int ProcessSummaryRequest( FCGIProcState *pState, char *query );
+static int ProcessFlappingRequest( FCGIProcState *pState, char *query );
+static int ProcessStatusRequest( FCGIProcState *pState, char *query );
+static int ProcessHealthRequest( FCGIProcState *pState, char *query );
+static int ProcessReadyRequest( FCGIProcState *pState, char *query );
+static int ProcessWaitRequest( FCGIProcState *pState, char *query );
+
+static int InitWaiters( FCGIProcState *pState );
+static void DetachRequest( FCGIProcState *pState );
+static int WaitForState( Coro *pCoro );
+static int WatchHangup( Coro *pCoro );
+static void ReleaseWaiter( Waiter *pWaiter );
+static void PollStates( void *arg );
+static int StartPoll( FCGIProcState *pState );
+static bool ReadPoll( void );
+static void FinishPoll( FCGIProcState *pState );
+static void AnswerWaiter( Waiter *pWaiter,
+                          const ProcRecord *pRecord,
+                          int status,
+                          const char *description );
 
 static int AllocatePOSTBuffer( FCGIProcState *pState );
+static int AllocateQueryBuffer( FCGIProcState *pState );
+static void CheckAllocations( FCGIProcState *pState, uint64_t allocCalls );
+static uint64_t GetTimeUs( void );
 static int ClearPOSTBuffer( FCGIProcState *pState );
 static void SetupTerminationHandler( void );
 static void TerminationHandler( int signum, siginfo_t *info, void *ptr );
@@ -151,9 +508,15 @@ static HandlerFunction GetHandlerFunction( char *method,
                                            FCGIHandler *pFCGIHandlers,
                                            size_t numHandlers );
 
-static void SendHeader( void );
-static void SendJSONHeader( void );
-static int ErrorResponse( int status,  char *description );
+static int SendResponse( FCGIProcState *pState,
+                         const char *response,
+                         size_t length );
+static int SendHeader( FCGIProcState *pState );
+static int SendJSONHeader( FCGIProcState *pState );
+static int ErrorResponse( FCGIProcState *pState,
+                          int status,
+                          char *description );
+static int TableErrorResponse( FCGIProcState *pState, int error );
 
 /*==============================================================================
         Private file scoped variables
@@ -170,6 +533,141 @@ FCGIHandler methodHandlers[] =
 /* FCGI Vars State object */
 FCGIProcState state;
 
+/*! preformatted text response header */
+static const char textHeader[] =
+    "Status: 200 OK\r\n"
+    "Content-Type: text/plain; charset=utf-8\r\n\r\n";
+
+/*! preformatted JSON response header */
+static const char jsonHeader[] =
+    "Status: 200 OK\r\n"
+    "Content-Type: application/json; charset=utf-8\r\n\r\n";
+
+/*! preformatted CBOR response header */
+static const char cborHeader[] =
+    "Status: 200 OK\r\n"
+    "Content-Type: application/cbor\r\n\r\n";
+
+/*! preformatted MessagePack response header */
+static const char msgpackHeader[] =
+    "Status: 200 OK\r\n"
+    "Content-Type: application/msgpack\r\n\r\n";
+
+/*! preformatted NDJSON response header */
+static const char ndjsonHeader[] =
+    "Status: 200 OK\r\n"
+    "Content-Type: application/x-ndjson; charset=utf-8\r\n\r\n";
+
+/*! preformatted response headers of the structured output formats */
+static const char * const formatHeaders[ENCODER_MAX] =
+{
+    jsonHeader,
+    cborHeader,
+    msgpackHeader,
+    ndjsonHeader
+};
+
+/*! typed process tables used for structured output: the published
+    snapshot, and spares the next snapshot is loaded into */
+static ProcTable procTables[PROCTABLE_SNAPSHOTS];
+
+/*! publication of the typed process table snapshots */
+static Snapshot tableSnapshot;
+
+/*! true while a process table snapshot is being loaded */
+static bool tableLoading;
+
+/*! list cache generation the published process table was loaded from,
+    or 0 if it was loaded from an uncached list */
+static uint64_t tableGeneration;
+
+/*! procmon actions of the batch action being processed */
+static BatchAction batchActions[BATCH_MAX_ACTIONS];
+
+/*! task accepting and processing requests */
+static CoroTask requestTask;
+
+/*! coroutine watching the listening socket for connections */
+static Coro listener;
+
+/*! true if a connection may be waiting to be accepted */
+static bool listenReady;
+
+/*! event signalled when there is a request to process */
+static CoroEvent workEvent;
+
+/*! event signalled when the listening socket is to be watched again */
+static CoroEvent listenEvent;
+
+/*! idle connections kept open by the web server */
+static Conn conns[CONN_MAX_KEPT];
+
+/*! first free kept connection */
+static Conn *pFreeConns;
+
+/*! first kept connection with a request to read */
+static Conn *pReadyConns;
+
+/*! last kept connection with a request to read */
+static Conn *pLastReadyConn;
+
+/*! eventfd written when the batch of a batch action completes, or -1 */
+static int batchFd = -1;
+
+/*! true while the request task is processing a request */
+static bool serving;
+
+/*! task refreshing the process list while requests are parked */
+static CoroTask poller;
+
+/*! true while the poller task is running */
+static bool polling;
+
+/*! event signalled when a process table snapshot is published */
+static CoroEvent tableEvent;
+
+/*! parked request pool */
+static Waiter *pWaiters;
+
+/*! first free parked request */
+static Waiter *pFreeWaiters;
+
+/*! number of parked requests */
+static size_t nWaiters;
+
+/*! maximum number of parked requests, limited by the file descriptors
+    available to hold their connections */
+static size_t maxWaiters;
+
+/*! response assembly buffer of the parked requests */
+static Response waitResponse;
+
+/*! process list read by the poller coroutine */
+static Response pollOutput;
+
+/*! read end of the procmon output pipe of the poller, or -1 */
+static int pollFd = -1;
+
+/*! process id of the procmon child of the poller */
+static pid_t pollPid;
+
+/*! true if the process list read by the poller is incomplete */
+static bool pollTruncated;
+
+/*! preformatted healthy probe response */
+static const char healthyResponse[] =
+    "Status: 200 OK\r\n"
+    "Content-Type: application/json\r\n"
+    "Cache-Control: no-store\r\n\r\n"
+    "{\"status\": \"ok\"}";
+
+/*! preformatted unavailable probe response */
+static const char unavailableResponse[] =
+    "Status: 503 Service Unavailable\r\n"
+    "Content-Type: application/json\r\n"
+    "Cache-Control: no-store\r\n\r\n"
+    "{\"status\": \"unavailable\"}";
+
 /*==============================================================================
         Private function definitions
 ==============================================================================*/
@@ -201,21 +699,71 @@ void main(int argc, char **argv)
     /* set up the termination handler */
     SetupTerminationHandler();
 
+    /* allow the profiler to walk the stack of the request thread */
+    Profiler_RegisterThread();
+
     /* process the command line options */
     ProcessOptions( argc, argv, &state );
 
-    /* allocate memory for the POST data buffer */
-    if( AllocatePOSTBuffer( &state ) == EOK )
+    /* check the procmon backend is available */
+    Health_Init( PROCMON_PATH );
+
+    /* enable request span tracing */
+    if ( ( state.traceFile != NULL ) &&
+         ( Trace_Open( state.traceFile ) != EOK ) )
+    {
+        syslog( LOG_ERR, "Cannot open trace file %s", state.traceFile );
+    }
+
+    /* allocate memory for the POST data, query and response buffers */
+    if( ( FCGX_Init() == 0 ) &&
+        ( FCGX_InitRequest( &state.request, 0, 0 ) == 0 ) &&
+        ( AllocatePOSTBuffer( &state ) == EOK ) &&
+        ( AllocateQueryBuffer( &state ) == EOK ) &&
+        ( Response_Init( &state.response, RESPONSE_BUFFER_SIZE ) == EOK ) &&
+        ( Response_Init( &state.capture, RESPONSE_BUFFER_SIZE ) == EOK ) &&
+        ( ListCache_Init( RESPONSE_BUFFER_SIZE, state.listCacheTtl ) == EOK ) &&
+        ( Backend_Init( RESPONSE_BUFFER_SIZE ) == EOK ) &&
+        ( Peer_Init( RESPONSE_BUFFER_SIZE,
+                     state.peerDeadline,
+                     state.peerTtl ) == EOK ) &&
+        ( Status_Init( 1 ) == EOK ) &&
+        ( InitProcTables() == EOK ) &&
+        ( Executor_Init( state.batchWorkers ) == EOK ) &&
+        ( InitWaiters( &state ) == EOK ) )
     {
-        /* process FCGI requests */
-        ProcessRequests( &state,
-                            methodHandlers,
-                            sizeof(methodHandlers) / sizeof(FCGIHandler) );
+        if ( ( state.sharedCache != NULL ) &&
+             ( ListCache_Share( state.sharedCache ) != EOK ) )
+        {
+            syslog( LOG_ERR,
+                    "Cannot share the process list in %s",
+                    state.sharedCache );
+        }
+
+        Status_SetBufferSize( STATUS_BUFFER_POST, state.maxPostLength );
+        Status_SetBufferSize( STATUS_BUFFER_QUERY, MAX_QUERY_LENGTH );
+        Status_SetBufferSize( STATUS_BUFFER_RESPONSE, RESPONSE_BUFFER_SIZE );
+
+        InitConnections( &state );
+
+        /* process FCGI requests, and the requests they park */
+        Coro_Start( &listener, WatchListener, &state );
+        if ( Coro_StartTask( &requestTask, ServeRequests, &state ) == EOK )
+        {
+            Coro_Run();
+        }
+        else
+        {
+            syslog( LOG_ERR, "Cannot start the request task" );
+        }
     }
     else
     {
-        syslog( LOG_ERR, "Cannot allocate POST buffer" );
+        syslog( LOG_ERR, "Cannot allocate request buffers" );
     }
+
+    /* stop the batch workers before the trace is completed at exit */
+    Executor_Shutdown();
 }
 
 /*============================================================================*/
@@ -236,6 +784,7 @@ void main(int argc, char **argv)
 static int InitState( FCGIProcState *pState )
 {
     int result = EINVAL;
+    long ncpu;
 
     if ( pState != NULL )
     {
@@ -245,6 +794,17 @@ static int InitState( FCGIProcState *pState )
         /* set the default POST content length */
         pState->maxPostLength = MAX_POST_LENGTH;
 
+        /* set the default peer request deadline and list time to live */
+        pState->peerDeadline = PEER_DEFAULT_DEADLINE;
+        pState->peerTtl = PEER_DEFAULT_TTL;
+
+        /* set the default number of batch action workers */
+        ncpu = sysconf( _SC_NPROCESSORS_ONLN );
+        pState->batchWorkers = ( ( ncpu > 0 ) &&
+                                 ( ncpu < BATCH_DEFAULT_WORKERS ) )
+                                    ? (unsigned int)ncpu
+                                    : BATCH_DEFAULT_WORKERS;
+
         result = EOK;
     }
 
@@ -274,7 +834,19 @@ static void usage( char *cmdname )
                 "usage: %s [-v] [-h] "
                 " [-h] : display this help"
                 " [-v] : verbose output"
-                " [-l <max POST length>] : maximum POST data length",
+                " [-l <max POST length>] : maximum POST data length"
+                " [-t <trace file>] : write request spans as trace events"
+                " [-Z <warm-up requests>] : abort if a list or get request"
+                " allocates"
+                " [-S] : enable the internal status and profile endpoints"
+                " [-c <ms>] : cache the process list for <ms> milliseconds"
+                " [-m <name>] : share the cached list in shared memory <name>"
+                " [-b <instance>=<procmon command>] : add a procmon backend"
+                " [-p <peer>=<unix:path|address:port>] : add a peer fcgi_proc"
+                " [-d <ms>] : wait up to <ms> milliseconds for the peers"
+                " [-C <ms>] : keep peer process lists for <ms> milliseconds"
+                " [-w <workers>] : run batch actions on <workers> threads"
+                " [-u] : wait for connections with io_uring",
                 cmdname );
     }
 }
@@ -309,7 +881,7 @@ static int ProcessOptions( int argC, char *argV[], FCGIProcState *pState )
 {
     int c;
     int result = EINVAL;
-    const char *options = "hvl:";
+    const char *options = "hvl:t:Z:Sc:m:b:p:d:C:w:u";
 
     if( ( pState != NULL ) &&
         ( argV != NULL ) )
@@ -328,6 +900,64 @@ static int ProcessOptions( int argC, char *argV[], FCGIProcState *pState )
                     pState->maxPostLength = strtoul( optarg, NULL, 0 );
                     break;
 
+                case 't':
+                    pState->traceFile = optarg;
+                    break;
+
+                case 'S':
+                    pState->statusEnabled = true;
+                    break;
+
+                case 'c':
+                    pState->listCacheTtl = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'm':
+                    pState->sharedCache = optarg;
+                    break;
+
+                case 'b':
+                    if ( Backend_Add( optarg ) != EOK )
+                    {
+                        syslog( LOG_ERR, "Invalid backend %s", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case 'p':
+                    if ( Peer_Add( optarg ) != EOK )
+                    {
+                        syslog( LOG_ERR, "Invalid peer %s", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case 'd':
+                    pState->peerDeadline = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'C':
+                    pState->peerTtl = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'w':
+                    pState->batchWorkers = strtoul( optarg, NULL, 0 );
+                    break;
+
+                case 'u':
+                    pState->ioUring = true;
+                    break;
+
+                case 'Z':
+                    pState->allocCheck = true;
+                    pState->allocCheckWarmup = strtoull( optarg, NULL, 0 );
+                    if ( AllocStats_Enabled() == false )
+                    {
+                        syslog( LOG_WARNING,
+                                "-Z requires the FCGI_PROC_ALLOC_STATS build" );
+                    }
+                    break;
+
                 case 'h':
                     usage( argV[0] );
                     break;
@@ -344,141 +974,543 @@ static int ProcessOptions( int argC, char *argV[], FCGIProcState *pState )
 }
 
 /*============================================================================*/
-/*  ProcessRequests                                                           */
+/*  InitConnections                                                           */
 /*!
-    Process incoming Fast CGI requests
+    Prepare to accept connections
 
-    The ProcessRequests function waits for incoming FCGI requests
-    and processes them according to their request method.
-    Typically this function will not exit, as doing so will terminate
-    the FCGI interface.
+    The InitConnections function makes the listening socket
+    non-blocking, so an accept which finds no connection, eg as another
+    process took it, returns at once instead of holding up the event
+    loop, and adds the kept connections to the free list.
 
     @param[in]
         pState
             pointer to the FCGIProc state object
 
-    @param[in]
-        pFCGIHandlers
-            pointer to an array of FCGIHandler objects which link method
-            names (eg GET, POST) with their method handling functions.
-
-    @param[in]
-        numHandlers
-            number of handlers in the array of FCGIHandler objects
-
-    @retval EOK request processed successfully
-    @retval EINVAL invalid arguments
-
 ==============================================================================*/
-static int ProcessRequests( FCGIProcState *pState,
-                            FCGIHandler *pFCGIHandlers,
-                            size_t numHandlers )
+static void InitConnections( FCGIProcState *pState )
 {
-    int result = EINVAL;
-    char *method;
-    HandlerFunction fn = NULL;
+    struct stat st;
+    int flags;
+    size_t i;
 
-    if ( ( pState != NULL ) &&
-         ( pFCGIHandlers != NULL ) &&
-         ( numHandlers > 0 ) )
+    /* leave the standard input alone when run as a CGI */
+    if ( ( fstat( pState->request.listen_sock, &st ) == 0 ) &&
+         ( S_ISSOCK( st.st_mode ) ) )
     {
-        /* wait for an FCGI request */
-        while( FCGI_Accept() >= 0 )
+        flags = fcntl( pState->request.listen_sock, F_GETFL );
+        if ( flags != -1 )
         {
-            /* check the request method */
-            method = getenv("REQUEST_METHOD");
-            if ( method != NULL )
-            {
-                /* get the handler associated with the method */
-                fn = GetHandlerFunction( method, pFCGIHandlers, numHandlers );
-                if ( fn != NULL )
-                {
-                    /* invoke the handler */
-                    result = fn( pState );
-                }
-            }
+            fcntl( pState->request.listen_sock, F_SETFL, flags | O_NONBLOCK );
         }
     }
 
-    return result;
+    for ( i = 0; i < CONN_MAX_KEPT; i++ )
+    {
+        conns[i].fd = -1;
+        conns[i].pNext = pFreeConns;
+        pFreeConns = &conns[i];
+    }
 }
 
 /*============================================================================*/
-/*  GetHandlerFunction                                                        */
+/*  ServeRequests                                                             */
 /*!
-    Get the handler function for the specified method
-
-    The GetHandlerFunction function looks up the processing function
-    associated with the specified HTTP method.
-
-    The handler functions are passed in via the pFCGIHandler pointer
-
-    @param[in]
-        method
-            pointer to the method name, eg "GET", "POST"
+    Process incoming Fast CGI requests
 
-    @param[in]
-        pFCGIHandlers
-            pointer to the FCGI method handling functions
+    The ServeRequests task processes the requests of the kept
+    connections which the web server has sent a request on (see
+    WatchConnection), and accepts and processes new connections while
+    the listening socket is ready (see WatchListener).  The request
+    handlers wait in the event loop, eg for command output, so parked
+    requests are answered and the process list is refreshed while a
+    request is processed.  Requests are processed one at a time.
+
+    An accept which finds no connection waiting hands the listening
+    socket back to the listener.  A request which cannot be accepted,
+    eg as no file descriptor is free for its connection, is retried
+    after a delay which doubles up to ACCEPT_BACKOFF_MAX milliseconds
+    while accepting fails.  Typically this task will not complete, as
+    doing so will terminate the FCGI interface.
 
     @param[in]
-        numHandlers
-            number of handlers in the method handling function array pointed
-            to by pFCGIHandler
-
-    @retval pointer to the method handler
-    @retval NULL no method handler could be found
+        arg
+            pointer to the FCGIProc state object
 
 ==============================================================================*/
-static HandlerFunction GetHandlerFunction( char *method,
-                                           FCGIHandler *pFCGIHandlers,
-                                           size_t numHandlers )
+static void ServeRequests( void *arg )
 {
-    size_t i;
-    FCGIHandler *pFCGIHandler;
-    HandlerFunction fn = NULL;
+    FCGIProcState *pState = arg;
+    Conn *pConn;
 
-    if ( ( method != NULL ) &&
-         ( pFCGIHandlers != NULL ) &&
-         ( numHandlers > 0 ) )
+    do
     {
-        /* iterate through the FCGI method handlers */
-        for ( i = 0; i < numHandlers ; i++ )
+        pState->acceptResult = EOK;
+
+        if ( pReadyConns != NULL )
         {
-            /* get a pointer to the current method handler */
-            pFCGIHandler = &pFCGIHandlers[i];
-            if ( pFCGIHandler != NULL )
+            pConn = pReadyConns;
+            pReadyConns = pConn->pNext;
+
+            /* let libfcgi read the next request from the connection */
+            pState->request.ipcFd = pConn->fd;
+            pState->request.keepConnection = 1;
+
+            pConn->fd = -1;
+            pConn->pNext = pFreeConns;
+            pFreeConns = pConn;
+
+            pState->acceptResult = ProcessRequest( pState,
+                                                   methodHandlers,
+                                                   sizeof(methodHandlers) /
+                                                     sizeof(FCGIHandler) );
+        }
+        else if ( listenReady == true )
+        {
+            pState->acceptResult = ProcessRequest( pState,
+                                                   methodHandlers,
+                                                   sizeof(methodHandlers) /
+                                                     sizeof(FCGIHandler) );
+        }
+        else if ( Coro_WaitEvent( Coro_Self(), &workEvent, 0 ) == EOK )
+        {
+            (void)Coro_Yield();
+        }
+
+        if ( pState->acceptResult == EAGAIN )
+        {
+            /* no connection is waiting */
+            listenReady = false;
+            Coro_Signal( &listenEvent );
+        }
+        else if ( pState->acceptResult == EBUSY )
+        {
+            /* let the parked requests run, and free their connections,
+               before trying again */
+            pState->acceptBackoff =
+                ( pState->acceptBackoff == 0 ) ? ACCEPT_BACKOFF_MIN
+                : ( pState->acceptBackoff < ACCEPT_BACKOFF_MAX / 2 )
+                    ? 2 * pState->acceptBackoff
+                    : ACCEPT_BACKOFF_MAX;
+
+            if ( Coro_Sleep( Coro_Self(), pState->acceptBackoff ) == EOK )
             {
-                /* check if it matches the REQUEST_METHOD or the
-                 * wild card */
-                if ( ( strcmp( pFCGIHandler->handler, method ) == 0 ) ||
-                     ( strcmp( pFCGIHandler->handler, "*" ) == 0 ) )
-                {
-                    /* get a pointer to the handler function */
-                    fn = pFCGIHandler->fn;
-                    break;
-                }
+                (void)Coro_Yield();
             }
         }
-    }
+        else if ( pState->acceptResult != EPIPE )
+        {
+            pState->acceptBackoff = 0;
+        }
+    } while ( pState->acceptResult != EPIPE );
 
-    return fn;
+    Coro_Cancel( &listener );
+    CloseConnections();
 }
 
 /*============================================================================*/
-/*  ProcessGETRequest                                                         */
+/*  WatchListener                                                             */
 /*!
-    Process a Fast CGI GET request
+    Watch the listening socket for connections
 
-    The ProcessGETRequest function processes a single FCGI GET request
-    contained in the QUERY_STRING environment variable
+    The WatchListener coroutine waits for the listening socket to become
+    ready, and lets the request task accept the connections, until an
+    accept finds no more connections waiting.  If the socket cannot be
+    waited for, eg when run as a CGI, the request task accepts directly.
 
     @param[in]
-        pState
-            pointer to the FCGIProc state object
+        pCoro
+            pointer to the coroutine, with the FCGIProc state object as
+            its argument
 
-    @retval EOK request processed successfully
-    @retval EINVAL invalid arguments
+    @retval CORO_SUSPENDED the coroutine is waiting
+    @retval CORO_DONE no more requests can be accepted
+
+==============================================================================*/
+static int WatchListener( Coro *pCoro )
+{
+    FCGIProcState *pState = pCoro->arg;
+
+    CORO_BEGIN( pCoro );
+
+    while ( pCoro->wake != CORO_WAKE_CANCEL )
+    {
+        if ( Coro_WaitFd( pCoro,
+                          pState->request.listen_sock,
+                          EPOLLIN,
+                          0 ) == EOK )
+        {
+            CORO_SUSPEND( pCoro );
+        }
+
+        if ( pCoro->wake != CORO_WAKE_CANCEL )
+        {
+            listenReady = true;
+            Coro_Signal( &workEvent );
+
+            Coro_WaitEvent( pCoro, &listenEvent, 0 );
+            CORO_SUSPEND( pCoro );
+        }
+    }
+
+    CORO_END( pCoro );
+}
+
+/*============================================================================*/
+/*  WatchConnection                                                           */
+/*!
+    Watch an idle kept connection for its next request
+
+    The WatchConnection coroutine waits for the web server to send a
+    request on a kept connection, or to close it, and then queues the
+    connection for the request task to read.  A connection which stays
+    idle for CONN_IDLE_TIMEOUT milliseconds is closed.
+
+    @param[in]
+        pCoro
+            pointer to the coroutine, with the Conn as its argument
+
+    @retval CORO_SUSPENDED the coroutine is waiting
+    @retval CORO_DONE the connection was queued or closed
+
+==============================================================================*/
+static int WatchConnection( Coro *pCoro )
+{
+    Conn *pConn = pCoro->arg;
+
+    CORO_BEGIN( pCoro );
+
+    if ( Coro_WaitFd( pCoro,
+                      pConn->fd,
+                      EPOLLIN | EPOLLRDHUP,
+                      CONN_IDLE_TIMEOUT ) == EOK )
+    {
+        CORO_SUSPEND( pCoro );
+    }
+
+    if ( pCoro->wake == CORO_WAKE_FD )
+    {
+        /* libfcgi reads the request, or finds the connection closed */
+        pConn->pNext = NULL;
+        if ( pReadyConns == NULL )
+        {
+            pReadyConns = pConn;
+        }
+        else
+        {
+            pLastReadyConn->pNext = pConn;
+        }
+
+        pLastReadyConn = pConn;
+        Coro_Signal( &workEvent );
+    }
+    else
+    {
+        close( pConn->fd );
+        pConn->fd = -1;
+        pConn->pNext = pFreeConns;
+        pFreeConns = pConn;
+    }
+
+    CORO_END( pCoro );
+}
+
+/*============================================================================*/
+/*  KeepConnection                                                            */
+/*!
+    Keep the connection of a completed request open
+
+    The KeepConnection function takes over the connection libfcgi kept
+    open after a request, as the web server asked, and watches it for
+    the next request, so libfcgi can accept other connections meanwhile.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+==============================================================================*/
+static void KeepConnection( FCGIProcState *pState )
+{
+    Conn *pConn = pFreeConns;
+
+    if ( ( pConn != NULL ) && ( pState->request.ipcFd != -1 ) )
+    {
+        pFreeConns = pConn->pNext;
+        pConn->fd = pState->request.ipcFd;
+        pConn->pNext = NULL;
+
+        pState->request.ipcFd = -1;
+        pState->request.keepConnection = 0;
+
+        Coro_Start( &pConn->coro, WatchConnection, pConn );
+    }
+}
+
+/*============================================================================*/
+/*  CloseConnections                                                          */
+/*!
+    Close the kept connections
+
+    The CloseConnections function closes the kept connections once no
+    more requests can be accepted.  The connections being watched are
+    closed as their watch is cancelled.
+
+==============================================================================*/
+static void CloseConnections( void )
+{
+    Conn *pConn;
+    size_t i;
+
+    while ( pReadyConns != NULL )
+    {
+        pConn = pReadyConns;
+        pReadyConns = pConn->pNext;
+
+        close( pConn->fd );
+        pConn->fd = -1;
+        pConn->pNext = pFreeConns;
+        pFreeConns = pConn;
+    }
+
+    for ( i = 0; i < CONN_MAX_KEPT; i++ )
+    {
+        if ( conns[i].fd != -1 )
+        {
+            Coro_Cancel( &conns[i].coro );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  ProcessRequest                                                            */
+/*!
+    Process an incoming Fast CGI request
+
+    The ProcessRequest function accepts an FCGI request and processes
+    it according to its request method.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        pFCGIHandlers
+            pointer to an array of FCGIHandler objects which link method
+            names (eg GET, POST) with their method handling functions.
+
+    @param[in]
+        numHandlers
+            number of handlers in the array of FCGIHandler objects
+
+    @retval EOK request processed successfully
+    @retval EAGAIN no connection is waiting to be accepted
+    @retval EBUSY no request could be accepted this time
+    @retval EPIPE no more requests can be accepted
+    @retval EINVAL invalid arguments
+    @retval other error processing the request
+
+==============================================================================*/
+static int ProcessRequest( FCGIProcState *pState,
+                           FCGIHandler *pFCGIHandlers,
+                           size_t numHandlers )
+{
+    int result = EINVAL;
+    char *method;
+    HandlerFunction fn = NULL;
+    uint64_t start;
+    uint64_t startUs;
+    uint64_t writeStart;
+    RequestMetrics metrics;
+    int rc;
+
+    if ( ( pState != NULL ) &&
+         ( pFCGIHandlers != NULL ) &&
+         ( numHandlers > 0 ) )
+    {
+        /* accept an FCGI request */
+        rc = FCGX_Accept_r( &pState->request );
+        if ( rc >= 0 )
+        {
+            serving = true;
+            pState->requestId++;
+            pState->reqClass = REQ_CLASS_OTHER;
+            start = TRACE_START();
+            startUs = GetTimeUs();
+            AllocStats_Begin();
+            Status_WorkerBusy( pState->worker, pState->requestId );
+            Response_Begin( &pState->response, &pState->request );
+            Response_SetEncoding( &pState->response,
+                                  Compress_Negotiate(
+                                        FCGX_GetParam( "HTTP_ACCEPT_ENCODING",
+                                                       pState->request.envp ) ) );
+            pState->format = Encoder_Negotiate(
+                                FCGX_GetParam( "HTTP_ACCEPT",
+                                               pState->request.envp ) );
+            pState->parked = false;
+            result = EINVAL;
+
+            /* check the request method */
+            method = FCGX_GetParam( "REQUEST_METHOD", pState->request.envp );
+            if ( method != NULL )
+            {
+                PROBE_REQUEST_ACCEPT( pState->requestId, method );
+
+                /* get the handler associated with the method */
+                fn = GetHandlerFunction( method, pFCGIHandlers, numHandlers );
+                if ( fn != NULL )
+                {
+                    /* invoke the handler */
+                    result = fn( pState );
+                }
+
+                PROBE_REQUEST_DONE( pState->requestId, result );
+            }
+
+            /* send the response and the end of request record, unless
+               the request was parked to be answered later */
+            writeStart = TRACE_START();
+            if ( pState->parked == true )
+            {
+                DetachRequest( pState );
+            }
+            else
+            {
+                Response_Finish( &pState->response, 0 );
+            }
+
+            /* close the connection if it cannot be watched */
+            if ( pFreeConns == NULL )
+            {
+                pState->request.keepConnection = 0;
+            }
+
+            FCGX_Finish_r( &pState->request );
+            KeepConnection( pState );
+            Trace_Span( "write", pState->requestId, writeStart, method );
+
+            Status_BufferUsed( STATUS_BUFFER_RESPONSE,
+                               pState->response.highWater );
+
+            AllocStats_End( &metrics.allocCalls, &metrics.allocBytes );
+            metrics.durationUs = GetTimeUs() - startUs;
+            metrics.writes = pState->response.writes;
+            metrics.failed = ( result != EOK );
+            Metrics_Record( pState->reqClass, &metrics );
+            CheckAllocations( pState, metrics.allocCalls );
+            Status_WorkerIdle( pState->worker );
+
+            /* release the process table snapshot read by the request */
+            Snapshot_Exit( &tableSnapshot, pState->worker );
+            pState->pTable = NULL;
+
+            Trace_Span( "request", pState->requestId, start, method );
+            Trace_RequestDone();
+            serving = false;
+        }
+        else if ( ( rc == -1 ) ||
+                  ( rc == -EBADF ) ||
+                  ( rc == -ENOTSOCK ) ||
+                  ( rc == -EINVAL ) )
+        {
+            /* libfcgi is shutting down, or there is no listening socket,
+               eg when run as a CGI */
+            result = EPIPE;
+        }
+        else if ( ( rc == -EAGAIN ) || ( rc == -EWOULDBLOCK ) )
+        {
+            /* no connection is waiting, eg another process accepted it */
+            result = EAGAIN;
+        }
+        else
+        {
+            /* eg a shortage of file descriptors or memory, or a
+               connection reset before it was accepted */
+            syslog( LOG_WARNING,
+                    "cannot accept a request: %s",
+                    strerror( -rc ) );
+            result = EBUSY;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GetHandlerFunction                                                        */
+/*!
+    Get the handler function for the specified method
+
+    The GetHandlerFunction function looks up the processing function
+    associated with the specified HTTP method.
+
+    The handler functions are passed in via the pFCGIHandler pointer
+
+    @param[in]
+        method
+            pointer to the method name, eg "GET", "POST"
+
+    @param[in]
+        pFCGIHandlers
+            pointer to the FCGI method handling functions
+
+    @param[in]
+        numHandlers
+            number of handlers in the method handling function array pointed
+            to by pFCGIHandler
+
+    @retval pointer to the method handler
+    @retval NULL no method handler could be found
+
+==============================================================================*/
+static HandlerFunction GetHandlerFunction( char *method,
+                                           FCGIHandler *pFCGIHandlers,
+                                           size_t numHandlers )
+{
+    size_t i;
+    FCGIHandler *pFCGIHandler;
+    HandlerFunction fn = NULL;
+
+    if ( ( method != NULL ) &&
+         ( pFCGIHandlers != NULL ) &&
+         ( numHandlers > 0 ) )
+    {
+        /* iterate through the FCGI method handlers */
+        for ( i = 0; i < numHandlers ; i++ )
+        {
+            /* get a pointer to the current method handler */
+            pFCGIHandler = &pFCGIHandlers[i];
+            if ( pFCGIHandler != NULL )
+            {
+                /* check if it matches the REQUEST_METHOD or the
+                 * wild card */
+                if ( ( strcmp( pFCGIHandler->handler, method ) == 0 ) ||
+                     ( strcmp( pFCGIHandler->handler, "*" ) == 0 ) )
+                {
+                    /* get a pointer to the handler function */
+                    fn = pFCGIHandler->fn;
+                    break;
+                }
+            }
+        }
+    }
+
+    return fn;
+}
+
+/*============================================================================*/
+/*  ProcessGETRequest                                                         */
+/*!
+    Process a Fast CGI GET request
+
+    The ProcessGETRequest function processes a single FCGI GET request
+    contained in the QUERY_STRING request parameter
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @retval EOK request processed successfully
+    @retval EINVAL invalid arguments
 
 ==============================================================================*/
 static int ProcessGETRequest( FCGIProcState *pState )
@@ -489,15 +1521,15 @@ static int ProcessGETRequest( FCGIProcState *pState )
     if ( pState != NULL )
     {
         /* get the query string */
-        query = getenv("QUERY_STRING");
+        query = FCGX_GetParam( "QUERY_STRING", pState->request.envp );
 
         /* process the request */
         result = ProcessQuery( pState, query );
     }
-	else
-	{
-	    result = ErrorResponse( 400, "Bad request" );
-	}
+    else
+    {
+        result = ErrorResponse( pState, 400, "Bad request" );
+    }
 
     return result;
 }
@@ -527,13 +1559,16 @@ static int ProcessPOSTRequest( FCGIProcState *pState )
     if ( pState != NULL )
     {
         /* get the content length */
-        contentLength = getenv("CONTENT_LENGTH");
+        contentLength = FCGX_GetParam( "CONTENT_LENGTH",
+                                       pState->request.envp );
         if( contentLength != NULL )
         {
             /* convert the content length to an integer */
             length = strtoul(contentLength, NULL, 0);
             if ( ( length > 0 ) && ( length <= pState->maxPostLength ) )
             {
+                Status_BufferUsed( STATUS_BUFFER_POST, length );
+
                 /* read the query from the POST Data */
                 result = GetPOSTData( pState, length );
                 if( result == EOK )
@@ -550,13 +1585,13 @@ static int ProcessPOSTRequest( FCGIProcState *pState )
             else
             {
                 /* content length is too large (or too small) */
-                ErrorResponse( 413, "Invalid Content-Length" );
+                ErrorResponse( pState, 413, "Invalid Content-Length" );
             }
         }
         else
         {
             /* unable to get content length */
-            ErrorResponse( 413, "Invalid Content-Length" );
+            ErrorResponse( pState, 413, "Invalid Content-Length" );
         }
     }
 
@@ -599,7 +1634,9 @@ static int GetPOSTData( FCGIProcState *pState, size_t length )
         if( length <= pState->maxPostLength )
         {
             /* read content-length bytes of data */
-            if ( FCGI_fread( pState->postBuffer, length, 1, FCGI_stdin ) == 1 )
+            if ( FCGX_GetStr( pState->postBuffer,
+                              length,
+                              pState->request.in ) == (int)length )
             {
                 /* content-length bytes of data successfully read */
                 result = EOK;
@@ -642,7 +1679,7 @@ static int ProcessUnsupportedRequest( FCGIProcState *pState )
 
     if ( pState != NULL )
     {
-        result = ErrorResponse( 405, "Method Not Allowed" );
+        result = ErrorResponse( pState, 405, "Method Not Allowed" );
     }
 
     return result;
@@ -676,10 +1713,19 @@ static int ProcessQuery( FCGIProcState *pState, char *query )
 
     QueryFunc fn[] =
     {
-        { "start=", &ProcessStartRequest },
-        { "stop=", &ProcessStopRequest },
-        { "restart=", &ProcessRestartRequest },
-        { "list", &ProcessListRequest }
+        { "start=", &ProcessStartRequest, REQ_CLASS_START },
+        { "stop=", &ProcessStopRequest, REQ_CLASS_STOP },
+        { "restart=", &ProcessRestartRequest, REQ_CLASS_RESTART },
+        { "list", &ProcessListRequest, REQ_CLASS_LIST },
+        { "get=", &ProcessGetRequest, REQ_CLASS_GET },
+        { "profile", &ProcessProfileRequest, REQ_CLASS_PROFILE },
+        { "metrics", &ProcessMetricsRequest, REQ_CLASS_METRICS },
+        { "summary", &ProcessSummaryRequest, REQ_CLASS_LIST },
+        { "flapping", &ProcessFlappingRequest, REQ_CLASS_LIST },
+        { "status", &ProcessStatusRequest, REQ_CLASS_STATUS },
+        { "health", &ProcessHealthRequest, REQ_CLASS_HEALTH },
+        { "ready", &ProcessReadyRequest, REQ_CLASS_HEALTH },
+        { "wait=", &ProcessWaitRequest, REQ_CLASS_GET }
     };
 
     /* count the number of query processing functions */
@@ -688,12 +1734,26 @@ static int ProcessQuery( FCGIProcState *pState, char *query )
     if ( ( pState != NULL ) &&
          ( query != NULL ) )
     {
+        /* make the full query available to the query functions */
+        pState->query = query;
+
         /* process the request */
         result = ProcessQueryFunctions( pState, query, fn, n );
         if ( result != EOK )
         {
-	        ErrorResponse( 400, "Bad request" );
+            /* replace a partial response with the error, or abort it
+               if it was already partly sent */
+            if ( Response_Discard( &pState->response ) == EOK )
+            {
+                ErrorResponse( pState, 400, "Bad request" );
+            }
+            else
+            {
+                Response_Abort( &pState->response );
+            }
         }
+
+        pState->query = NULL;
     }
 
     return result;
@@ -739,16 +1799,23 @@ static int ProcessQueryFunctions( FCGIProcState *pState,
     char *pQuery;
     char *save = NULL;
     int rc;
+    size_t len;
 
-    if ( ( pState != NULL ) && ( query != NULL ) && ( pFns != NULL ))
+    if ( ( pState != NULL ) &&
+         ( pState->queryBuffer != NULL ) &&
+         ( query != NULL ) &&
+         ( pFns != NULL ))
     {
         /* assume everything is ok, until it is not */
         result = EOK;
 
         /* create a copy of the query string we can freely mutate */
-        mutquery = strdup( query );
-        if ( mutquery != NULL )
+        len = strlen( query );
+        if ( len < MAX_QUERY_LENGTH )
         {
+            mutquery = memcpy( pState->queryBuffer, query, len + 1 );
+            Status_BufferUsed( STATUS_BUFFER_QUERY, len + 1 );
+
             /* split the query on "&" */
             pQuery = strtok_r( mutquery, "&", &save );
             while ( pQuery != NULL )
@@ -763,13 +1830,10 @@ static int ProcessQueryFunctions( FCGIProcState *pState,
                 /* get the next token */
                 pQuery = strtok_r( NULL, "&", &save );
             }
-
-            /* free the mutable query string */
-            free( mutquery );
         }
         else
         {
-            result = ENOMEM;
+            result = E2BIG;
         }
     }
 
@@ -816,6 +1880,7 @@ static int InvokeQueryFunction( FCGIProcState *pState,
     int (*pTagFn)( FCGIProcState *, char *) = NULL;
     bool found;
     size_t offset;
+    uint64_t start = TRACE_START();
 
     if ( ( pState != NULL ) && ( query != NULL ) && ( pFns != NULL ) )
     {
@@ -838,6 +1903,29 @@ static int InvokeQueryFunction( FCGIProcState *pState,
                     /* get the start of the query data */
                     offset = strlen( tag );
 
+                    /* record the action name (the tag without its "=")
+                     * and the process it applies to */
+                    snprintf( pState->action,
+                              sizeof( pState->action ),
+                              "%.*s",
+                              (int)strcspn( tag, "=" ),
+                              tag );
+                    pState->procname = &query[offset];
+                    pState->reqClass = pFns[i].reqClass;
+
+                    PROBE_QUERY_DISPATCH( pState->requestId,
+                                          pState->action,
+                                          pState->procname );
+
+                    Status_WorkerAction( pState->worker,
+                                         pState->action,
+                                         pState->procname );
+
+                    Trace_Span( "parse",
+                                pState->requestId,
+                                start,
+                                pState->action );
+
                     /* invoke the query handler */
                     result = pTagFn( pState, &query[offset] );
                     break;
@@ -851,38 +1939,137 @@ static int InvokeQueryFunction( FCGIProcState *pState,
 }
 
 /*============================================================================*/
-/*  ProcessStartRequest                                                       */
+/*  GetQueryParam                                                             */
 /*!
-    Handle a process start request
+    Get the value of a query parameter
 
-    The ProcessStartRequest function starts the process specified in the
-    query argument
+    The GetQueryParam function searches the query string of the request
+    being processed for a "name=value" parameter, and copies its value
+    into the supplied buffer.  This allows a query function to be
+    qualified by other parameters in the same request.
 
     @param[in]
         pState
             pointer to the FCGIProc state object
 
     @param[in]
-        query
-            pointer to the name of the process to start
+        name
+            name of the parameter to search for
 
-    @retval EOK query processed successfully
+    @param[out]
+        buf
+            buffer to receive the NUL terminated parameter value
+
+    @param[in]
+        len
+            size of the buffer
+
+    @retval EOK the parameter value was retrieved
+    @retval ENOENT the parameter was not found
+    @retval E2BIG the parameter value does not fit in the buffer
     @retval EINVAL invalid arguments
 
 ==============================================================================*/
-static int ProcessStartRequest( FCGIProcState *pState, char *query )
+static int GetQueryParam( FCGIProcState *pState,
+                          char *name,
+                          char *buf,
+                          size_t len )
 {
     int result = EINVAL;
-    char cmd[BUFSIZ];
+    char *p;
+    size_t namelen;
+    size_t n;
 
     if ( ( pState != NULL ) &&
-         ( query != NULL ) )
+         ( pState->query != NULL ) &&
+         ( name != NULL ) &&
+         ( buf != NULL ) &&
+         ( len > 0 ) )
     {
-        result = ValidateProcName( query );
-        if ( result == EOK )
+        result = ENOENT;
+        namelen = strlen( name );
+        p = pState->query;
+
+        while ( p != NULL )
+        {
+            if ( ( strncmp( p, name, namelen ) == 0 ) &&
+                 ( p[namelen] == '=' ) )
+            {
+                /* get the length of the value */
+                p += namelen + 1;
+                n = strcspn( p, "&" );
+                if ( n < len )
+                {
+                    memcpy( buf, p, n );
+                    buf[n] = 0;
+                    result = EOK;
+                }
+                else
+                {
+                    result = E2BIG;
+                }
+
+                break;
+            }
+
+            /* move to the next parameter */
+            p = strchr( p, '&' );
+            if ( p != NULL )
+            {
+                p++;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcessStartRequest                                                       */
+/*!
+    Handle a process start request
+
+    The ProcessStartRequest function starts the process specified in the
+    query argument, or each process of a comma separated list of
+    processes (see ExecuteBatch)
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        query
+            pointer to the name of the process to start
+
+    @retval EOK query processed successfully
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int ProcessStartRequest( FCGIProcState *pState, char *query )
+{
+    int result = EINVAL;
+    uint64_t startUs;
+
+    if ( ( pState != NULL ) &&
+         ( query != NULL ) &&
+         ( strchr( query, ',' ) != NULL ) )
+    {
+        result = ExecuteBatch( pState, "-s", query, true );
+    }
+    else if ( ( pState != NULL ) &&
+              ( query != NULL ) )
+    {
+        result = ValidateProcName( query );
+        if ( result == EOK )
         {
-            snprintf(cmd, BUFSIZ, "/usr/local/bin/procmon -s %s", query );
-            result = ExecuteCommand(cmd, false);
+            startUs = GetTimeUs();
+            result = ExecuteAction( pState, "-s", query );
+            ListCache_Invalidate();
+            if ( ( result == EOK ) && ( pState->exitStatus == 0 ) )
+            {
+                /* measure the time until the process is seen running */
+                ProcTrack_Action( query, startUs );
+            }
         }
     }
 
@@ -895,7 +2082,8 @@ static int ProcessStartRequest( FCGIProcState *pState, char *query )
     Handle a process stop request
 
     The ProcessStopRequest function stops the process specified in the
-    query argument
+    query argument, or each process of a comma separated list of
+    processes (see ExecuteBatch)
 
     @param[in]
         pState
@@ -912,16 +2100,21 @@ static int ProcessStartRequest( FCGIProcState *pState, char *query )
 static int ProcessStopRequest( FCGIProcState *pState, char *query )
 {
     int result = EINVAL;
-    char cmd[BUFSIZ];
 
     if ( ( pState != NULL ) &&
-         ( query != NULL ) )
+         ( query != NULL ) &&
+         ( strchr( query, ',' ) != NULL ) )
+    {
+        result = ExecuteBatch( pState, "-k", query, false );
+    }
+    else if ( ( pState != NULL ) &&
+              ( query != NULL ) )
     {
         result = ValidateProcName( query );
         if ( result == EOK )
         {
-            snprintf(cmd, BUFSIZ, "/usr/local/bin/procmon -k %s", query );
-            result = ExecuteCommand(cmd, false);
+            result = ExecuteAction( pState, "-k", query );
+            ListCache_Invalidate();
         }
     }
 
@@ -934,7 +2127,8 @@ static int ProcessStopRequest( FCGIProcState *pState, char *query )
     Handle a process restart request
 
     The ProcessRestartRequest function stops and restarts the process
-    specified in the query argument
+    specified in the query argument, or each process of a comma
+    separated list of processes (see ExecuteBatch)
 
     @param[in]
         pState
@@ -951,16 +2145,28 @@ static int ProcessStopRequest( FCGIProcState *pState, char *query )
 static int ProcessRestartRequest( FCGIProcState *pState, char *query )
 {
     int result = EINVAL;
-    char cmd[BUFSIZ];
+    uint64_t startUs;
 
     if ( ( pState != NULL ) &&
-         ( query != NULL ) )
+         ( query != NULL ) &&
+         ( strchr( query, ',' ) != NULL ) )
+    {
+        result = ExecuteBatch( pState, "-r", query, true );
+    }
+    else if ( ( pState != NULL ) &&
+              ( query != NULL ) )
     {
         result = ValidateProcName( query );
         if ( result == EOK )
         {
-            snprintf(cmd, BUFSIZ, "/usr/local/bin/procmon -r %s", query );
-            result = ExecuteCommand(cmd, false);
+            startUs = GetTimeUs();
+            result = ExecuteAction( pState, "-r", query );
+            ListCache_Invalidate();
+            if ( ( result == EOK ) && ( pState->exitStatus == 0 ) )
+            {
+                /* measure the time until the process is seen running */
+                ProcTrack_Action( query, startUs );
+            }
         }
     }
 
@@ -973,7 +2179,20 @@ static int ProcessRestartRequest( FCGIProcState *pState, char *query )
     Handle a process stop request
 
     The ProcessListRequest function lists all the processes managed by
-    the process manager.
+    the process manager.  When the list cache is enabled (-c) a recent
+    snapshot is served without running procmon, in the negotiated
+    content encoding if the client accepts one.
+
+    If the client accepts CBOR or MessagePack, the list is output from
+    the typed process table in that format.  The format=ndjson
+    parameter selects newline delimited JSON, one process per line,
+    which is gathered from the pre-rendered record fragments and
+    streamed to the client as the response buffer fills.
+
+    The limit and cursor parameters select a page of the list in
+    process name order (see ListPage).  The scope=cluster parameter
+    lists the processes of the peer fcgi_proc instances as well as the
+    local processes (see ClusterList).
 
     @param[in]
         pState
@@ -989,51 +2208,201 @@ static int ProcessRestartRequest( FCGIProcState *pState, char *query )
 ==============================================================================*/
 static int ProcessListRequest( FCGIProcState *pState, char *query )
 {
-    int result;
-    char *cmd = "/usr/local/bin/procmon -o json";
+    int result = EINVAL;
+    const char *data;
+    size_t len;
+    CompressEncoding encoding;
+    Encoder encoder;
+    char format[16];
+    char scope[16];
+    char limit[16];
+    char cursor[PROCTABLE_CURSOR_LEN];
+    int limitResult;
+    int cursorResult;
+    int scopeResult;
+    uint64_t start = TRACE_START();
+
+    if ( ( pState != NULL ) &&
+         ( GetQueryParam( pState, "format", format, sizeof format ) == EOK ) &&
+         ( strcmp( format, "ndjson" ) == 0 ) )
+    {
+        /* newline delimited JSON was requested explicitly */
+        pState->format = ENCODER_NDJSON;
+    }
+
+    limitResult = GetQueryParam( pState, "limit", limit, sizeof limit );
+    cursorResult = GetQueryParam( pState, "cursor", cursor, sizeof cursor );
+    scopeResult = GetQueryParam( pState, "scope", scope, sizeof scope );
+
+    if ( ( limitResult == E2BIG ) ||
+         ( cursorResult == E2BIG ) ||
+         ( scopeResult == E2BIG ) ||
+         ( ( scopeResult == EOK ) &&
+           ( strcmp( scope, "local" ) != 0 ) &&
+           ( strcmp( scope, "cluster" ) != 0 ) ) )
+    {
+        result = ErrorResponse( pState, 400, "Bad request" );
+    }
+    else if ( ( scopeResult == EOK ) && ( strcmp( scope, "cluster" ) == 0 ) )
+    {
+        result = ClusterList( pState );
+    }
+    else if ( ( limitResult == EOK ) || ( cursorResult == EOK ) )
+    {
+        result = ListPage( pState,
+                           ( limitResult == EOK ) ? limit : NULL,
+                           ( cursorResult == EOK ) ? cursor : NULL );
+    }
+    else if ( ( pState != NULL ) && ( pState->format == ENCODER_NDJSON ) )
+    {
+        result = LoadProcTable( pState );
+        if ( result == EOK )
+        {
+            /* gather the pre-rendered JSON record fragments */
+            SendEncodedHeader( pState );
+            result = ProcTable_Gather( pState->pTable,
+                                       0,
+                                       pState->pTable->count,
+                                       false,
+                                       true,
+                                       Response_WriteV,
+                                       &pState->response );
+        }
+        else
+        {
+            result = TableErrorResponse( pState, result );
+        }
+    }
+    else if ( ( pState != NULL ) && ( pState->format != ENCODER_JSON ) )
+    {
+        result = LoadProcTable( pState );
+        if ( result == EOK )
+        {
+            Encoder_Init( &encoder,
+                          pState->format,
+                          Response_Write,
+                          &pState->response );
+
+            SendEncodedHeader( pState );
+            result = ProcTable_Encode( pState->pTable,
+                                       0,
+                                       pState->pTable->count,
+                                       false,
+                                       &encoder );
+        }
+        else
+        {
+            result = TableErrorResponse( pState, result );
+        }
+    }
+    else if ( pState != NULL )
+    {
+        if ( ListCache_Get( GetTimeUs(),
+                            pState->response.encoding,
+                            &data,
+                            &len,
+                            &encoding ) == EOK )
+        {
+            PROBE_CACHE_HIT( pState->requestId, pState->action );
+            Trace_Span( "cache", pState->requestId, start, "hit" );
+
+            result = Response_Header( &pState->response,
+                                      jsonHeader,
+                                      sizeof( jsonHeader ) - 1,
+                                      encoding );
+            if ( result == EOK )
+            {
+                result = Response_Write( &pState->response, data, len );
+            }
+        }
+        else
+        {
+            PROBE_CACHE_MISS( pState->requestId, pState->action );
+            Trace_Span( "cache", pState->requestId, start, "miss" );
+
+            /* an uncached list is only passed through */
+            result = FetchList( pState,
+                                &pState->response,
+                                jsonHeader,
+                                sizeof( jsonHeader ) - 1,
+                                ( pState->listCacheTtl == 0 ) );
+            if ( ( result == EOK ) && ( pState->exitStatus == 0 ) )
+            {
+                /* keep the list if it is still in the response buffer */
+                data = Response_Body( &pState->response, &len );
+                if ( data != NULL )
+                {
+                    ListCache_Store( GetTimeUs(), data, len );
+                }
+            }
 
-    result = ExecuteCommand(cmd, true);
+            ListCache_Release();
+        }
+    }
 
     return result;
 }
 
 /*============================================================================*/
-/*  AllocatePOSTBuffer                                                        */
+/*  ProcessGetRequest                                                         */
 /*!
-    Allocate memory for the POST buffer
+    Handle a single process request
 
-    The AllocatePOSTBuffer function allocates storage space on the heap
-    for a buffer to contain the POST data.  It gets the requested POST
-    buffer size from the FCGIProcState object.
+    The ProcessGetRequest function outputs the record of the process
+    specified in the query argument from the typed process table,
+    in JSON, CBOR or MessagePack according to the Accept header.
 
     @param[in]
         pState
-            pointer to the FCGIProc state object containing the requested
-            POST buffer size
+            pointer to the FCGIProc state object
 
-    @retval EOK memory was successfully allocated for the POST buffer
-    @retval ENOMEM could not allocate memory for the POST buffer
+    @param[in]
+        query
+            pointer to the name of the process to get
+
+    @retval EOK query processed successfully
     @retval EINVAL invalid arguments
 
 ==============================================================================*/
-static int AllocatePOSTBuffer( FCGIProcState *pState )
+static int ProcessGetRequest( FCGIProcState *pState, char *query )
 {
     int result = EINVAL;
+    const ProcRecord *pRecord;
+    Encoder encoder;
 
-    if ( pState != NULL )
+    if ( ( pState != NULL ) &&
+         ( query != NULL ) )
     {
-        if( pState->maxPostLength > 0 )
+        result = ValidateProcName( query );
+        if ( result == EOK )
         {
-            /* allocate memory for the POST buffer including a NUL terminator */
-            pState->postBuffer = calloc( 1, pState->maxPostLength + 1 );
-            if( pState->postBuffer != NULL )
+            result = LoadProcTable( pState );
+            if ( result == EOK )
             {
-                result = EOK;
+                pRecord = ProcTable_Find( pState->pTable, query );
+                if ( pRecord != NULL )
+                {
+                    Encoder_Init( &encoder,
+                                  pState->format,
+                                  Response_Write,
+                                  &pState->response );
+
+                    /* the record names the backend which manages the
+                       process, if there are backends */
+                    SendEncodedHeader( pState );
+                    ProcTable_EncodeRecord( pRecord, 1, &encoder );
+
+                    Encoder_String( &encoder, "startLatency" );
+                    result = ProcTrack_EncodeLatency( pRecord->name, &encoder );
+                }
+                else
+                {
+                    result = ErrorResponse( pState, 404, "Not Found" );
+                }
             }
             else
             {
-                /* cannot allocate memory for the POST buffer */
-                result = ENOMEM;
+                result = TableErrorResponse( pState, result );
             }
         }
     }
@@ -1042,38 +2411,84 @@ static int AllocatePOSTBuffer( FCGIProcState *pState )
 }
 
 /*============================================================================*/
-/*  ClearPOSTBuffer                                                           */
+/*  ProcessProfileRequest                                                     */
 /*!
-    Zero the memory used for the POST data
+    Handle a profiler request
 
-    The ClearPOSTBuffer function zeros the memory used by the POST buffer
-    between requests.
+    The ProcessProfileRequest function controls the built-in sampling
+    profiler.  When a "seconds" parameter is supplied, the profiler is
+    armed to sample all threads for the specified number of seconds
+    (and optional "hz" sampling frequency).  Without a "seconds"
+    parameter the folded stacks of the most recent profile are returned.
+    Like the internal status, the profiler is only available when the
+    internal endpoints are enabled with -S.
 
     @param[in]
         pState
-            pointer to the FCGIProc state object containing the POST buffer.
+            pointer to the FCGIProc state object
 
-    @retval EOK memory was successfully allocated for the POST buffer
-    @retval ENOMEM the POST buffer memory was not allocated
+    @param[in]
+        query
+            pointer to the query argument (unused)
+
+    @retval EOK query processed successfully
     @retval EINVAL invalid arguments
 
 ==============================================================================*/
-static int ClearPOSTBuffer( FCGIProcState *pState )
+static int ProcessProfileRequest( FCGIProcState *pState, char *query )
 {
     int result = EINVAL;
+    char buf[32];
+    unsigned int seconds = PROFILER_DEFAULT_SECONDS;
+    unsigned int hz = PROFILER_DEFAULT_HZ;
+    unsigned int remaining = 0;
 
     if ( pState != NULL )
     {
-        if ( pState->postBuffer != NULL )
+        if ( pState->statusEnabled == false )
         {
-            /* clear the post buffer (including NUL terminator) */
-            memset( pState->postBuffer, 0, pState->maxPostLength + 1 );
+            result = ErrorResponse( pState, 404, "Not Found" );
+        }
+        else if ( GetQueryParam( pState,
+                                 "seconds",
+                                 buf,
+                                 sizeof( buf ) ) == EOK )
+        {
+            seconds = strtoul( buf, NULL, 0 );
+            if ( GetQueryParam( pState, "hz", buf, sizeof( buf ) ) == EOK )
+            {
+                hz = strtoul( buf, NULL, 0 );
+            }
 
-            result = EOK;
+            /* arm the profiler */
+            result = Profiler_Start( seconds, hz );
+            if ( result == EOK )
+            {
+                SendJSONHeader( pState );
+                result = Response_Printf( &pState->response,
+                                          "{\"profile\": \"armed\", "
+                                          "\"seconds\": %u, \"hz\": %u}",
+                                          seconds,
+                                          hz );
+            }
+            else if ( result == EBUSY )
+            {
+                result = ErrorResponse( pState, 409, "Profiler busy" );
+            }
+        }
+        else if ( Profiler_IsRunning( &remaining ) == true )
+        {
+            SendJSONHeader( pState );
+            result = Response_Printf( &pState->response,
+                                      "{\"profile\": \"running\", "
+                                      "\"remaining\": %u}",
+                                      remaining );
         }
         else
         {
-            result = ENOMEM;
+            /* output the folded stacks of the last profile */
+            SendHeader( pState );
+            result = Profiler_Fold( Response_Write, &pState->response );
         }
     }
 
@@ -1081,85 +2496,125 @@ static int ClearPOSTBuffer( FCGIProcState *pState )
 }
 
 /*============================================================================*/
-/*  SetupTerminationHandler                                                   */
+/*  ProcessMetricsRequest                                                     */
 /*!
-    Set up an abnormal termination handler
-
-    The SetupTerminationHandler function registers a termination handler
-    function with the kernel in case of an abnormal termination of this
-    process.
+    Handle a metrics request
 
-==============================================================================*/
-static void SetupTerminationHandler( void )
-{
-    static struct sigaction sigact;
-
-    memset( &sigact, 0, sizeof(sigact) );
-
-    sigact.sa_sigaction = TerminationHandler;
-    sigact.sa_flags = SA_SIGINFO;
+    The ProcessMetricsRequest function outputs the request metrics
+    in the Prometheus text exposition format, or in CBOR or MessagePack
+    if the client accepts one of them.  The text format also includes
+    per-process gauges from the most recently loaded process table.
 
-    sigaction( SIGTERM, &sigact, NULL );
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
 
-}
+    @param[in]
+        query
+            pointer to the query argument (unused)
 
-/*============================================================================*/
-/*  TerminationHandler                                                        */
-/*!
-    Abnormal termination handler
+    @retval EOK query processed successfully
+    @retval EINVAL invalid arguments
 
-    The TerminationHandler function will be invoked in case of an abnormal
-    termination of this process.
+==============================================================================*/
+static int ProcessMetricsRequest( FCGIProcState *pState, char *query )
+{
+    int result = EINVAL;
+    Encoder encoder;
 
-@param[in]
-    signum
-        The signal which caused the abnormal termination (unused)
+    if ( ( pState != NULL ) && ( pState->format != ENCODER_JSON ) )
+    {
+        Encoder_Init( &encoder,
+                      pState->format,
+                      Response_Write,
+                      &pState->response );
 
-@param[in]
-    info
-        pointer to a siginfo_t object (unused)
+        SendEncodedHeader( pState );
+        result = Metrics_Encode( &encoder );
+    }
+    else if ( pState != NULL )
+    {
+        SendHeader( pState );
+        result = Metrics_Output( Response_Write, &pState->response );
+        if ( result == EOK )
+        {
+            /* process gauges as of the most recently loaded table */
+            result = ProcTable_Metrics( Snapshot_Enter( &tableSnapshot,
+                                                        pState->worker ),
+                                        Response_Write,
+                                        &pState->response );
+        }
 
-@param[in]
-    ptr
-        signal context information (ucontext_t) (unused)
+        if ( result == EOK )
+        {
+            result = ProcTrack_Metrics( Response_Write, &pState->response );
+        }
+    }
 
-==============================================================================*/
-static void TerminationHandler( int signum, siginfo_t *info, void *ptr )
-{
+    return result;
 }
 
 /*============================================================================*/
-/*  ValidateProcName                                                          */
+/*  ProcessSummaryRequest                                                     */
 /*!
-    Validate the process name
+    Handle a process summary request
 
-    The ValidateProcName function checks the specified process name
-    to make sure it only contains alphanumeric characters.
+    The ProcessSummaryRequest function outputs the number of processes
+    in each state, the total number of restarts, and the number of
+    processes restarted in the last "minutes" minutes (default 10,
+    at most 60).  The totals are maintained as the process table is
+    loaded, so the list is not serialized, and the table is only loaded
+    if the cached list it was loaded from has changed.
 
     @param[in]
-       procname
-            pointer to the NUL terminated process name
+        pState
+            pointer to the FCGIProc state object
 
-    @retval EOK - the process name is valid
-    @retval EINVAL - the process name is invalid
+    @param[in]
+        query
+            pointer to the query argument (unused)
+
+    @retval EOK query processed successfully
+    @retval EINVAL invalid arguments
 
 ==============================================================================*/
-static int ValidateProcName( char *procname )
+static int ProcessSummaryRequest( FCGIProcState *pState, char *query )
 {
     int result = EINVAL;
-    int len;
-    int i;
+    unsigned int minutes = PROCTRACK_DEFAULT_MINUTES;
+    char buf[16];
+    Encoder encoder;
 
-    if ( procname != NULL )
+    if ( pState != NULL )
     {
-        result = EOK;
+        if ( GetQueryParam( pState, "minutes", buf, sizeof( buf ) ) == EOK )
+        {
+            minutes = strtoul( buf, NULL, 0 );
+        }
 
-        len = strlen( procname );
-        for(i=0;i<len;i++)
+        if ( ( minutes == 0 ) || ( minutes > PROCTRACK_WINDOW_MINUTES ) )
         {
-            if ( ! ( isalpha(procname[i]) || isdigit(procname[i]) ) )
+            result = ErrorResponse( pState, 400, "Bad request" );
+        }
+        else
+        {
+            result = ( TableCurrent() == true ) ? EOK
+                                                : LoadProcTable( pState );
+            if ( result == EOK )
             {
-                result = EINVAL;
+                Encoder_Init( &encoder,
+                              pState->format,
+                              Response_Write,
+                              &pState->response );
+
+                SendEncodedHeader( pState );
+                result = ProcTrack_EncodeSummary( minutes,
+                                                  GetTimeUs(),
+                                                  &encoder );
+            }
+            else
+            {
+                result = TableErrorResponse( pState, result );
             }
         }
     }
@@ -1168,83 +2623,2533 @@ static int ValidateProcName( char *procname )
 }
 
 /*============================================================================*/
-/*  ExecuteCommand                                                            */
+/*  ProcessFlappingRequest                                                    */
 /*!
-    Execute a command and pipe the output to the output stream
+    Handle a flapping process request
 
-    The ExecuteCommand function executes the specified command
-    and redirects the command output to the FCGI output stream
+    The ProcessFlappingRequest function outputs the records of the
+    processes which restarted at least PROCTRACK_FLAP_RESTARTS times
+    in the last PROCTRACK_FLAP_MINUTES minutes.
 
     @param[in]
-       cmd
-            pointer to the NUL terminated command string to execute
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        query
+            pointer to the query argument (unused)
+
+    @retval EOK query processed successfully
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int ProcessFlappingRequest( FCGIProcState *pState, char *query )
+{
+    int result = EINVAL;
+    Encoder encoder;
+
+    if ( pState != NULL )
+    {
+        result = LoadProcTable( pState );
+        if ( result == EOK )
+        {
+            Encoder_Init( &encoder,
+                          pState->format,
+                          Response_Write,
+                          &pState->response );
+
+            SendEncodedHeader( pState );
+            result = ProcTrack_EncodeFlapping( pState->pTable, &encoder );
+        }
+        else
+        {
+            result = TableErrorResponse( pState, result );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcessStatusRequest                                                      */
+/*!
+    Handle an internal status request
+
+    The ProcessStatusRequest function outputs the internal status
+    (worker activity, procmon children in flight, buffer high-water
+    marks and uptime) if the status endpoint is enabled with -S.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        query
+            pointer to the query argument (unused)
+
+    @retval EOK query processed successfully
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int ProcessStatusRequest( FCGIProcState *pState, char *query )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        if ( pState->statusEnabled == true )
+        {
+            SendJSONHeader( pState );
+            result = Status_Output( Response_Write, &pState->response );
+        }
+        else
+        {
+            result = ErrorResponse( pState, 404, "Not Found" );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcessHealthRequest                                                      */
+/*!
+    Handle a health probe
+
+    The ProcessHealthRequest function answers a liveness probe.  The
+    request is being served, so the process and its request worker are
+    alive.  The response is preformatted and procmon is never run.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        query
+            pointer to the query argument (unused)
+
+    @retval EOK query processed successfully
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int ProcessHealthRequest( FCGIProcState *pState, char *query )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        result = SendResponse( pState,
+                               healthyResponse,
+                               sizeof( healthyResponse ) - 1 );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcessReadyRequest                                                       */
+/*!
+    Handle a readiness probe
+
+    The ProcessReadyRequest function answers a readiness probe from the
+    in-memory state: fcgi_proc is ready when procmon was found at
+    startup and is not failing to run, the cached process list is not
+    overdue for a refresh, and the batch action workers are running.
+    The response is preformatted and procmon is never run.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        query
+            pointer to the query argument (unused)
+
+    @retval EOK query processed successfully
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int ProcessReadyRequest( FCGIProcState *pState, char *query )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        result = ( Health_IsReady() &&
+                   ListCache_IsCurrent( GetTimeUs() ) &&
+                   Executor_IsRunning() )
+                    ? SendResponse( pState,
+                                    healthyResponse,
+                                    sizeof( healthyResponse ) - 1 )
+                    : SendResponse( pState,
+                                    unavailableResponse,
+                                    sizeof( unavailableResponse ) - 1 );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcessWaitRequest                                                        */
+/*!
+    Handle a wait for process state request
+
+    The ProcessWaitRequest function answers with the process record once
+    the process specified in the query argument is in the state given
+    by the state parameter (running by default).  If it is not in that
+    state yet, the request is parked: it is detached from libfcgi and
+    answered by a coroutine (see WaitForState) when a refreshed process
+    table shows the state, or with a 408 response once the time given
+    by the timeout parameter (in milliseconds) has passed.  A request
+    whose connection is closed by the web server is dropped at once
+    (see WatchHangup).  While requests are parked, the process list is
+    refreshed every WAIT_POLL_INTERVAL milliseconds (see PollStates).
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        query
+            pointer to the name of the process to wait for
+
+    @retval EOK query processed successfully
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int ProcessWaitRequest( FCGIProcState *pState, char *query )
+{
+    int result = EINVAL;
+    const ProcRecord *pRecord = NULL;
+    Encoder encoder;
+    Waiter *pWaiter;
+    char state[PROCTABLE_STATE_LEN] = "running";
+    char timeout[16];
+    unsigned long timeoutMs = WAIT_DEFAULT_TIMEOUT;
+
+    if ( ( pState != NULL ) &&
+         ( query != NULL ) )
+    {
+        result = ValidateProcName( query );
+        if ( ( result == EOK ) &&
+             ( GetQueryParam( pState, "state", state, sizeof state ) == E2BIG ) )
+        {
+            result = EINVAL;
+        }
+
+        if ( ( result == EOK ) &&
+             ( GetQueryParam( pState,
+                              "timeout",
+                              timeout,
+                              sizeof timeout ) == EOK ) )
+        {
+            timeoutMs = strtoul( timeout, NULL, 10 );
+            if ( ( timeoutMs == 0 ) || ( timeoutMs > WAIT_MAX_TIMEOUT ) )
+            {
+                result = EINVAL;
+            }
+        }
+
+        if ( result == EOK )
+        {
+            result = LoadProcTable( pState );
+            if ( result == EOK )
+            {
+                pRecord = ProcTable_Find( pState->pTable, query );
+                if ( pRecord == NULL )
+                {
+                    result = ErrorResponse( pState, 404, "Not Found" );
+                }
+                else if ( strcmp( pRecord->state, state ) == 0 )
+                {
+                    Encoder_Init( &encoder,
+                                  pState->format,
+                                  Response_Write,
+                                  &pState->response );
+
+                    SendEncodedHeader( pState );
+                    result = ProcTable_EncodeRecord( pRecord, 0, &encoder );
+                }
+                else if ( pFreeWaiters == NULL )
+                {
+                    result = ErrorResponse( pState, 503, "Too Many Waiters" );
+                }
+                else
+                {
+                    pWaiter = pFreeWaiters;
+                    pFreeWaiters = pWaiter->pNextFree;
+                    nWaiters++;
+
+                    memset( &pWaiter->request, 0, sizeof( FCGX_Request ) );
+                    pWaiter->request.ipcFd = pState->request.ipcFd;
+                    pWaiter->request.requestId = pState->request.requestId;
+                    strcpy( pWaiter->name, pRecord->name );
+                    strcpy( pWaiter->state, state );
+                    pWaiter->deadlineUs = GetTimeUs() + ( timeoutMs * 1000ULL );
+                    pWaiter->format = pState->format;
+                    pWaiter->active = 2;
+
+                    Coro_Start( &pWaiter->coro, WaitForState, pWaiter );
+                    Coro_Start( &pWaiter->hangup, WatchHangup, pWaiter );
+                    pState->parked = true;
+
+                    if ( polling == false )
+                    {
+                        polling = ( Coro_StartTask( &poller,
+                                                    PollStates,
+                                                    pState ) == EOK );
+                    }
+                }
+            }
+            else
+            {
+                result = TableErrorResponse( pState, result );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  InitWaiters                                                               */
+/*!
+    Initialize the parked request pool
+
+    The InitWaiters function initializes the coroutine runtime, and
+    allocates the parked requests and their shared response buffer.
+    Each parked request holds its connection open, so the file
+    descriptor limit is raised to its hard limit, and the number of
+    parked requests is kept within it, leaving room for the kept
+    connections.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @retval EOK the parked request pool was initialized
+    @retval ENOMEM cannot allocate the parked requests
+    @retval other error initializing the coroutine runtime
+
+==============================================================================*/
+static int InitWaiters( FCGIProcState *pState )
+{
+    int result;
+    struct rlimit limit;
+    size_t i;
+
+    maxWaiters = WAIT_MAX_WAITERS;
+    if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 )
+    {
+        if ( limit.rlim_cur < limit.rlim_max )
+        {
+            limit.rlim_cur = limit.rlim_max;
+            if ( setrlimit( RLIMIT_NOFILE, &limit ) != 0 )
+            {
+                getrlimit( RLIMIT_NOFILE, &limit );
+            }
+        }
+
+        if ( limit.rlim_cur <
+                WAIT_MAX_WAITERS + WAIT_RESERVED_FDS + CONN_MAX_KEPT )
+        {
+            maxWaiters =
+                ( limit.rlim_cur > 2 * ( WAIT_RESERVED_FDS + CONN_MAX_KEPT ) )
+                    ? limit.rlim_cur - WAIT_RESERVED_FDS - CONN_MAX_KEPT
+                    : limit.rlim_cur / 2;
+            syslog( LOG_WARNING,
+                    "parked requests limited to %zu by the open file limit",
+                    maxWaiters );
+        }
+    }
+
+    /* the request task, the poller and the kept connections may wait
+       with timeouts too */
+    result = Coro_Init( maxWaiters + CONN_MAX_KEPT + 4,
+                        ( pState->ioUring == true ) ? CORO_IO_URING
+                                                    : CORO_IO_EPOLL );
+    if ( ( result == EOK ) &&
+         ( pState->ioUring == true ) &&
+         ( Coro_GetIo() != CORO_IO_URING ) )
+    {
+        syslog( LOG_WARNING, "io_uring is not available, using epoll" );
+    }
+
+    if ( result == EOK )
+    {
+        result = Response_Init( &waitResponse, WAIT_RESPONSE_LEN );
+    }
+
+    if ( result == EOK )
+    {
+        result = Response_Init( &pollOutput, RESPONSE_BUFFER_SIZE );
+    }
+
+    if ( result == EOK )
+    {
+        pWaiters = calloc( maxWaiters, sizeof( Waiter ) );
+        if ( pWaiters != NULL )
+        {
+            for ( i = 0; i < maxWaiters; i++ )
+            {
+                pWaiters[i].pNextFree = pFreeWaiters;
+                pFreeWaiters = &pWaiters[i];
+            }
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DetachRequest                                                             */
+/*!
+    Detach a parked request from libfcgi
+
+    The DetachRequest function hands the connection of a parked request
+    over to its waiter, so that finishing the request in libfcgi neither
+    writes its closing records nor closes the connection.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+==============================================================================*/
+static void DetachRequest( FCGIProcState *pState )
+{
+    if ( pState != NULL )
+    {
+        if ( pState->request.out != NULL )
+        {
+            pState->request.out->wasFCloseCalled = 1;
+            pState->request.out->isClosed = 1;
+        }
+
+        pState->request.ipcFd = -1;
+    }
+}
+
+/*============================================================================*/
+/*  WaitForState                                                              */
+/*!
+    Answer a parked request
+
+    The WaitForState coroutine checks the state of the process of a
+    parked request each time a process table snapshot is published,
+    until the process reaches the requested state, disappears, or the
+    request times out.  It then answers the request and returns the
+    waiter to the pool.  A request whose connection was closed by the
+    web server is cancelled (see WatchHangup), and is not answered.
+
+    @param[in]
+        pCoro
+            pointer to the coroutine, with the Waiter as its argument
+
+    @retval CORO_SUSPENDED the coroutine is waiting for a new table
+    @retval CORO_DONE the request was answered
+
+==============================================================================*/
+static int WaitForState( Coro *pCoro )
+{
+    Waiter *pWaiter = pCoro->arg;
+    const ProcTable *pTable;
+    const ProcRecord *pRecord;
+    uint64_t nowUs;
+    bool done = false;
+
+    CORO_BEGIN( pCoro );
+
+    while ( done == false )
+    {
+        /* wait at least a millisecond for the remaining time */
+        nowUs = GetTimeUs();
+        Coro_WaitEvent( pCoro,
+                        &tableEvent,
+                        ( pWaiter->deadlineUs > nowUs + 1000 )
+                            ? ( pWaiter->deadlineUs - nowUs ) / 1000
+                            : 1 );
+        CORO_SUSPEND( pCoro );
+
+        if ( pCoro->wake == CORO_WAKE_CANCEL )
+        {
+            /* the web server has given up on the request */
+            done = true;
+        }
+        else if ( pCoro->wake == CORO_WAKE_TIMEOUT )
+        {
+            AnswerWaiter( pWaiter, NULL, 408, "Request Timeout" );
+            done = true;
+        }
+        else
+        {
+            /* the request being processed may hold its own reader slot
+               across a wait, so the parked requests have their own */
+            pTable = Snapshot_Enter( &tableSnapshot, WAIT_SNAPSHOT_READER );
+            pRecord = ProcTable_Find( pTable, pWaiter->name );
+            if ( pRecord == NULL )
+            {
+                AnswerWaiter( pWaiter, NULL, 404, "Not Found" );
+                done = true;
+            }
+            else if ( strcmp( pRecord->state, pWaiter->state ) == 0 )
+            {
+                AnswerWaiter( pWaiter, pRecord, 200, NULL );
+                done = true;
+            }
+
+            Snapshot_Exit( &tableSnapshot, WAIT_SNAPSHOT_READER );
+        }
+    }
+
+    Coro_Cancel( &pWaiter->hangup );
+    ReleaseWaiter( pWaiter );
+
+    CORO_END( pCoro );
+}
+
+/*============================================================================*/
+/*  WatchHangup                                                               */
+/*!
+    Watch the connection of a parked request
+
+    The WatchHangup coroutine waits for the web server to close the
+    connection of a parked request, eg as its client went away, and
+    then cancels the request so its waiter is freed without waiting for
+    the request to time out.
+
+    @param[in]
+        pCoro
+            pointer to the coroutine, with the Waiter as its argument
+
+    @retval CORO_SUSPENDED the coroutine is waiting
+    @retval CORO_DONE the connection was closed or the request answered
+
+==============================================================================*/
+static int WatchHangup( Coro *pCoro )
+{
+    Waiter *pWaiter = pCoro->arg;
+
+    CORO_BEGIN( pCoro );
+
+    if ( Coro_WaitFd( pCoro, pWaiter->request.ipcFd, EPOLLRDHUP, 0 ) == EOK )
+    {
+        CORO_SUSPEND( pCoro );
+
+        if ( pCoro->wake == CORO_WAKE_FD )
+        {
+            Coro_Cancel( &pWaiter->coro );
+        }
+    }
+
+    ReleaseWaiter( pWaiter );
+
+    CORO_END( pCoro );
+}
+
+/*============================================================================*/
+/*  ReleaseWaiter                                                             */
+/*!
+    Release a parked request
+
+    The ReleaseWaiter function closes the connection of a parked request
+    and returns its waiter to the pool once both of its coroutines have
+    completed.
+
+    @param[in]
+        pWaiter
+            pointer to the parked request
+
+==============================================================================*/
+static void ReleaseWaiter( Waiter *pWaiter )
+{
+    if ( --pWaiter->active == 0 )
+    {
+        close( pWaiter->request.ipcFd );
+        pWaiter->request.ipcFd = -1;
+
+        pWaiter->pNextFree = pFreeWaiters;
+        pFreeWaiters = pWaiter;
+        nWaiters--;
+    }
+}
+
+/*============================================================================*/
+/*  PollStates                                                                */
+/*!
+    Refresh the process list while requests are parked
+
+    The PollStates task reloads the process table every
+    WAIT_POLL_INTERVAL milliseconds while there are parked requests,
+    which wakes the parked requests to check it.  procmon is run without
+    waiting for it: its output is read as it becomes available, so the
+    request task goes on processing requests while procmon runs (see
+    StartPoll).  The poller has its own buffers, as a request may be
+    waiting in the middle of its own refresh.
+
+    @param[in]
+        arg
+            pointer to the FCGIProc state object
+
+==============================================================================*/
+static void PollStates( void *arg )
+{
+    FCGIProcState *pState = arg;
+    struct pollfd pfd;
+
+    while ( nWaiters > 0 )
+    {
+        if ( Coro_Sleep( Coro_Self(), WAIT_POLL_INTERVAL ) == EOK )
+        {
+            (void)Coro_Yield();
+        }
+
+        if ( ( nWaiters > 0 ) && ( StartPoll( pState ) == EOK ) )
+        {
+            pfd.fd = pollFd;
+            pfd.events = POLLIN;
+
+            while ( ReadPoll() == false )
+            {
+                if ( Coro_Poll( &pfd, 1, -1 ) == -1 )
+                {
+                    /* the pipe cannot be waited for, so read it until
+                       procmon closes it */
+                    fcntl( pollFd, F_SETFL, 0 );
+                }
+            }
+
+            FinishPoll( pState );
+        }
+    }
+
+    polling = false;
+}
+
+/*============================================================================*/
+/*  StartPoll                                                                 */
+/*!
+    Start a process list refresh for the parked requests
+
+    The StartPoll function starts procmon with its output connected to a
+    non-blocking pipe, for the poller to read.  If the list cache holds
+    a current list, the table is loaded from it instead.  The backends
+    are listed together into the poller buffer, within BACKEND_DEADLINE
+    milliseconds, and the table is loaded from their list directly.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @retval EOK procmon was started
+    @retval EALREADY the table was refreshed without running procmon
+    @retval ENOENT procmon could not be started
+
+==============================================================================*/
+static int StartPoll( FCGIProcState *pState )
+{
+    int result = EALREADY;
+    char *argv[] = { PROCMON_PATH, "-o", "json", NULL };
+    const char *data;
+    size_t len;
+    CompressEncoding encoding;
+    int exitStatus = -1;
+    uint64_t generation;
+
+    if ( ListCache_Get( GetTimeUs(),
+                        COMPRESS_IDENTITY,
+                        &data,
+                        &len,
+                        &encoding ) == EOK )
+    {
+        if ( ListCache_Generation() != __atomic_load_n( &tableGeneration,
+                                                        __ATOMIC_ACQUIRE ) )
+        {
+            PublishProcTable( pState, data, len, ListCache_Generation() );
+        }
+    }
+    else if ( Backend_Count() > 0 )
+    {
+        /* a request listing the backends leaves this refresh to it */
+        Response_Begin( &pollOutput, NULL );
+        if ( Backend_List( Response_Write,
+                           &pollOutput,
+                           &exitStatus ) == EOK )
+        {
+            generation = ( ( exitStatus == 0 ) &&
+                           ( serving == false ) &&
+                           ( ListCache_Store( GetTimeUs(),
+                                              pollOutput.buf,
+                                              pollOutput.len ) == EOK ) )
+                            ? ListCache_Generation()
+                            : 0;
+            PublishProcTable( pState,
+                              pollOutput.buf,
+                              pollOutput.len,
+                              generation );
+        }
+
+        ListCache_Release();
+    }
+    else
+    {
+        result = Spawn_Command( argv, COMMAND_PIPE_SIZE, &pollPid, &pollFd );
+        if ( result == EOK )
+        {
+            Status_ChildStart( pollPid, argv );
+            fcntl( pollFd, F_SETFL, O_NONBLOCK );
+            Response_Begin( &pollOutput, NULL );
+            pollTruncated = false;
+        }
+        else
+        {
+            Health_BackendResult( false );
+            ListCache_Release();
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ReadPoll                                                                  */
+/*!
+    Read the procmon output of a process list refresh
+
+    The ReadPoll function reads the procmon output which is available
+    into the poller buffer, which grows to hold the whole list.  Output
+    which cannot be held is discarded so procmon can run to completion.
+
+    @retval true procmon has closed its output
+    @retval false more output may follow
+
+==============================================================================*/
+static bool ReadPoll( void )
+{
+    char discard[512];
+    char *p;
+    size_t available;
+    ssize_t n;
+    bool eof = false;
+    bool more = true;
+
+    while ( more == true )
+    {
+        p = Response_Reserve( &pollOutput, &available );
+        if ( p == NULL )
+        {
+            p = discard;
+            available = sizeof( discard );
+            pollTruncated = true;
+        }
+
+        n = read( pollFd, p, available );
+        if ( n > 0 )
+        {
+            if ( p != discard )
+            {
+                Response_Commit( &pollOutput, n );
+            }
+        }
+        else if ( ( n == 0 ) ||
+                  ( ( errno != EINTR ) && ( errno != EAGAIN ) ) )
+        {
+            eof = true;
+            more = false;
+        }
+        else if ( errno == EAGAIN )
+        {
+            more = false;
+        }
+    }
+
+    return eof;
+}
+
+/*============================================================================*/
+/*  FinishPoll                                                                */
+/*!
+    Complete a process list refresh for the parked requests
+
+    The FinishPoll function reaps procmon once it has closed its output,
+    which it does as it exits, and publishes the process table loaded
+    from the list.  The list is also cached for the requests, unless a
+    request is being processed, as it may hold the cached list across a
+    wait.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+==============================================================================*/
+static void FinishPoll( FCGIProcState *pState )
+{
+    int status;
+    uint64_t generation;
+
+    close( pollFd );
+    pollFd = -1;
+
+    status = Spawn_Wait( pollPid );
+    Status_ChildEnd( pollPid );
+
+    /* an exec failure or a crash is a backend failure */
+    Health_BackendResult( WIFEXITED( status ) &&
+                          ( WEXITSTATUS( status ) != 127 ) );
+
+    if ( ( WIFEXITED( status ) ) &&
+         ( WEXITSTATUS( status ) == 0 ) &&
+         ( pollTruncated == false ) )
+    {
+        generation = ( ( serving == false ) &&
+                       ( ListCache_Store( GetTimeUs(),
+                                          pollOutput.buf,
+                                          pollOutput.len ) == EOK ) )
+                        ? ListCache_Generation()
+                        : 0;
+        PublishProcTable( pState, pollOutput.buf, pollOutput.len, generation );
+    }
+
+    ListCache_Release();
+}
+
+/*============================================================================*/
+/*  AnswerWaiter                                                              */
+/*!
+    Send the response of a parked request
+
+    The AnswerWaiter function sends the process record, or an error
+    response on the connection of a parked request.
+
+    @param[in]
+        pWaiter
+            pointer to the parked request
+
+    @param[in]
+        pRecord
+            pointer to the process record to send, or NULL to send an
+            error response
+
+    @param[in]
+        status
+            HTTP status of the error response
+
+    @param[in]
+        description
+            description of the error response
+
+==============================================================================*/
+static void AnswerWaiter( Waiter *pWaiter,
+                          const ProcRecord *pRecord,
+                          int status,
+                          const char *description )
+{
+    Encoder encoder;
+    const char *header;
+
+    Response_Begin( &waitResponse, &pWaiter->request );
+
+    if ( pRecord != NULL )
+    {
+        header = formatHeaders[pWaiter->format];
+        Response_Header( &waitResponse,
+                         header,
+                         strlen( header ),
+                         COMPRESS_IDENTITY );
+
+        Encoder_Init( &encoder,
+                      pWaiter->format,
+                      Response_Write,
+                      &waitResponse );
+        ProcTable_EncodeRecord( pRecord, 0, &encoder );
+    }
+    else
+    {
+        Response_Printf( &waitResponse,
+                         "Status: %d %s\r\n"
+                         "Content-Type: application/json\r\n\r\n"
+                         "{\"status\": %d, \"description\" : \"%s\"}",
+                         status,
+                         description,
+                         status,
+                         description );
+    }
+
+    Response_Finish( &waitResponse, 0 );
+}
+
+/*============================================================================*/
+/*  AllocatePOSTBuffer                                                        */
+/*!
+    Allocate memory for the POST buffer
+
+    The AllocatePOSTBuffer function allocates storage space on the heap
+    for a buffer to contain the POST data.  It gets the requested POST
+    buffer size from the FCGIProcState object.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object containing the requested
+            POST buffer size
+
+    @retval EOK memory was successfully allocated for the POST buffer
+    @retval ENOMEM could not allocate memory for the POST buffer
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int AllocatePOSTBuffer( FCGIProcState *pState )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        if( pState->maxPostLength > 0 )
+        {
+            /* allocate memory for the POST buffer including a NUL terminator */
+            pState->postBuffer = calloc( 1, pState->maxPostLength + 1 );
+            if( pState->postBuffer != NULL )
+            {
+                result = EOK;
+            }
+            else
+            {
+                /* cannot allocate memory for the POST buffer */
+                result = ENOMEM;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  AllocateQueryBuffer                                                       */
+/*!
+    Allocate memory for the query buffer
+
+    The AllocateQueryBuffer function allocates the buffer used to split
+    the query string into its query functions, so that no memory needs
+    to be allocated while processing a request.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @retval EOK memory was successfully allocated for the query buffer
+    @retval ENOMEM could not allocate memory for the query buffer
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int AllocateQueryBuffer( FCGIProcState *pState )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        pState->queryBuffer = calloc( 1, MAX_QUERY_LENGTH );
+        result = ( pState->queryBuffer != NULL ) ? EOK : ENOMEM;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CheckAllocations                                                          */
+/*!
+    Verify that a warmed-up list or get request did not allocate
+
+    The CheckAllocations function implements the zero allocation
+    verification mode (-Z).  The warm-up is counted separately for the
+    list and the get request classes.  Once the configured number of
+    warm-up requests of its class have been processed, a list or get
+    request which made any heap allocation is reported and the process
+    is aborted, so a test run fails loudly.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        allocCalls
+            number of allocation calls made by the completed request
+
+==============================================================================*/
+static void CheckAllocations( FCGIProcState *pState, uint64_t allocCalls )
+{
+    if ( ( pState != NULL ) &&
+         ( pState->allocCheck == true ) &&
+         ( ( pState->reqClass == REQ_CLASS_LIST ) ||
+           ( pState->reqClass == REQ_CLASS_GET ) ) &&
+         ( ++pState->allocCheckCount[pState->reqClass] >
+           pState->allocCheckWarmup ) &&
+         ( allocCalls > 0 ) )
+    {
+        syslog( LOG_CRIT,
+                "request %llu (%s) made %llu allocations after warm-up",
+                (unsigned long long)pState->requestId,
+                Metrics_ClassName( pState->reqClass ),
+                (unsigned long long)allocCalls );
+        abort();
+    }
+}
+
+/*============================================================================*/
+/*  GetTimeUs                                                                 */
+/*!
+    Get the monotonic time in microseconds
+
+    @retval current monotonic time in microseconds
+
+==============================================================================*/
+static uint64_t GetTimeUs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/*============================================================================*/
+/*  ClearPOSTBuffer                                                           */
+/*!
+    Zero the memory used for the POST data
+
+    The ClearPOSTBuffer function zeros the memory used by the POST buffer
+    between requests.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object containing the POST buffer.
+
+    @retval EOK memory was successfully allocated for the POST buffer
+    @retval ENOMEM the POST buffer memory was not allocated
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int ClearPOSTBuffer( FCGIProcState *pState )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        if ( pState->postBuffer != NULL )
+        {
+            /* clear the post buffer (including NUL terminator) */
+            memset( pState->postBuffer, 0, pState->maxPostLength + 1 );
+
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SetupTerminationHandler                                                   */
+/*!
+    Set up an abnormal termination handler
+
+    The SetupTerminationHandler function registers a termination handler
+    function with the kernel in case of an abnormal termination of this
+    process.  SIGPIPE is ignored, since splicing output to a connection
+    the web server has closed raises it, and the failure is handled
+    where the output is sent.
+
+==============================================================================*/
+static void SetupTerminationHandler( void )
+{
+    static struct sigaction sigact;
+
+    memset( &sigact, 0, sizeof(sigact) );
+
+    sigact.sa_sigaction = TerminationHandler;
+    sigact.sa_flags = SA_SIGINFO;
+
+    sigaction( SIGTERM, &sigact, NULL );
+
+    signal( SIGPIPE, SIG_IGN );
+
+}
+
+/*============================================================================*/
+/*  TerminationHandler                                                        */
+/*!
+    Abnormal termination handler
+
+    The TerminationHandler function will be invoked in case of an abnormal
+    termination of this process.
+
+@param[in]
+    signum
+        The signal which caused the abnormal termination (unused)
+
+@param[in]
+    info
+        pointer to a siginfo_t object (unused)
+
+@param[in]
+    ptr
+        signal context information (ucontext_t) (unused)
+
+==============================================================================*/
+static void TerminationHandler( int signum, siginfo_t *info, void *ptr )
+{
+}
+
+/*============================================================================*/
+/*  ValidateProcName                                                          */
+/*!
+    Validate the process name
+
+    The ValidateProcName function checks the specified process name
+    to make sure it only contains alphanumeric characters.  When
+    several backends are configured, the name may be qualified with the
+    instance of the process as <instance>/<name>, where the instance
+    name may also contain '-' and '_' (see backend.c).
+
+    @param[in]
+       procname
+            pointer to the NUL terminated process name
+
+    @retval EOK - the process name is valid
+    @retval EINVAL - the process name is invalid
+
+==============================================================================*/
+static int ValidateProcName( char *procname )
+{
+    int result = EINVAL;
+    int len;
+    int i;
+    int qualifier = 0;
+
+    if ( procname != NULL )
+    {
+        result = EOK;
+
+        if ( Backend_Count() > 0 )
+        {
+            /* skip a valid instance qualifier */
+            while ( isalnum( (unsigned char)procname[qualifier] ) ||
+                    ( procname[qualifier] == '-' ) ||
+                    ( procname[qualifier] == '_' ) )
+            {
+                qualifier++;
+            }
+
+            qualifier = ( ( qualifier > 0 ) && ( procname[qualifier] == '/' ) )
+                            ? qualifier + 1
+                            : 0;
+        }
+
+        len = strlen( procname );
+        for(i=qualifier;i<len;i++)
+        {
+            if ( ! ( isalpha(procname[i]) || isdigit(procname[i]) ) )
+            {
+                result = EINVAL;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ExecuteCommand                                                            */
+/*!
+    Execute a command and pipe the output to the output stream
+
+    The ExecuteCommand function executes the specified command
+    and redirects the command output to the FCGI output stream,
+    after a text or JSON response header.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        argv
+            NULL terminated argument vector of the command to execute.
+            argv[0] is the full path of the command.
 
     @param[in]
         json
             boolean indicating if JSON output is expected (true)
             or not (false)
 
-    @retval EOK - command executed successfully
-    @retval ENOENT - the command was not found
-    @retval EINVAL - invalid arguments
+    @retval EOK - command executed successfully
+    @retval ENOENT - the command could not be run
+    @retval EINVAL - invalid arguments
+
+==============================================================================*/
+static int ExecuteCommand( FCGIProcState *pState,
+                           char * const argv[],
+                           bool json )
+{
+    int result = EINVAL;
+
+    if ( pState != NULL )
+    {
+        result = json ? RunCommand( pState,
+                                    argv,
+                                    &pState->response,
+                                    jsonHeader,
+                                    sizeof( jsonHeader ) - 1,
+                                    true )
+                      : RunCommand( pState,
+                                    argv,
+                                    &pState->response,
+                                    textHeader,
+                                    sizeof( textHeader ) - 1,
+                                    true );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RunCommand                                                                */
+/*!
+    Run a command and collect its output
+
+    The RunCommand function runs the specified command and adds its
+    output to a response, after an optional response header which is
+    only written once the command has started.
+
+    The command is run directly (without a shell) with its output
+    connected to a pipe large enough to hold a full process list, so
+    the command can write all of its output and exit without waiting
+    for it to be read.  The request task waits for the output in the
+    event loop, and reads what is in the pipe directly into the
+    response buffer, so no heap memory is allocated and the output is
+    not copied before it is sent.  After the first output, the output
+    is left to collect for up to COMMAND_DRAIN_INTERVAL milliseconds
+    between reads, unless the command closes its output first, so it is
+    read in a few large reads rather than one for each write by the
+    command.  Once the command has closed its output the rest is read
+    without waiting.  Only when a read fills
+    COMMAND_SPLICE_MIN bytes is the pipe checked for more passthrough
+    output, which is then spliced from the pipe to the connection
+    without being copied into the process at all.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        argv
+            NULL terminated argument vector of the command to execute.
+            argv[0] is the full path of the command.
+
+    @param[in]
+        pOutput
+            pointer to the response to add the command output to
+
+    @param[in]
+        header
+            pointer to the response header, or NULL for no header
+
+    @param[in]
+        headerLen
+            length of the response header
+
+    @param[in]
+        passthrough
+            true if the output is only sent, so it need not pass through
+            the response buffer
+
+    @retval EOK - command executed successfully
+    @retval ENOENT - the command could not be run
+    @retval EINVAL - invalid arguments
+
+==============================================================================*/
+static int RunCommand( FCGIProcState *pState,
+                       char * const argv[],
+                       Response *pOutput,
+                       const char *header,
+                       size_t headerLen,
+                       bool passthrough )
+{
+    int result = EINVAL;
+    int fd;
+    pid_t pid;
+    struct pollfd pfd;
+    bool first = true;
+    int status;
+    int pending;
+    size_t n;
+    size_t moved;
+    uint64_t spawnStart;
+    uint64_t childStart;
+    uint64_t drainStart;
+
+    if( ( pState != NULL ) &&
+        ( argv != NULL ) &&
+        ( argv[0] != NULL ) &&
+        ( pOutput != NULL ) )
+    {
+        /* assume command not executed until the child is created */
+        result = ENOENT;
+        pState->exitStatus = -1;
+
+        PROBE_SPAWN_START( pState->requestId, pState->action, argv[0] );
+        spawnStart = TRACE_START();
+
+        /* run the command with its output connected to a pipe */
+        if ( Spawn_Command( argv, COMMAND_PIPE_SIZE, &pid, &fd ) == EOK )
+        {
+            Status_ChildStart( pid, argv );
+
+            Trace_Span( "spawn",
+                        pState->requestId,
+                        spawnStart,
+                        pState->action );
+            childStart = TRACE_START();
+
+            /* send the header */
+            if ( header != NULL )
+            {
+                Response_Header( pOutput,
+                                 header,
+                                 headerLen,
+                                 COMPRESS_IDENTITY );
+            }
+
+            drainStart = TRACE_START();
+
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+
+            do
+            {
+                /* wait for the first output, then for the command to
+                 * close its output or for more output to collect, unless
+                 * the command has closed its output already, and read
+                 * all that is in the pipe */
+                if ( ( pfd.revents & POLLHUP ) == 0 )
+                {
+                    pfd.revents = 0;
+                    (void)Coro_Poll( &pfd,
+                                     1,
+                                     ( first == true ) ? -1
+                                                       : COMMAND_DRAIN_INTERVAL );
+                    pfd.events = 0;
+                }
+
+                n = ReadOutput( pOutput, fd, SIZE_MAX );
+                if ( ( n > 0 ) && ( first == true ) )
+                {
+                    PROBE_OUTPUT_FIRST( pState->requestId,
+                                        pState->action );
+                    first = false;
+                }
+
+                /* only output which filled a large read is checked for
+                 * more to splice */
+                if ( ( passthrough == true ) &&
+                     ( n >= COMMAND_SPLICE_MIN ) &&
+                     ( ioctl( fd, FIONREAD, &pending ) == 0 ) &&
+                     ( pending >= COMMAND_SPLICE_MIN ) )
+                {
+                    /* a failure part way through a record aborts the
+                     * response, so the rest of the output is discarded */
+                    moved = 0;
+                    (void)Response_Splice( pOutput, fd, pending, &moved );
+
+                    /* anything not spliced is read, or discarded if the
+                     * response cannot be sent */
+                    while ( ( moved < (size_t)pending ) &&
+                            ( ( n = ReadOutput( pOutput,
+                                                fd,
+                                                pending - moved ) ) > 0 ) )
+                    {
+                        moved += n;
+                    }
+                }
+            } while ( n > 0 );
+
+            Trace_Span( "drain",
+                        pState->requestId,
+                        drainStart,
+                        pState->action );
+
+            /* wait for the command to complete */
+            status = Spawn_Wait( pid );
+
+            Status_ChildEnd( pid );
+
+            if ( WIFEXITED( status ) )
+            {
+                pState->exitStatus = WEXITSTATUS( status );
+            }
+
+            /* an exec failure or a crash is a backend failure */
+            Health_BackendResult( WIFEXITED( status ) &&
+                                  ( WEXITSTATUS( status ) != 127 ) );
+
+            Trace_Span( "child",
+                        pState->requestId,
+                        childStart,
+                        pState->action );
+
+            PROBE_SPAWN_END( pState->requestId,
+                             pState->action,
+                             WIFEXITED( status )
+                                ? WEXITSTATUS( status )
+                                : -1 );
+
+            /* indicate success */
+            result = EOK;
+
+            close( fd );
+        }
+
+        if ( result != EOK )
+        {
+            Health_BackendResult( false );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ReadOutput                                                                */
+/*!
+    Read command output into a response
+
+    The ReadOutput function reads the command output which is in the
+    pipe directly into the free space of the response buffer, with a
+    single read.  If the response cannot be sent the output is
+    discarded so the command can run to completion.
+
+    @param[in]
+        pOutput
+            pointer to the response to add the output to
+
+    @param[in]
+        fd
+            read end of the command output pipe
+
+    @param[in]
+        len
+            maximum number of bytes to read
+
+    @retval number of bytes read
+    @retval 0 the command has closed its output, or the pipe failed
+
+==============================================================================*/
+static size_t ReadOutput( Response *pOutput, int fd, size_t len )
+{
+    char discard[512];
+    char *p;
+    size_t available;
+    ssize_t n;
+
+    p = Response_Reserve( pOutput, &available );
+    if ( p == NULL )
+    {
+        p = discard;
+        available = sizeof( discard );
+    }
+
+    do
+    {
+        n = read( fd, p, ( available < len ) ? available : len );
+    } while ( ( n < 0 ) && ( errno == EINTR ) );
+
+    if ( ( n > 0 ) && ( p != discard ) )
+    {
+        Response_Commit( pOutput, n );
+    }
+
+    return ( n > 0 ) ? (size_t)n : 0;
+}
+
+/*============================================================================*/
+/*  FetchList                                                                 */
+/*!
+    Fetch the process list from procmon
+
+    The FetchList function adds the JSON process list to a response,
+    after an optional response header.  The list is produced by the
+    default procmon instance, or merged from all of the configured
+    backends (see backend.c).  The exit status of procmon is stored
+    in the FCGIProc state, and is non-zero if any backend failed.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        pOutput
+            pointer to the response to add the process list to
+
+    @param[in]
+        header
+            pointer to the response header, or NULL for no header
+
+    @param[in]
+        headerLen
+            length of the response header
+
+    @param[in]
+        passthrough
+            true if the list is only sent, and is not needed afterwards
+
+    @retval EOK - the process list was fetched
+    @retval ENOENT - procmon could not be run
+    @retval EINVAL - invalid arguments
+    @retval other - output error
+
+==============================================================================*/
+static int FetchList( FCGIProcState *pState,
+                      Response *pOutput,
+                      const char *header,
+                      size_t headerLen,
+                      bool passthrough )
+{
+    int result = EINVAL;
+    char *argv[] = { PROCMON_PATH, "-o", "json", NULL };
+
+    if ( ( pState != NULL ) && ( pOutput != NULL ) )
+    {
+        if ( Backend_Count() == 0 )
+        {
+            result = RunCommand( pState,
+                                 argv,
+                                 pOutput,
+                                 header,
+                                 headerLen,
+                                 passthrough );
+        }
+        else
+        {
+            pState->exitStatus = -1;
+            result = EOK;
+
+            if ( header != NULL )
+            {
+                result = Response_Header( pOutput,
+                                          header,
+                                          headerLen,
+                                          COMPRESS_IDENTITY );
+            }
+
+            if ( result == EOK )
+            {
+                result = Backend_List( Response_Write,
+                                       pOutput,
+                                       &pState->exitStatus );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ExecuteAction                                                             */
+/*!
+    Run a procmon action on a process
+
+    The ExecuteAction function runs procmon with the specified action
+    option on a process, and sends its output as a text response.
+    When several backends are configured, the action is routed to the
+    backend which listed the process.  If the process is not in the
+    most recent list, the list is refreshed once before a 404 response
+    is sent.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        option
+            procmon action option, eg -s
+
+    @param[in]
+        procname
+            name of the process
+
+    @retval EOK - the action was run, or an error response was sent
+    @retval ENOENT - procmon could not be run
+    @retval EINVAL - invalid arguments
+
+==============================================================================*/
+static int ExecuteAction( FCGIProcState *pState,
+                          char *option,
+                          char *procname )
+{
+    int result = EINVAL;
+    char *argv[BACKEND_ARGV_LEN];
+
+    if ( ( pState != NULL ) && ( option != NULL ) && ( procname != NULL ) )
+    {
+        result = RouteAction( pState, option, procname, argv );
+        if ( result == EOK )
+        {
+            result = ExecuteCommand( pState, argv, false );
+        }
+        else if ( result == EEXIST )
+        {
+            /* the name must be qualified with its instance */
+            pState->exitStatus = -1;
+            result = ErrorResponse( pState, 409, "Conflict" );
+        }
+        else
+        {
+            pState->exitStatus = -1;
+            result = ErrorResponse( pState, 404, "Not Found" );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RouteAction                                                               */
+/*!
+    Build the procmon command line of an action
+
+    The RouteAction function builds the procmon command line which runs
+    an action on a process.  When several backends are configured, the
+    action is routed to the backend which listed the process, and if
+    the process is not in the most recent list, the list is refreshed
+    once.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        option
+            procmon action option, eg -s
+
+    @param[in]
+        procname
+            name of the process
+
+    @param[out]
+        argv
+            argument vector of BACKEND_ARGV_LEN entries to store the
+            command line in
+
+    @retval EOK the command line was built
+    @retval ENOENT no backend lists the process
+    @retval EEXIST several backends list the unqualified process name
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int RouteAction( FCGIProcState *pState,
+                        char *option,
+                        char *procname,
+                        char *argv[] )
+{
+    int result = EINVAL;
+    size_t instance;
+
+    if ( ( pState != NULL ) &&
+         ( option != NULL ) &&
+         ( procname != NULL ) &&
+         ( argv != NULL ) )
+    {
+        argv[0] = PROCMON_PATH;
+        argv[1] = option;
+        argv[2] = procname;
+        argv[3] = NULL;
+        result = EOK;
+
+        if ( Backend_Count() > 0 )
+        {
+            result = Backend_Find( procname, &instance );
+            if ( result == ENOENT )
+            {
+                /* the process may have been added since the last list */
+                ListCache_Invalidate();
+                LoadProcTable( pState );
+                result = Backend_Find( procname, &instance );
+            }
+
+            if ( result == EOK )
+            {
+                result = Backend_Command( instance,
+                                          option,
+                                          procname,
+                                          argv,
+                                          BACKEND_ARGV_LEN );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ExecuteBatch                                                              */
+/*!
+    Run a procmon action on several processes
+
+    The ExecuteBatch function runs procmon with the specified action
+    option on each process of a comma separated list.  The actions are
+    routed like single actions (see RouteAction), then run concurrently
+    by the work-stealing executor (see executor.c), so a process which
+    is slow to stop does not hold up the others.  The response is an
+    array with the name, procmon exit status and procmon output of each
+    process, in the order requested, in the negotiated output format:
+
+    [{"name": "job1", "exitStatus": 0, "output": "..."}, ...]
+
+    A process which is not in the process list has exit status -1.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        option
+            procmon action option, eg -s
+
+    @param[in]
+        procnames
+            comma separated list of process names, which is split in
+            place
+
+    @param[in]
+        starts
+            true if the action starts the processes, so the time until
+            they are seen running is measured
+
+    @retval EOK the actions were run
+    @retval E2BIG too many processes
+    @retval EINVAL invalid arguments or process names
+
+==============================================================================*/
+static int ExecuteBatch( FCGIProcState *pState,
+                         char *option,
+                         char *procnames,
+                         bool starts )
+{
+    int result = EINVAL;
+    ExecutorBatch batch = { 0 };
+    struct pollfd pfd;
+    BatchAction *pAction;
+    Encoder encoder;
+    uint64_t startUs;
+    char *save = NULL;
+    char *procname;
+    size_t count = 0;
+    size_t i;
+
+    if ( ( pState != NULL ) && ( option != NULL ) && ( procnames != NULL ) )
+    {
+        result = EOK;
+        procname = strtok_r( procnames, ",", &save );
+        while ( ( procname != NULL ) && ( result == EOK ) )
+        {
+            result = ( count < BATCH_MAX_ACTIONS )
+                        ? ValidateProcName( procname )
+                        : E2BIG;
+            if ( result == EOK )
+            {
+                batchActions[count++].procname = procname;
+            }
+
+            procname = strtok_r( NULL, ",", &save );
+        }
+
+        if ( count == 0 )
+        {
+            result = EINVAL;
+        }
+
+        /* route every action before any is run, as routing may reload
+           the process list */
+        for ( i = 0; ( i < count ) && ( result == EOK ); i++ )
+        {
+            pAction = &batchActions[i];
+            pAction->routed = ( RouteAction( pState,
+                                             option,
+                                             pAction->procname,
+                                             pAction->argv ) == EOK );
+            pAction->exitStatus = -1;
+            pAction->output[0] = '\0';
+        }
+
+        startUs = GetTimeUs();
+
+        /* the batch wakes the event loop when it completes */
+        if ( batchFd == -1 )
+        {
+            batchFd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK );
+        }
+
+        batch.fd = batchFd;
+
+        for ( i = 0; ( i < count ) && ( result == EOK ); i++ )
+        {
+            pAction = &batchActions[i];
+            if ( pAction->routed == true )
+            {
+                pAction->task.fn = RunBatchAction;
+                pAction->task.arg = pAction;
+                Executor_Submit( &batch, &pAction->task );
+            }
+        }
+
+        /* serve the parked requests and kept connections until the
+           actions complete, unless the batch cannot be waited for */
+        pfd.fd = batchFd;
+        pfd.events = POLLIN;
+        while ( Executor_Done( &batch ) == false )
+        {
+            if ( ( batchFd == -1 ) || ( Coro_Poll( &pfd, 1, -1 ) == -1 ) )
+            {
+                Executor_Wait( &batch );
+            }
+        }
+
+        if ( result == EOK )
+        {
+            ListCache_Invalidate();
+
+            Encoder_Init( &encoder,
+                          pState->format,
+                          Response_Write,
+                          &pState->response );
+
+            SendEncodedHeader( pState );
+            result = Encoder_Array( &encoder, count );
+            pState->exitStatus = 0;
+        }
+
+        for ( i = 0; ( i < count ) && ( result == EOK ); i++ )
+        {
+            pAction = &batchActions[i];
+            if ( pAction->routed == true )
+            {
+                /* an exec failure or a crash is a backend failure */
+                Health_BackendResult( ( pAction->exitStatus >= 0 ) &&
+                                      ( pAction->exitStatus != 127 ) );
+            }
+
+            if ( ( starts == true ) && ( pAction->exitStatus == 0 ) )
+            {
+                /* measure the time until the process is seen running */
+                ProcTrack_Action( pAction->procname, startUs );
+            }
+
+            if ( pState->exitStatus == 0 )
+            {
+                pState->exitStatus = pAction->exitStatus;
+            }
+
+            result = Encoder_Map( &encoder, 3 );
+            if ( result == EOK )
+            {
+                result = Encoder_String( &encoder, "name" );
+            }
+
+            if ( result == EOK )
+            {
+                result = Encoder_String( &encoder, pAction->procname );
+            }
+
+            if ( result == EOK )
+            {
+                result = Encoder_String( &encoder, "exitStatus" );
+            }
+
+            if ( result == EOK )
+            {
+                result = Encoder_Int( &encoder, pAction->exitStatus );
+            }
+
+            if ( result == EOK )
+            {
+                result = Encoder_String( &encoder, "output" );
+            }
+
+            if ( result == EOK )
+            {
+                result = Encoder_String( &encoder, pAction->output );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RunBatchAction                                                            */
+/*!
+    Run the procmon command of a batch action
+
+    The RunBatchAction function runs on an executor worker thread.  It
+    runs the procmon command of one process of a batch action and keeps
+    its output and exit status in the action.  It only uses the action,
+    so that any number of actions can run at once.
+
+    @param[in]
+        arg
+            pointer to the BatchAction
+
+==============================================================================*/
+static void RunBatchAction( void *arg )
+{
+    BatchAction *pAction = arg;
+    char discard[512];
+    size_t len = 0;
+    ssize_t n;
+    int fd;
+    pid_t pid;
+    int status;
+
+    if ( ( pAction != NULL ) &&
+         ( Spawn_Command( pAction->argv, 0, &pid, &fd ) == EOK ) )
+    {
+        /* keep the start of the output, and drain the rest so the
+           command can run to completion */
+        do
+        {
+            n = ( len < sizeof( pAction->output ) - 1 )
+                ? read( fd,
+                        &pAction->output[len],
+                        sizeof( pAction->output ) - 1 - len )
+                : read( fd, discard, sizeof( discard ) );
+            if ( ( n > 0 ) && ( len < sizeof( pAction->output ) - 1 ) )
+            {
+                len += n;
+            }
+        } while( ( n > 0 ) || ( ( n < 0 ) && ( errno == EINTR ) ) );
+
+        pAction->output[len] = '\0';
+
+        status = Spawn_Wait( pid );
+        if ( WIFEXITED( status ) )
+        {
+            pAction->exitStatus = WEXITSTATUS( status );
+        }
+
+        close( fd );
+    }
+}
+
+/*============================================================================*/
+/*  GetProcessList                                                            */
+/*!
+    Get the JSON process list
+
+    The GetProcessList function gets the JSON process list from the
+    cache, or from the output of procmon if there is no current cached
+    list.  A new procmon list is stored in the cache.  When several
+    backends are configured, the processes of the backends which could
+    be listed are returned, but the list is not cached.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[out]
+        pData
+            pointer to the location to store a pointer to the list
+
+    @param[out]
+        pLen
+            pointer to the location to store the length of the list
+
+    @param[out]
+        pGeneration
+            pointer to the location to store the list cache generation
+            of the list, or 0 if the list is not cached
+
+    @retval EOK the process list was retrieved
+    @retval EIO procmon failed
+    @retval ENOENT procmon could not be run
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int GetProcessList( FCGIProcState *pState,
+                           const char **pData,
+                           size_t *pLen,
+                           uint64_t *pGeneration )
+{
+    int result = EINVAL;
+    CompressEncoding encoding;
+    uint64_t start = TRACE_START();
+
+    if ( ( pState != NULL ) &&
+         ( pData != NULL ) &&
+         ( pLen != NULL ) &&
+         ( pGeneration != NULL ) )
+    {
+        *pGeneration = 0;
+
+        if ( ListCache_Get( GetTimeUs(),
+                            COMPRESS_IDENTITY,
+                            pData,
+                            pLen,
+                            &encoding ) == EOK )
+        {
+            PROBE_CACHE_HIT( pState->requestId, pState->action );
+            Trace_Span( "cache", pState->requestId, start, "hit" );
+            *pGeneration = ListCache_Generation();
+            result = EOK;
+        }
+        else
+        {
+            PROBE_CACHE_MISS( pState->requestId, pState->action );
+            Trace_Span( "cache", pState->requestId, start, "miss" );
+
+            /* collect the procmon output without sending it.  The
+               capture buffer grows to hold the whole list */
+            Response_Begin( &pState->capture, NULL );
+            result = FetchList( pState, &pState->capture, NULL, 0, false );
+            *pData = pState->capture.buf;
+            *pLen = pState->capture.len;
+
+            if ( ( result == EOK ) && ( pState->exitStatus == 0 ) )
+            {
+                if ( ListCache_Store( GetTimeUs(), *pData, *pLen ) == EOK )
+                {
+                    *pGeneration = ListCache_Generation();
+                }
+            }
+            else if ( ( result == EOK ) && ( Backend_Count() == 0 ) )
+            {
+                result = EIO;
+            }
+
+            ListCache_Release();
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  InitProcTables                                                            */
+/*!
+    Initialize the typed process table snapshots
+
+    The InitProcTables function publishes the first, empty, process
+    table and adds the others as spares to load refreshes into.
+
+    @retval EOK the process tables were initialized
+    @retval ENOSPC too many spare process tables
+
+==============================================================================*/
+static int InitProcTables( void )
+{
+    int result = EOK;
+    size_t i;
+
+    Snapshot_Init( &tableSnapshot, &procTables[0] );
+
+    for ( i = 1; ( i < PROCTABLE_SNAPSHOTS ) && ( result == EOK ); i++ )
+    {
+        result = Snapshot_Add( &tableSnapshot, &procTables[i] );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  LoadProcTable                                                             */
+/*!
+    Load the typed process table
+
+    The LoadProcTable function loads the typed process table from the
+    process list (see GetProcessList), and enters the published table
+    snapshot for the request to read (see snapshot.c).
+
+    The next snapshot is loaded into a copy of the published table which
+    no reader can still hold, and is published through an atomic
+    pointer, so readers never wait for a refresh.  A single refresher
+    loads at a time; if another refresh is in progress, or every spare
+    table may still be read, the request reads the current snapshot.
+    The published table is read as it is while the cached list it was
+    loaded from is current, so a cache hit is neither parsed nor copied.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @retval EOK the process table was loaded
+    @retval ENOMEM cannot grow the table to hold the process list
+    @retval EIO procmon failed
+    @retval EBADMSG the process list could not be parsed
+    @retval EINVAL invalid arguments
 
 ==============================================================================*/
-static int ExecuteCommand( char *cmd, bool json )
+static int LoadProcTable( FCGIProcState *pState )
 {
-    int n;
     int result = EINVAL;
-    char buf[BUFSIZ];
-    FILE *fp_in;
+    const char *data = NULL;
+    size_t len = 0;
+    uint64_t generation = 0;
 
-    if( cmd != NULL )
+    if ( pState != NULL )
     {
-        /* assume command not executed until popen succeeds */
-        result = ENOENT;
+        result = GetProcessList( pState, &data, &len, &generation );
+        if ( ( result == EOK ) &&
+             ( ( generation == 0 ) ||
+               ( generation != __atomic_load_n( &tableGeneration,
+                                                __ATOMIC_ACQUIRE ) ) ) )
+        {
+            result = PublishProcTable( pState, data, len, generation );
+        }
 
-        /* execute the command */
-        fp_in = popen( cmd, "r" );
-        if( fp_in != NULL )
+        if ( result == EOK )
         {
-            /* send the header */
-            json ? SendJSONHeader() : SendHeader();
+            pState->pTable = Snapshot_Enter( &tableSnapshot, pState->worker );
+            result = ( pState->pTable != NULL ) ? EOK : EINVAL;
+        }
+    }
 
-            do
+    return result;
+}
+
+/*============================================================================*/
+/*  TableCurrent                                                              */
+/*!
+    Check whether the published process table is current
+
+    The TableCurrent function checks whether the published process
+    table was loaded from the cached process list, and the list has not
+    expired, so that data maintained as the table is loaded (see
+    proctrack.c) can be used without loading the table.
+
+    @retval true the published table is current
+    @retval false the table must be loaded
+
+==============================================================================*/
+static bool TableCurrent( void )
+{
+    const char *data;
+    size_t len;
+    CompressEncoding encoding;
+
+    return ( ListCache_Get( GetTimeUs(),
+                            COMPRESS_IDENTITY,
+                            &data,
+                            &len,
+                            &encoding ) == EOK ) &&
+           ( ListCache_Generation() == __atomic_load_n( &tableGeneration,
+                                                        __ATOMIC_ACQUIRE ) );
+}
+
+/*============================================================================*/
+/*  PublishProcTable                                                          */
+/*!
+    Publish a process table snapshot loaded from a process list
+
+    The PublishProcTable function loads the next process table snapshot
+    from a JSON process list, and publishes it (see LoadProcTable).  The
+    snapshot is not loaded if another refresh is in progress, or every
+    spare table may still be read.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        data
+            pointer to the JSON process list
+
+    @param[in]
+        len
+            length of the JSON process list
+
+    @param[in]
+        generation
+            list cache generation of the process list, or 0 if the list
+            is not cached
+
+    @retval EOK the snapshot was published, or was left to another refresh
+    @retval ENOMEM cannot grow the table to hold the process list
+    @retval EBADMSG the process list could not be parsed
+
+==============================================================================*/
+static int PublishProcTable( FCGIProcState *pState,
+                             const char *data,
+                             size_t len,
+                             uint64_t generation )
+{
+    int result = EOK;
+    uint64_t start;
+    ProcTable *pNext = NULL;
+    bool idle = false;
+
+    if ( __atomic_compare_exchange_n( &tableLoading,
+                                      &idle,
+                                      true,
+                                      false,
+                                      __ATOMIC_ACQUIRE,
+                                      __ATOMIC_RELAXED ) )
+    {
+        pNext = Snapshot_Reclaim( &tableSnapshot );
+        if ( pNext != NULL )
+        {
+            start = TRACE_START();
+            result = ProcTable_Copy( pNext,
+                                     Snapshot_Current( &tableSnapshot ) );
+            if ( result == EOK )
             {
-                /* read a buffer of output */
-                n = fread( buf, 1, BUFSIZ, fp_in);
-                if( n > 0 )
-                {
-                    FCGI_fwrite( buf, n, 1, FCGI_stdout );
-                }
-            } while( n > 0 );
+                result = ProcTable_Load( pNext, data, len );
+            }
 
-            /* close the command output data stream */
-            pclose( fp_in );
+            Trace_Span( "parse", pState->requestId, start, "proctable" );
+            if ( result == EOK )
+            {
+                ProcTrack_Update( pNext, GetTimeUs() );
+                Snapshot_Publish( &tableSnapshot, pNext );
+                __atomic_store_n( &tableGeneration,
+                                  generation,
+                                  __ATOMIC_RELEASE );
+
+                /* let the parked requests check the new table */
+                Coro_Signal( &tableEvent );
+            }
+            else
+            {
+                /* the unpublished table remains a spare */
+                Snapshot_Add( &tableSnapshot, pNext );
+            }
+        }
 
-            /* indicate success */
-            result = EOK;
+        __atomic_store_n( &tableLoading, false, __ATOMIC_RELEASE );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ClusterList                                                               */
+/*!
+    Output the process lists of the cluster
+
+    The ClusterList function outputs the local process list together
+    with the process lists of the peer fcgi_proc instances.  The peer
+    requests are started before the local list is retrieved, and are
+    collected up to the peer deadline (see peer.c).  The response holds
+    an entry for each member of the cluster, with the outcome of its
+    request and its process list:
+
+    {"peers": [{"peer": "local", "status": "ok", "ageMs": 0,
+    "processes": [...]}, {"peer": "node2", ...}]}
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @retval EOK the cluster list was output
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+static int ClusterList( FCGIProcState *pState )
+{
+    int result = EINVAL;
+    const char *data = NULL;
+    size_t len = 0;
+    uint64_t generation;
+    bool local;
+
+    if ( pState != NULL )
+    {
+        Peer_Begin();
+        local = ( GetProcessList( pState,
+                                  &data,
+                                  &len,
+                                  &generation ) == EOK ) &&
+                ( len > 0 );
+        Peer_Collect();
+
+        result = SendJSONHeader( pState );
+        if ( result == EOK )
+        {
+            result = Response_Printf( &pState->response,
+                                      "{\"peers\": [{\"peer\": \"local\", "
+                                      "\"status\": \"%s\", \"ageMs\": 0, "
+                                      "\"processes\": ",
+                                      local ? "ok" : "error" );
+        }
+
+        if ( result == EOK )
+        {
+            result = local ? Response_Write( &pState->response, data, len )
+                           : Response_Write( &pState->response, "[]", 2 );
+        }
+
+        if ( result == EOK )
+        {
+            result = Response_Write( &pState->response, "}", 1 );
+        }
+
+        if ( result == EOK )
+        {
+            result = Peer_Output( Response_Write, &pState->response );
+        }
+
+        if ( result == EOK )
+        {
+            result = Response_Write( &pState->response, "]}", 2 );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ListPage                                                                  */
+/*!
+    Output a page of the process list
+
+    The ListPage function outputs up to limit processes in process name
+    order, starting after the process named by the cursor.  If more
+    processes follow the page, a Link header gives the query of the next
+    page with its cursor.  As the cursor holds a process name rather
+    than a position, it remains valid when processes are added or
+    removed between requests.  The work done per page depends on the
+    limit rather than the size of the table.
+
+    JSON and NDJSON pages are gathered from the pre-rendered record
+    fragments, so since is output as a number of seconds as in the
+    other structured formats.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        limit
+            maximum number of processes in the page, or NULL to use
+            the default
+
+    @param[in]
+        cursor
+            cursor returned with the previous page, or NULL for the
+            first page
+
+    @retval EOK page output successfully
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int ListPage( FCGIProcState *pState, char *limit, char *cursor )
+{
+    int result = EINVAL;
+    char header[LIST_PAGE_HEADER_LEN];
+    char next[PROCTABLE_CURSOR_LEN];
+    const char *base;
+    size_t count = LIST_DEFAULT_LIMIT;
+    size_t first;
+    char *end;
+    Encoder encoder;
+    bool loaded = false;
+    int n;
+
+    if ( pState != NULL )
+    {
+        result = EOK;
+
+        if ( limit != NULL )
+        {
+            count = strtoul( limit, &end, 10 );
+            if ( ( *end != '\0' ) || ( count == 0 ) )
+            {
+                result = EINVAL;
+            }
+        }
+
+        if ( result == EOK )
+        {
+            result = LoadProcTable( pState );
+            if ( result == EOK )
+            {
+                result = ProcTable_Seek( pState->pTable, cursor, &first );
+                loaded = true;
+            }
+            else
+            {
+                result = TableErrorResponse( pState, result );
+            }
+        }
+
+        if ( ( result == EINVAL ) || ( result == EBADMSG ) )
+        {
+            /* the limit or cursor is malformed */
+            result = ErrorResponse( pState, 400, "Bad request" );
+        }
+        else if ( ( result == EOK ) && ( loaded == true ) )
+        {
+            /* a page is never longer than the table */
+            count = ( count < pState->pTable->count ) ? count
+                                                      : pState->pTable->count;
+
+            base = formatHeaders[pState->format];
+
+            if ( ProcTable_Cursor( pState->pTable,
+                                   first + count,
+                                   next,
+                                   sizeof next ) == EOK )
+            {
+                /* insert the link to the next page before the blank line */
+                n = snprintf( header,
+                              sizeof header,
+                              "%.*sLink: <?list&limit=%zu&cursor=%s%s>; "
+                              "rel=\"next\"\r\n\r\n",
+                              (int)strlen( base ) - 2,
+                              base,
+                              count,
+                              next,
+                              ( pState->format == ENCODER_NDJSON )
+                                ? "&format=ndjson" : "" );
+
+                result = Response_Header( &pState->response,
+                                          header,
+                                          n,
+                                          COMPRESS_IDENTITY );
+            }
+            else
+            {
+                result = SendEncodedHeader( pState );
+            }
+
+            if ( ( pState->format == ENCODER_JSON ) ||
+                 ( pState->format == ENCODER_NDJSON ) )
+            {
+                result = ProcTable_Gather( pState->pTable,
+                                           first,
+                                           count,
+                                           true,
+                                           pState->format == ENCODER_NDJSON,
+                                           Response_WriteV,
+                                           &pState->response );
+            }
+            else
+            {
+                Encoder_Init( &encoder,
+                              pState->format,
+                              Response_Write,
+                              &pState->response );
+
+                result = ProcTable_Encode( pState->pTable,
+                                           first,
+                                           count,
+                                           true,
+                                           &encoder );
+            }
         }
     }
 
     return result;
 }
 
+/*============================================================================*/
+/*  SendEncodedHeader                                                         */
+/*!
+    Send a structured output response header
+
+    The SendEncodedHeader function adds the preformatted response header
+    for the negotiated structured output format to the response buffer.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @retval EOK response sent successfully
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int SendEncodedHeader( FCGIProcState *pState )
+{
+    int result = EINVAL;
+    const char *header;
+
+    if ( ( pState != NULL ) && ( pState->format < ENCODER_MAX ) )
+    {
+        header = formatHeaders[pState->format];
+        result = Response_Header( &pState->response,
+                                  header,
+                                  strlen( header ),
+                                  COMPRESS_IDENTITY );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SendResponse                                                              */
+/*!
+    Send a preformatted response
+
+    The SendResponse function adds a complete preformatted response
+    (header and body) to the response buffer.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        response
+            pointer to the preformatted response
+
+    @param[in]
+        length
+            length of the response
+
+    @retval EOK response sent successfully
+    @retval EIO the response could not be sent
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+static int SendResponse( FCGIProcState *pState,
+                         const char *response,
+                         size_t length )
+{
+    int result = EINVAL;
+
+    if ( ( pState != NULL ) && ( response != NULL ) )
+    {
+        result = Response_Write( &pState->response, response, length );
+    }
+
+    return result;
+}
+
 /*============================================================================*/
 /*  SendHeader                                                                */
 /*!
     Send a response header
 
-    The SendHeader function sends a response header
+    The SendHeader function adds the preformatted text response header
+    to the response buffer.  The body which follows it may be compressed.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
 
     @retval EOK response sent successfully
     @retval EINVAL invalid arguments
 
 ==============================================================================*/
-static void SendHeader( void )
+static int SendHeader( FCGIProcState *pState )
 {
-    /* output the response header */
-    printf("Status: 200 OK\r\n");
-    printf("Content-Type: text/plain; charset=utf-8\r\n\r\n");
+    return ( pState != NULL ) ? Response_Header( &pState->response,
+                                                 textHeader,
+                                                 sizeof( textHeader ) - 1,
+                                                 COMPRESS_IDENTITY )
+                              : EINVAL;
 }
 
 /*============================================================================*/
@@ -1252,17 +5157,24 @@ static void SendHeader( void )
 /*!
     Send a JSON response header
 
-    The SendJSONHeader function sends a JSON response header
+    The SendJSONHeader function adds the preformatted JSON response header
+    to the response buffer.  The body which follows it may be compressed.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
 
     @retval EOK response sent successfully
     @retval EINVAL invalid arguments
 
 ==============================================================================*/
-static void SendJSONHeader( void )
+static int SendJSONHeader( FCGIProcState *pState )
 {
-    /* output the response header */
-    printf("Status: 200 OK\r\n");
-    printf("Content-Type: application/json; charset=utf-8\r\n\r\n");
+    return ( pState != NULL ) ? Response_Header( &pState->response,
+                                                 jsonHeader,
+                                                 sizeof( jsonHeader ) - 1,
+                                                 COMPRESS_IDENTITY )
+                              : EINVAL;
 }
 
 /*============================================================================*/
@@ -1274,6 +5186,10 @@ static void SendJSONHeader( void )
     using the Status header, and the status code and error description
     in a JSON object.
 
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
     @param[in]
         status
             status response code
@@ -1286,23 +5202,62 @@ static void SendJSONHeader( void )
     @retval EINVAL invalid arguments
 
 ==============================================================================*/
-static int ErrorResponse( int status,  char *description )
+static int ErrorResponse( FCGIProcState *pState,
+                          int status,
+                          char *description )
 {
     int result = EINVAL;
 
-    if ( description != NULL )
+    if ( ( pState != NULL ) && ( description != NULL ) )
     {
-        /* output header */
-        printf("Status: %d %s\r\n", status, description);
-        printf("Content-Type: application/json\r\n\r\n");
+        /* output the header and body in one pass */
+        result = Response_Printf( &pState->response,
+                                  "Status: %d %s\r\n"
+                                  "Content-Type: application/json\r\n\r\n"
+                                  "{\"status\": %d, \"description\" : \"%s\"}",
+                                  status,
+                                  description,
+                                  status,
+                                  description );
+    }
 
-        /* output body */
-        printf("{\"status\": %d, \"description\" : \"%s\"}",
-                status,
-                description );
+    return result;
+}
 
-        result = EOK;
+/*============================================================================*/
+/*  TableErrorResponse                                                        */
+/*!
+    Send the error response of a process table load failure
+
+    The TableErrorResponse function reports a process list which could
+    not be loaded as a server error, rather than a bad request.  A
+    failure of procmon, or a list which cannot be parsed, is reported
+    as a bad gateway, and any other failure (eg the table cannot be
+    grown to hold the list) as an internal server error.
+
+    @param[in]
+        pState
+            pointer to the FCGIProc state object
+
+    @param[in]
+        error
+            error returned by LoadProcTable
+
+    @retval EOK the response was sent
+    @retval EINVAL invalid arguments
 
+==============================================================================*/
+static int TableErrorResponse( FCGIProcState *pState, int error )
+{
+    int result;
+
+    if ( ( error == EIO ) || ( error == ENOENT ) || ( error == EBADMSG ) )
+    {
+        result = ErrorResponse( pState, 502, "Bad Gateway" );
+    }
+    else
+    {
+        result = ErrorResponse( pState, 500, "Internal Server Error" );
     }
 
     return result;
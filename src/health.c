@@ -0,0 +1,158 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup health health
+ * @brief Health and readiness tracking
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file health.c
+
+    Health and Readiness
+
+    The health module keeps the in-memory state used to answer health
+    and readiness probes, so that probes never need to run procmon.
+
+    fcgi_proc is ready when the procmon backend was found at startup and
+    the most recent procmon invocations have not failed to run.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include "health.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! true if the backend executable was found */
+static bool backendFound = false;
+
+/*! number of consecutive backend failures */
+static unsigned int backendFailures = 0;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Health_Init                                                               */
+/*!
+    Initialize health tracking
+
+    The Health_Init function checks that the backend executable exists
+    and can be executed.
+
+    @param[in]
+        backend
+            pointer to the path of the backend executable
+
+    @retval EOK the backend was found
+    @retval EINVAL invalid arguments
+    @retval other error from access
+
+==============================================================================*/
+int Health_Init( const char *backend )
+{
+    int result = EINVAL;
+
+    if ( backend != NULL )
+    {
+        if ( access( backend, X_OK ) == 0 )
+        {
+            __atomic_store_n( &backendFound, true, __ATOMIC_RELAXED );
+            result = EOK;
+        }
+        else
+        {
+            result = errno;
+            syslog( LOG_ERR, "backend %s is not executable", backend );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Health_BackendResult                                                      */
+/*!
+    Record the result of a backend invocation
+
+    The Health_BackendResult function counts consecutive backend failures.
+    A successful invocation clears the count.
+
+    @param[in]
+        ok
+            true if the backend ran, false if it could not be run
+
+==============================================================================*/
+void Health_BackendResult( bool ok )
+{
+    if ( ok == true )
+    {
+        __atomic_store_n( &backendFailures, 0, __ATOMIC_RELAXED );
+    }
+    else
+    {
+        __atomic_fetch_add( &backendFailures, 1, __ATOMIC_RELAXED );
+    }
+}
+
+/*============================================================================*/
+/*  Health_IsReady                                                            */
+/*!
+    Check if fcgi_proc is ready to serve requests
+
+    @retval true the backend was found and is not failing
+    @retval false the backend is missing or failing
+
+==============================================================================*/
+bool Health_IsReady( void )
+{
+    return ( __atomic_load_n( &backendFound, __ATOMIC_RELAXED ) == true ) &&
+           ( __atomic_load_n( &backendFailures, __ATOMIC_RELAXED ) <
+             HEALTH_MAX_BACKEND_FAILURES );
+}
+
+/*! @}
+ * end of health group */
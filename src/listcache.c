@@ -0,0 +1,840 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup listcache listcache
+ * @brief Process list snapshot cache
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file listcache.c
+
+    Process List Snapshot Cache
+
+    The listcache module keeps the most recent process list produced by
+    procmon for a configurable time, so that list requests arriving in
+    quick succession do not each run procmon.  The snapshot is dropped
+    when a process is started, stopped or restarted through fcgi_proc.
+
+    A compressed variant of the snapshot is kept for each content
+    encoding next to the raw bytes.  It is built the first time the
+    snapshot is requested in that encoding, so repeated requests copy
+    the compressed bytes instead of compressing them again.
+
+    All buffers are allocated when the cache is initialized.
+
+    When several fcgi_proc processes serve the same web server, the
+    snapshot can be shared through a POSIX shared memory segment so
+    that procmon is run once per time to live for all of them.  The
+    segment holds two snapshot slots, each protected by a sequence
+    lock.  A new snapshot is written to the slot which is not current
+    before it is made current, so readers copy it without taking a
+    lock and only retry if a second update overtakes them.  When the
+    snapshot has expired, one process claims the refresh and the
+    others keep serving the expired snapshot until it publishes the
+    new one, so only the claimer runs procmon and no request waits for
+    it.  A claim lapses if the refresher does not publish in time, eg
+    because it exited, and an expired snapshot is not served for
+    longer than a claim can last.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "listcache.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! a cached copy of the snapshot */
+typedef struct _Variant
+{
+    /*! pointer to the variant buffer */
+    char *buf;
+
+    /*! size of the variant buffer */
+    size_t size;
+
+    /*! length of the variant, or 0 if it has not been built */
+    size_t len;
+
+} Variant;
+
+/*! number of snapshot slots in the shared segment */
+#define LISTCACHE_SHARED_SLOTS  2
+
+/*! time in microseconds after which a refresh claim lapses */
+#define LISTCACHE_CLAIM_US      2000000ULL
+
+/*! number of attempts to copy a shared snapshot which is being
+    rewritten before the copy is given up */
+#define LISTCACHE_ADOPT_TRIES   4
+
+/*! a snapshot slot in the shared segment */
+typedef struct _SharedSlot
+{
+    /*! sequence number, odd while the slot is being written */
+    uint32_t seq;
+
+    /*! time the snapshot was stored */
+    uint64_t storedUs;
+
+    /*! length of the snapshot */
+    uint64_t len;
+
+    /*! snapshot data */
+    char data[];
+
+} SharedSlot;
+
+/*! the shared segment header, followed by the snapshot slots */
+typedef struct _SharedHeader
+{
+    /*! capacity of each slot, set by the first process to attach */
+    uint64_t capacity;
+
+    /*! incremented whenever the snapshot is replaced or dropped */
+    uint64_t generation;
+
+    /*! index of the current slot */
+    uint32_t current;
+
+    /*! non-zero if the current slot holds a snapshot */
+    uint32_t valid;
+
+    /*! process id of the process writing a slot, or 0 */
+    int32_t writing;
+
+    /*! process id of the process refreshing the snapshot, or 0 */
+    int32_t claimPid;
+
+    /*! time the refresh was claimed */
+    uint64_t claimUs;
+
+} SharedHeader;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static SharedSlot *Slot( uint32_t index );
+static void Adopt( void );
+static bool Claim( uint64_t nowUs );
+static void Publish( uint64_t nowUs, const char *data, size_t len );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! snapshot time to live in microseconds, or 0 if caching is disabled */
+static uint64_t ttlUs = 0;
+
+/*! time the snapshot was stored */
+static uint64_t storedUs = 0;
+
+/*! true if the cache holds a snapshot */
+static bool valid = false;
+
+/*! number of the snapshot held in this process, counted up each time
+    it is replaced or dropped */
+static uint64_t storedGeneration = 0;
+
+/*! time this process was asked to refresh the snapshot, or 0 if it is
+    not refreshing it */
+static uint64_t refreshUs = 0;
+
+/*! raw (COMPRESS_IDENTITY) and compressed snapshot variants */
+static Variant variants[COMPRESS_MAX];
+
+/*! compressor used to build the compressed variants */
+static Compressor compressor;
+
+/*! shared segment, or NULL if the snapshot is not shared */
+static SharedHeader *pShared = NULL;
+
+/*! size of each shared snapshot slot */
+static size_t slotSize = 0;
+
+/*! generation of the shared snapshot held in this process */
+static uint64_t sharedGeneration = 0;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  ListCache_Init                                                            */
+/*!
+    Initialize the list snapshot cache
+
+    The ListCache_Init function allocates the snapshot buffers.
+    A time to live of zero disables the cache.
+
+    @param[in]
+        capacity
+            largest snapshot which can be cached
+
+    @param[in]
+        ttlMs
+            snapshot time to live in milliseconds
+
+    @retval EOK the cache was initialized
+    @retval ENOMEM cannot allocate the snapshot buffers
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int ListCache_Init( size_t capacity, unsigned int ttlMs )
+{
+    int result = EINVAL;
+    int i;
+
+    if ( capacity > 0 )
+    {
+        result = EOK;
+
+        if ( ttlMs > 0 )
+        {
+            for ( i = 0; ( i < COMPRESS_MAX ) && ( result == EOK ); i++ )
+            {
+                variants[i].size = Compress_Bound( i, capacity );
+                variants[i].buf = malloc( variants[i].size );
+                variants[i].len = 0;
+                if ( variants[i].buf == NULL )
+                {
+                    result = ENOMEM;
+                }
+            }
+
+            if ( result == EOK )
+            {
+                ttlUs = (uint64_t)ttlMs * 1000ULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ListCache_Share                                                           */
+/*!
+    Share the snapshot with other processes
+
+    The ListCache_Share function attaches the cache to the named POSIX
+    shared memory segment, creating it if necessary.  Every process
+    sharing the segment must use the same cache capacity.
+
+    @param[in]
+        name
+            name of the shared memory segment, eg /fcgi_proc
+
+    @retval EOK the snapshot is shared
+    @retval ENOTSUP the cache is disabled
+    @retval EINVAL invalid arguments, or the segment has another capacity
+    @retval other cannot create or map the segment
+
+==============================================================================*/
+int ListCache_Share( const char *name )
+{
+    int result = EINVAL;
+    size_t capacity = variants[COMPRESS_IDENTITY].size;
+    uint64_t expected = 0;
+    struct stat st;
+    size_t size;
+    void *p;
+    int fd;
+
+    if ( ( name != NULL ) && ( pShared == NULL ) )
+    {
+        slotSize = ( offsetof( SharedSlot, data ) + capacity + 63 ) & ~63UL;
+        size = sizeof( SharedHeader ) + LISTCACHE_SHARED_SLOTS * slotSize;
+
+        fd = ( ttlUs > 0 )
+                ? shm_open( name, O_RDWR | O_CREAT | O_CLOEXEC, 0600 )
+                : -1;
+        if ( ttlUs == 0 )
+        {
+            /* do not create a segment which would never be used */
+            result = ENOTSUP;
+        }
+        else if ( fd == -1 )
+        {
+            result = errno;
+        }
+        else if ( ( fstat( fd, &st ) != 0 ) ||
+                  ( ( (size_t)st.st_size < size ) &&
+                    ( ftruncate( fd, size ) != 0 ) ) )
+        {
+            result = errno;
+        }
+        else
+        {
+            p = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+            if ( p == MAP_FAILED )
+            {
+                result = errno;
+            }
+            else if ( ( __atomic_compare_exchange_n( &((SharedHeader *)p)->capacity,
+                                                     &expected,
+                                                     capacity,
+                                                     false,
+                                                     __ATOMIC_ACQ_REL,
+                                                     __ATOMIC_ACQUIRE ) ) ||
+                      ( expected == capacity ) )
+            {
+                /* a new segment is zero filled, which is an empty cache */
+                pShared = p;
+                sharedGeneration = 0;
+                result = EOK;
+            }
+            else
+            {
+                munmap( p, size );
+            }
+        }
+
+        if ( fd != -1 )
+        {
+            close( fd );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ListCache_Get                                                             */
+/*!
+    Get the cached process list
+
+    The ListCache_Get function gets the cached process list if it has not
+    expired.  If the client accepts a content encoding and the snapshot
+    is large enough to compress, the compressed variant is returned,
+    building it if necessary.  Otherwise the raw snapshot is returned.
+
+    When the snapshot is shared, a newer snapshot published by another
+    process is copied in first.  If the snapshot has expired and
+    another process is refreshing it, the expired snapshot is returned
+    until the new one is published, for at most LISTCACHE_CLAIM_US.
+    Otherwise the caller is expected to refresh it, and to call
+    ListCache_Release when it is done.
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+    @param[in]
+        encoding
+            content encoding accepted by the client
+
+    @param[out]
+        pData
+            pointer to a location to store a pointer to the snapshot
+
+    @param[out]
+        pLen
+            pointer to a location to store the snapshot length
+
+    @param[out]
+        pEncoding
+            pointer to a location to store the encoding of the snapshot
+
+    @retval EOK the snapshot was retrieved
+    @retval ENOENT there is no current snapshot
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int ListCache_Get( uint64_t nowUs,
+                   CompressEncoding encoding,
+                   const char **pData,
+                   size_t *pLen,
+                   CompressEncoding *pEncoding )
+{
+    int result = EINVAL;
+    Variant *pRaw = &variants[COMPRESS_IDENTITY];
+    Variant *pVariant;
+    bool stale = false;
+
+    if ( ( pData != NULL ) &&
+         ( pLen != NULL ) &&
+         ( pEncoding != NULL ) &&
+         ( encoding < COMPRESS_MAX ) )
+    {
+        result = ENOENT;
+
+        if ( pShared != NULL )
+        {
+            Adopt();
+
+            if ( ( ( valid == false ) || ( nowUs - storedUs >= ttlUs ) ) &&
+                 ( Claim( nowUs ) == false ) )
+            {
+                /* another process is refreshing the snapshot */
+                stale = ( nowUs - storedUs < ttlUs + LISTCACHE_CLAIM_US );
+            }
+        }
+
+        if ( ( valid == true ) &&
+             ( nowUs >= storedUs ) &&
+             ( ( nowUs - storedUs < ttlUs ) || ( stale == true ) ) )
+        {
+            *pData = pRaw->buf;
+            *pLen = pRaw->len;
+            *pEncoding = COMPRESS_IDENTITY;
+
+            if ( ( encoding != COMPRESS_IDENTITY ) &&
+                 ( pRaw->len >= COMPRESS_MIN_LENGTH ) )
+            {
+                pVariant = &variants[encoding];
+                if ( ( pVariant->len > 0 ) ||
+                     ( Compress_Buffer( &compressor,
+                                        encoding,
+                                        pRaw->buf,
+                                        pRaw->len,
+                                        pVariant->buf,
+                                        pVariant->size,
+                                        &pVariant->len ) == EOK ) )
+                {
+                    *pData = pVariant->buf;
+                    *pLen = pVariant->len;
+                    *pEncoding = encoding;
+                }
+                else
+                {
+                    pVariant->len = 0;
+                }
+            }
+
+            result = EOK;
+        }
+        else if ( ( ttlUs > 0 ) && ( refreshUs == 0 ) )
+        {
+            refreshUs = nowUs;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ListCache_Store                                                           */
+/*!
+    Store a process list snapshot
+
+    The ListCache_Store function replaces the cached snapshot and drops
+    its compressed variants.
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+    @param[in]
+        data
+            pointer to the process list
+
+    @param[in]
+        len
+            length of the process list
+
+    @retval EOK the snapshot was stored
+    @retval ENOTSUP the cache is disabled
+    @retval E2BIG the snapshot is too large to cache
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int ListCache_Store( uint64_t nowUs, const char *data, size_t len )
+{
+    int result = EINVAL;
+    int i;
+
+    if ( data != NULL )
+    {
+        if ( ttlUs == 0 )
+        {
+            result = ENOTSUP;
+        }
+        else if ( len > variants[COMPRESS_IDENTITY].size )
+        {
+            ListCache_Invalidate();
+            result = E2BIG;
+        }
+        else
+        {
+            memcpy( variants[COMPRESS_IDENTITY].buf, data, len );
+
+            for ( i = 0; i < COMPRESS_MAX; i++ )
+            {
+                variants[i].len = 0;
+            }
+
+            variants[COMPRESS_IDENTITY].len = len;
+            storedUs = nowUs;
+            storedGeneration++;
+            refreshUs = 0;
+            valid = true;
+            result = EOK;
+
+            if ( pShared != NULL )
+            {
+                Publish( nowUs, data, len );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ListCache_Release                                                         */
+/*!
+    Release a refresh claim
+
+    The ListCache_Release function gives up the claim to refresh the
+    shared snapshot made by ListCache_Get, whether or not a new snapshot
+    was stored, so that waiting processes do not wait for the claim to
+    lapse.  It has no effect if the snapshot is not shared or this
+    process holds no claim.
+
+==============================================================================*/
+void ListCache_Release( void )
+{
+    int32_t pid = getpid();
+
+    refreshUs = 0;
+
+    if ( pShared != NULL )
+    {
+        __atomic_compare_exchange_n( &pShared->claimPid,
+                                     &pid,
+                                     0,
+                                     false,
+                                     __ATOMIC_RELEASE,
+                                     __ATOMIC_RELAXED );
+    }
+}
+
+/*============================================================================*/
+/*  ListCache_Invalidate                                                      */
+/*!
+    Drop the cached process list
+
+    The ListCache_Invalidate function drops the cached snapshot after
+    an action which changes the process list.
+
+==============================================================================*/
+void ListCache_Invalidate( void )
+{
+    valid = false;
+    storedGeneration++;
+    refreshUs = 0;
+
+    if ( pShared != NULL )
+    {
+        /* drop the snapshot of the other processes too */
+        __atomic_store_n( &pShared->valid, 0, __ATOMIC_RELEASE );
+        sharedGeneration = __atomic_add_fetch( &pShared->generation,
+                                               1,
+                                               __ATOMIC_ACQ_REL );
+    }
+}
+
+/*============================================================================*/
+/*  ListCache_Generation                                                      */
+/*!
+    Get the generation of the cached process list
+
+    The ListCache_Generation function identifies the snapshot held in
+    the cache, so that a caller which derives data from a snapshot can
+    tell whether the snapshot has changed since.  The generation changes
+    whenever the snapshot is stored, copied in from another process or
+    dropped, and is never reused.
+
+    @retval generation of the cached snapshot
+    @retval 0 the cache holds no snapshot
+
+==============================================================================*/
+uint64_t ListCache_Generation( void )
+{
+    return ( valid == true ) ? storedGeneration : 0;
+}
+
+/*============================================================================*/
+/*  ListCache_IsCurrent                                                       */
+/*!
+    Check that the cached process list is kept current
+
+    The ListCache_IsCurrent function checks that a refresh of the cached
+    list which this process was asked to make has not been under way for
+    longer than a refresh claim can last, ie that the list is not older
+    than its time to live by more than LISTCACHE_CLAIM_US.
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+    @retval true the list is current, or is not cached
+    @retval false the list refresh is overdue
+
+==============================================================================*/
+bool ListCache_IsCurrent( uint64_t nowUs )
+{
+    return ( refreshUs == 0 ) ||
+           ( nowUs < refreshUs + LISTCACHE_CLAIM_US );
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Slot                                                                      */
+/*!
+    Get a shared snapshot slot
+
+    @param[in]
+        index
+            index of the slot
+
+    @retval pointer to the slot
+
+==============================================================================*/
+static SharedSlot *Slot( uint32_t index )
+{
+    return (SharedSlot *)( (char *)pShared +
+                           sizeof( SharedHeader ) +
+                           ( index % LISTCACHE_SHARED_SLOTS ) * slotSize );
+}
+
+/*============================================================================*/
+/*  Adopt                                                                     */
+/*!
+    Copy in the shared snapshot
+
+    The Adopt function copies the current shared snapshot into the raw
+    variant if it has changed since it was last copied, and drops the
+    compressed variants.  The copy is retried from the then current
+    slot if the slot is rewritten while it is being copied.  If it is
+    still being rewritten after LISTCACHE_ADOPT_TRIES attempts, the
+    cache is left without a snapshot so the caller refreshes it.
+
+==============================================================================*/
+static void Adopt( void )
+{
+    Variant *pRaw = &variants[COMPRESS_IDENTITY];
+    uint64_t generation;
+    SharedSlot *pSlot;
+    uint32_t before;
+    uint32_t after;
+    uint64_t len;
+    int tries = 0;
+    int i;
+
+    generation = __atomic_load_n( &pShared->generation, __ATOMIC_ACQUIRE );
+    if ( generation != sharedGeneration )
+    {
+        sharedGeneration = generation;
+        valid = false;
+
+        if ( __atomic_load_n( &pShared->valid, __ATOMIC_ACQUIRE ) != 0 )
+        {
+            do
+            {
+                pSlot = Slot( __atomic_load_n( &pShared->current,
+                                               __ATOMIC_ACQUIRE ) );
+                before = __atomic_load_n( &pSlot->seq, __ATOMIC_ACQUIRE );
+                len = pSlot->len;
+                if ( len > pRaw->size )
+                {
+                    len = 0;
+                }
+
+                storedUs = pSlot->storedUs;
+                memcpy( pRaw->buf, pSlot->data, len );
+                __atomic_thread_fence( __ATOMIC_ACQUIRE );
+                after = __atomic_load_n( &pSlot->seq, __ATOMIC_RELAXED );
+                if ( ( before & 1 ) || ( before != after ) )
+                {
+                    len = 0;
+                }
+            } while ( ( len == 0 ) && ( ++tries < LISTCACHE_ADOPT_TRIES ) );
+
+            for ( i = 0; i < COMPRESS_MAX; i++ )
+            {
+                variants[i].len = 0;
+            }
+
+            pRaw->len = len;
+            storedGeneration++;
+            valid = ( len > 0 );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Claim                                                                     */
+/*!
+    Claim the refresh of the shared snapshot
+
+    The Claim function claims the refresh of the shared snapshot if no
+    other process holds a current claim.  It does not wait for another
+    refresh to complete.
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+    @retval true this process should refresh the snapshot
+    @retval false another process is refreshing the snapshot
+
+==============================================================================*/
+static bool Claim( uint64_t nowUs )
+{
+    int32_t pid = getpid();
+    int32_t owner;
+    bool claimed = false;
+
+    owner = __atomic_load_n( &pShared->claimPid, __ATOMIC_ACQUIRE );
+    if ( ( owner == 0 ) ||
+         ( owner == pid ) ||
+         ( __atomic_load_n( &pShared->claimUs, __ATOMIC_RELAXED ) +
+                LISTCACHE_CLAIM_US < nowUs ) )
+    {
+        claimed = __atomic_compare_exchange_n( &pShared->claimPid,
+                                               &owner,
+                                               pid,
+                                               false,
+                                               __ATOMIC_ACQ_REL,
+                                               __ATOMIC_RELAXED );
+        if ( claimed == true )
+        {
+            __atomic_store_n( &pShared->claimUs, nowUs, __ATOMIC_RELAXED );
+        }
+    }
+
+    return claimed;
+}
+
+/*============================================================================*/
+/*  Publish                                                                   */
+/*!
+    Publish a snapshot to the other processes
+
+    The Publish function writes the snapshot to the slot which is not
+    current and then makes it current.  If another process is already
+    publishing, this snapshot is not published.  A process which died
+    while publishing would otherwise block every later snapshot, so its
+    place is taken over.  Any refresh claim held by this process is
+    released.
+
+    @param[in]
+        nowUs
+            time the snapshot was stored
+
+    @param[in]
+        data
+            pointer to the snapshot
+
+    @param[in]
+        len
+            length of the snapshot
+
+==============================================================================*/
+static void Publish( uint64_t nowUs, const char *data, size_t len )
+{
+    int32_t pid = getpid();
+    int32_t writer = 0;
+    uint32_t next;
+    uint32_t seq;
+    SharedSlot *pSlot;
+    bool owned;
+
+    owned = __atomic_compare_exchange_n( &pShared->writing,
+                                         &writer,
+                                         pid,
+                                         false,
+                                         __ATOMIC_ACQUIRE,
+                                         __ATOMIC_RELAXED );
+    if ( ( owned == false ) &&
+         ( kill( writer, 0 ) == -1 ) &&
+         ( errno == ESRCH ) )
+    {
+        /* the writer died while publishing */
+        owned = __atomic_compare_exchange_n( &pShared->writing,
+                                             &writer,
+                                             pid,
+                                             false,
+                                             __ATOMIC_ACQUIRE,
+                                             __ATOMIC_RELAXED );
+    }
+
+    if ( owned == true )
+    {
+        next = ( __atomic_load_n( &pShared->current, __ATOMIC_RELAXED ) + 1 )
+                    % LISTCACHE_SHARED_SLOTS;
+        pSlot = Slot( next );
+
+        /* the sequence number is already odd if a dead writer left the
+           slot partly written */
+        seq = __atomic_load_n( &pSlot->seq, __ATOMIC_RELAXED ) | 1;
+        __atomic_store_n( &pSlot->seq, seq, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_RELEASE );
+        pSlot->storedUs = nowUs;
+        pSlot->len = len;
+        memcpy( pSlot->data, data, len );
+        __atomic_store_n( &pSlot->seq, seq + 1, __ATOMIC_RELEASE );
+
+        __atomic_store_n( &pShared->current, next, __ATOMIC_RELEASE );
+        __atomic_store_n( &pShared->valid, 1, __ATOMIC_RELEASE );
+        sharedGeneration = __atomic_add_fetch( &pShared->generation,
+                                               1,
+                                               __ATOMIC_ACQ_REL );
+
+        __atomic_store_n( &pShared->writing, 0, __ATOMIC_RELEASE );
+    }
+
+    ListCache_Release();
+}
+
+/*! @}
+ * end of listcache group */
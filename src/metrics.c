@@ -0,0 +1,370 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup metrics metrics
+ * @brief Request metrics
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file metrics.c
+
+    Request Metrics
+
+    The metrics module accumulates request counts, errors, processing
+    time and heap allocations for each request class, and outputs them
+    in the Prometheus text exposition format.
+
+    Counters are updated with atomic operations so they can be read
+    while requests are being processed.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <errno.h>
+#include "metrics.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! maximum length of a formatted metrics line */
+#define METRICS_MAX_LINE_LEN    256
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! counters for a single request class */
+typedef struct _ClassCounters
+{
+    /*! number of requests */
+    uint64_t requests;
+
+    /*! number of failed requests */
+    uint64_t errors;
+
+    /*! total processing time in microseconds */
+    uint64_t durationUs;
+
+    /*! number of heap allocation calls */
+    uint64_t allocCalls;
+
+    /*! number of heap bytes requested */
+    uint64_t allocBytes;
+
+    /*! number of response write system calls */
+    uint64_t writes;
+
+} ClassCounters;
+
+/*! description of a per-class counter metric */
+typedef struct _CounterMetric
+{
+    /*! metric name */
+    const char *name;
+
+    /*! metric help text */
+    const char *help;
+
+    /*! offset of the counter in the ClassCounters object */
+    size_t offset;
+
+} CounterMetric;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! request class names */
+static const char *classNames[REQ_CLASS_MAX] =
+{
+    "other",
+    "list",
+    "start",
+    "stop",
+    "restart",
+    "profile",
+    "metrics",
+    "status",
+    "health",
+    "get"
+};
+
+/*! per-class counters */
+static ClassCounters counters[REQ_CLASS_MAX];
+
+/*! per-class counter metrics */
+static const CounterMetric counterMetrics[] =
+{
+    { "fcgi_proc_requests_total",
+      "Requests processed",
+      offsetof( ClassCounters, requests ) },
+
+    { "fcgi_proc_request_errors_total",
+      "Requests which failed",
+      offsetof( ClassCounters, errors ) },
+
+    { "fcgi_proc_request_duration_microseconds_total",
+      "Request processing time",
+      offsetof( ClassCounters, durationUs ) },
+
+    { "fcgi_proc_alloc_calls_total",
+      "Heap allocation calls made while processing requests",
+      offsetof( ClassCounters, allocCalls ) },
+
+    { "fcgi_proc_alloc_bytes_total",
+      "Heap bytes requested while processing requests",
+      offsetof( ClassCounters, allocBytes ) },
+
+    { "fcgi_proc_response_writes_total",
+      "Write system calls made to send responses",
+      offsetof( ClassCounters, writes ) }
+};
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Metrics_Record                                                            */
+/*!
+    Record the measurements of a completed request
+
+    The Metrics_Record function adds the measurements of a completed
+    request to the counters of its request class.
+
+    @param[in]
+        reqClass
+            the class of the completed request
+
+    @param[in]
+        pMetrics
+            pointer to the measurements of the completed request
+
+==============================================================================*/
+void Metrics_Record( RequestClass reqClass, RequestMetrics *pMetrics )
+{
+    ClassCounters *pCounters;
+
+    if ( ( reqClass < REQ_CLASS_MAX ) && ( pMetrics != NULL ) )
+    {
+        pCounters = &counters[reqClass];
+
+        __atomic_fetch_add( &pCounters->requests, 1, __ATOMIC_RELAXED );
+        __atomic_fetch_add( &pCounters->durationUs,
+                            pMetrics->durationUs,
+                            __ATOMIC_RELAXED );
+        __atomic_fetch_add( &pCounters->allocCalls,
+                            pMetrics->allocCalls,
+                            __ATOMIC_RELAXED );
+        __atomic_fetch_add( &pCounters->allocBytes,
+                            pMetrics->allocBytes,
+                            __ATOMIC_RELAXED );
+        __atomic_fetch_add( &pCounters->writes,
+                            pMetrics->writes,
+                            __ATOMIC_RELAXED );
+
+        if ( pMetrics->failed == true )
+        {
+            __atomic_fetch_add( &pCounters->errors, 1, __ATOMIC_RELAXED );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Metrics_GetRequestCount                                                   */
+/*!
+    Get the number of requests processed for a request class
+
+    @param[in]
+        reqClass
+            the request class
+
+    @retval number of requests of the class which have been recorded
+
+==============================================================================*/
+uint64_t Metrics_GetRequestCount( RequestClass reqClass )
+{
+    uint64_t count = 0;
+
+    if ( reqClass < REQ_CLASS_MAX )
+    {
+        count = __atomic_load_n( &counters[reqClass].requests,
+                                 __ATOMIC_RELAXED );
+    }
+
+    return count;
+}
+
+/*============================================================================*/
+/*  Metrics_ClassName                                                         */
+/*!
+    Get the name of a request class
+
+    @param[in]
+        reqClass
+            the request class
+
+    @retval pointer to the name of the request class
+
+==============================================================================*/
+const char *Metrics_ClassName( RequestClass reqClass )
+{
+    return ( reqClass < REQ_CLASS_MAX ) ? classNames[reqClass] : "unknown";
+}
+
+/*============================================================================*/
+/*  Metrics_Output                                                            */
+/*!
+    Output the metrics
+
+    The Metrics_Output function outputs all the metrics in the Prometheus
+    text exposition format.
+
+    @param[in]
+        fn
+            output function to send the metrics text to
+
+    @param[in]
+        arg
+            opaque argument passed to the output function
+
+    @retval EOK the metrics were output
+    @retval EINVAL invalid arguments
+    @retval other error returned by the output function
+
+==============================================================================*/
+int Metrics_Output( OutputFn fn, void *arg )
+{
+    int result = EINVAL;
+    char buf[METRICS_MAX_LINE_LEN];
+    const CounterMetric *pMetric;
+    uint64_t value;
+    size_t i;
+    int cls;
+    int n;
+
+    if ( fn != NULL )
+    {
+        result = EOK;
+
+        for ( i = 0;
+              ( i < sizeof( counterMetrics ) / sizeof( CounterMetric ) ) &&
+              ( result == EOK );
+              i++ )
+        {
+            pMetric = &counterMetrics[i];
+
+            n = snprintf( buf,
+                          sizeof( buf ),
+                          "# HELP %s %s\n# TYPE %s counter\n",
+                          pMetric->name,
+                          pMetric->help,
+                          pMetric->name );
+            result = fn( arg, buf, n );
+
+            for ( cls = 0; ( cls < REQ_CLASS_MAX ) && ( result == EOK ); cls++ )
+            {
+                value = __atomic_load_n(
+                            (uint64_t *)( (char *)&counters[cls] +
+                                          pMetric->offset ),
+                            __ATOMIC_RELAXED );
+
+                n = snprintf( buf,
+                              sizeof( buf ),
+                              "%s{class=\"%s\"} %llu\n",
+                              pMetric->name,
+                              classNames[cls],
+                              (unsigned long long)value );
+                result = fn( arg, buf, n );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Metrics_Encode                                                            */
+/*!
+    Encode the metrics
+
+    The Metrics_Encode function encodes the metrics as a map from
+    request class name to a map of counter name to value, for output
+    in a structured format.
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @retval EOK the metrics were encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int Metrics_Encode( Encoder *pEncoder )
+{
+    int result = EINVAL;
+    size_t numMetrics = sizeof( counterMetrics ) / sizeof( CounterMetric );
+    const CounterMetric *pMetric;
+    size_t i;
+    int cls;
+
+    if ( pEncoder != NULL )
+    {
+        result = Encoder_Map( pEncoder, REQ_CLASS_MAX );
+
+        for ( cls = 0; ( cls < REQ_CLASS_MAX ) && ( result == EOK ); cls++ )
+        {
+            Encoder_String( pEncoder, classNames[cls] );
+            result = Encoder_Map( pEncoder, numMetrics );
+
+            for ( i = 0; ( i < numMetrics ) && ( result == EOK ); i++ )
+            {
+                pMetric = &counterMetrics[i];
+                Encoder_String( pEncoder, pMetric->name );
+                result = Encoder_Uint(
+                            pEncoder,
+                            __atomic_load_n(
+                                (uint64_t *)( (char *)&counters[cls] +
+                                              pMetric->offset ),
+                                __ATOMIC_RELAXED ) );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of metrics group */
@@ -0,0 +1,1045 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup peer peer
+ * @brief Peer fcgi_proc federation
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file peer.c
+
+    Peer Federation
+
+    The peer module allows one fcgi_proc to answer for a small cluster
+    by requesting the process lists of its peer fcgi_proc instances.
+    Each peer is reached directly over FastCGI, on a unix domain socket
+    or a TCP address, with the same ?list query a web server would send.
+
+    The requests to all peers are started together and collected with
+    a common deadline, so a cluster list takes as long as the slowest
+    peer up to the deadline.  The local process list is fetched while
+    the peer requests are in progress, and inside a task the wait for
+    the peers yields to the event loop (see Coro_Poll).  The process list of each peer
+    is kept for a short time, so that cluster lists arriving in quick
+    succession do not query the peers again.
+
+    The peer buffers are allocated when the module is initialized, and
+    a full buffer is doubled, up to PEER_BUFFER_MAX, to hold a larger
+    process list.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "coro.h"
+#include "peer.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! length of a FastCGI record header */
+#define FCGI_HEADER_LEN         8
+
+/*! FastCGI record types used by the peer client */
+#define FCGI_BEGIN_REQUEST      1
+#define FCGI_END_REQUEST        3
+#define FCGI_PARAMS             4
+#define FCGI_STDIN              5
+#define FCGI_STDOUT             6
+
+/*! FastCGI responder role */
+#define FCGI_RESPONDER          1
+
+/*! maximum size of a peer response buffer */
+#define PEER_BUFFER_MAX         ( 16 * 1024 * 1024 )
+
+/*! maximum length of a peer status entry without its process list */
+#define PEER_ENTRY_LEN          ( PEER_NAME_LEN + 96 )
+
+/*! progress of a peer request */
+typedef enum _PeerState
+{
+    /*! no request in progress */
+    PEER_IDLE = 0,
+
+    /*! waiting for the connection to complete */
+    PEER_CONNECTING,
+
+    /*! sending the request */
+    PEER_SENDING,
+
+    /*! reading the response */
+    PEER_READING
+
+} PeerState;
+
+/*! outcome of the most recent peer request */
+typedef enum _PeerStatus
+{
+    /*! the process list was received */
+    PEER_STATUS_OK = 0,
+
+    /*! the process list was kept from an earlier request */
+    PEER_STATUS_CACHED,
+
+    /*! the peer did not respond before the deadline */
+    PEER_STATUS_TIMEOUT,
+
+    /*! the peer could not be connected */
+    PEER_STATUS_UNREACHABLE,
+
+    /*! the peer response was not a process list */
+    PEER_STATUS_ERROR,
+
+    /*! number of peer status values */
+    PEER_STATUS_MAX
+
+} PeerStatus;
+
+/*! a peer fcgi_proc instance */
+typedef struct _Peer
+{
+    /*! peer name */
+    char name[PEER_NAME_LEN];
+
+    /*! peer socket address */
+    struct sockaddr_storage addr;
+
+    /*! length of the peer socket address */
+    socklen_t addrLen;
+
+    /*! response buffer */
+    char *buf;
+
+    /*! size of the response buffer */
+    size_t size;
+
+    /*! length of the data in the response buffer */
+    size_t len;
+
+    /*! process list in the response buffer */
+    const char *list;
+
+    /*! length of the process list */
+    size_t listLen;
+
+    /*! time the process list was received, if list is not NULL */
+    uint64_t receivedUs;
+
+    /*! request socket, or -1 */
+    int fd;
+
+    /*! number of request bytes sent */
+    size_t sent;
+
+    /*! progress of the request */
+    PeerState state;
+
+    /*! outcome of the most recent request */
+    PeerStatus status;
+
+} Peer;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int ParseAddress( Peer *pPeer, const char *address );
+static void Connect( Peer *pPeer );
+static void Progress( Peer *pPeer );
+static void Finish( Peer *pPeer, PeerStatus status );
+static int Decode( Peer *pPeer );
+static int GrowBuffer( Peer *pPeer );
+static size_t BuildRequest( unsigned char *buf );
+static unsigned char *PutHeader( unsigned char *p, int type, size_t len );
+static size_t PutParam( unsigned char *p, const char *name, const char *value );
+static uint64_t NowUs( void );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! configured peers */
+static Peer peers[PEER_MAX];
+
+/*! number of configured peers */
+static size_t numPeers = 0;
+
+/*! initial size of each peer response buffer */
+static size_t bufSize = 0;
+
+/*! time to wait for the peers of a request in microseconds */
+static uint64_t deadlineUs = PEER_DEFAULT_DEADLINE * 1000ULL;
+
+/*! time to keep a peer process list in microseconds */
+static uint64_t ttlUs = PEER_DEFAULT_TTL * 1000ULL;
+
+/*! time at which the current peer requests are abandoned */
+static uint64_t expiresUs = 0;
+
+/*! FastCGI request sent to every peer */
+static unsigned char request[128];
+
+/*! length of the FastCGI request */
+static size_t requestLen = 0;
+
+/*! names of the peer status values */
+static const char *statusNames[PEER_STATUS_MAX] =
+{
+    "ok",
+    "cached",
+    "timeout",
+    "unreachable",
+    "error"
+};
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Peer_Add                                                                  */
+/*!
+    Add a peer fcgi_proc instance
+
+    The Peer_Add function adds a peer from a specification of the form
+    <name>=unix:<socket path> or <name>=<IPv4 address>:<port>, naming
+    the FastCGI socket the peer fcgi_proc listens on.  Peer names may
+    only contain alphanumeric characters, '-', '_' and '.'.
+
+    @param[in]
+        spec
+            pointer to the peer specification
+
+    @retval EOK the peer was added
+    @retval ENOSPC too many peers
+    @retval E2BIG the name or socket path is too long
+    @retval EINVAL invalid specification
+
+==============================================================================*/
+int Peer_Add( const char *spec )
+{
+    int result = EINVAL;
+    const char *address;
+    size_t nameLen;
+    Peer *pPeer;
+    size_t i;
+
+    address = ( spec != NULL ) ? strchr( spec, '=' ) : NULL;
+    if ( address != NULL )
+    {
+        nameLen = address - spec;
+        address++;
+
+        result = ( nameLen > 0 ) ? EOK : EINVAL;
+        for ( i = 0; i < nameLen; i++ )
+        {
+            if ( !isalnum( (unsigned char)spec[i] ) &&
+                 ( strchr( "-_.", spec[i] ) == NULL ) )
+            {
+                result = EINVAL;
+            }
+        }
+
+        if ( ( result == EOK ) && ( nameLen >= PEER_NAME_LEN ) )
+        {
+            result = E2BIG;
+        }
+        else if ( ( result == EOK ) && ( numPeers == PEER_MAX ) )
+        {
+            result = ENOSPC;
+        }
+
+        if ( result == EOK )
+        {
+            pPeer = &peers[numPeers];
+            memset( pPeer, 0, sizeof( Peer ) );
+            memcpy( pPeer->name, spec, nameLen );
+            pPeer->fd = -1;
+
+            result = ParseAddress( pPeer, address );
+            if ( result == EOK )
+            {
+                numPeers++;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Peer_Init                                                                 */
+/*!
+    Initialize the peer federation
+
+    The Peer_Init function allocates a response buffer for each
+    configured peer and builds the FastCGI request sent to the peers.
+    Nothing is allocated if no peers are configured.
+
+    @param[in]
+        capacity
+            initial size of each peer response buffer
+
+    @param[in]
+        deadlineMs
+            time to wait for the peers of a request in milliseconds,
+            or 0 for the default
+
+    @param[in]
+        ttlMs
+            time to keep a peer process list in milliseconds
+
+    @retval EOK the peers were initialized
+    @retval ENOMEM cannot allocate the response buffers
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Peer_Init( size_t capacity, unsigned int deadlineMs, unsigned int ttlMs )
+{
+    int result = EINVAL;
+    size_t i;
+
+    if ( capacity > 0 )
+    {
+        result = EOK;
+        bufSize = capacity;
+        ttlUs = ttlMs * 1000ULL;
+        if ( deadlineMs > 0 )
+        {
+            deadlineUs = deadlineMs * 1000ULL;
+        }
+
+        requestLen = BuildRequest( request );
+
+        for ( i = 0; ( i < numPeers ) && ( result == EOK ); i++ )
+        {
+            peers[i].buf = malloc( capacity );
+            if ( peers[i].buf != NULL )
+            {
+                peers[i].size = capacity;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Peer_Count                                                                */
+/*!
+    Get the number of peers
+
+    @retval number of configured peers
+
+==============================================================================*/
+size_t Peer_Count( void )
+{
+    return numPeers;
+}
+
+/*============================================================================*/
+/*  Peer_Begin                                                                */
+/*!
+    Start requesting the peer process lists
+
+    The Peer_Begin function starts a non-blocking request to each peer
+    whose process list has not been kept, and sets the deadline by
+    which the requests must complete.
+
+==============================================================================*/
+void Peer_Begin( void )
+{
+    uint64_t nowUs = NowUs();
+    Peer *pPeer;
+    size_t i;
+
+    expiresUs = nowUs + deadlineUs;
+
+    for ( i = 0; ( i < numPeers ) && ( bufSize > 0 ); i++ )
+    {
+        pPeer = &peers[i];
+
+        if ( ( pPeer->list != NULL ) &&
+             ( nowUs - pPeer->receivedUs < ttlUs ) )
+        {
+            pPeer->status = PEER_STATUS_CACHED;
+        }
+        else
+        {
+            pPeer->list = NULL;
+            Connect( pPeer );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Peer_Collect                                                              */
+/*!
+    Complete the peer requests
+
+    The Peer_Collect function waits until every peer request started by
+    Peer_Begin has completed, or the deadline has passed.  Inside a task
+    the wait yields to the event loop (see Coro_Poll).  Requests which
+    have not completed by the deadline are abandoned.
+
+==============================================================================*/
+void Peer_Collect( void )
+{
+    struct pollfd fds[PEER_MAX];
+    Peer *owners[PEER_MAX];
+    uint64_t nowUs;
+    size_t nfds;
+    size_t i;
+    int timeoutMs;
+    int n;
+
+    do
+    {
+        nfds = 0;
+        for ( i = 0; i < numPeers; i++ )
+        {
+            if ( peers[i].state != PEER_IDLE )
+            {
+                fds[nfds].fd = peers[i].fd;
+                fds[nfds].events = ( peers[i].state == PEER_READING )
+                                    ? POLLIN : POLLOUT;
+                fds[nfds].revents = 0;
+                owners[nfds++] = &peers[i];
+            }
+        }
+
+        if ( nfds == 0 )
+        {
+            break;
+        }
+
+        /* poll at least once after the deadline for responses which
+           have already arrived */
+        nowUs = NowUs();
+        timeoutMs = ( nowUs < expiresUs )
+                        ? (int)( ( expiresUs - nowUs + 999 ) / 1000 )
+                        : 0;
+
+        n = Coro_Poll( fds, nfds, timeoutMs );
+        if ( n > 0 )
+        {
+            for ( i = 0; i < nfds; i++ )
+            {
+                if ( fds[i].revents != 0 )
+                {
+                    Progress( owners[i] );
+                }
+            }
+        }
+        else if ( ( n < 0 ) && ( errno == EINTR ) )
+        {
+            continue;
+        }
+
+        if ( ( n <= 0 ) || ( NowUs() >= expiresUs ) )
+        {
+            for ( i = 0; i < nfds; i++ )
+            {
+                if ( owners[i]->state != PEER_IDLE )
+                {
+                    Finish( owners[i], PEER_STATUS_TIMEOUT );
+                }
+            }
+        }
+
+    } while ( nfds > 0 );
+}
+
+/*============================================================================*/
+/*  Peer_Output                                                               */
+/*!
+    Output the peer process lists
+
+    The Peer_Output function outputs an entry for each peer giving its
+    name, the outcome of the most recent request, the age in
+    milliseconds of its process list, and the process list itself,
+    which is empty if none is available.  Each entry is preceded by a
+    comma, so it follows an earlier entry in a JSON array.
+
+    @param[in]
+        fn
+            output function
+
+    @param[in]
+        arg
+            output function argument
+
+    @retval EOK the peer entries were output
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int Peer_Output( OutputFn fn, void *arg )
+{
+    int result = EINVAL;
+    char entry[PEER_ENTRY_LEN];
+    uint64_t nowUs = NowUs();
+    Peer *pPeer;
+    size_t i;
+    int n;
+
+    if ( fn != NULL )
+    {
+        result = EOK;
+
+        for ( i = 0; ( i < numPeers ) && ( result == EOK ); i++ )
+        {
+            pPeer = &peers[i];
+
+            n = snprintf( entry,
+                          sizeof entry,
+                          ", {\"peer\": \"%s\", \"status\": \"%s\", "
+                          "\"ageMs\": %llu, \"processes\": ",
+                          pPeer->name,
+                          statusNames[pPeer->status],
+                          ( pPeer->list != NULL )
+                            ? (unsigned long long)
+                              ( ( nowUs - pPeer->receivedUs ) / 1000 )
+                            : 0ULL );
+
+            result = fn( arg, entry, n );
+            if ( result == EOK )
+            {
+                result = ( pPeer->list != NULL )
+                            ? fn( arg, pPeer->list, pPeer->listLen )
+                            : fn( arg, "[]", 2 );
+            }
+
+            if ( result == EOK )
+            {
+                result = fn( arg, "}", 1 );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  ParseAddress                                                              */
+/*!
+    Parse a peer socket address
+
+    @param[in]
+        pPeer
+            pointer to the peer
+
+    @param[in]
+        address
+            unix:<socket path> or <IPv4 address>:<port>
+
+    @retval EOK the address was parsed
+    @retval E2BIG the socket path is too long
+    @retval EINVAL invalid address
+
+==============================================================================*/
+static int ParseAddress( Peer *pPeer, const char *address )
+{
+    int result = EINVAL;
+    struct sockaddr_un *pUnix = (struct sockaddr_un *)&pPeer->addr;
+    struct sockaddr_in *pInet = (struct sockaddr_in *)&pPeer->addr;
+    char host[INET_ADDRSTRLEN];
+    const char *port;
+    unsigned long value;
+    char *end;
+
+    if ( strncmp( address, "unix:", 5 ) == 0 )
+    {
+        address += 5;
+        if ( strlen( address ) >= sizeof( pUnix->sun_path ) )
+        {
+            result = E2BIG;
+        }
+        else if ( *address != '\0' )
+        {
+            pUnix->sun_family = AF_UNIX;
+            strcpy( pUnix->sun_path, address );
+            pPeer->addrLen = sizeof( struct sockaddr_un );
+            result = EOK;
+        }
+    }
+    else if ( ( port = strrchr( address, ':' ) ) != NULL )
+    {
+        value = strtoul( port + 1, &end, 10 );
+        if ( ( port - address < (ptrdiff_t)sizeof( host ) ) &&
+             ( port[1] != '\0' ) &&
+             ( *end == '\0' ) &&
+             ( value > 0 ) &&
+             ( value <= 65535 ) )
+        {
+            memcpy( host, address, port - address );
+            host[port - address] = '\0';
+
+            if ( inet_pton( AF_INET, host, &pInet->sin_addr ) == 1 )
+            {
+                pInet->sin_family = AF_INET;
+                pInet->sin_port = htons( (uint16_t)value );
+                pPeer->addrLen = sizeof( struct sockaddr_in );
+                result = EOK;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Connect                                                                   */
+/*!
+    Start a peer request
+
+    The Connect function starts a non-blocking connection to a peer.
+
+    @param[in]
+        pPeer
+            pointer to the peer
+
+==============================================================================*/
+static void Connect( Peer *pPeer )
+{
+    pPeer->len = 0;
+    pPeer->sent = 0;
+    pPeer->fd = socket( pPeer->addr.ss_family,
+                        SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        0 );
+    if ( pPeer->fd == -1 )
+    {
+        pPeer->status = PEER_STATUS_UNREACHABLE;
+    }
+    else if ( connect( pPeer->fd,
+                       (struct sockaddr *)&pPeer->addr,
+                       pPeer->addrLen ) == 0 )
+    {
+        pPeer->state = PEER_SENDING;
+    }
+    else if ( ( errno == EINPROGRESS ) || ( errno == EAGAIN ) )
+    {
+        pPeer->state = PEER_CONNECTING;
+    }
+    else
+    {
+        Finish( pPeer, PEER_STATUS_UNREACHABLE );
+    }
+}
+
+/*============================================================================*/
+/*  Progress                                                                  */
+/*!
+    Advance a peer request
+
+    The Progress function completes the connection, sends more of the
+    request, or reads more of the response of a peer whose socket is
+    ready.  A full response buffer is grown before reading more.
+
+    @param[in]
+        pPeer
+            pointer to the peer
+
+==============================================================================*/
+static void Progress( Peer *pPeer )
+{
+    int err = 0;
+    socklen_t errLen = sizeof( err );
+    ssize_t n;
+
+    if ( pPeer->state == PEER_CONNECTING )
+    {
+        getsockopt( pPeer->fd, SOL_SOCKET, SO_ERROR, &err, &errLen );
+        if ( err != 0 )
+        {
+            Finish( pPeer, PEER_STATUS_UNREACHABLE );
+        }
+        else
+        {
+            pPeer->state = PEER_SENDING;
+        }
+    }
+    else if ( pPeer->state == PEER_SENDING )
+    {
+        n = send( pPeer->fd,
+                  &request[pPeer->sent],
+                  requestLen - pPeer->sent,
+                  MSG_NOSIGNAL );
+        if ( n > 0 )
+        {
+            pPeer->sent += n;
+            if ( pPeer->sent == requestLen )
+            {
+                pPeer->state = PEER_READING;
+            }
+        }
+        else if ( ( errno != EAGAIN ) && ( errno != EINTR ) )
+        {
+            Finish( pPeer, PEER_STATUS_ERROR );
+        }
+    }
+    else if ( ( pPeer->len == pPeer->size ) &&
+              ( GrowBuffer( pPeer ) != EOK ) )
+    {
+        /* the response does not fit in the buffer */
+        Finish( pPeer, PEER_STATUS_ERROR );
+    }
+    else if ( pPeer->state == PEER_READING )
+    {
+        n = read( pPeer->fd,
+                  &pPeer->buf[pPeer->len],
+                  pPeer->size - pPeer->len );
+        if ( n > 0 )
+        {
+            pPeer->len += n;
+        }
+        else if ( n == 0 )
+        {
+            /* the peer closes the connection after the response */
+            Finish( pPeer,
+                    ( Decode( pPeer ) == EOK ) ? PEER_STATUS_OK
+                                               : PEER_STATUS_ERROR );
+        }
+        else if ( ( errno != EAGAIN ) && ( errno != EINTR ) )
+        {
+            Finish( pPeer, PEER_STATUS_ERROR );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Finish                                                                    */
+/*!
+    End a peer request
+
+    @param[in]
+        pPeer
+            pointer to the peer
+
+    @param[in]
+        status
+            outcome of the request
+
+==============================================================================*/
+static void Finish( Peer *pPeer, PeerStatus status )
+{
+    if ( pPeer->fd != -1 )
+    {
+        close( pPeer->fd );
+        pPeer->fd = -1;
+    }
+
+    pPeer->state = PEER_IDLE;
+    pPeer->status = status;
+
+    if ( status == PEER_STATUS_OK )
+    {
+        pPeer->receivedUs = NowUs();
+    }
+    else
+    {
+        pPeer->list = NULL;
+    }
+}
+
+/*============================================================================*/
+/*  Decode                                                                    */
+/*!
+    Decode a peer response
+
+    The Decode function joins the content of the FastCGI stdout records
+    of a peer response in place, and checks that it is a successful
+    response whose body is a JSON array.
+
+    @param[in]
+        pPeer
+            pointer to the peer
+
+    @retval EOK the response holds a process list
+    @retval EBADMSG the response is incomplete or not a process list
+
+==============================================================================*/
+static int Decode( Peer *pPeer )
+{
+    int result = EBADMSG;
+    const unsigned char *p = (const unsigned char *)pPeer->buf;
+    const unsigned char *end = p + pPeer->len;
+    char *out = pPeer->buf;
+    size_t contentLen;
+    size_t paddingLen;
+    bool complete = false;
+    char *body;
+    size_t len;
+
+    while ( ( complete == false ) && ( end - p >= FCGI_HEADER_LEN ) )
+    {
+        contentLen = ( (size_t)p[4] << 8 ) | p[5];
+        paddingLen = p[6];
+        if ( (size_t)( end - p ) < FCGI_HEADER_LEN + contentLen + paddingLen )
+        {
+            break;
+        }
+
+        if ( p[1] == FCGI_STDOUT )
+        {
+            /* the output never overtakes the input */
+            memmove( out, p + FCGI_HEADER_LEN, contentLen );
+            out += contentLen;
+        }
+        else if ( p[1] == FCGI_END_REQUEST )
+        {
+            complete = true;
+        }
+
+        p += FCGI_HEADER_LEN + contentLen + paddingLen;
+    }
+
+    len = out - pPeer->buf;
+    body = memmem( pPeer->buf, len, "\r\n\r\n", 4 );
+
+    if ( ( complete == true ) &&
+         ( body != NULL ) &&
+         ( strncmp( pPeer->buf, "Status: 200", 11 ) == 0 ) )
+    {
+        body += 4;
+        len -= body - pPeer->buf;
+        while ( ( len > 0 ) && isspace( (unsigned char)*body ) )
+        {
+            body++;
+            len--;
+        }
+
+        if ( ( len > 0 ) && ( *body == '[' ) )
+        {
+            pPeer->list = body;
+            pPeer->listLen = len;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GrowBuffer                                                                */
+/*!
+    Double the size of a peer response buffer
+
+    @param[in]
+        pPeer
+            pointer to the peer
+
+    @retval EOK the buffer was grown
+    @retval E2BIG the buffer is already PEER_BUFFER_MAX bytes or more
+    @retval ENOMEM cannot allocate the larger buffer
+
+==============================================================================*/
+static int GrowBuffer( Peer *pPeer )
+{
+    int result = E2BIG;
+    size_t size = 2 * pPeer->size;
+    char *buf;
+
+    if ( size <= PEER_BUFFER_MAX )
+    {
+        result = ENOMEM;
+        buf = realloc( pPeer->buf, size );
+        if ( buf != NULL )
+        {
+            pPeer->buf = buf;
+            pPeer->size = size;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  BuildRequest                                                              */
+/*!
+    Build the FastCGI request sent to the peers
+
+    The BuildRequest function builds a FastCGI responder request for the
+    local process list of a peer, as a GET of ?list with no body.
+
+    @param[out]
+        buf
+            buffer to receive the request
+
+    @retval length of the request
+
+==============================================================================*/
+static size_t BuildRequest( unsigned char *buf )
+{
+    unsigned char *p = buf;
+    size_t paramsLen;
+
+    /* begin request as a responder which closes the connection */
+    p = PutHeader( p, FCGI_BEGIN_REQUEST, 8 );
+    memset( p, 0, 8 );
+    p[1] = FCGI_RESPONDER;
+    p += 8;
+
+    /* parameters */
+    paramsLen = PutParam( p + FCGI_HEADER_LEN, "REQUEST_METHOD", "GET" );
+    paramsLen += PutParam( p + FCGI_HEADER_LEN + paramsLen,
+                           "QUERY_STRING",
+                           "list" );
+    p = PutHeader( p, FCGI_PARAMS, paramsLen ) + paramsLen;
+
+    /* end of the parameters and empty stdin */
+    p = PutHeader( p, FCGI_PARAMS, 0 );
+    p = PutHeader( p, FCGI_STDIN, 0 );
+
+    return p - buf;
+}
+
+/*============================================================================*/
+/*  PutHeader                                                                 */
+/*!
+    Encode a FastCGI record header
+
+    The PutHeader function encodes the header of a record of request 1
+    with no padding.
+
+    @param[out]
+        p
+            location to store the header
+
+    @param[in]
+        type
+            record type
+
+    @param[in]
+        len
+            content length
+
+    @retval location following the header
+
+==============================================================================*/
+static unsigned char *PutHeader( unsigned char *p, int type, size_t len )
+{
+    p[0] = 1;
+    p[1] = (unsigned char)type;
+    p[2] = 0;
+    p[3] = 1;
+    p[4] = (unsigned char)( len >> 8 );
+    p[5] = (unsigned char)len;
+    p[6] = 0;
+    p[7] = 0;
+
+    return p + FCGI_HEADER_LEN;
+}
+
+/*============================================================================*/
+/*  PutParam                                                                  */
+/*!
+    Encode a FastCGI name-value pair
+
+    @param[out]
+        p
+            location to store the pair
+
+    @param[in]
+        name
+            parameter name, shorter than 128 characters
+
+    @param[in]
+        value
+            parameter value, shorter than 128 characters
+
+    @retval length of the encoded pair
+
+==============================================================================*/
+static size_t PutParam( unsigned char *p, const char *name, const char *value )
+{
+    size_t nameLen = strlen( name );
+    size_t valueLen = strlen( value );
+
+    p[0] = (unsigned char)nameLen;
+    p[1] = (unsigned char)valueLen;
+    memcpy( &p[2], name, nameLen );
+    memcpy( &p[2 + nameLen], value, valueLen );
+
+    return 2 + nameLen + valueLen;
+}
+
+/*============================================================================*/
+/*  NowUs                                                                     */
+/*!
+    Get the monotonic time
+
+    @retval monotonic time in microseconds
+
+==============================================================================*/
+static uint64_t NowUs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/*! @}
+ * end of peer group */
@@ -0,0 +1,2056 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup proctable proctable
+ * @brief Typed process table
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file proctable.c
+
+    Typed Process Table
+
+    The proctable module parses the JSON process list produced by
+    "procmon -o json" into a table of typed records, so that processes
+    can be looked up by name and output in any structured format with
+    native integer fields.
+
+    The "since" field, reported by procmon as a duration such as
+    "1h02m03s", is converted to a number of seconds.
+
+    Each record keeps a pre-rendered JSON fragment which is only
+    rebuilt when the record changes between loads, so the JSON list
+    output is gathered from existing fragments and its serialization
+    cost follows the number of changed records rather than the table
+    size.  The since value changes on every load, so it is formatted
+    as the fragments are gathered.
+
+    The records are also indexed in name order for paginated output.
+    A cursor holds the name of the last record of a page, so the next
+    page starts after that name even if processes were added or removed
+    in between.
+
+    The table has no fixed size limit: its arrays grow with the process
+    list, and are reused by later loads.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <errno.h>
+#include "proctable.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! prefix of the names of the process metrics */
+#define PROCTABLE_METRIC_PREFIX "fcgi_proc_process_"
+
+/*! generate the description of a process record field */
+#define PROCTABLE_FIELD_INFO( field, kind, help ) \
+    { #field, \
+      "\"" #field "\": ", \
+      sizeof( "\"" #field "\": " ) - 1, \
+      PROCTABLE_METRIC_PREFIX #field, \
+      help, \
+      FIELD_##kind, \
+      offsetof( ProcRecord, field ), \
+      sizeof( ((ProcRecord *)0)->field ) },
+
+/*! number of records gathered into each output call */
+#define PROCTABLE_GATHER_RECORDS    16
+
+/*! number of buffers gathered for each record */
+#define PROCTABLE_GATHER_IOV    5
+
+/*! maximum length of the computed fields of a record in JSON */
+#define PROCTABLE_COMPUTED_LEN  128
+
+/*! true for fields computed by fcgi_proc rather than reported by procmon */
+#define PROCTABLE_COMPUTED( pField )    ( (pField)->kind >= FIELD_FLAG )
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! JSON parser state */
+typedef struct _Parser
+{
+    /*! current parse position */
+    const char *p;
+
+    /*! end of the JSON text */
+    const char *end;
+
+} Parser;
+
+/*! kinds of process record field */
+typedef enum _FieldKind
+{
+    /*! NUL terminated string */
+    FIELD_STRING,
+
+    /*! signed integer */
+    FIELD_INT,
+
+    /*! unsigned integer */
+    FIELD_UINT,
+
+    /*! duration string held as an unsigned number of seconds */
+    FIELD_DURATION,
+
+    /*! NUL terminated string which is left out when it is empty */
+    FIELD_TAG,
+
+    /*! boolean computed by fcgi_proc */
+    FIELD_FLAG,
+
+    /*! unsigned rate computed by fcgi_proc */
+    FIELD_RATE
+
+} FieldKind;
+
+/*! description of a process record field, generated from the schema */
+typedef struct _FieldInfo
+{
+    /*! field name */
+    const char *key;
+
+    /*! pre-escaped JSON object key and separator */
+    const char *jsonKey;
+
+    /*! length of the JSON object key and separator */
+    size_t jsonKeyLen;
+
+    /*! metric name */
+    const char *metric;
+
+    /*! metric description */
+    const char *help;
+
+    /*! field kind */
+    FieldKind kind;
+
+    /*! offset of the field in the process record */
+    size_t offset;
+
+    /*! size of the field in the process record */
+    size_t size;
+
+} FieldInfo;
+
+/*! formatted values of a gathered record */
+typedef struct _DynamicText
+{
+    /*! decimal digits of the since value */
+    char since[ENCODER_INT_LEN];
+
+    /*! computed fields and the closing brace of the JSON object */
+    char computed[PROCTABLE_COMPUTED_LEN];
+
+} DynamicText;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void SkipSpace( Parser *pParser );
+static bool Expect( Parser *pParser, char c );
+static int ParseObject( Parser *pParser, ProcRecord *pRecord );
+static int ParseString( Parser *pParser, char *buf, size_t len );
+static int SkipValue( Parser *pParser );
+static int64_t ParseInteger( Parser *pParser );
+static uint64_t ParseDuration( const char *duration );
+static bool RecordChanged( const ProcRecord *pOld, const ProcRecord *pNew );
+static int Reserve( ProcTable *pTable, size_t count );
+static int Grow( void **pArray, size_t oldCount, size_t newCount, size_t size );
+static void SortNames( ProcTable *pTable );
+static int CompareNames( const void *a, const void *b, void *arg );
+static size_t RecordIndex( const ProcTable *pTable,
+                           size_t position,
+                           bool sorted );
+static int HexValue( char c );
+static const FieldInfo *FindField( const char *key );
+static void SetInteger( ProcRecord *pRecord,
+                        const FieldInfo *pField,
+                        int64_t value );
+static int64_t GetInteger( const ProcRecord *pRecord,
+                           const FieldInfo *pField );
+static int PutMetricName( const char *name, OutputFn fn, void *arg );
+static int RenderFragment( const ProcRecord *pRecord,
+                           ProcFragment *pFragment );
+static int FragmentWrite( void *arg, const char *buf, size_t len );
+static size_t FormatComputed( const ProcRecord *pRecord, char *buf );
+static bool IsString( const FieldInfo *pField );
+static bool IsOmitted( const ProcRecord *pRecord, const FieldInfo *pField );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! process record fields in output order */
+static const FieldInfo fields[] =
+{
+    PROCTABLE_SCHEMA( PROCTABLE_FIELD_INFO )
+};
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  ProcTable_Load                                                            */
+/*!
+    Load the process table from the procmon JSON process list
+
+    The ProcTable_Load function parses a JSON array of process objects
+    into the process table.  Unknown fields are ignored, and strings
+    longer than their record field are truncated.  The JSON fragment of
+    a record is re-rendered if the record differs from the one
+    previously loaded at the same position, and the name order index
+    is rebuilt if any process was added, removed or renamed.  The table
+    grows to hold the whole list, and keeps its size for later loads.
+    Once loaded, the table is only read, so it can be published to
+    concurrent readers as a snapshot.
+
+    @param[in]
+        pTable
+            pointer to the process table to load
+
+    @param[in]
+        json
+            pointer to the JSON process list (not NUL terminated)
+
+    @param[in]
+        len
+            length of the JSON process list
+
+    @retval EOK the process table was loaded
+    @retval EBADMSG the process list could not be parsed
+    @retval ENOMEM cannot grow the table to hold the process list
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int ProcTable_Load( ProcTable *pTable, const char *json, size_t len )
+{
+    int result = EINVAL;
+    Parser parser;
+    ProcRecord record;
+    ProcRecord *pRecord;
+    ProcFragment *pFragment;
+    size_t previous;
+    size_t i;
+    bool renamed = false;
+
+    if ( ( pTable != NULL ) && ( json != NULL ) )
+    {
+        parser.p = json;
+        parser.end = json + len;
+        previous = pTable->count;
+        pTable->count = 0;
+        pTable->loads++;
+
+        result = Expect( &parser, '[' ) ? EOK : EBADMSG;
+        if ( ( result == EOK ) && ( Expect( &parser, ']' ) == false ) )
+        {
+            do
+            {
+                result = ( pTable->count < pTable->capacity )
+                            ? EOK
+                            : Reserve( pTable, pTable->count + 1 );
+                if ( result == EOK )
+                {
+                    result = ParseObject( &parser, &record );
+                    if ( result == EOK )
+                    {
+                        pRecord = &pTable->records[pTable->count];
+                        pTable->changed[pTable->count] =
+                            RecordChanged( pRecord, &record );
+                        if ( pTable->changed[pTable->count] )
+                        {
+                            pTable->fragments[pTable->count].dirty = true;
+                            renamed |= ( strcmp( pRecord->name,
+                                                 record.name ) != 0 );
+                        }
+
+                        *pRecord = record;
+                        pTable->count++;
+                    }
+                }
+            } while ( ( result == EOK ) && ( Expect( &parser, ',' ) ) );
+
+            if ( ( result == EOK ) && ( Expect( &parser, ']' ) == false ) )
+            {
+                result = EBADMSG;
+            }
+        }
+
+        pTable->reindexed = ( renamed == true ) ||
+                            ( pTable->count != previous );
+        if ( pTable->reindexed == true )
+        {
+            SortNames( pTable );
+        }
+
+        for ( i = 0; ( i < pTable->count ) && ( result == EOK ); i++ )
+        {
+            pFragment = &pTable->fragments[i];
+            if ( ( pFragment->dirty == true ) || ( pFragment->len == 0 ) )
+            {
+                result = RenderFragment( &pTable->records[i], pFragment );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTable_Copy                                                            */
+/*!
+    Copy a process table
+
+    The ProcTable_Copy function copies the records in use, their
+    fragments and the name order index of a process table, eg to
+    prepare the next snapshot of a published table by loading into the
+    copy.
+
+    A destination fragment which already renders the same record, as
+    it does for the processes which have not changed since the
+    destination was last loaded, is kept, and only the used part of the
+    other fragments is copied.
+
+    @param[out]
+        pDest
+            pointer to the process table to copy into
+
+    @param[in]
+        pSrc
+            pointer to the process table to copy
+
+    @retval EOK the process table was copied
+    @retval ENOMEM cannot grow the table to copy into
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int ProcTable_Copy( ProcTable *pDest, const ProcTable *pSrc )
+{
+    int result = EINVAL;
+    ProcFragment *pFragment;
+    const ProcFragment *pSource;
+    size_t i;
+
+    if ( ( pDest != NULL ) && ( pSrc != NULL ) && ( pDest != pSrc ) )
+    {
+        result = ( pSrc->count <= pDest->capacity )
+                    ? EOK
+                    : Reserve( pDest, pSrc->count );
+    }
+
+    if ( result == EOK )
+    {
+        for ( i = 0; i < pSrc->count; i++ )
+        {
+            pFragment = &pDest->fragments[i];
+            pSource = &pSrc->fragments[i];
+            if ( ( pFragment->dirty == true ) ||
+                 ( pFragment->len == 0 ) ||
+                 ( pSource->dirty == true ) ||
+                 ( RecordChanged( &pDest->records[i],
+                                  &pSrc->records[i] ) == true ) )
+            {
+                memcpy( pFragment->json, pSource->json, pSource->len );
+                pFragment->len = pSource->len;
+                pFragment->sinceStart = pSource->sinceStart;
+                pFragment->sinceEnd = pSource->sinceEnd;
+                pFragment->dirty = pSource->dirty;
+            }
+        }
+
+        pDest->count = pSrc->count;
+        memcpy( pDest->records,
+                pSrc->records,
+                pSrc->count * sizeof( ProcRecord ) );
+        memcpy( pDest->order,
+                pSrc->order,
+                pSrc->count * sizeof( uint32_t ) );
+        memcpy( pDest->changed,
+                pSrc->changed,
+                pSrc->count * sizeof( bool ) );
+        pDest->reindexed = pSrc->reindexed;
+        pDest->loads = pSrc->loads;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTable_Find                                                            */
+/*!
+    Find a process by name
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        name
+            name of the process to find
+
+    @retval pointer to the process record
+    @retval NULL the process was not found
+
+==============================================================================*/
+const ProcRecord *ProcTable_Find( const ProcTable *pTable, const char *name )
+{
+    const ProcRecord *pRecord = NULL;
+    size_t i;
+
+    if ( ( pTable != NULL ) && ( name != NULL ) )
+    {
+        for ( i = 0; i < pTable->count; i++ )
+        {
+            if ( strcmp( pTable->records[i].name, name ) == 0 )
+            {
+                pRecord = &pTable->records[i];
+                break;
+            }
+        }
+    }
+
+    return pRecord;
+}
+
+/*============================================================================*/
+/*  ProcTable_EncodeRecord                                                    */
+/*!
+    Encode a process record
+
+    The ProcTable_EncodeRecord function encodes a process record as a map
+    of the schema fields, with integer pid, runcount and since (seconds)
+    values.  The instance is only encoded for a process listed by a
+    backend.  The caller may add further entries to the map.
+
+    @param[in]
+        pRecord
+            pointer to the process record
+
+    @param[in]
+        extra
+            number of key and value pairs the caller will encode after
+            the record fields
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @retval EOK the record was encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int ProcTable_EncodeRecord( const ProcRecord *pRecord,
+                            size_t extra,
+                            Encoder *pEncoder )
+{
+    int result = EINVAL;
+    const FieldInfo *pField;
+    size_t numFields = 0;
+    size_t i;
+
+    if ( ( pRecord != NULL ) && ( pEncoder != NULL ) )
+    {
+        for ( i = 0; i < PROCTABLE_NUM_FIELDS; i++ )
+        {
+            numFields += IsOmitted( pRecord, &fields[i] ) ? 0 : 1;
+        }
+
+        result = Encoder_Map( pEncoder, numFields + extra );
+
+        for ( i = 0; ( i < PROCTABLE_NUM_FIELDS ) && ( result == EOK ); i++ )
+        {
+            pField = &fields[i];
+            if ( IsOmitted( pRecord, pField ) )
+            {
+                continue;
+            }
+
+            Encoder_String( pEncoder, pField->key );
+
+            switch( pField->kind )
+            {
+                case FIELD_STRING:
+                case FIELD_TAG:
+                    result = Encoder_String( pEncoder,
+                                             (const char *)pRecord +
+                                                 pField->offset );
+                    break;
+
+                case FIELD_INT:
+                    result = Encoder_Int( pEncoder,
+                                          GetInteger( pRecord, pField ) );
+                    break;
+
+                case FIELD_FLAG:
+                    result = Encoder_Bool( pEncoder,
+                                           GetInteger( pRecord, pField ) != 0 );
+                    break;
+
+                default:
+                    result = Encoder_Uint( pEncoder,
+                                 (uint64_t)GetInteger( pRecord, pField ) );
+                    break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTable_Encode                                                          */
+/*!
+    Encode the process table
+
+    The ProcTable_Encode function encodes a range of the process table
+    as an array of process record maps.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        first
+            position of the first record to encode
+
+    @param[in]
+        count
+            maximum number of records to encode
+
+    @param[in]
+        sorted
+            true if first is a position in name order, false if it is
+            a position in procmon order
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @retval EOK the table was encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int ProcTable_Encode( const ProcTable *pTable,
+                      size_t first,
+                      size_t count,
+                      bool sorted,
+                      Encoder *pEncoder )
+{
+    int result = EINVAL;
+    size_t last;
+    size_t i;
+
+    if ( ( pTable != NULL ) && ( pEncoder != NULL ) )
+    {
+        first = ( first < pTable->count ) ? first : pTable->count;
+        last = ( count < pTable->count - first ) ? first + count
+                                                 : pTable->count;
+
+        result = Encoder_Array( pEncoder, last - first );
+
+        for ( i = first; ( i < last ) && ( result == EOK ); i++ )
+        {
+            result = ProcTable_EncodeRecord(
+                        &pTable->records[RecordIndex( pTable, i, sorted )],
+                        0,
+                        pEncoder );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTable_Gather                                                          */
+/*!
+    Output process records as JSON from their fragments
+
+    The ProcTable_Gather function outputs a range of records by
+    gathering their fragments, rendered when the table was loaded, their
+    since values and separators into calls to the output function.  The
+    records are output as a JSON array, or as newline delimited JSON
+    with one record per line.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        first
+            index of the first record to output
+
+    @param[in]
+        count
+            maximum number of records to output
+
+    @param[in]
+        sorted
+            true if first is a position in name order, false if it is
+            a position in procmon order
+
+    @param[in]
+        lines
+            true to output one record per line instead of an array
+
+    @param[in]
+        fn
+            output function to gather the records into
+
+    @param[in]
+        arg
+            output function argument
+
+    @retval EOK the records were output
+    @retval EBADMSG a record has no rendered fragment
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int ProcTable_Gather( const ProcTable *pTable,
+                      size_t first,
+                      size_t count,
+                      bool sorted,
+                      bool lines,
+                      OutputVFn fn,
+                      void *arg )
+{
+    int result = EINVAL;
+    struct iovec iov[PROCTABLE_GATHER_RECORDS * PROCTABLE_GATHER_IOV + 1];
+    DynamicText text[PROCTABLE_GATHER_RECORDS];
+    size_t sinceLen;
+    size_t computedLen;
+    const ProcFragment *pFragment;
+    const ProcRecord *pRecord;
+    size_t last;
+    size_t i;
+    int n = 0;
+    int batch = 0;
+
+    if ( ( pTable != NULL ) && ( fn != NULL ) )
+    {
+        result = EOK;
+        first = ( first < pTable->count ) ? first : pTable->count;
+        last = ( count < pTable->count - first ) ? first + count
+                                                 : pTable->count;
+
+        if ( lines == false )
+        {
+            iov[n].iov_base = "[";
+            iov[n++].iov_len = 1;
+        }
+
+        for ( i = first; ( i < last ) && ( result == EOK ); i++ )
+        {
+            pRecord = &pTable->records[RecordIndex( pTable, i, sorted )];
+            pFragment = &pTable->fragments[pRecord - pTable->records];
+            if ( ( pFragment->dirty == true ) || ( pFragment->len == 0 ) )
+            {
+                result = EBADMSG;
+                break;
+            }
+
+            sinceLen = Encoder_FormatUint( text[batch].since, pRecord->since );
+            computedLen = FormatComputed( pRecord, text[batch].computed );
+
+            iov[n].iov_base = (void *)pFragment->json;
+            iov[n++].iov_len = pFragment->sinceStart;
+            iov[n].iov_base = text[batch].since;
+            iov[n++].iov_len = sinceLen;
+            iov[n].iov_base = (void *)&pFragment->json[pFragment->sinceEnd];
+            iov[n++].iov_len = pFragment->len - pFragment->sinceEnd;
+            iov[n].iov_base = text[batch].computed;
+            iov[n++].iov_len = computedLen;
+
+            if ( lines == true )
+            {
+                iov[n].iov_base = "\n";
+                iov[n++].iov_len = 1;
+            }
+            else if ( i + 1 < last )
+            {
+                iov[n].iov_base = ", ";
+                iov[n++].iov_len = 2;
+            }
+
+            if ( ++batch == PROCTABLE_GATHER_RECORDS )
+            {
+                result = fn( arg, iov, n );
+                n = 0;
+                batch = 0;
+            }
+        }
+
+        if ( ( result == EOK ) && ( lines == false ) )
+        {
+            iov[n].iov_base = "]";
+            iov[n++].iov_len = 1;
+        }
+
+        if ( ( result == EOK ) && ( n > 0 ) )
+        {
+            result = fn( arg, iov, n );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTable_Seek                                                            */
+/*!
+    Find the start of a page of the process list
+
+    The ProcTable_Seek function gets the name order position of the first
+    process following the one named by a list cursor.  The position is
+    found by binary search, and does not depend on the record having
+    been present in, or at the same position of, the current table.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        cursor
+            list cursor returned with the previous page, or NULL for
+            the first page
+
+    @param[out]
+        pPosition
+            pointer to the location to store the name order position
+
+    @retval EOK the position was found
+    @retval EBADMSG the cursor is malformed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int ProcTable_Seek( const ProcTable *pTable,
+                    const char *cursor,
+                    size_t *pPosition )
+{
+    int result = EINVAL;
+    char name[PROCTABLE_NAME_LEN];
+    size_t len;
+    size_t lo = 0;
+    size_t hi;
+    size_t mid;
+    size_t i;
+    int hi4;
+    int lo4;
+
+    if ( ( pTable != NULL ) && ( pPosition != NULL ) )
+    {
+        result = EOK;
+        hi = pTable->count;
+
+        if ( cursor != NULL )
+        {
+            /* decode the hexadecimal process name */
+            len = strlen( cursor );
+            if ( ( len % 2 != 0 ) || ( len / 2 >= sizeof( name ) ) )
+            {
+                result = EBADMSG;
+            }
+
+            for ( i = 0; ( i < len / 2 ) && ( result == EOK ); i++ )
+            {
+                hi4 = HexValue( cursor[2 * i] );
+                lo4 = HexValue( cursor[2 * i + 1] );
+                if ( ( hi4 < 0 ) || ( lo4 < 0 ) )
+                {
+                    result = EBADMSG;
+                }
+
+                name[i] = (char)( ( hi4 << 4 ) | lo4 );
+            }
+
+            if ( result == EOK )
+            {
+                name[len / 2] = '\0';
+
+                /* find the first name which sorts after the cursor */
+                while ( lo < hi )
+                {
+                    mid = lo + ( hi - lo ) / 2;
+                    if ( strcmp( pTable->records[pTable->order[mid]].name,
+                                 name ) <= 0 )
+                    {
+                        lo = mid + 1;
+                    }
+                    else
+                    {
+                        hi = mid;
+                    }
+                }
+            }
+        }
+
+        *pPosition = lo;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTable_Cursor                                                          */
+/*!
+    Get the cursor of the next page of the process list
+
+    The ProcTable_Cursor function encodes the name of the last process
+    of a page as a list cursor.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        position
+            name order position following the last process of the page
+
+    @param[out]
+        buf
+            buffer to receive the NUL terminated cursor
+
+    @param[in]
+        len
+            size of the buffer, at least PROCTABLE_CURSOR_LEN
+
+    @retval EOK the cursor was encoded
+    @retval ENOENT there are no more processes after the page
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int ProcTable_Cursor( const ProcTable *pTable,
+                      size_t position,
+                      char *buf,
+                      size_t len )
+{
+    static const char hex[] = "0123456789abcdef";
+    int result = EINVAL;
+    const char *name;
+    size_t n = 0;
+
+    if ( ( pTable != NULL ) &&
+         ( buf != NULL ) &&
+         ( len >= PROCTABLE_CURSOR_LEN ) &&
+         ( position > 0 ) )
+    {
+        result = ENOENT;
+        if ( position < pTable->count )
+        {
+            name = pTable->records[pTable->order[position - 1]].name;
+            while ( *name != '\0' )
+            {
+                buf[n++] = hex[(unsigned char)*name >> 4];
+                buf[n++] = hex[(unsigned char)*name & 0x0f];
+                name++;
+            }
+
+            buf[n] = '\0';
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTable_Metrics                                                         */
+/*!
+    Output the process metrics
+
+    The ProcTable_Metrics function outputs each integer field of the
+    schema as a Prometheus gauge with one sample per process, labelled
+    with the process name.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        fn
+            output function
+
+    @param[in]
+        arg
+            output function argument
+
+    @retval EOK the metrics were output
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int ProcTable_Metrics( const ProcTable *pTable, OutputFn fn, void *arg )
+{
+    int result = EINVAL;
+    const FieldInfo *pField;
+    const ProcRecord *pRecord;
+    char buf[ENCODER_INT_LEN];
+    size_t i;
+    size_t j;
+
+    if ( ( pTable != NULL ) && ( fn != NULL ) )
+    {
+        result = EOK;
+
+        for ( i = 0; ( i < PROCTABLE_NUM_FIELDS ) && ( result == EOK ); i++ )
+        {
+            pField = &fields[i];
+            if ( IsString( pField ) )
+            {
+                continue;
+            }
+
+            fn( arg, "# HELP ", 7 );
+            fn( arg, pField->metric, strlen( pField->metric ) );
+            fn( arg, " ", 1 );
+            fn( arg, pField->help, strlen( pField->help ) );
+            fn( arg, "\n# TYPE ", 8 );
+            fn( arg, pField->metric, strlen( pField->metric ) );
+            result = fn( arg, " gauge\n", 7 );
+
+            for ( j = 0; ( j < pTable->count ) && ( result == EOK ); j++ )
+            {
+                pRecord = &pTable->records[j];
+
+                fn( arg, pField->metric, strlen( pField->metric ) );
+                fn( arg, "{name=\"", 7 );
+                PutMetricName( pRecord->name, fn, arg );
+                fn( arg, "\"} ", 3 );
+                fn( arg,
+                    buf,
+                    ( pField->kind == FIELD_INT )
+                        ? Encoder_FormatInt( buf,
+                                             GetInteger( pRecord, pField ) )
+                        : Encoder_FormatUint( buf,
+                                    (uint64_t)GetInteger( pRecord, pField ) ) );
+                result = fn( arg, "\n", 1 );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  FindField                                                                 */
+/*!
+    Find a schema field by name
+
+    @param[in]
+        key
+            name of the field
+
+    @retval pointer to the field description
+    @retval NULL the field is not in the schema
+
+==============================================================================*/
+static const FieldInfo *FindField( const char *key )
+{
+    const FieldInfo *pField = NULL;
+    size_t i;
+
+    for ( i = 0; i < PROCTABLE_NUM_FIELDS; i++ )
+    {
+        if ( strcmp( fields[i].key, key ) == 0 )
+        {
+            pField = &fields[i];
+            break;
+        }
+    }
+
+    return pField;
+}
+
+/*============================================================================*/
+/*  SetInteger                                                                */
+/*!
+    Store an integer field of a process record
+
+    @param[in]
+        pRecord
+            pointer to the process record
+
+    @param[in]
+        pField
+            pointer to the description of an integer field
+
+    @param[in]
+        value
+            value to store, truncated to the size of the field
+
+==============================================================================*/
+static void SetInteger( ProcRecord *pRecord,
+                        const FieldInfo *pField,
+                        int64_t value )
+{
+    char *p = (char *)pRecord + pField->offset;
+    uint32_t u32;
+    uint64_t u64;
+
+    if ( pField->kind == FIELD_FLAG )
+    {
+        *(bool *)p = ( value != 0 );
+    }
+    else if ( pField->size == sizeof( uint32_t ) )
+    {
+        u32 = (uint32_t)value;
+        memcpy( p, &u32, sizeof( u32 ) );
+    }
+    else if ( pField->size == sizeof( uint64_t ) )
+    {
+        u64 = (uint64_t)value;
+        memcpy( p, &u64, sizeof( u64 ) );
+    }
+}
+
+/*============================================================================*/
+/*  GetInteger                                                                */
+/*!
+    Get an integer field of a process record
+
+    Signed fields are sign extended, unsigned fields are zero extended.
+
+    @param[in]
+        pRecord
+            pointer to the process record
+
+    @param[in]
+        pField
+            pointer to the description of an integer field
+
+    @retval the field value
+
+==============================================================================*/
+static int64_t GetInteger( const ProcRecord *pRecord,
+                           const FieldInfo *pField )
+{
+    const char *p = (const char *)pRecord + pField->offset;
+    int64_t value = 0;
+    uint32_t u32;
+    uint64_t u64;
+
+    if ( pField->kind == FIELD_FLAG )
+    {
+        value = *(const bool *)p ? 1 : 0;
+    }
+    else if ( pField->size == sizeof( uint32_t ) )
+    {
+        memcpy( &u32, p, sizeof( u32 ) );
+        value = ( pField->kind == FIELD_INT ) ? (int64_t)(int32_t)u32
+                                              : (int64_t)u32;
+    }
+    else if ( pField->size == sizeof( uint64_t ) )
+    {
+        memcpy( &u64, p, sizeof( u64 ) );
+        value = (int64_t)u64;
+    }
+
+    return value;
+}
+
+/*============================================================================*/
+/*  PutMetricName                                                             */
+/*!
+    Output a process name as a metric label value
+
+    The PutMetricName function escapes backslash, double quote and
+    newline as required by the Prometheus text format.
+
+    @param[in]
+        name
+            NUL terminated process name
+
+    @param[in]
+        fn
+            output function
+
+    @param[in]
+        arg
+            output function argument
+
+    @retval EOK the name was output
+    @retval other output error
+
+==============================================================================*/
+static int PutMetricName( const char *name, OutputFn fn, void *arg )
+{
+    int result = EOK;
+    size_t n;
+
+    while ( ( *name != '\0' ) && ( result == EOK ) )
+    {
+        n = strcspn( name, "\\\"\n" );
+        if ( n > 0 )
+        {
+            result = fn( arg, name, n );
+            name += n;
+        }
+        else
+        {
+            result = fn( arg,
+                         ( *name == '\n' ) ? "\\n"
+                         : ( *name == '"' ) ? "\\\"" : "\\\\",
+                         2 );
+            name++;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SortNames                                                                 */
+/*!
+    Rebuild the name order index
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+==============================================================================*/
+static void SortNames( ProcTable *pTable )
+{
+    size_t i;
+
+    for ( i = 0; i < pTable->count; i++ )
+    {
+        pTable->order[i] = (uint32_t)i;
+    }
+
+    qsort_r( pTable->order,
+             pTable->count,
+             sizeof( pTable->order[0] ),
+             CompareNames,
+             pTable );
+}
+
+/*============================================================================*/
+/*  CompareNames                                                              */
+/*!
+    Compare the names of two process records
+
+    The CompareNames function is the qsort_r comparison function used
+    to build the name order index.
+
+    @param[in]
+        a
+            pointer to the first record index
+
+    @param[in]
+        b
+            pointer to the second record index
+
+    @param[in]
+        arg
+            pointer to the process table
+
+    @retval the strcmp ordering of the process names
+
+==============================================================================*/
+static int CompareNames( const void *a, const void *b, void *arg )
+{
+    const ProcTable *pTable = (const ProcTable *)arg;
+
+    return strcmp( pTable->records[*(const uint32_t *)a].name,
+                   pTable->records[*(const uint32_t *)b].name );
+}
+
+/*============================================================================*/
+/*  RecordIndex                                                               */
+/*!
+    Get the index of the record at a list position
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        position
+            position in the list
+
+    @param[in]
+        sorted
+            true for a position in name order, false for procmon order
+
+    @retval the index of the record in the table
+
+==============================================================================*/
+static size_t RecordIndex( const ProcTable *pTable,
+                           size_t position,
+                           bool sorted )
+{
+    return ( sorted == true ) ? pTable->order[position] : position;
+}
+
+/*============================================================================*/
+/*  HexValue                                                                  */
+/*!
+    Get the value of a hexadecimal digit
+
+    @param[in]
+        c
+            the digit
+
+    @retval the value of the digit
+    @retval -1 the character is not a hexadecimal digit
+
+==============================================================================*/
+static int HexValue( char c )
+{
+    int value = -1;
+
+    if ( ( c >= '0' ) && ( c <= '9' ) )
+    {
+        value = c - '0';
+    }
+    else if ( ( c >= 'a' ) && ( c <= 'f' ) )
+    {
+        value = c - 'a' + 10;
+    }
+    else if ( ( c >= 'A' ) && ( c <= 'F' ) )
+    {
+        value = c - 'A' + 10;
+    }
+
+    return value;
+}
+
+/*============================================================================*/
+/*  RecordChanged                                                             */
+/*!
+    Check if a process record has changed
+
+    The RecordChanged function compares the fields of a process record
+    which are held in its JSON fragment.  Duration fields are not
+    compared, as they are formatted on output, and neither are the
+    computed fields.
+
+    @param[in]
+        pOld
+            pointer to the previously loaded record
+
+    @param[in]
+        pNew
+            pointer to the newly parsed record
+
+    @retval true the record has changed
+    @retval false the record fragment can be reused
+
+==============================================================================*/
+static bool RecordChanged( const ProcRecord *pOld, const ProcRecord *pNew )
+{
+    bool changed = false;
+    const FieldInfo *pField;
+    size_t i;
+
+    for ( i = 0; ( i < PROCTABLE_NUM_FIELDS ) && ( changed == false ); i++ )
+    {
+        pField = &fields[i];
+        if ( IsString( pField ) )
+        {
+            changed = strcmp( (const char *)pOld + pField->offset,
+                              (const char *)pNew + pField->offset ) != 0;
+        }
+        else if ( ( pField->kind != FIELD_DURATION ) &&
+                  ( PROCTABLE_COMPUTED( pField ) == false ) )
+        {
+            changed = GetInteger( pOld, pField ) !=
+                      GetInteger( pNew, pField );
+        }
+    }
+
+    return changed;
+}
+
+/*============================================================================*/
+/*  Reserve                                                                   */
+/*!
+    Grow a process table to hold the specified number of records
+
+    The Reserve function at least doubles the capacity of the table, so
+    a table loaded from a growing process list is only reallocated a few
+    times.  The added records and fragments are empty.  The table is
+    unchanged if it cannot be grown.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        count
+            number of records the table must hold
+
+    @retval EOK the table can hold the records
+    @retval ENOMEM cannot allocate the larger table
+
+==============================================================================*/
+static int Reserve( ProcTable *pTable, size_t count )
+{
+    int result = EOK;
+    size_t capacity = ( pTable->capacity > 0 ) ? 2 * pTable->capacity
+                                               : PROCTABLE_INITIAL_RECORDS;
+
+    while ( capacity < count )
+    {
+        capacity *= 2;
+    }
+
+    if ( ( Grow( (void **)&pTable->records,
+                 pTable->capacity,
+                 capacity,
+                 sizeof( ProcRecord ) ) != EOK ) ||
+         ( Grow( (void **)&pTable->fragments,
+                 pTable->capacity,
+                 capacity,
+                 sizeof( ProcFragment ) ) != EOK ) ||
+         ( Grow( (void **)&pTable->order,
+                 pTable->capacity,
+                 capacity,
+                 sizeof( uint32_t ) ) != EOK ) ||
+         ( Grow( (void **)&pTable->changed,
+                 pTable->capacity,
+                 capacity,
+                 sizeof( bool ) ) != EOK ) )
+    {
+        result = ENOMEM;
+    }
+    else
+    {
+        pTable->capacity = capacity;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Grow                                                                      */
+/*!
+    Grow an array of a process table
+
+    @param[in,out]
+        pArray
+            pointer to the array to reallocate
+
+    @param[in]
+        oldCount
+            number of elements in the array
+
+    @param[in]
+        newCount
+            number of elements to grow the array to.  The added elements
+            are zeroed.
+
+    @param[in]
+        size
+            size of an element
+
+    @retval EOK the array was grown
+    @retval ENOMEM cannot allocate the larger array
+
+==============================================================================*/
+static int Grow( void **pArray, size_t oldCount, size_t newCount, size_t size )
+{
+    int result = ENOMEM;
+    char *p;
+
+    p = realloc( *pArray, newCount * size );
+    if ( p != NULL )
+    {
+        memset( &p[oldCount * size], 0, ( newCount - oldCount ) * size );
+        *pArray = p;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RenderFragment                                                            */
+/*!
+    Render the JSON fragment of a process record
+
+    The RenderFragment function outputs the procmon fields of a process
+    record as an unterminated JSON object using the pre-escaped keys of
+    the schema.  Integers are formatted directly, and the duration value
+    is output as a zero placeholder whose position is recorded so that
+    the actual value can be substituted on output.
+
+    @param[in]
+        pRecord
+            pointer to the process record
+
+    @param[out]
+        pFragment
+            pointer to the fragment to render
+
+    @retval EOK the fragment was rendered
+    @retval E2BIG the fragment does not fit in its buffer
+
+==============================================================================*/
+static int RenderFragment( const ProcRecord *pRecord,
+                           ProcFragment *pFragment )
+{
+    int result;
+    Encoder encoder;
+    const FieldInfo *pField;
+    char buf[ENCODER_INT_LEN];
+    size_t i;
+
+    pFragment->len = 0;
+
+    /* strings are escaped by an encoder with no enclosing container */
+    Encoder_Init( &encoder, ENCODER_JSON, FragmentWrite, pFragment );
+
+    result = FragmentWrite( pFragment, "{", 1 );
+
+    for ( i = 0; ( i < PROCTABLE_NUM_FIELDS ) && ( result == EOK ); i++ )
+    {
+        pField = &fields[i];
+        if ( PROCTABLE_COMPUTED( pField ) )
+        {
+            /* the computed fields are appended on output */
+            break;
+        }
+
+        if ( IsOmitted( pRecord, pField ) )
+        {
+            continue;
+        }
+
+        if ( pFragment->len > 1 )
+        {
+            result = FragmentWrite( pFragment, ", ", 2 );
+        }
+
+        if ( result == EOK )
+        {
+            result = FragmentWrite( pFragment,
+                                    pField->jsonKey,
+                                    pField->jsonKeyLen );
+        }
+
+        if ( result != EOK )
+        {
+            break;
+        }
+
+        switch( pField->kind )
+        {
+            case FIELD_STRING:
+            case FIELD_TAG:
+                result = Encoder_String( &encoder,
+                                         (const char *)pRecord +
+                                             pField->offset );
+                break;
+
+            case FIELD_INT:
+                result = FragmentWrite(
+                            pFragment,
+                            buf,
+                            Encoder_FormatInt(
+                                buf,
+                                GetInteger( pRecord, pField ) ) );
+                break;
+
+            case FIELD_UINT:
+                result = FragmentWrite(
+                            pFragment,
+                            buf,
+                            Encoder_FormatUint(
+                                buf,
+                                (uint64_t)GetInteger( pRecord, pField ) ) );
+                break;
+
+            default:
+                pFragment->sinceStart = pFragment->len;
+                result = FragmentWrite( pFragment, "0", 1 );
+                pFragment->sinceEnd = pFragment->len;
+                break;
+        }
+    }
+
+    pFragment->dirty = ( result != EOK );
+    if ( result != EOK )
+    {
+        pFragment->len = 0;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FormatComputed                                                            */
+/*!
+    Format the computed fields of a record as JSON
+
+    The FormatComputed function formats the computed fields of a record,
+    which follow the fragment, and the closing brace of the JSON object.
+
+    @param[in]
+        pRecord
+            pointer to the process record
+
+    @param[out]
+        buf
+            buffer of PROCTABLE_COMPUTED_LEN bytes to receive the text
+
+    @retval the length of the text
+
+==============================================================================*/
+static size_t FormatComputed( const ProcRecord *pRecord, char *buf )
+{
+    const FieldInfo *pField;
+    size_t len = 0;
+    size_t i;
+
+    for ( i = 0; i < PROCTABLE_NUM_FIELDS; i++ )
+    {
+        pField = &fields[i];
+        if ( PROCTABLE_COMPUTED( pField ) == false )
+        {
+            continue;
+        }
+
+        memcpy( &buf[len], ", ", 2 );
+        len += 2;
+        memcpy( &buf[len], pField->jsonKey, pField->jsonKeyLen );
+        len += pField->jsonKeyLen;
+
+        if ( pField->kind == FIELD_FLAG )
+        {
+            if ( GetInteger( pRecord, pField ) != 0 )
+            {
+                memcpy( &buf[len], "true", 4 );
+                len += 4;
+            }
+            else
+            {
+                memcpy( &buf[len], "false", 5 );
+                len += 5;
+            }
+        }
+        else
+        {
+            len += Encoder_FormatUint( &buf[len],
+                                (uint64_t)GetInteger( pRecord, pField ) );
+        }
+    }
+
+    buf[len++] = '}';
+
+    return len;
+}
+
+/*============================================================================*/
+/*  FragmentWrite                                                             */
+/*!
+    Append rendered JSON to a fragment
+
+    The FragmentWrite function is the OutputFn used to render a record
+    fragment.
+
+    @param[in]
+        arg
+            pointer to the ProcFragment being rendered
+
+    @param[in]
+        buf
+            pointer to the JSON text to append
+
+    @param[in]
+        len
+            length of the JSON text
+
+    @retval EOK the text was appended
+    @retval E2BIG the text does not fit in the fragment
+
+==============================================================================*/
+static int FragmentWrite( void *arg, const char *buf, size_t len )
+{
+    ProcFragment *pFragment = (ProcFragment *)arg;
+    int result = E2BIG;
+
+    if ( len <= sizeof( pFragment->json ) - pFragment->len )
+    {
+        memcpy( &pFragment->json[pFragment->len], buf, len );
+        pFragment->len += len;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  IsString                                                                  */
+/*!
+    Check if a field holds a string
+
+    @param[in]
+        pField
+            pointer to the field description
+
+    @retval true the field is a string or tag
+    @retval false the field is a number
+
+==============================================================================*/
+static bool IsString( const FieldInfo *pField )
+{
+    return ( pField->kind == FIELD_STRING ) || ( pField->kind == FIELD_TAG );
+}
+
+/*============================================================================*/
+/*  IsOmitted                                                                 */
+/*!
+    Check if a field is left out of an output record
+
+    The IsOmitted function checks for an empty tag, such as the instance
+    of a process when fcgi_proc has no backends, so a record has the
+    same fields as the procmon record it was loaded from.
+
+    @param[in]
+        pRecord
+            pointer to the process record
+
+    @param[in]
+        pField
+            pointer to the field description
+
+    @retval true the field is not output
+    @retval false the field is output
+
+==============================================================================*/
+static bool IsOmitted( const ProcRecord *pRecord, const FieldInfo *pField )
+{
+    return ( pField->kind == FIELD_TAG ) &&
+           ( *( (const char *)pRecord + pField->offset ) == '\0' );
+}
+
+/*============================================================================*/
+/*  SkipSpace                                                                 */
+/*!
+    Skip JSON whitespace
+
+    @param[in]
+        pParser
+            pointer to the parser state
+
+==============================================================================*/
+static void SkipSpace( Parser *pParser )
+{
+    while ( ( pParser->p < pParser->end ) &&
+            ( isspace( (unsigned char)*pParser->p ) ) )
+    {
+        pParser->p++;
+    }
+}
+
+/*============================================================================*/
+/*  Expect                                                                    */
+/*!
+    Consume an expected character
+
+    The Expect function skips whitespace and consumes the next character
+    if it is the expected one.
+
+    @param[in]
+        pParser
+            pointer to the parser state
+
+    @param[in]
+        c
+            the expected character
+
+    @retval true the character was consumed
+    @retval false the next character is not the expected one
+
+==============================================================================*/
+static bool Expect( Parser *pParser, char c )
+{
+    bool found = false;
+
+    SkipSpace( pParser );
+    if ( ( pParser->p < pParser->end ) && ( *pParser->p == c ) )
+    {
+        pParser->p++;
+        found = true;
+    }
+
+    return found;
+}
+
+/*============================================================================*/
+/*  ParseObject                                                               */
+/*!
+    Parse a process object
+
+    The ParseObject function populates the fields of a process record
+    which are named in the record schema, and skips any other fields.
+
+    @param[in]
+        pParser
+            pointer to the parser state
+
+    @param[out]
+        pRecord
+            pointer to the process record to populate
+
+    @retval EOK the object was parsed
+    @retval EBADMSG the object could not be parsed
+
+==============================================================================*/
+static int ParseObject( Parser *pParser, ProcRecord *pRecord )
+{
+    int result = EBADMSG;
+    char key[16];
+    char value[32];
+    const FieldInfo *pField;
+
+    memset( pRecord, 0, sizeof( ProcRecord ) );
+
+    if ( Expect( pParser, '{' ) )
+    {
+        result = EOK;
+
+        if ( Expect( pParser, '}' ) == false )
+        {
+            do
+            {
+                result = ParseString( pParser, key, sizeof( key ) );
+                if ( ( result == EOK ) && ( Expect( pParser, ':' ) == false ) )
+                {
+                    result = EBADMSG;
+                }
+
+                if ( result != EOK )
+                {
+                    break;
+                }
+
+                pField = FindField( key );
+                if ( ( pField == NULL ) || ( PROCTABLE_COMPUTED( pField ) ) )
+                {
+                    result = SkipValue( pParser );
+                }
+                else if ( IsString( pField ) )
+                {
+                    result = ParseString( pParser,
+                                          (char *)pRecord + pField->offset,
+                                          pField->size );
+                }
+                else if ( pField->kind == FIELD_DURATION )
+                {
+                    result = ParseString( pParser, value, sizeof( value ) );
+                    SetInteger( pRecord, pField, ParseDuration( value ) );
+                }
+                else
+                {
+                    SetInteger( pRecord, pField, ParseInteger( pParser ) );
+                }
+            } while ( ( result == EOK ) && ( Expect( pParser, ',' ) ) );
+
+            if ( ( result == EOK ) && ( Expect( pParser, '}' ) == false ) )
+            {
+                result = EBADMSG;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ParseString                                                               */
+/*!
+    Parse a JSON string
+
+    The ParseString function parses a JSON string into a NUL terminated
+    buffer, truncating it if it does not fit.  Escaped characters are
+    unescaped, except for \\u escapes which are kept as they are.
+
+    @param[in]
+        pParser
+            pointer to the parser state
+
+    @param[out]
+        buf
+            buffer to receive the string
+
+    @param[in]
+        len
+            size of the buffer
+
+    @retval EOK the string was parsed
+    @retval EBADMSG the string could not be parsed
+
+==============================================================================*/
+static int ParseString( Parser *pParser, char *buf, size_t len )
+{
+    int result = EBADMSG;
+    size_t n = 0;
+    char c;
+
+    if ( Expect( pParser, '"' ) )
+    {
+        while ( pParser->p < pParser->end )
+        {
+            c = *pParser->p++;
+            if ( c == '"' )
+            {
+                result = EOK;
+                break;
+            }
+
+            if ( ( c == '\\' ) && ( pParser->p < pParser->end ) )
+            {
+                c = *pParser->p++;
+                switch( c )
+                {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'r': c = '\r'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'u':
+                        /* keep the escape sequence */
+                        if ( n + 1 < len )
+                        {
+                            buf[n++] = '\\';
+                        }
+                        break;
+                    default: break;
+                }
+            }
+
+            if ( n + 1 < len )
+            {
+                buf[n++] = c;
+            }
+        }
+    }
+
+    if ( len > 0 )
+    {
+        buf[n] = '\0';
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SkipValue                                                                 */
+/*!
+    Skip a JSON value of an unknown field
+
+    The SkipValue function skips a string, number or literal value,
+    or a nested object or array.
+
+    @param[in]
+        pParser
+            pointer to the parser state
+
+    @retval EOK the value was skipped
+    @retval EBADMSG the value could not be parsed
+
+==============================================================================*/
+static int SkipValue( Parser *pParser )
+{
+    int result = EOK;
+    int depth = 0;
+    char c;
+
+    SkipSpace( pParser );
+
+    do
+    {
+        if ( pParser->p >= pParser->end )
+        {
+            result = EBADMSG;
+            break;
+        }
+
+        c = *pParser->p;
+        if ( c == '"' )
+        {
+            result = ParseString( pParser, NULL, 0 );
+            continue;
+        }
+
+        if ( ( c == '{' ) || ( c == '[' ) )
+        {
+            depth++;
+        }
+        else if ( ( c == '}' ) || ( c == ']' ) )
+        {
+            if ( depth == 0 )
+            {
+                /* end of the enclosing object */
+                break;
+            }
+
+            depth--;
+        }
+        else if ( ( c == ',' ) && ( depth == 0 ) )
+        {
+            break;
+        }
+
+        pParser->p++;
+
+    } while ( ( result == EOK ) && ( ( depth > 0 ) || ( c != '}' ) ) );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ParseInteger                                                              */
+/*!
+    Parse a JSON integer
+
+    The ParseInteger function parses a JSON number or a quoted number,
+    and skips any fractional part.
+
+    @param[in]
+        pParser
+            pointer to the parser state
+
+    @retval the parsed integer, or 0 if the value is not a number
+
+==============================================================================*/
+static int64_t ParseInteger( Parser *pParser )
+{
+    int64_t value = 0;
+    bool negative = false;
+    bool quoted;
+
+    SkipSpace( pParser );
+
+    quoted = Expect( pParser, '"' );
+
+    if ( ( pParser->p < pParser->end ) && ( *pParser->p == '-' ) )
+    {
+        negative = true;
+        pParser->p++;
+    }
+
+    while ( ( pParser->p < pParser->end ) &&
+            ( isdigit( (unsigned char)*pParser->p ) ) )
+    {
+        value = value * 10 + ( *pParser->p++ - '0' );
+    }
+
+    /* skip anything else up to the end of the value */
+    while ( ( pParser->p < pParser->end ) &&
+            ( quoted ? ( *pParser->p != '"' )
+                     : ( strchr( ",}] \t\r\n", *pParser->p ) == NULL ) ) )
+    {
+        pParser->p++;
+    }
+
+    if ( ( quoted == true ) && ( pParser->p < pParser->end ) )
+    {
+        pParser->p++;
+    }
+
+    return negative ? -value : value;
+}
+
+/*============================================================================*/
+/*  ParseDuration                                                             */
+/*!
+    Convert a procmon duration to seconds
+
+    The ParseDuration function converts a duration made of numbers
+    followed by d, h, m or s units (eg "2d03h", "12m01s") to seconds.
+    A number without a unit is taken as seconds.
+
+    @param[in]
+        duration
+            pointer to the NUL terminated duration
+
+    @retval the duration in seconds
+
+==============================================================================*/
+static uint64_t ParseDuration( const char *duration )
+{
+    uint64_t seconds = 0;
+    uint64_t value = 0;
+    const char *p;
+
+    for ( p = duration; *p != '\0'; p++ )
+    {
+        if ( isdigit( (unsigned char)*p ) )
+        {
+            value = value * 10 + ( *p - '0' );
+        }
+        else
+        {
+            switch( *p )
+            {
+                case 'd': seconds += value * 86400; break;
+                case 'h': seconds += value * 3600; break;
+                case 'm': seconds += value * 60; break;
+                case 's': seconds += value; break;
+                default: break;
+            }
+
+            value = 0;
+        }
+    }
+
+    return seconds + value;
+}
+
+/*! @}
+ * end of proctable group */
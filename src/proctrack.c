@@ -0,0 +1,1279 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup proctrack proctrack
+ * @brief Incremental process table statistics
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file proctrack.c
+
+    Process Table Statistics
+
+    The proctrack module follows each process across process table
+    loads, keyed by name, and maintains the process counts by state,
+    the total number of restarts and the recent restart history as
+    running totals.  Each load only adjusts the totals for the records
+    which changed, so the summary is output without visiting the table.
+
+    A restart is recorded when the runcount of a process increases
+    between loads.  A process which is first seen running after more
+    than one start is taken to have restarted when it entered the
+    running state.  Recent restarts are counted in one minute buckets.
+
+    Each process also counts its restarts, the increases of its runcount
+    between loads, in a sliding window of one minute buckets.  A process
+    with at least PROCTRACK_FLAP_RESTARTS restarts in the window is
+    flapping.  Processes with restarts in their window are kept on an
+    active list, so that on each load their windows are advanced and
+    their flapping flag and restart rate are written to the process
+    table without visiting the other processes.
+
+    Start and restart actions are timestamped, and the time until the
+    process is next seen to enter the running state, or to restart
+    while running, is added to a start latency histogram for the
+    process.  Transitions are observed when the process table is
+    loaded, so the latency resolution depends on how often the table
+    is refreshed.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include "proctrack.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! minimum number of hash table slots for tracked processes */
+#define PROCTRACK_MIN_SLOTS ( 2 * PROCTABLE_INITIAL_RECORDS )
+
+/*! state index of processes counted as "other" */
+#define PROCTRACK_OTHER     ( -1 )
+
+/*! a tracked process */
+typedef struct _Track
+{
+    /*! process name, empty if the slot is unused */
+    char name[PROCTABLE_NAME_LEN];
+
+    /*! true if the process was found in the table during a full update */
+    bool carried;
+
+    /*! runcount at the most recent load */
+    uint32_t runcount;
+
+    /*! index of the process state, or PROCTRACK_OTHER */
+    int state;
+
+    /*! monotonic time in seconds of the most recent restart, or 0 */
+    uint64_t restartSec;
+
+    /*! index of the process in the process table */
+    size_t index;
+
+    /*! restarts in each minute of the flapping window */
+    uint16_t flapCounts[PROCTRACK_FLAP_MINUTES];
+
+    /*! most recent minute of the flapping window */
+    uint64_t flapMinute;
+
+    /*! number of restarts in the flapping window */
+    uint32_t flapTotal;
+
+    /*! true if the process is on the active list */
+    bool active;
+
+    /*! true if the process was running at the most recent load */
+    bool running;
+
+    /*! start latency histogram bucket counts */
+    uint32_t latency[PROCTRACK_LATENCY_BUCKETS];
+
+    /*! number of start latency samples */
+    uint32_t latencyCount;
+
+    /*! sum of the start latency samples in milliseconds */
+    uint64_t latencySumMs;
+
+} Track;
+
+/*! hash table of tracked processes */
+typedef struct _TrackSet
+{
+    /*! process slots */
+    Track *tracks;
+
+    /*! number of process slots */
+    size_t slots;
+
+} TrackSet;
+
+/*! a start or restart action awaiting a transition to running */
+typedef struct _Pending
+{
+    /*! process name */
+    char name[PROCTABLE_NAME_LEN];
+
+    /*! monotonic time in microseconds of the action */
+    uint64_t startUs;
+
+} Pending;
+
+/*! number of restarts in one minute */
+typedef struct _MinuteCount
+{
+    /*! minute the count applies to */
+    uint64_t minute;
+
+    /*! number of processes which last restarted in the minute */
+    uint32_t count;
+
+} MinuteCount;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void FullUpdate( const ProcTable *pTable, uint64_t nowUs );
+static void PartialUpdate( const ProcTable *pTable, uint64_t nowUs );
+static void AdvanceWindow( Track *pTrack, uint64_t minute );
+static void UpdateFlapping( ProcTable *pTable, uint64_t nowSec );
+static int SizeSet( TrackSet *pSet, size_t count );
+static Track *FindTrack( const TrackSet *pSet,
+                         const char *name,
+                         bool *pFound );
+static void Apply( Track *pTrack,
+                   const ProcRecord *pRecord,
+                   bool found,
+                   uint64_t nowUs );
+static bool TakePending( const char *name, uint64_t nowUs, uint64_t *pStartUs );
+static void AddLatency( Track *pTrack, uint64_t latencyMs );
+static void Contribute( const Track *pTrack, int sign );
+static int StateIndex( const char *state );
+static uint32_t RecentRestarts( unsigned int minutes, uint64_t nowSec );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! tracked process hash tables, one current and one rebuilt by a full
+    update */
+static TrackSet trackSets[2];
+
+/*! index of the current tracked process hash table */
+static int current = 0;
+
+/*! number of loads of the table when it was last tracked */
+static uint64_t trackedLoads = 0;
+
+/*! number of tracked processes */
+static uint32_t processes = 0;
+
+/*! names of the distinct process states */
+static char stateNames[PROCTRACK_MAX_STATES][PROCTABLE_STATE_LEN];
+
+/*! number of distinct process states */
+static int numStates = 0;
+
+/*! number of processes in each state */
+static uint32_t stateCounts[PROCTRACK_MAX_STATES];
+
+/*! number of processes in other states */
+static uint32_t otherCount = 0;
+
+/*! total number of restarts of the tracked processes */
+static uint64_t restarts = 0;
+
+/*! recent restarts per minute */
+static MinuteCount recent[PROCTRACK_WINDOW_MINUTES];
+
+/*! processes with restarts in their flapping window */
+static Track **active = NULL;
+
+/*! number of processes the active list can hold */
+static size_t activeSlots = 0;
+
+/*! number of processes on the active list */
+static size_t numActive = 0;
+
+/*! actions awaiting a transition to running */
+static Pending pending[PROCTRACK_MAX_PENDING];
+
+/*! number of actions awaiting a transition to running */
+static size_t numPending = 0;
+
+/*! upper bounds of the start latency histogram buckets in milliseconds */
+static const uint32_t latencyBounds[PROCTRACK_LATENCY_BUCKETS - 1] =
+{
+    10, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000
+};
+
+/*! upper bounds of the start latency histogram buckets as metric labels */
+static const char *latencyLabels[PROCTRACK_LATENCY_BUCKETS] =
+{
+    "0.01", "0.05", "0.1", "0.25", "0.5", "1", "2.5", "5", "10", "30", "60",
+    "+Inf"
+};
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  ProcTrack_Update                                                          */
+/*!
+    Update the statistics from a newly loaded process table
+
+    The ProcTrack_Update function adjusts the running totals for the
+    records which changed in the most recent load of the process table.
+    If processes were added, removed or renamed, or a load was missed,
+    the tracked processes are matched to the table by name and any
+    which are no longer present are removed from the totals.  The
+    flapping flag and restart rate of the active processes are then
+    written to the table.
+
+    @param[in]
+        pTable
+            pointer to the newly loaded process table
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+    @retval EOK the statistics were updated
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int ProcTrack_Update( ProcTable *pTable, uint64_t nowUs )
+{
+    int result = EINVAL;
+
+    if ( pTable != NULL )
+    {
+        if ( ( pTable->reindexed == true ) ||
+             ( pTable->loads != trackedLoads + 1 ) )
+        {
+            FullUpdate( pTable, nowUs );
+        }
+        else
+        {
+            PartialUpdate( pTable, nowUs );
+        }
+
+        UpdateFlapping( pTable, nowUs / 1000000ULL );
+        trackedLoads = pTable->loads;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTrack_EncodeSummary                                                   */
+/*!
+    Encode the process summary
+
+    The ProcTrack_EncodeSummary function encodes the number of processes,
+    the number of processes in each state, the total number of restarts
+    and the number of processes restarted in the last few minutes.
+
+    @param[in]
+        minutes
+            number of minutes of recent restarts to count, at most
+            PROCTRACK_WINDOW_MINUTES
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @retval EOK the summary was encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int ProcTrack_EncodeSummary( unsigned int minutes,
+                             uint64_t nowUs,
+                             Encoder *pEncoder )
+{
+    int result = EINVAL;
+    int i;
+
+    if ( ( pEncoder != NULL ) &&
+         ( minutes > 0 ) &&
+         ( minutes <= PROCTRACK_WINDOW_MINUTES ) )
+    {
+        Encoder_Map( pEncoder, 5 );
+        Encoder_String( pEncoder, "processes" );
+        Encoder_Uint( pEncoder, processes );
+
+        Encoder_String( pEncoder, "states" );
+        Encoder_Map( pEncoder, numStates + ( ( otherCount > 0 ) ? 1 : 0 ) );
+        for ( i = 0; i < numStates; i++ )
+        {
+            Encoder_String( pEncoder, stateNames[i] );
+            Encoder_Uint( pEncoder, stateCounts[i] );
+        }
+
+        if ( otherCount > 0 )
+        {
+            Encoder_String( pEncoder, "other" );
+            Encoder_Uint( pEncoder, otherCount );
+        }
+
+        Encoder_String( pEncoder, "restarts" );
+        Encoder_Uint( pEncoder, restarts );
+        Encoder_String( pEncoder, "minutes" );
+        Encoder_Uint( pEncoder, minutes );
+        Encoder_String( pEncoder, "restarted" );
+        result = Encoder_Uint( pEncoder,
+                               RecentRestarts( minutes,
+                                               nowUs / 1000000ULL ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTrack_EncodeFlapping                                                  */
+/*!
+    Encode the flapping processes
+
+    The ProcTrack_EncodeFlapping function encodes an array of the
+    records of the processes which are flapping.  Only the active list
+    is visited.
+
+    @param[in]
+        pTable
+            pointer to the process table last passed to ProcTrack_Update
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @retval EOK the processes were encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int ProcTrack_EncodeFlapping( const ProcTable *pTable, Encoder *pEncoder )
+{
+    int result = EINVAL;
+    size_t count = 0;
+    size_t i;
+
+    if ( ( pTable != NULL ) && ( pEncoder != NULL ) )
+    {
+        for ( i = 0; i < numActive; i++ )
+        {
+            if ( active[i]->flapTotal >= PROCTRACK_FLAP_RESTARTS )
+            {
+                count++;
+            }
+        }
+
+        result = Encoder_Array( pEncoder, count );
+
+        for ( i = 0; ( i < numActive ) && ( result == EOK ); i++ )
+        {
+            if ( active[i]->flapTotal >= PROCTRACK_FLAP_RESTARTS )
+            {
+                result = ProcTable_EncodeRecord(
+                            &pTable->records[active[i]->index],
+                            0,
+                            pEncoder );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTrack_Action                                                          */
+/*!
+    Timestamp a start or restart action
+
+    The ProcTrack_Action function records the time a process was asked
+    to start or restart, so that its start latency can be measured when
+    it is next seen to be running.  If too many actions are awaiting
+    a transition, the oldest is replaced.
+
+    @param[in]
+        name
+            name of the process
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+==============================================================================*/
+void ProcTrack_Action( const char *name, uint64_t nowUs )
+{
+    Pending *pPending = NULL;
+    size_t i;
+
+    if ( ( name != NULL ) && ( strlen( name ) < PROCTABLE_NAME_LEN ) )
+    {
+        for ( i = 0; i < numPending; i++ )
+        {
+            if ( strcmp( pending[i].name, name ) == 0 )
+            {
+                pPending = &pending[i];
+                break;
+            }
+
+            if ( ( pPending == NULL ) ||
+                 ( pending[i].startUs < pPending->startUs ) )
+            {
+                /* remember the oldest action */
+                pPending = &pending[i];
+            }
+        }
+
+        if ( ( i == numPending ) && ( numPending < PROCTRACK_MAX_PENDING ) )
+        {
+            pPending = &pending[numPending++];
+        }
+
+        strcpy( pPending->name, name );
+        pPending->startUs = nowUs;
+    }
+}
+
+/*============================================================================*/
+/*  ProcTrack_EncodeLatency                                                   */
+/*!
+    Encode the start latency histogram of a process
+
+    The ProcTrack_EncodeLatency function encodes a map of the number of
+    start latency samples, their sum in milliseconds, and a map from
+    each bucket upper bound in milliseconds to its count.
+
+    @param[in]
+        name
+            name of the process
+
+    @param[in]
+        pEncoder
+            pointer to the encoder
+
+    @retval EOK the histogram was encoded
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int ProcTrack_EncodeLatency( const char *name, Encoder *pEncoder )
+{
+    int result = EINVAL;
+    static const Track empty;
+    const Track *pTrack;
+    char key[ENCODER_INT_LEN];
+    bool found;
+    size_t i;
+
+    if ( ( name != NULL ) && ( pEncoder != NULL ) )
+    {
+        pTrack = FindTrack( &trackSets[current], name, &found );
+        if ( found == false )
+        {
+            pTrack = &empty;
+        }
+
+        Encoder_Map( pEncoder, 3 );
+        Encoder_String( pEncoder, "count" );
+        Encoder_Uint( pEncoder, pTrack->latencyCount );
+        Encoder_String( pEncoder, "sumMs" );
+        Encoder_Uint( pEncoder, pTrack->latencySumMs );
+        Encoder_String( pEncoder, "buckets" );
+        result = Encoder_Map( pEncoder, PROCTRACK_LATENCY_BUCKETS );
+
+        for ( i = 0; i < PROCTRACK_LATENCY_BUCKETS; i++ )
+        {
+            if ( i < PROCTRACK_LATENCY_BUCKETS - 1 )
+            {
+                Encoder_FormatUint( key, latencyBounds[i] );
+                Encoder_String( pEncoder, key );
+            }
+            else
+            {
+                Encoder_String( pEncoder, "+Inf" );
+            }
+
+            result = Encoder_Uint( pEncoder, pTrack->latency[i] );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ProcTrack_Metrics                                                         */
+/*!
+    Output the start latency metrics
+
+    The ProcTrack_Metrics function outputs the start latency histogram
+    of each process with at least one sample, in the Prometheus text
+    format.
+
+    @param[in]
+        fn
+            output function
+
+    @param[in]
+        arg
+            output function argument
+
+    @retval EOK the metrics were output
+    @retval EINVAL invalid arguments
+    @retval other output error
+
+==============================================================================*/
+int ProcTrack_Metrics( OutputFn fn, void *arg )
+{
+    static const char header[] =
+        "# HELP fcgi_proc_process_start_seconds Time from a start or "
+        "restart action until the process was seen running\n"
+        "# TYPE fcgi_proc_process_start_seconds histogram\n";
+    int result = EINVAL;
+    char buf[256];
+    const Track *pTrack;
+    uint32_t cumulative;
+    size_t i;
+    size_t j;
+    int n;
+
+    if ( fn != NULL )
+    {
+        result = fn( arg, header, sizeof( header ) - 1 );
+
+        for ( i = 0;
+              ( i < trackSets[current].slots ) && ( result == EOK );
+              i++ )
+        {
+            pTrack = &trackSets[current].tracks[i];
+            if ( ( pTrack->name[0] == '\0' ) || ( pTrack->latencyCount == 0 ) )
+            {
+                continue;
+            }
+
+            cumulative = 0;
+            for ( j = 0;
+                  ( j < PROCTRACK_LATENCY_BUCKETS ) && ( result == EOK );
+                  j++ )
+            {
+                cumulative += pTrack->latency[j];
+                n = snprintf( buf,
+                              sizeof( buf ),
+                              "fcgi_proc_process_start_seconds_bucket"
+                              "{name=\"%s\",le=\"%s\"} %u\n",
+                              pTrack->name,
+                              latencyLabels[j],
+                              cumulative );
+                result = fn( arg, buf, n );
+            }
+
+            if ( result == EOK )
+            {
+                n = snprintf( buf,
+                              sizeof( buf ),
+                              "fcgi_proc_process_start_seconds_sum"
+                              "{name=\"%s\"} %llu.%03llu\n"
+                              "fcgi_proc_process_start_seconds_count"
+                              "{name=\"%s\"} %u\n",
+                              pTrack->name,
+                              (unsigned long long)pTrack->latencySumMs / 1000,
+                              (unsigned long long)pTrack->latencySumMs % 1000,
+                              pTrack->name,
+                              pTrack->latencyCount );
+                result = fn( arg, buf, n );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  FullUpdate                                                                */
+/*!
+    Match all tracked processes to the process table
+
+    The FullUpdate function rebuilds the tracked process hash table from
+    the process table, carrying over the history of processes which
+    were already tracked, and removes processes which are no longer in
+    the table from the totals.  The rebuilt hash table is grown to twice
+    the number of processes.  If it cannot be grown, the processes which
+    do not fit are not tracked.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+==============================================================================*/
+static void FullUpdate( const ProcTable *pTable, uint64_t nowUs )
+{
+    TrackSet *pOldSet = &trackSets[current];
+    TrackSet *pNewSet = &trackSets[1 - current];
+    const ProcRecord *pRecord;
+    Track *pOld;
+    Track *pNew;
+    bool found;
+    size_t i;
+
+    if ( SizeSet( pNewSet, pTable->count ) != EOK )
+    {
+        syslog( LOG_ERR, "cannot track %zu processes", pTable->count );
+    }
+
+    numActive = 0;
+
+    for ( i = 0; i < pTable->count; i++ )
+    {
+        pRecord = &pTable->records[i];
+        pNew = FindTrack( pNewSet, pRecord->name, &found );
+        if ( ( pNew == NULL ) || ( found == true ) )
+        {
+            /* ignore unnamed and duplicate processes */
+            continue;
+        }
+
+        pOld = FindTrack( pOldSet, pRecord->name, &found );
+        if ( found == true )
+        {
+            *pNew = *pOld;
+            pOld->carried = true;
+        }
+
+        pNew->active = false;
+        pNew->index = i;
+        Apply( pNew, pRecord, found, nowUs );
+    }
+
+    /* remove the processes which have gone from the totals */
+    for ( i = 0; i < pOldSet->slots; i++ )
+    {
+        pOld = &pOldSet->tracks[i];
+        if ( ( pOld->name[0] != '\0' ) && ( pOld->carried == false ) )
+        {
+            Contribute( pOld, -1 );
+        }
+    }
+
+    current = 1 - current;
+}
+
+/*============================================================================*/
+/*  PartialUpdate                                                             */
+/*!
+    Update the tracked processes which changed
+
+    The PartialUpdate function updates the tracked processes for the
+    records which changed in the most recent load, when the set of
+    process names is unchanged.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+==============================================================================*/
+static void PartialUpdate( const ProcTable *pTable, uint64_t nowUs )
+{
+    const ProcRecord *pRecord;
+    Track *pTrack;
+    bool found;
+    size_t i;
+
+    for ( i = 0; i < pTable->count; i++ )
+    {
+        if ( pTable->changed[i] == true )
+        {
+            pRecord = &pTable->records[i];
+            pTrack = FindTrack( &trackSets[current], pRecord->name, &found );
+            if ( pTrack != NULL )
+            {
+                pTrack->index = i;
+                Apply( pTrack, pRecord, found, nowUs );
+            }
+        }
+    }
+}
+
+/*============================================================================*/
+/*  SizeSet                                                                   */
+/*!
+    Empty a tracked process hash table and size it for a process count
+
+    The SizeSet function clears the hash table, and reallocates it if it
+    has fewer than twice as many slots as processes.  The active list is
+    grown with it, as it may hold every process of the table.  The table
+    keeps its previous size if it cannot be grown.
+
+    @param[in]
+        pSet
+            pointer to the hash table
+
+    @param[in]
+        count
+            number of processes to track
+
+    @retval EOK the hash table can hold the processes
+    @retval ENOMEM cannot allocate the larger hash table
+
+==============================================================================*/
+static int SizeSet( TrackSet *pSet, size_t count )
+{
+    int result = EOK;
+    size_t slots = PROCTRACK_MIN_SLOTS;
+    Track *tracks;
+    Track **list;
+
+    while ( slots < 2 * count )
+    {
+        slots *= 2;
+    }
+
+    if ( pSet->slots < slots )
+    {
+        tracks = calloc( slots, sizeof( Track ) );
+        list = ( activeSlots < slots )
+                    ? realloc( active, slots * sizeof( Track * ) )
+                    : active;
+        if ( list != NULL )
+        {
+            active = list;
+            activeSlots = ( activeSlots < slots ) ? slots : activeSlots;
+        }
+
+        if ( ( tracks != NULL ) && ( list != NULL ) )
+        {
+            free( pSet->tracks );
+            pSet->tracks = tracks;
+            pSet->slots = slots;
+        }
+        else
+        {
+            free( tracks );
+            result = ENOMEM;
+        }
+    }
+
+    if ( pSet->slots > 0 )
+    {
+        memset( pSet->tracks, 0, pSet->slots * sizeof( Track ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FindTrack                                                                 */
+/*!
+    Find the hash table slot of a process
+
+    The FindTrack function uses linear probing from the FNV-1a hash of
+    the process name.
+
+    @param[in]
+        pSet
+            pointer to the tracked process hash table
+
+    @param[in]
+        name
+            process name
+
+    @param[out]
+        pFound
+            set to true if the process is tracked, false if the returned
+            slot is free
+
+    @retval pointer to the process slot, or a free slot for it
+    @retval NULL the name is empty, or the hash table is full
+
+==============================================================================*/
+static Track *FindTrack( const TrackSet *pSet,
+                         const char *name,
+                         bool *pFound )
+{
+    Track *tracks = pSet->tracks;
+    Track *pTrack = NULL;
+    uint32_t hash = 2166136261U;
+    const char *p;
+    size_t i;
+    size_t n;
+
+    *pFound = false;
+
+    if ( name[0] != '\0' )
+    {
+        for ( p = name; *p != '\0'; p++ )
+        {
+            hash = ( hash ^ (unsigned char)*p ) * 16777619U;
+        }
+
+        /* the table is sized for twice as many slots as processes, so
+           a free slot is found unless it could not be grown */
+        for ( n = 0, i = ( pSet->slots > 0 ) ? hash % pSet->slots : 0;
+              n < pSet->slots;
+              n++, i = ( i + 1 ) % pSet->slots )
+        {
+            if ( tracks[i].name[0] == '\0' )
+            {
+                pTrack = &tracks[i];
+                break;
+            }
+
+            if ( strcmp( tracks[i].name, name ) == 0 )
+            {
+                pTrack = &tracks[i];
+                *pFound = true;
+                break;
+            }
+        }
+    }
+
+    return pTrack;
+}
+
+/*============================================================================*/
+/*  Apply                                                                     */
+/*!
+    Apply a process record to its tracked process
+
+    @param[in]
+        pTrack
+            pointer to the tracked process
+
+    @param[in]
+        pRecord
+            pointer to the process record
+
+    @param[in]
+        found
+            true if the process was already tracked, false if it is new
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+==============================================================================*/
+static void Apply( Track *pTrack,
+                   const ProcRecord *pRecord,
+                   bool found,
+                   uint64_t nowUs )
+{
+    size_t index = pTrack->index;
+    uint64_t nowSec = nowUs / 1000000ULL;
+    bool running = ( strcmp( pRecord->state, "running" ) == 0 );
+    bool started = running;
+    uint64_t startUs;
+
+    if ( found == true )
+    {
+        Contribute( pTrack, -1 );
+
+        if ( pRecord->runcount > pTrack->runcount )
+        {
+            pTrack->restartSec = nowSec;
+
+            /* count the restarts in the flapping window */
+            AdvanceWindow( pTrack, nowSec / 60 );
+            pTrack->flapCounts[pTrack->flapMinute % PROCTRACK_FLAP_MINUTES] +=
+                pRecord->runcount - pTrack->runcount;
+            pTrack->flapTotal += pRecord->runcount - pTrack->runcount;
+        }
+        else if ( pTrack->running == true )
+        {
+            /* still running since the last load */
+            started = false;
+        }
+    }
+    else
+    {
+        memset( pTrack, 0, sizeof( Track ) );
+        strcpy( pTrack->name, pRecord->name );
+        pTrack->index = index;
+
+        if ( ( pRecord->runcount > 1 ) &&
+             ( running == true ) &&
+             ( pRecord->since < nowSec ) )
+        {
+            pTrack->restartSec = nowSec - pRecord->since;
+        }
+    }
+
+    if ( ( started == true ) &&
+         ( numPending > 0 ) &&
+         ( TakePending( pRecord->name, nowUs, &startUs ) == true ) )
+    {
+        AddLatency( pTrack, ( nowUs - startUs ) / 1000 );
+    }
+
+    pTrack->carried = false;
+    pTrack->running = running;
+    pTrack->runcount = pRecord->runcount;
+    pTrack->state = StateIndex( pRecord->state );
+
+    if ( ( pTrack->flapTotal > 0 ) && ( pTrack->active == false ) )
+    {
+        pTrack->active = true;
+        active[numActive++] = pTrack;
+    }
+
+    Contribute( pTrack, 1 );
+}
+
+/*============================================================================*/
+/*  TakePending                                                               */
+/*!
+    Take the pending action of a process
+
+    The TakePending function removes the action awaiting a transition to
+    running for the named process.  Actions older than the pending
+    timeout are discarded.
+
+    @param[in]
+        name
+            name of the process
+
+    @param[in]
+        nowUs
+            current monotonic time in microseconds
+
+    @param[out]
+        pStartUs
+            pointer to the location to store the time of the action
+
+    @retval true a recent action was found
+    @retval false no recent action was found
+
+==============================================================================*/
+static bool TakePending( const char *name, uint64_t nowUs, uint64_t *pStartUs )
+{
+    bool result = false;
+    size_t i;
+
+    for ( i = 0; i < numPending; i++ )
+    {
+        if ( strcmp( pending[i].name, name ) == 0 )
+        {
+            *pStartUs = pending[i].startUs;
+            result = ( nowUs >= *pStartUs ) &&
+                     ( nowUs - *pStartUs <=
+                       PROCTRACK_PENDING_TIMEOUT * 1000000ULL );
+
+            pending[i] = pending[--numPending];
+            break;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  AddLatency                                                                */
+/*!
+    Add a start latency sample
+
+    The AddLatency function adds a start latency sample to the
+    histogram of a process.
+
+    @param[in]
+        pTrack
+            pointer to the tracked process
+
+    @param[in]
+        latencyMs
+            start latency in milliseconds
+
+==============================================================================*/
+static void AddLatency( Track *pTrack, uint64_t latencyMs )
+{
+    size_t i;
+
+    for ( i = 0; i < PROCTRACK_LATENCY_BUCKETS - 1; i++ )
+    {
+        if ( latencyMs <= latencyBounds[i] )
+        {
+            break;
+        }
+    }
+
+    pTrack->latency[i]++;
+    pTrack->latencyCount++;
+    pTrack->latencySumMs += latencyMs;
+}
+
+/*============================================================================*/
+/*  AdvanceWindow                                                             */
+/*!
+    Advance the flapping window of a process
+
+    The AdvanceWindow function moves the flapping window of a process to
+    end at the specified minute, dropping the restarts of the minutes
+    which leave the window.
+
+    @param[in]
+        pTrack
+            pointer to the tracked process
+
+    @param[in]
+        minute
+            current minute
+
+==============================================================================*/
+static void AdvanceWindow( Track *pTrack, uint64_t minute )
+{
+    uint16_t *pCount;
+
+    while ( ( pTrack->flapMinute < minute ) && ( pTrack->flapTotal > 0 ) )
+    {
+        pTrack->flapMinute++;
+        pCount = &pTrack->flapCounts[pTrack->flapMinute %
+                                     PROCTRACK_FLAP_MINUTES];
+        pTrack->flapTotal -= *pCount;
+        *pCount = 0;
+    }
+
+    pTrack->flapMinute = minute;
+}
+
+/*============================================================================*/
+/*  UpdateFlapping                                                            */
+/*!
+    Update the flapping state of the active processes
+
+    The UpdateFlapping function advances the flapping window of each
+    active process, writes its flapping flag and restart rate to its
+    process table record, and removes it from the active list once its
+    window holds no restarts.  The records of other processes keep the
+    zero values they were loaded with.
+
+    @param[in]
+        pTable
+            pointer to the process table
+
+    @param[in]
+        nowSec
+            current monotonic time in seconds
+
+==============================================================================*/
+static void UpdateFlapping( ProcTable *pTable, uint64_t nowSec )
+{
+    ProcRecord *pRecord;
+    Track *pTrack;
+    size_t i = 0;
+
+    while ( i < numActive )
+    {
+        pTrack = active[i];
+        AdvanceWindow( pTrack, nowSec / 60 );
+
+        if ( pTrack->index < pTable->count )
+        {
+            pRecord = &pTable->records[pTrack->index];
+            pRecord->flapping =
+                ( pTrack->flapTotal >= PROCTRACK_FLAP_RESTARTS );
+            pRecord->restartRate =
+                pTrack->flapTotal * 60 / PROCTRACK_FLAP_MINUTES;
+        }
+
+        if ( pTrack->flapTotal == 0 )
+        {
+            /* replace the process with the last on the list */
+            pTrack->active = false;
+            active[i] = active[--numActive];
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Contribute                                                                */
+/*!
+    Add a tracked process to, or remove it from, the totals
+
+    @param[in]
+        pTrack
+            pointer to the tracked process
+
+    @param[in]
+        sign
+            1 to add the process, -1 to remove it
+
+==============================================================================*/
+static void Contribute( const Track *pTrack, int sign )
+{
+    uint64_t minute = pTrack->restartSec / 60;
+    MinuteCount *pMinute = &recent[minute % PROCTRACK_WINDOW_MINUTES];
+
+    processes += sign;
+
+    if ( pTrack->state == PROCTRACK_OTHER )
+    {
+        otherCount += sign;
+    }
+    else
+    {
+        stateCounts[pTrack->state] += sign;
+    }
+
+    if ( pTrack->runcount > 1 )
+    {
+        restarts += sign * (int64_t)( pTrack->runcount - 1 );
+    }
+
+    if ( pTrack->restartSec != 0 )
+    {
+        if ( sign > 0 )
+        {
+            if ( pMinute->minute != minute )
+            {
+                /* reuse the bucket of a minute outside the window */
+                pMinute->minute = minute;
+                pMinute->count = 0;
+            }
+
+            pMinute->count++;
+        }
+        else if ( ( pMinute->minute == minute ) && ( pMinute->count > 0 ) )
+        {
+            pMinute->count--;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  StateIndex                                                                */
+/*!
+    Get the index of a process state
+
+    The StateIndex function finds a process state, adding it if there
+    is room for another distinct state.
+
+    @param[in]
+        state
+            process state name
+
+    @retval index of the state
+    @retval PROCTRACK_OTHER the state is not counted separately
+
+==============================================================================*/
+static int StateIndex( const char *state )
+{
+    int index = PROCTRACK_OTHER;
+    int i;
+
+    for ( i = 0; i < numStates; i++ )
+    {
+        if ( strcmp( stateNames[i], state ) == 0 )
+        {
+            index = i;
+            break;
+        }
+    }
+
+    if ( ( index == PROCTRACK_OTHER ) &&
+         ( numStates < PROCTRACK_MAX_STATES ) &&
+         ( state[0] != '\0' ) )
+    {
+        strcpy( stateNames[numStates], state );
+        index = numStates++;
+    }
+
+    return index;
+}
+
+/*============================================================================*/
+/*  RecentRestarts                                                            */
+/*!
+    Count the processes which restarted recently
+
+    @param[in]
+        minutes
+            number of minutes to count, including the current minute
+
+    @param[in]
+        nowSec
+            current monotonic time in seconds
+
+    @retval number of processes which last restarted in the period
+
+==============================================================================*/
+static uint32_t RecentRestarts( unsigned int minutes, uint64_t nowSec )
+{
+    uint64_t minute = nowSec / 60;
+    uint32_t count = 0;
+    unsigned int i;
+
+    for ( i = 0; ( i < minutes ) && ( i <= minute ); i++ )
+    {
+        if ( recent[( minute - i ) % PROCTRACK_WINDOW_MINUTES].minute ==
+             minute - i )
+        {
+            count += recent[( minute - i ) % PROCTRACK_WINDOW_MINUTES].count;
+        }
+    }
+
+    return count;
+}
+
+/*! @}
+ * end of proctrack group */
@@ -0,0 +1,858 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup profiler profiler
+ * @brief On-demand CPU sampling profiler
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file profiler.c
+
+    CPU Sampling Profiler
+
+    The profiler samples the call stacks of all threads in the process
+    using a SIGPROF signal driven by a process CPU-time timer.
+    Stacks are captured by walking the frame pointer chain into a
+    preallocated sample buffer, and are rendered on request as
+    folded stack text suitable for flame graph tools.
+
+    No timer exists and no signals are delivered when the profiler
+    is not armed.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <syslog.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include "profiler.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! maximum number of frames captured per sample */
+#define PROFILER_MAX_DEPTH      32
+
+/*! maximum number of samples captured per profile */
+#define PROFILER_MAX_SAMPLES    8192
+
+/*! maximum length of a symbolized frame */
+#define PROFILER_MAX_FRAME_LEN  128
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/* program counter and frame pointer from the interrupted context */
+#if defined(__x86_64__)
+#define UC_PC(uc)   ((uintptr_t)(uc)->uc_mcontext.gregs[REG_RIP])
+#define UC_FP(uc)   ((uintptr_t)(uc)->uc_mcontext.gregs[REG_RBP])
+#elif defined(__aarch64__)
+#define UC_PC(uc)   ((uintptr_t)(uc)->uc_mcontext.pc)
+#define UC_FP(uc)   ((uintptr_t)(uc)->uc_mcontext.regs[29])
+#else
+#define UC_PC(uc)   ((uintptr_t)0)
+#define UC_FP(uc)   ((uintptr_t)0)
+#endif
+
+/*! a single captured call stack */
+typedef struct _ProfilerSample
+{
+    /*! number of frames in the sample, written last by the signal handler */
+    size_t depth;
+
+    /*! program counters, leaf first */
+    uintptr_t pc[PROFILER_MAX_DEPTH];
+
+} ProfilerSample;
+
+/*! profiler state */
+typedef struct _ProfilerState
+{
+    /*! preallocated sample buffer */
+    ProfilerSample *samples;
+
+    /*! number of sample slots claimed */
+    size_t count;
+
+    /*! number of samples dropped due to a full buffer */
+    size_t dropped;
+
+    /*! true once the samples have been normalized for folding */
+    bool normalized;
+
+    /*! profiler armed flag */
+    bool running;
+
+    /*! CPU time sampling timer */
+    timer_t timerid;
+
+    /*! monotonic time at which sampling ends */
+    struct timespec deadline;
+
+} ProfilerState;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void SampleHandler( int signum, siginfo_t *info, void *ptr );
+static bool DeadlinePassed( void );
+static int CompareSamples( const void *a, const void *b );
+static int OutputStack( ProfilerSample *pSample,
+                        size_t count,
+                        OutputFn fn,
+                        void *arg );
+static void NormalizeSample( ProfilerSample *pSample );
+static size_t FormatFrame( uintptr_t addr, char *buf, size_t len );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! profiler state */
+static ProfilerState profiler;
+
+/*! lowest address of the stack the calling thread runs on */
+static __thread uintptr_t stackLo;
+
+/*! highest address of the stack the calling thread runs on */
+static __thread uintptr_t stackHi;
+
+/*! lowest address of the calling thread's own stack */
+static __thread uintptr_t threadLo;
+
+/*! highest address of the calling thread's own stack */
+static __thread uintptr_t threadHi;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Profiler_RegisterThread                                                   */
+/*!
+    Register the calling thread for frame pointer stack walking
+
+    The Profiler_RegisterThread function records the stack bounds of the
+    calling thread, so the signal handler can safely follow its frame
+    pointer chain.  Samples taken on unregistered threads only record
+    the interrupted program counter.
+
+    @retval EOK the thread was registered
+    @retval other error from pthread_getattr_np
+
+==============================================================================*/
+int Profiler_RegisterThread( void )
+{
+    int result;
+    pthread_attr_t attr;
+    void *addr;
+    size_t size;
+
+    result = pthread_getattr_np( pthread_self(), &attr );
+    if ( result == EOK )
+    {
+        result = pthread_attr_getstack( &attr, &addr, &size );
+        if ( result == EOK )
+        {
+            threadLo = (uintptr_t)addr;
+            threadHi = (uintptr_t)addr + size;
+            stackLo = threadLo;
+            stackHi = threadHi;
+        }
+
+        pthread_attr_destroy( &attr );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Profiler_SetStack                                                         */
+/*!
+    Set the stack the calling thread is switching to
+
+    The Profiler_SetStack function sets the bounds of the stack whose
+    frames the signal handler follows, when the calling thread switches
+    to another stack, eg that of a coroutine task.  The bounds are
+    cleared while they change, so a sample taken meanwhile only records
+    the interrupted program counter.
+
+    @param[in]
+        pStack
+            lowest address of the stack, or NULL for the thread's own
+            stack
+
+    @param[in]
+        size
+            size of the stack
+
+==============================================================================*/
+void Profiler_SetStack( const void *pStack, size_t size )
+{
+    stackHi = 0;
+    __atomic_signal_fence( __ATOMIC_SEQ_CST );
+
+    stackLo = ( pStack != NULL ) ? (uintptr_t)pStack : threadLo;
+    __atomic_signal_fence( __ATOMIC_SEQ_CST );
+
+    stackHi = ( pStack != NULL ) ? (uintptr_t)pStack + size : threadHi;
+}
+
+/*============================================================================*/
+/*  Profiler_Start                                                            */
+/*!
+    Arm the sampling profiler
+
+    The Profiler_Start function allocates the sample buffer (once),
+    installs the SIGPROF handler and starts a process CPU-time timer
+    which samples at the requested frequency for the requested
+    number of seconds.
+
+    @param[in]
+        seconds
+            number of seconds to sample for
+
+    @param[in]
+        hz
+            sampling frequency in samples per second of consumed CPU time
+
+    @retval EOK the profiler was armed
+    @retval EBUSY the profiler is already armed
+    @retval ENOMEM cannot allocate the sample buffer
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Profiler_Start( unsigned int seconds, unsigned int hz )
+{
+    int result = EINVAL;
+    struct sigaction sigact;
+    struct sigevent sev;
+    struct itimerspec its;
+
+    if ( profiler.running == true )
+    {
+        result = EBUSY;
+    }
+    else if ( ( seconds > 0 ) && ( seconds <= PROFILER_MAX_SECONDS ) &&
+              ( hz > 0 ) && ( hz <= PROFILER_MAX_HZ ) )
+    {
+        if ( profiler.samples == NULL )
+        {
+            profiler.samples = calloc( PROFILER_MAX_SAMPLES,
+                                       sizeof( ProfilerSample ) );
+        }
+
+        if ( profiler.samples != NULL )
+        {
+            /* discard the previous profile */
+            memset( profiler.samples,
+                    0,
+                    PROFILER_MAX_SAMPLES * sizeof( ProfilerSample ) );
+            profiler.count = 0;
+            profiler.dropped = 0;
+            profiler.normalized = false;
+
+            clock_gettime( CLOCK_MONOTONIC, &profiler.deadline );
+            profiler.deadline.tv_sec += seconds;
+
+            memset( &sigact, 0, sizeof( sigact ) );
+            sigact.sa_sigaction = SampleHandler;
+            sigact.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset( &sigact.sa_mask );
+            sigaction( SIGPROF, &sigact, NULL );
+
+            memset( &sev, 0, sizeof( sev ) );
+            sev.sigev_notify = SIGEV_SIGNAL;
+            sev.sigev_signo = SIGPROF;
+
+            if ( timer_create( CLOCK_PROCESS_CPUTIME_ID,
+                               &sev,
+                               &profiler.timerid ) == 0 )
+            {
+                its.it_interval.tv_sec = ( hz == 1 ) ? 1 : 0;
+                its.it_interval.tv_nsec = ( hz == 1 ) ? 0 : 1000000000L / hz;
+                its.it_value = its.it_interval;
+
+                __atomic_store_n( &profiler.running, true, __ATOMIC_RELEASE );
+
+                if ( timer_settime( profiler.timerid, 0, &its, NULL ) == 0 )
+                {
+                    result = EOK;
+                }
+                else
+                {
+                    result = errno;
+                    Profiler_Stop();
+                }
+            }
+            else
+            {
+                result = errno;
+                signal( SIGPROF, SIG_IGN );
+            }
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Profiler_Stop                                                             */
+/*!
+    Disarm the sampling profiler
+
+    The Profiler_Stop function deletes the sampling timer and ignores
+    any SIGPROF signals which may still be pending.  The captured
+    samples are retained until the next call to Profiler_Start.
+
+    @retval EOK the profiler was stopped
+    @retval EALREADY the profiler was not running
+
+==============================================================================*/
+int Profiler_Stop( void )
+{
+    int result = EALREADY;
+    size_t dropped;
+
+    if ( profiler.running == true )
+    {
+        __atomic_store_n( &profiler.running, false, __ATOMIC_RELEASE );
+
+        timer_delete( profiler.timerid );
+        signal( SIGPROF, SIG_IGN );
+
+        dropped = __atomic_load_n( &profiler.dropped, __ATOMIC_RELAXED );
+        if ( dropped > 0 )
+        {
+            syslog( LOG_WARNING,
+                    "profiler dropped %zu samples",
+                    dropped );
+        }
+
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Profiler_IsRunning                                                        */
+/*!
+    Check if the profiler is armed
+
+    The Profiler_IsRunning function checks if the profiler is still
+    sampling.  A profiler whose sampling period has elapsed is stopped.
+
+    @param[out]
+        remaining
+            optional pointer to receive the number of seconds remaining
+
+    @retval true the profiler is sampling
+    @retval false the profiler is not sampling
+
+==============================================================================*/
+bool Profiler_IsRunning( unsigned int *remaining )
+{
+    struct timespec now;
+
+    if ( profiler.running == true )
+    {
+        if ( DeadlinePassed() )
+        {
+            Profiler_Stop();
+        }
+        else if ( remaining != NULL )
+        {
+            clock_gettime( CLOCK_MONOTONIC, &now );
+            *remaining = profiler.deadline.tv_sec - now.tv_sec;
+        }
+    }
+
+    return profiler.running;
+}
+
+/*============================================================================*/
+/*  Profiler_Fold                                                             */
+/*!
+    Output the captured samples as folded stacks
+
+    The Profiler_Fold function groups identical call stacks from the last
+    profile and outputs one line per distinct stack, with the frames
+    listed root first and separated by semicolons, followed by the
+    number of samples.
+
+    @param[in]
+        fn
+            output function to send the folded stack text to
+
+    @param[in]
+        arg
+            opaque argument passed to the output function
+
+    @retval EOK the folded stacks were output
+    @retval EBUSY the profiler is still running
+    @retval ENOMEM cannot allocate memory to sort the samples
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Profiler_Fold( OutputFn fn, void *arg )
+{
+    int result = EINVAL;
+    ProfilerSample **pSamples;
+    size_t count;
+    size_t n = 0;
+    size_t i;
+    size_t j;
+    char buf[PROFILER_MAX_FRAME_LEN];
+    int len;
+
+    if ( fn != NULL )
+    {
+        if ( profiler.running == true )
+        {
+            result = EBUSY;
+        }
+        else if ( profiler.samples == NULL )
+        {
+            result = EOK;
+        }
+        else
+        {
+            count = profiler.count;
+            if ( count > PROFILER_MAX_SAMPLES )
+            {
+                count = PROFILER_MAX_SAMPLES;
+            }
+
+            pSamples = calloc( count + 1, sizeof( ProfilerSample * ) );
+            if ( pSamples != NULL )
+            {
+                /* collect the completed samples.  They are normalized in
+                 * place, so only by the first fold of the profile */
+                for ( i = 0; i < count; i++ )
+                {
+                    if ( __atomic_load_n( &profiler.samples[i].depth,
+                                          __ATOMIC_ACQUIRE ) > 0 )
+                    {
+                        if ( profiler.normalized == false )
+                        {
+                            NormalizeSample( &profiler.samples[i] );
+                        }
+
+                        pSamples[n++] = &profiler.samples[i];
+                    }
+                }
+
+                profiler.normalized = true;
+
+                /* group identical stacks together */
+                qsort( pSamples, n, sizeof( ProfilerSample * ), CompareSamples );
+
+                result = EOK;
+                i = 0;
+                while ( ( i < n ) && ( result == EOK ) )
+                {
+                    j = i + 1;
+                    while ( ( j < n ) &&
+                            ( CompareSamples( &pSamples[i],
+                                              &pSamples[j] ) == 0 ) )
+                    {
+                        j++;
+                    }
+
+                    result = OutputStack( pSamples[i], j - i, fn, arg );
+                    i = j;
+                }
+
+                if ( ( result == EOK ) && ( profiler.dropped > 0 ) )
+                {
+                    len = snprintf( buf,
+                                    sizeof( buf ),
+                                    "[dropped] %zu\n",
+                                    profiler.dropped );
+                    result = fn( arg, buf, len );
+                }
+
+                free( pSamples );
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  SampleHandler                                                             */
+/*!
+    SIGPROF signal handler
+
+    The SampleHandler function captures the call stack of the interrupted
+    thread into the next free slot of the sample buffer.  It only uses
+    async-signal-safe operations, and only dereferences frame pointers
+    which lie inside the registered stack of the interrupted thread.
+
+    @param[in]
+        signum
+            the signal number (unused)
+
+    @param[in]
+        info
+            pointer to a siginfo_t object (unused)
+
+    @param[in]
+        ptr
+            pointer to the ucontext_t of the interrupted thread
+
+==============================================================================*/
+static void SampleHandler( int signum, siginfo_t *info, void *ptr )
+{
+    ucontext_t *uc = (ucontext_t *)ptr;
+    ProfilerSample *pSample;
+    size_t idx;
+    size_t depth = 0;
+    uintptr_t pc;
+    uintptr_t fp;
+    uintptr_t next;
+    uintptr_t lo = stackLo;
+    uintptr_t hi = stackHi;
+    int errnum = errno;
+
+    (void)signum;
+    (void)info;
+
+    if ( ( __atomic_load_n( &profiler.running, __ATOMIC_ACQUIRE ) == true ) &&
+         ( uc != NULL ) &&
+         ( DeadlinePassed() == false ) )
+    {
+        idx = __atomic_fetch_add( &profiler.count, 1, __ATOMIC_RELAXED );
+        if ( idx < PROFILER_MAX_SAMPLES )
+        {
+            pSample = &profiler.samples[idx];
+
+            pc = UC_PC( uc );
+            fp = UC_FP( uc );
+
+            if ( pc != 0 )
+            {
+                pSample->pc[depth++] = pc;
+            }
+
+            /* follow the frame records: [0] saved frame pointer,
+             * [1] return address */
+            while ( ( depth < PROFILER_MAX_DEPTH ) &&
+                    ( fp >= lo ) &&
+                    ( fp + 2 * sizeof( uintptr_t ) <= hi ) &&
+                    ( ( fp & ( sizeof( uintptr_t ) - 1 ) ) == 0 ) )
+            {
+                pc = ((uintptr_t *)fp)[1];
+                next = ((uintptr_t *)fp)[0];
+                if ( pc == 0 )
+                {
+                    break;
+                }
+
+                pSample->pc[depth++] = pc;
+
+                /* stacks grow down, so the caller's frame is higher */
+                if ( next <= fp )
+                {
+                    break;
+                }
+
+                fp = next;
+            }
+
+            __atomic_store_n( &pSample->depth, depth, __ATOMIC_RELEASE );
+        }
+        else
+        {
+            __atomic_fetch_add( &profiler.dropped, 1, __ATOMIC_RELAXED );
+        }
+    }
+
+    errno = errnum;
+}
+
+/*============================================================================*/
+/*  DeadlinePassed                                                            */
+/*!
+    Check if the sampling period has elapsed
+
+    The DeadlinePassed function compares the current monotonic time
+    against the profiler deadline.  It is async-signal-safe.
+
+    @retval true the sampling period has elapsed
+    @retval false the sampling period has not elapsed
+
+==============================================================================*/
+static bool DeadlinePassed( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( now.tv_sec > profiler.deadline.tv_sec ) ||
+           ( ( now.tv_sec == profiler.deadline.tv_sec ) &&
+             ( now.tv_nsec >= profiler.deadline.tv_nsec ) );
+}
+
+/*============================================================================*/
+/*  CompareSamples                                                            */
+/*!
+    Compare two samples for sorting
+
+    The CompareSamples function is a qsort comparison function which
+    orders sample pointers by stack depth and then by program counters.
+
+    @param[in]
+        a
+            pointer to the first ProfilerSample pointer
+
+    @param[in]
+        b
+            pointer to the second ProfilerSample pointer
+
+    @retval <0 a sorts before b
+    @retval 0 a and b contain the same stack
+    @retval >0 a sorts after b
+
+==============================================================================*/
+static int CompareSamples( const void *a, const void *b )
+{
+    const ProfilerSample *pA = *(ProfilerSample * const *)a;
+    const ProfilerSample *pB = *(ProfilerSample * const *)b;
+    size_t i;
+
+    if ( pA->depth != pB->depth )
+    {
+        return ( pA->depth < pB->depth ) ? -1 : 1;
+    }
+
+    for ( i = 0; i < pA->depth; i++ )
+    {
+        if ( pA->pc[i] != pB->pc[i] )
+        {
+            return ( pA->pc[i] < pB->pc[i] ) ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+/*============================================================================*/
+/*  OutputStack                                                               */
+/*!
+    Output a single folded stack line
+
+    The OutputStack function outputs the frames of the sample, root first,
+    separated by semicolons and followed by the sample count.
+
+    @param[in]
+        pSample
+            pointer to the sample containing the stack
+
+    @param[in]
+        count
+            number of samples which share this stack
+
+    @param[in]
+        fn
+            output function
+
+    @param[in]
+        arg
+            opaque argument passed to the output function
+
+    @retval EOK the line was output
+    @retval other error returned by the output function
+
+==============================================================================*/
+static int OutputStack( ProfilerSample *pSample,
+                        size_t count,
+                        OutputFn fn,
+                        void *arg )
+{
+    int result = EOK;
+    char buf[PROFILER_MAX_FRAME_LEN];
+    size_t len;
+    size_t i = pSample->depth;
+
+    while ( ( i > 0 ) && ( result == EOK ) )
+    {
+        i--;
+        len = FormatFrame( pSample->pc[i], buf, sizeof( buf ) );
+        result = fn( arg, buf, len );
+        if ( ( result == EOK ) && ( i > 0 ) )
+        {
+            result = fn( arg, ";", 1 );
+        }
+    }
+
+    if ( result == EOK )
+    {
+        len = snprintf( buf, sizeof( buf ), " %zu\n", count );
+        result = fn( arg, buf, len );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  NormalizeSample                                                           */
+/*!
+    Normalize the program counters of a sample
+
+    The NormalizeSample function replaces each program counter in the
+    sample with the start address of its enclosing exported symbol, so
+    that samples taken at different instructions of the same functions
+    fold into a single stack.  Return addresses point after the call,
+    so the call instruction itself is used for the lookup.  Program
+    counters without a symbol keep their (call) address.
+
+    @param[in,out]
+        pSample
+            pointer to the sample to normalize
+
+==============================================================================*/
+static void NormalizeSample( ProfilerSample *pSample )
+{
+    Dl_info info;
+    uintptr_t addr;
+    size_t i;
+
+    for ( i = 0; i < pSample->depth; i++ )
+    {
+        addr = ( i == 0 ) ? pSample->pc[i] : pSample->pc[i] - 1;
+
+        if ( ( dladdr( (void *)addr, &info ) != 0 ) &&
+             ( info.dli_sname != NULL ) &&
+             ( info.dli_saddr != NULL ) )
+        {
+            addr = (uintptr_t)info.dli_saddr;
+        }
+
+        pSample->pc[i] = addr;
+    }
+}
+
+/*============================================================================*/
+/*  FormatFrame                                                               */
+/*!
+    Symbolize a normalized program counter
+
+    The FormatFrame function converts a normalized program counter into
+    a symbol name if one is exported, or into a module+offset string
+    which can be resolved offline with addr2line.
+
+    @param[in]
+        addr
+            normalized program counter to symbolize
+
+    @param[out]
+        buf
+            buffer to receive the frame text
+
+    @param[in]
+        len
+            size of the buffer
+
+    @retval length of the frame text
+
+==============================================================================*/
+static size_t FormatFrame( uintptr_t addr, char *buf, size_t len )
+{
+    Dl_info info;
+    const char *module;
+    int n;
+
+    if ( ( dladdr( (void *)addr, &info ) != 0 ) && ( info.dli_fname != NULL ) )
+    {
+        if ( info.dli_sname != NULL )
+        {
+            n = snprintf( buf, len, "%s", info.dli_sname );
+        }
+        else
+        {
+            module = strrchr( info.dli_fname, '/' );
+            module = ( module != NULL ) ? module + 1 : info.dli_fname;
+            n = snprintf( buf,
+                          len,
+                          "%s+0x%lx",
+                          module,
+                          (unsigned long)( addr - (uintptr_t)info.dli_fbase ) );
+        }
+    }
+    else
+    {
+        n = snprintf( buf, len, "0x%lx", (unsigned long)addr );
+    }
+
+    if ( n < 0 )
+    {
+        n = 0;
+    }
+    else if ( (size_t)n >= len )
+    {
+        n = len - 1;
+    }
+
+    return (size_t)n;
+}
+
+/*! @}
+ * end of profiler group */
@@ -0,0 +1,593 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup queue queue
+ * @brief Bounded lock-free hand-off queue
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file queue.c
+
+    Hand-off Queue
+
+    The queue module hands items, such as accepted requests or queued
+    actions, from producer threads to consumer threads through a
+    bounded ring of cells without taking a lock.
+
+    Each cell carries a sequence number which tells producers and
+    consumers whose turn it is to use the cell: a producer claims the
+    enqueue position whose cell sequence equals the position, stores
+    the item and advances the sequence by one, and a consumer claims
+    the dequeue position whose cell sequence is one past the position,
+    takes the item and advances the sequence by the size of the ring.
+    Positions are claimed by compare and swap, so the only contention
+    between threads is on the position counters.
+
+    A consumer which finds the queue empty first spins for a short
+    while, on hosts with more than one CPU, as an item usually follows
+    soon on a busy queue.  It then yields the CPU a few times, so that
+    on a single CPU the producers can add a batch of items, and only
+    then parks on a futex.  A producer only
+    wakes a parked consumer when it adds an item to an empty queue, and
+    a woken consumer which leaves items behind wakes the next one, so a
+    busy queue makes no system calls.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "queue.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! number of times a consumer polls an empty queue before it yields */
+#define QUEUE_SPINS         128
+
+/*! number of times a consumer yields on an empty queue before it parks */
+#define QUEUE_YIELDS        4
+
+/*! hint to the CPU that the thread is spinning */
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define QUEUE_RELAX()       __builtin_ia32_pause()
+#elif defined( __aarch64__ )
+#define QUEUE_RELAX()       __asm__ __volatile__( "yield" )
+#else
+#define QUEUE_RELAX()       __atomic_thread_fence( __ATOMIC_SEQ_CST )
+#endif
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int Spin( Queue *pQueue, void **pItem );
+static int Park( Queue *pQueue, uint32_t seen, uint64_t deadlineMs );
+static void Wake( Queue *pQueue, int count );
+static uint64_t NowMs( void );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Queue_Init                                                                */
+/*!
+    Initialize a queue
+
+    @param[in]
+        pQueue
+            pointer to the queue to initialize
+
+    @param[in]
+        capacity
+            maximum number of queued items, a power of two of at least 2
+
+    @retval EOK the queue was initialized
+    @retval ENOMEM cannot allocate the queue cells
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Queue_Init( Queue *pQueue, size_t capacity )
+{
+    int result = EINVAL;
+    size_t i;
+
+    if ( ( pQueue != NULL ) &&
+         ( capacity >= 2 ) &&
+         ( ( capacity & ( capacity - 1 ) ) == 0 ) )
+    {
+        memset( pQueue, 0, sizeof( Queue ) );
+
+        pQueue->cells = calloc( capacity, sizeof( QueueCell ) );
+        if ( pQueue->cells != NULL )
+        {
+            for ( i = 0; i < capacity; i++ )
+            {
+                pQueue->cells[i].seq = i;
+            }
+
+            pQueue->mask = capacity - 1;
+
+            /* spinning only helps if a producer can run meanwhile */
+            pQueue->spins = ( sysconf( _SC_NPROCESSORS_ONLN ) > 1 )
+                                ? QUEUE_SPINS
+                                : 0;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Queue_Destroy                                                             */
+/*!
+    Release the cells of a queue
+
+    The queue must no longer be used by any thread.
+
+    @param[in]
+        pQueue
+            pointer to the queue
+
+==============================================================================*/
+void Queue_Destroy( Queue *pQueue )
+{
+    if ( pQueue != NULL )
+    {
+        free( pQueue->cells );
+        pQueue->cells = NULL;
+    }
+}
+
+/*============================================================================*/
+/*  Queue_Push                                                                */
+/*!
+    Add an item to a queue
+
+    The Queue_Push function adds an item to the tail of the queue without
+    blocking.  If the queue was empty, a parked consumer is woken.
+
+    @param[in]
+        pQueue
+            pointer to the queue
+
+    @param[in]
+        item
+            item to add
+
+    @retval EOK the item was added
+    @retval EAGAIN the queue is full
+    @retval ECANCELED the queue is closed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Queue_Push( Queue *pQueue, void *item )
+{
+    int result = EINVAL;
+    QueueCell *pCell;
+    size_t pos;
+    intptr_t diff;
+
+    if ( ( pQueue != NULL ) && ( pQueue->cells != NULL ) )
+    {
+        result = EAGAIN;
+        pos = __atomic_load_n( &pQueue->enqueuePos, __ATOMIC_RELAXED );
+
+        while ( __atomic_load_n( &pQueue->closed, __ATOMIC_RELAXED ) == false )
+        {
+            pCell = &pQueue->cells[pos & pQueue->mask];
+            diff = (intptr_t)__atomic_load_n( &pCell->seq, __ATOMIC_ACQUIRE ) -
+                   (intptr_t)pos;
+
+            if ( ( diff == 0 ) &&
+                 ( __atomic_compare_exchange_n( &pQueue->enqueuePos,
+                                                &pos,
+                                                pos + 1,
+                                                true,
+                                                __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED ) ) )
+            {
+                pCell->item = item;
+                __atomic_store_n( &pCell->seq, pos + 1, __ATOMIC_SEQ_CST );
+                result = EOK;
+                break;
+            }
+            else if ( diff < 0 )
+            {
+                /* the cell still holds an item a lap behind */
+                break;
+            }
+            else if ( diff > 0 )
+            {
+                pos = __atomic_load_n( &pQueue->enqueuePos,
+                                       __ATOMIC_RELAXED );
+            }
+        }
+
+        if ( result == EOK )
+        {
+            /* consumers only park on an empty queue, so they are already
+               awake if an earlier item has not been removed yet */
+            if ( ( __atomic_load_n( &pQueue->dequeuePos,
+                                    __ATOMIC_SEQ_CST ) == pos ) &&
+                 ( __atomic_load_n( &pQueue->waiters, __ATOMIC_SEQ_CST ) > 0 ) )
+            {
+                Wake( pQueue, 1 );
+            }
+        }
+        else if ( __atomic_load_n( &pQueue->closed, __ATOMIC_RELAXED ) )
+        {
+            result = ECANCELED;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Queue_TryPop                                                              */
+/*!
+    Remove an item from a queue without waiting
+
+    @param[in]
+        pQueue
+            pointer to the queue
+
+    @param[out]
+        pItem
+            pointer to the location to store the removed item
+
+    @retval EOK an item was removed
+    @retval EAGAIN the queue is empty
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Queue_TryPop( Queue *pQueue, void **pItem )
+{
+    int result = EINVAL;
+    QueueCell *pCell;
+    size_t pos;
+    intptr_t diff;
+
+    if ( ( pQueue != NULL ) && ( pQueue->cells != NULL ) && ( pItem != NULL ) )
+    {
+        result = EAGAIN;
+        pos = __atomic_load_n( &pQueue->dequeuePos, __ATOMIC_RELAXED );
+
+        do
+        {
+            pCell = &pQueue->cells[pos & pQueue->mask];
+            diff = (intptr_t)__atomic_load_n( &pCell->seq, __ATOMIC_SEQ_CST ) -
+                   (intptr_t)( pos + 1 );
+
+            if ( ( diff == 0 ) &&
+                 ( __atomic_compare_exchange_n( &pQueue->dequeuePos,
+                                                &pos,
+                                                pos + 1,
+                                                true,
+                                                __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED ) ) )
+            {
+                *pItem = pCell->item;
+                __atomic_store_n( &pCell->seq,
+                                  pos + pQueue->mask + 1,
+                                  __ATOMIC_RELEASE );
+                result = EOK;
+            }
+            else if ( diff > 0 )
+            {
+                pos = __atomic_load_n( &pQueue->dequeuePos,
+                                       __ATOMIC_RELAXED );
+            }
+        } while ( ( result == EAGAIN ) && ( diff >= 0 ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Queue_Pop                                                                 */
+/*!
+    Remove an item from a queue
+
+    The Queue_Pop function removes the item at the head of the queue.
+    While the queue is empty, the calling thread spins briefly and then
+    parks on a futex.  A consumer which was parked wakes another parked
+    consumer if it leaves items in the queue.
+
+    @param[in]
+        pQueue
+            pointer to the queue
+
+    @param[out]
+        pItem
+            pointer to the location to store the removed item
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or 0 to wait until an
+            item is added or the queue is closed
+
+    @retval EOK an item was removed
+    @retval ETIMEDOUT no item was added in time
+    @retval ECANCELED the queue is closed and empty
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Queue_Pop( Queue *pQueue, void **pItem, unsigned int timeoutMs )
+{
+    int result;
+    uint32_t seen;
+    uint64_t deadlineMs = ( timeoutMs > 0 ) ? NowMs() + timeoutMs : 0;
+    bool parked = false;
+
+    result = Spin( pQueue, pItem );
+    while ( result == EAGAIN )
+    {
+        /* read the futex word before the last check, so a push which
+           the check misses is guaranteed to change it */
+        seen = __atomic_load_n( &pQueue->signal, __ATOMIC_SEQ_CST );
+        __atomic_add_fetch( &pQueue->waiters, 1, __ATOMIC_SEQ_CST );
+
+        result = Queue_TryPop( pQueue, pItem );
+        if ( result == EAGAIN )
+        {
+            result = __atomic_load_n( &pQueue->closed, __ATOMIC_SEQ_CST )
+                        ? ECANCELED
+                        : Park( pQueue, seen, deadlineMs );
+        }
+
+        __atomic_sub_fetch( &pQueue->waiters, 1, __ATOMIC_SEQ_CST );
+
+        if ( result == EOK )
+        {
+            parked = true;
+            result = Spin( pQueue, pItem );
+        }
+        else if ( result == ECANCELED )
+        {
+            /* items added before the close are still delivered */
+            result = ( Queue_TryPop( pQueue, pItem ) == EOK ) ? EOK
+                                                              : ECANCELED;
+        }
+    }
+
+    if ( ( result == EOK ) &&
+         ( parked == true ) &&
+         ( __atomic_load_n( &pQueue->waiters, __ATOMIC_SEQ_CST ) > 0 ) &&
+         ( __atomic_load_n( &pQueue->dequeuePos, __ATOMIC_SEQ_CST ) !=
+           __atomic_load_n( &pQueue->enqueuePos, __ATOMIC_SEQ_CST ) ) )
+    {
+        /* the producers did not wake anyone for the items left behind */
+        Wake( pQueue, 1 );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Queue_Close                                                               */
+/*!
+    Close a queue
+
+    The Queue_Close function stops the queue accepting items, and wakes
+    every parked consumer.  Items already queued can still be removed.
+
+    @param[in]
+        pQueue
+            pointer to the queue
+
+==============================================================================*/
+void Queue_Close( Queue *pQueue )
+{
+    if ( pQueue != NULL )
+    {
+        __atomic_store_n( &pQueue->closed, true, __ATOMIC_SEQ_CST );
+        Wake( pQueue, INT_MAX );
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Spin                                                                      */
+/*!
+    Poll an empty queue for a short while
+
+    The Spin function polls the queue with a CPU pause between polls,
+    then yields the CPU between polls, until an item is removed or the
+    polls run out.
+
+    @param[in]
+        pQueue
+            pointer to the queue
+
+    @param[out]
+        pItem
+            pointer to the location to store the removed item
+
+    @retval EOK an item was removed
+    @retval EAGAIN the queue is still empty
+
+==============================================================================*/
+static int Spin( Queue *pQueue, void **pItem )
+{
+    int result = Queue_TryPop( pQueue, pItem );
+    uint32_t i;
+
+    for ( i = 0; ( i < pQueue->spins ) && ( result == EAGAIN ); i++ )
+    {
+        QUEUE_RELAX();
+
+        /* only try to claim an item once one has been added */
+        if ( __atomic_load_n( &pQueue->enqueuePos, __ATOMIC_RELAXED ) !=
+             __atomic_load_n( &pQueue->dequeuePos, __ATOMIC_RELAXED ) )
+        {
+            result = Queue_TryPop( pQueue, pItem );
+        }
+    }
+
+    for ( i = 0; ( i < QUEUE_YIELDS ) && ( result == EAGAIN ); i++ )
+    {
+        sched_yield();
+        result = Queue_TryPop( pQueue, pItem );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Park                                                                      */
+/*!
+    Park the calling thread until the queue signal changes
+
+    @param[in]
+        pQueue
+            pointer to the queue
+
+    @param[in]
+        seen
+            value of the queue signal when the queue was found empty
+
+    @param[in]
+        deadlineMs
+            monotonic time to stop waiting in milliseconds, or 0 to wait
+            without a time limit
+
+    @retval EOK the signal changed, or the thread was woken
+    @retval ETIMEDOUT the deadline passed
+
+==============================================================================*/
+static int Park( Queue *pQueue, uint32_t seen, uint64_t deadlineMs )
+{
+    int result = EOK;
+    struct timespec timeout;
+    struct timespec *pTimeout = NULL;
+    uint64_t nowMs;
+
+    if ( deadlineMs > 0 )
+    {
+        nowMs = NowMs();
+        if ( nowMs < deadlineMs )
+        {
+            timeout.tv_sec = ( deadlineMs - nowMs ) / 1000;
+            timeout.tv_nsec = ( ( deadlineMs - nowMs ) % 1000 ) * 1000000L;
+            pTimeout = &timeout;
+        }
+        else
+        {
+            result = ETIMEDOUT;
+        }
+    }
+
+    if ( ( result == EOK ) &&
+         ( syscall( SYS_futex,
+                    &pQueue->signal,
+                    FUTEX_WAIT_PRIVATE,
+                    seen,
+                    pTimeout,
+                    NULL,
+                    0 ) != 0 ) &&
+         ( errno == ETIMEDOUT ) )
+    {
+        result = ETIMEDOUT;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Wake                                                                      */
+/*!
+    Wake parked consumers
+
+    @param[in]
+        pQueue
+            pointer to the queue
+
+    @param[in]
+        count
+            maximum number of consumers to wake
+
+==============================================================================*/
+static void Wake( Queue *pQueue, int count )
+{
+    __atomic_add_fetch( &pQueue->signal, 1, __ATOMIC_SEQ_CST );
+    (void)syscall( SYS_futex,
+                   &pQueue->signal,
+                   FUTEX_WAKE_PRIVATE,
+                   count,
+                   NULL,
+                   NULL,
+                   0 );
+}
+
+/*============================================================================*/
+/*  NowMs                                                                     */
+/*!
+    Get the monotonic time in milliseconds
+
+    @retval current monotonic time in milliseconds
+
+==============================================================================*/
+static uint64_t NowMs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( (uint64_t)ts.tv_sec * 1000ULL ) +
+           ( (uint64_t)ts.tv_nsec / 1000000ULL );
+}
+
+/*! @}
+ * end of queue group */
@@ -0,0 +1,1452 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup response response
+ * @brief FastCGI response assembly
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file response.c
+
+    FastCGI Response Assembly
+
+    The response module assembles the header and body of a response in
+    a single preallocated buffer, and sends it directly on the FastCGI
+    connection as maximal (64 KiB) FCGI_STDOUT records.  The final batch
+    of records is sent together with the empty FCGI_STDOUT record and the
+    FCGI_END_REQUEST record in a single gathered write, so a response
+    which fits in the buffer costs one system call.
+
+    The record headers are built on the stack and gathered with the
+    buffered content, so the content is never copied again.
+
+    When the client accepts a supported content encoding and the body
+    is at least COMPRESS_MIN_LENGTH bytes, the body is compressed into
+    a second preallocated buffer as it is sent, and the Content-Encoding
+    and Vary headers are added to the response header.
+
+    Command output which is only passed through can be sent with
+    Response_Splice, which moves it from the command's pipe to the
+    connection with splice, so it is never copied into the process.
+    Each record header (with any buffered data, eg the response header)
+    is sent ahead of the spliced content of its record.
+
+    libfcgi would normally write the closing records when the request is
+    finished.  Once Response_Finish has sent them, the request's output
+    stream is marked as closed so that FCGX_Finish_r does not write them
+    a second time.
+
+    A response which fails before any of it was sent can be discarded
+    and replaced, eg by an error response.  Once part of it was sent,
+    it can only be aborted by shutting down the connection.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "compress.h"
+#include "response.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! FastCGI protocol version */
+#define FCGI_RECORD_VERSION     1
+
+/*! FastCGI end of request record type */
+#define FCGI_RECORD_END_REQUEST 3
+
+/*! FastCGI standard output record type */
+#define FCGI_RECORD_STDOUT      6
+
+/*! FastCGI request complete protocol status */
+#define FCGI_RECORD_COMPLETE    0
+
+/*! maximum content length of a FastCGI record */
+#define FCGI_RECORD_MAX_CONTENT 0xFFFF
+
+/*! size of a FastCGI record header */
+#define FCGI_RECORD_HEADER_LEN  8
+
+/*! maximum number of records in one gathered write */
+#define RESPONSE_MAX_RECORDS    32
+
+/*! header lines added to the header of a compressed response */
+#define RESPONSE_ENCODING_HEADER \
+    "Content-Encoding: %s\r\nVary: Accept-Encoding\r\n\r\n"
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! FastCGI record header */
+typedef struct _RecordHeader
+{
+    unsigned char version;
+    unsigned char type;
+    unsigned char requestIdB1;
+    unsigned char requestIdB0;
+    unsigned char contentLengthB1;
+    unsigned char contentLengthB0;
+    unsigned char paddingLength;
+    unsigned char reserved;
+
+} RecordHeader;
+
+/*! closing records: empty FCGI_STDOUT followed by FCGI_END_REQUEST */
+typedef struct _CloseRecords
+{
+    /*! empty FCGI_STDOUT record (end of stream) */
+    RecordHeader stdoutEnd;
+
+    /*! FCGI_END_REQUEST record header */
+    RecordHeader endRequest;
+
+    /*! FCGI_END_REQUEST body */
+    unsigned char appStatus[4];
+    unsigned char protocolStatus;
+    unsigned char reserved[3];
+
+} CloseRecords;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void MakeHeader( RecordHeader *pHeader,
+                        int type,
+                        int requestId,
+                        size_t contentLength );
+static int Grow( Response *pResponse );
+static int Output( Response *pResponse, bool final, int appStatus );
+static int Compress( Response *pResponse, bool final, int appStatus );
+static int Send( Response *pResponse,
+                 const char *data,
+                 size_t len,
+                 bool final,
+                 int appStatus );
+static int WriteAll( Response *pResponse,
+                     struct iovec *iov,
+                     int iovcnt,
+                     int flags );
+static int SpliceAll( Response *pResponse,
+                      int fd,
+                      size_t len,
+                      size_t *pMoved );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Response_Init                                                             */
+/*!
+    Initialize a response object
+
+    The Response_Init function allocates the response assembly buffer
+    and a buffer of the same size for compressed output.
+
+    @param[in]
+        pResponse
+            pointer to the response object to initialize
+
+    @param[in]
+        size
+            size of the response assembly buffer
+
+    @retval EOK the response object was initialized
+    @retval ENOMEM cannot allocate the response buffers
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Response_Init( Response *pResponse, size_t size )
+{
+    int result = EINVAL;
+
+    if ( ( pResponse != NULL ) && ( size > 0 ) )
+    {
+        memset( pResponse, 0, sizeof( Response ) );
+
+        pResponse->buf = malloc( size );
+        pResponse->zbuf = malloc( size );
+        if ( ( pResponse->buf != NULL ) && ( pResponse->zbuf != NULL ) )
+        {
+            pResponse->size = size;
+            pResponse->zsize = size;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Response_Begin                                                            */
+/*!
+    Start a new response
+
+    The Response_Begin function empties the response buffer and associates
+    the response with the request it will be sent on.  The response is
+    not compressed unless an encoding is set with Response_SetEncoding.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        pRequest
+            pointer to the accepted FCGI request, or NULL to only
+            collect data in the response buffer
+
+==============================================================================*/
+void Response_Begin( Response *pResponse, FCGX_Request *pRequest )
+{
+    if ( pResponse != NULL )
+    {
+        pResponse->len = 0;
+        pResponse->pRequest = pRequest;
+        pResponse->writes = 0;
+        pResponse->sent = 0;
+        pResponse->finished = false;
+        pResponse->headerLen = 0;
+        pResponse->encoding = COMPRESS_IDENTITY;
+        pResponse->compressing = false;
+    }
+}
+
+/*============================================================================*/
+/*  Response_SetEncoding                                                      */
+/*!
+    Set the content encoding of the response
+
+    The Response_SetEncoding function sets the content encoding negotiated
+    with the client.  The body of a response with a header written by
+    Response_Header is compressed if it is large enough.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        encoding
+            the content encoding accepted by the client
+
+==============================================================================*/
+void Response_SetEncoding( Response *pResponse, CompressEncoding encoding )
+{
+    if ( ( pResponse != NULL ) && ( encoding < COMPRESS_MAX ) )
+    {
+        pResponse->encoding = encoding;
+    }
+}
+
+/*============================================================================*/
+/*  Response_Header                                                           */
+/*!
+    Write the response header
+
+    The Response_Header function writes a preformatted response header,
+    which must end with an empty line.  A header written at the start
+    of the response marks the start of a body which may be compressed.
+
+    If the body to follow is already compressed, the Content-Encoding
+    header for its encoding is added, and the body is not compressed
+    again.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        header
+            pointer to the preformatted header
+
+    @param[in]
+        len
+            length of the header
+
+    @param[in]
+        bodyEncoding
+            content encoding of the body which will follow
+
+    @retval EOK the header was written
+    @retval EINVAL invalid arguments
+    @retval other error sending the response
+
+==============================================================================*/
+int Response_Header( Response *pResponse,
+                     const char *header,
+                     size_t len,
+                     CompressEncoding bodyEncoding )
+{
+    int result = EINVAL;
+    bool start;
+
+    if ( ( pResponse != NULL ) && ( header != NULL ) && ( len >= 2 ) )
+    {
+        start = ( pResponse->len == 0 ) && ( pResponse->sent == 0 );
+
+        if ( bodyEncoding == COMPRESS_IDENTITY )
+        {
+            result = Response_Write( pResponse, header, len );
+            if ( ( result == EOK ) && ( start == true ) )
+            {
+                pResponse->headerLen = len;
+            }
+        }
+        else
+        {
+            /* replace the empty line with the encoding headers */
+            result = Response_Write( pResponse, header, len - 2 );
+            if ( result == EOK )
+            {
+                result = Response_Printf( pResponse,
+                                          RESPONSE_ENCODING_HEADER,
+                                          Compress_Name( bodyEncoding ) );
+            }
+
+            pResponse->encoding = COMPRESS_IDENTITY;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Response_Body                                                             */
+/*!
+    Get the body of the response
+
+    The Response_Body function gets the body written after the
+    Response_Header, if the complete body is still in the response
+    buffer.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[out]
+        pLen
+            pointer to a location to store the body length
+
+    @retval pointer to the response body
+    @retval NULL the body is not available
+
+==============================================================================*/
+const char *Response_Body( Response *pResponse, size_t *pLen )
+{
+    const char *body = NULL;
+
+    if ( ( pResponse != NULL ) &&
+         ( pLen != NULL ) &&
+         ( pResponse->headerLen > 0 ) &&
+         ( pResponse->sent == 0 ) )
+    {
+        body = &pResponse->buf[pResponse->headerLen];
+        *pLen = pResponse->len - pResponse->headerLen;
+    }
+
+    return body;
+}
+
+/*============================================================================*/
+/*  Response_Write                                                            */
+/*!
+    Append data to the response
+
+    The Response_Write function appends data to the response buffer,
+    sending the buffer as FCGI_STDOUT records whenever it fills.
+    It can be used as an OutputFn with a Response object argument.
+
+    @param[in]
+        arg
+            pointer to the Response object
+
+    @param[in]
+        buf
+            pointer to the data to append
+
+    @param[in]
+        len
+            number of bytes to append
+
+    @retval EOK the data was appended
+    @retval EINVAL invalid arguments
+    @retval other error sending the response
+
+==============================================================================*/
+int Response_Write( void *arg, const char *buf, size_t len )
+{
+    Response *pResponse = (Response *)arg;
+    int result = EINVAL;
+    char *p;
+    size_t available;
+    size_t n;
+
+    if ( ( pResponse != NULL ) && ( buf != NULL ) )
+    {
+        result = EOK;
+
+        while ( ( len > 0 ) && ( result == EOK ) )
+        {
+            p = Response_Reserve( pResponse, &available );
+            if ( p != NULL )
+            {
+                n = ( len < available ) ? len : available;
+                memcpy( p, buf, n );
+                Response_Commit( pResponse, n );
+                buf += n;
+                len -= n;
+            }
+            else
+            {
+                result = EIO;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Response_WriteV                                                           */
+/*!
+    Append a gathered list of buffers to the response
+
+    The Response_WriteV function appends each of the buffers in turn
+    to the response buffer, sending it whenever it fills.  It can be
+    used as an OutputVFn with a Response object argument.
+
+    @param[in]
+        arg
+            pointer to the Response object
+
+    @param[in]
+        iov
+            pointer to the array of buffers to append
+
+    @param[in]
+        iovcnt
+            number of buffers in the array
+
+    @retval EOK the data was appended
+    @retval EINVAL invalid arguments
+    @retval other error sending the response
+
+==============================================================================*/
+int Response_WriteV( void *arg, const struct iovec *iov, int iovcnt )
+{
+    int result = EINVAL;
+    int i;
+
+    if ( ( arg != NULL ) && ( iov != NULL ) )
+    {
+        result = EOK;
+
+        for ( i = 0; ( i < iovcnt ) && ( result == EOK ); i++ )
+        {
+            if ( iov[i].iov_len > 0 )
+            {
+                result = Response_Write( arg,
+                                         iov[i].iov_base,
+                                         iov[i].iov_len );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Response_Printf                                                           */
+/*!
+    Append formatted text to the response
+
+    The Response_Printf function formats text directly into the response
+    buffer.  Text which does not fit in an empty buffer is truncated.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        format
+            printf format string
+
+    @retval EOK the text was appended
+    @retval EINVAL invalid arguments
+    @retval other error sending the response
+
+==============================================================================*/
+int Response_Printf( Response *pResponse, const char *format, ... )
+{
+    int result = EINVAL;
+    va_list args;
+    char *p;
+    size_t available;
+    size_t len;
+    int n;
+
+    if ( ( pResponse != NULL ) && ( format != NULL ) )
+    {
+        p = Response_Reserve( pResponse, &available );
+        if ( p != NULL )
+        {
+            va_start( args, format );
+            n = vsnprintf( p, available, format, args );
+            va_end( args );
+
+            if ( ( n >= 0 ) &&
+                 ( (size_t)n >= available ) &&
+                 ( pResponse->len > 0 ) )
+            {
+                /* send what we have and format again into the empty buffer */
+                result = Response_Flush( pResponse );
+                if ( result == EOK )
+                {
+                    p = Response_Reserve( pResponse, &available );
+                    va_start( args, format );
+                    n = vsnprintf( p, available, format, args );
+                    va_end( args );
+                }
+            }
+
+            if ( n >= 0 )
+            {
+                len = (size_t)n;
+                Response_Commit( pResponse,
+                                 ( len < available ) ? len : available - 1 );
+                result = EOK;
+            }
+            else
+            {
+                result = EINVAL;
+            }
+        }
+        else
+        {
+            result = EIO;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Response_Reserve                                                          */
+/*!
+    Get the free space in the response buffer
+
+    The Response_Reserve function gets a pointer to the free space at the
+    end of the response buffer, so that data can be read or formatted
+    directly into it.  If the buffer is full it is sent first.  The data
+    is added to the response by Response_Commit.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[out]
+        pAvailable
+            pointer to a location to store the number of free bytes
+
+    @retval pointer to the free space
+    @retval NULL the full buffer could not be sent
+
+==============================================================================*/
+char *Response_Reserve( Response *pResponse, size_t *pAvailable )
+{
+    char *p = NULL;
+
+    if ( ( pResponse != NULL ) && ( pAvailable != NULL ) )
+    {
+        if ( ( pResponse->len < pResponse->size ) ||
+             ( Response_Flush( pResponse ) == EOK ) )
+        {
+            p = &pResponse->buf[pResponse->len];
+            *pAvailable = pResponse->size - pResponse->len;
+        }
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*  Response_Commit                                                           */
+/*!
+    Add reserved data to the response
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        len
+            number of bytes written into the space from Response_Reserve
+
+==============================================================================*/
+void Response_Commit( Response *pResponse, size_t len )
+{
+    if ( ( pResponse != NULL ) &&
+         ( len <= pResponse->size - pResponse->len ) )
+    {
+        pResponse->len += len;
+        if ( pResponse->len > pResponse->highWater )
+        {
+            pResponse->highWater = pResponse->len;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Response_Flush                                                            */
+/*!
+    Send the buffered response data
+
+    The Response_Flush function sends the buffered data as FCGI_STDOUT
+    records and empties the buffer.  It is only needed when a response
+    is larger than the response buffer.  A response being flushed is
+    large enough to compress if an encoding has been set.
+
+    A response without a request only collects data, so its buffer is
+    grown instead.  The grown buffer is kept for the following responses.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @retval EOK the buffered data was sent, or the buffer was grown
+    @retval ENOMEM cannot grow the buffer of a response without a request
+    @retval EINVAL invalid arguments
+    @retval other error sending the response
+
+==============================================================================*/
+int Response_Flush( Response *pResponse )
+{
+    int result = EINVAL;
+
+    if ( ( pResponse != NULL ) && ( pResponse->finished == false ) )
+    {
+        result = ( pResponse->pRequest != NULL )
+                    ? Output( pResponse, false, 0 )
+                    : Grow( pResponse );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Response_Splice                                                           */
+/*!
+    Send data from a pipe without copying it
+
+    The Response_Splice function sends the buffered data followed by
+    data waiting in a pipe, eg the output of a command, as FCGI_STDOUT
+    records.  The pipe data is moved to the connection with splice.
+    Each record header is sent first, together with any buffered data,
+    and the content is spliced after it.  Data is only spliced into an
+    uncompressed response.
+
+    If sending fails once a record header has been sent, the record
+    cannot be completed, so the response is aborted (see Response_Abort).
+    The number of bytes taken from the pipe is reported either way, so
+    the caller can deal with the rest of them.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        fd
+            read end of the pipe
+
+    @param[in]
+        len
+            number of bytes to send, which must already be in the pipe
+
+    @param[out]
+        pMoved
+            pointer to the location to store the number of bytes taken
+            from the pipe
+
+    @retval EOK the data was sent
+    @retval ENOTSUP the response may be compressed
+    @retval ENOTCONN the response has no request to send it on
+    @retval EINVAL invalid arguments
+    @retval other error sending the response
+
+==============================================================================*/
+int Response_Splice( Response *pResponse,
+                     int fd,
+                     size_t len,
+                     size_t *pMoved )
+{
+    int result = EINVAL;
+    RecordHeader header;
+    struct iovec iov[2];
+    size_t n;
+    int iovcnt;
+
+    if ( ( pResponse != NULL ) && ( fd >= 0 ) && ( pMoved != NULL ) )
+    {
+        *pMoved = 0;
+
+        if ( ( pResponse->pRequest == NULL ) ||
+             ( pResponse->finished == true ) )
+        {
+            result = ENOTCONN;
+        }
+        else if ( ( pResponse->encoding != COMPRESS_IDENTITY ) ||
+                  ( pResponse->compressing == true ) )
+        {
+            result = ENOTSUP;
+        }
+        else
+        {
+            result = ( pResponse->len < FCGI_RECORD_MAX_CONTENT )
+                        ? EOK
+                        : Output( pResponse, false, 0 );
+        }
+
+        while ( ( len > 0 ) && ( result == EOK ) )
+        {
+            /* fill the record with the buffered data first */
+            n = FCGI_RECORD_MAX_CONTENT - pResponse->len;
+            if ( n > len )
+            {
+                n = len;
+            }
+
+            MakeHeader( &header,
+                        FCGI_RECORD_STDOUT,
+                        pResponse->pRequest->requestId,
+                        pResponse->len + n );
+            iov[0].iov_base = &header;
+            iov[0].iov_len = FCGI_RECORD_HEADER_LEN;
+            iov[1].iov_base = pResponse->buf;
+            iov[1].iov_len = pResponse->len;
+            iovcnt = ( pResponse->len > 0 ) ? 2 : 1;
+
+            result = WriteAll( pResponse, iov, iovcnt, MSG_MORE );
+            pResponse->len = 0;
+            pResponse->headerLen = 0;
+
+            if ( result == EOK )
+            {
+                result = SpliceAll( pResponse, fd, n, pMoved );
+            }
+
+            if ( result != EOK )
+            {
+                /* the record header may have gone out without all of
+                 * its content, which leaves the connection unusable */
+                Response_Abort( pResponse );
+            }
+
+            len -= n;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Response_Finish                                                           */
+/*!
+    Complete the response
+
+    The Response_Finish function sends the remaining buffered data,
+    the end of the FCGI_STDOUT stream and the FCGI_END_REQUEST record
+    in a single gathered write, and marks the request's output stream
+    as closed so libfcgi does not close it again.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        appStatus
+            application status for the FCGI_END_REQUEST record
+
+    @retval EOK the response was completed
+    @retval EALREADY the response was already completed
+    @retval EINVAL invalid arguments
+    @retval other error sending the response
+
+==============================================================================*/
+int Response_Finish( Response *pResponse, int appStatus )
+{
+    int result = EINVAL;
+
+    if ( ( pResponse != NULL ) && ( pResponse->pRequest != NULL ) )
+    {
+        if ( pResponse->finished == false )
+        {
+            result = Output( pResponse, true, appStatus );
+
+            pResponse->finished = true;
+
+            /* the closing records have been written, so stop libfcgi
+             * from writing them again in FCGX_Finish_r */
+            if ( pResponse->pRequest->out != NULL )
+            {
+                pResponse->pRequest->out->wasFCloseCalled = 1;
+                pResponse->pRequest->out->isClosed = 1;
+            }
+        }
+        else
+        {
+            result = EALREADY;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Response_Discard                                                          */
+/*!
+    Discard the buffered response data
+
+    The Response_Discard function drops the response data which has not
+    been sent yet, so a different response (eg an error response) can
+    be written in its place.  This is only possible while none of the
+    response has been sent.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @retval EOK the buffered data was discarded
+    @retval EBUSY part of the response has already been sent
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Response_Discard( Response *pResponse )
+{
+    int result = EINVAL;
+
+    if ( pResponse != NULL )
+    {
+        if ( ( pResponse->writes == 0 ) && ( pResponse->finished == false ) )
+        {
+            Response_Begin( pResponse, pResponse->pRequest );
+            result = EOK;
+        }
+        else
+        {
+            result = EBUSY;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Response_Abort                                                            */
+/*!
+    Abort a response which cannot be completed
+
+    The Response_Abort function shuts down the FastCGI connection of a
+    response which was partly sent, without sending the end of request
+    record.  The web server then reports the response as failed, rather
+    than passing on a truncated response as complete.  The request's
+    output stream is marked as closed so that libfcgi does not write
+    to the connection again, and the connection is not kept open.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @retval EOK the response was aborted
+    @retval EALREADY the response was already completed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Response_Abort( Response *pResponse )
+{
+    int result = EINVAL;
+
+    if ( ( pResponse != NULL ) && ( pResponse->pRequest != NULL ) )
+    {
+        if ( pResponse->finished == false )
+        {
+            (void)shutdown( pResponse->pRequest->ipcFd, SHUT_RDWR );
+
+            pResponse->finished = true;
+            pResponse->len = 0;
+            pResponse->pRequest->keepConnection = 0;
+
+            if ( pResponse->pRequest->out != NULL )
+            {
+                pResponse->pRequest->out->wasFCloseCalled = 1;
+                pResponse->pRequest->out->isClosed = 1;
+            }
+
+            result = EOK;
+        }
+        else
+        {
+            result = EALREADY;
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  MakeHeader                                                                */
+/*!
+    Build a FastCGI record header
+
+    @param[out]
+        pHeader
+            pointer to the header to build
+
+    @param[in]
+        type
+            record type
+
+    @param[in]
+        requestId
+            FastCGI request id
+
+    @param[in]
+        contentLength
+            record content length (at most 65535)
+
+==============================================================================*/
+static void MakeHeader( RecordHeader *pHeader,
+                        int type,
+                        int requestId,
+                        size_t contentLength )
+{
+    pHeader->version = FCGI_RECORD_VERSION;
+    pHeader->type = (unsigned char)type;
+    pHeader->requestIdB1 = (unsigned char)( ( requestId >> 8 ) & 0xFF );
+    pHeader->requestIdB0 = (unsigned char)( requestId & 0xFF );
+    pHeader->contentLengthB1 = (unsigned char)( ( contentLength >> 8 ) & 0xFF );
+    pHeader->contentLengthB0 = (unsigned char)( contentLength & 0xFF );
+    pHeader->paddingLength = 0;
+    pHeader->reserved = 0;
+}
+
+/*============================================================================*/
+/*  Grow                                                                      */
+/*!
+    Double the size of the response buffer
+
+    The Grow function enlarges the buffer of a response which collects
+    data without sending it, eg captured command output.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @retval EOK the buffer was grown
+    @retval ENOMEM cannot allocate the larger buffer
+
+==============================================================================*/
+static int Grow( Response *pResponse )
+{
+    int result = ENOMEM;
+    size_t size = 2 * pResponse->size;
+    char *buf;
+
+    buf = realloc( pResponse->buf, size );
+    if ( buf != NULL )
+    {
+        pResponse->buf = buf;
+        pResponse->size = size;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Output                                                                    */
+/*!
+    Send the buffered response data
+
+    The Output function sends the buffered response data, compressing
+    the body if an encoding has been set and the body is large enough,
+    and empties the buffer.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        final
+            true to complete the response
+
+    @param[in]
+        appStatus
+            application status for the FCGI_END_REQUEST record
+
+    @retval EOK the data was sent
+    @retval other error sending the response
+
+==============================================================================*/
+static int Output( Response *pResponse, bool final, int appStatus )
+{
+    int result;
+
+    if ( ( pResponse->compressing == false ) &&
+         ( pResponse->encoding != COMPRESS_IDENTITY ) &&
+         ( pResponse->headerLen > 0 ) &&
+         ( ( final == false ) ||
+           ( pResponse->len - pResponse->headerLen >= COMPRESS_MIN_LENGTH ) ) &&
+         ( Compress_Begin( &pResponse->compressor,
+                           pResponse->encoding ) == EOK ) )
+    {
+        pResponse->compressing = true;
+    }
+
+    if ( pResponse->compressing == true )
+    {
+        result = Compress( pResponse, final, appStatus );
+    }
+    else
+    {
+        result = Send( pResponse,
+                       pResponse->buf,
+                       pResponse->len,
+                       final,
+                       appStatus );
+    }
+
+    pResponse->len = 0;
+    pResponse->headerLen = 0;
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Compress                                                                  */
+/*!
+    Compress and send the buffered response data
+
+    The Compress function compresses the buffered body into the
+    compressed output buffer and sends it.  The first time it is called
+    for a response, the header with the encoding headers added is placed
+    ahead of the compressed body.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        final
+            true to end the compressed stream and complete the response
+
+    @param[in]
+        appStatus
+            application status for the FCGI_END_REQUEST record
+
+    @retval EOK the data was sent
+    @retval EIO compression error
+    @retval other error sending the response
+
+==============================================================================*/
+static int Compress( Response *pResponse, bool final, int appStatus )
+{
+    int result = EOK;
+    const char *in = &pResponse->buf[pResponse->headerLen];
+    size_t inLen = pResponse->len - pResponse->headerLen;
+    size_t zlen = 0;
+    size_t consumed;
+    size_t produced;
+    int rc;
+    int n;
+
+    if ( pResponse->headerLen > 0 )
+    {
+        /* header without its empty line, followed by the encoding headers */
+        zlen = pResponse->headerLen - 2;
+        memcpy( pResponse->zbuf, pResponse->buf, zlen );
+        n = snprintf( &pResponse->zbuf[zlen],
+                      pResponse->zsize - zlen,
+                      RESPONSE_ENCODING_HEADER,
+                      Compress_Name( pResponse->encoding ) );
+        zlen += ( n > 0 ) ? n : 0;
+    }
+
+    do
+    {
+        rc = Compress_Run( &pResponse->compressor,
+                           in,
+                           inLen,
+                           &consumed,
+                           &pResponse->zbuf[zlen],
+                           pResponse->zsize - zlen,
+                           &produced,
+                           final );
+        in += consumed;
+        inLen -= consumed;
+        zlen += produced;
+
+        if ( rc == EAGAIN )
+        {
+            /* the compressed output buffer is full */
+            result = Send( pResponse, pResponse->zbuf, zlen, false, 0 );
+            zlen = 0;
+        }
+    } while ( ( rc == EAGAIN ) && ( result == EOK ) );
+
+    if ( ( rc != EOK ) && ( result == EOK ) )
+    {
+        result = EIO;
+    }
+
+    if ( result == EOK )
+    {
+        result = Send( pResponse, pResponse->zbuf, zlen, final, appStatus );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Send                                                                      */
+/*!
+    Send data as FastCGI records
+
+    The Send function splits the data into maximal FCGI_STDOUT
+    records, optionally followed by the closing records, and sends them
+    all with a single gathered write.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        data
+            pointer to the data to send
+
+    @param[in]
+        len
+            number of bytes to send
+
+    @param[in]
+        final
+            true to append the closing records
+
+    @param[in]
+        appStatus
+            application status for the FCGI_END_REQUEST record
+
+    @retval EOK the records were sent
+    @retval ENOTCONN the response has no request
+    @retval other error from the write
+
+==============================================================================*/
+static int Send( Response *pResponse,
+                 const char *data,
+                 size_t len,
+                 bool final,
+                 int appStatus )
+{
+    int result = EOK;
+    RecordHeader headers[RESPONSE_MAX_RECORDS];
+    struct iovec iov[2 * RESPONSE_MAX_RECORDS + 1];
+    CloseRecords close;
+    FCGX_Request *pRequest = pResponse->pRequest;
+    size_t offset = 0;
+    size_t n;
+    int nrec = 0;
+    int iovcnt = 0;
+
+    if ( pRequest == NULL )
+    {
+        return ENOTCONN;
+    }
+
+    while ( ( offset < len ) && ( result == EOK ) )
+    {
+        n = len - offset;
+        if ( n > FCGI_RECORD_MAX_CONTENT )
+        {
+            n = FCGI_RECORD_MAX_CONTENT;
+        }
+
+        MakeHeader( &headers[nrec],
+                    FCGI_RECORD_STDOUT,
+                    pRequest->requestId,
+                    n );
+        iov[iovcnt].iov_base = &headers[nrec];
+        iov[iovcnt++].iov_len = FCGI_RECORD_HEADER_LEN;
+        iov[iovcnt].iov_base = (char *)&data[offset];
+        iov[iovcnt++].iov_len = n;
+        nrec++;
+        offset += n;
+
+        if ( ( nrec == RESPONSE_MAX_RECORDS ) && ( offset < len ) )
+        {
+            /* more records than fit in a gathered write */
+            result = WriteAll( pResponse, iov, iovcnt, 0 );
+            nrec = 0;
+            iovcnt = 0;
+        }
+    }
+
+    if ( ( result == EOK ) && ( final == true ) )
+    {
+        memset( &close, 0, sizeof( close ) );
+        MakeHeader( &close.stdoutEnd,
+                    FCGI_RECORD_STDOUT,
+                    pRequest->requestId,
+                    0 );
+        MakeHeader( &close.endRequest,
+                    FCGI_RECORD_END_REQUEST,
+                    pRequest->requestId,
+                    8 );
+        close.appStatus[0] = (unsigned char)( ( appStatus >> 24 ) & 0xFF );
+        close.appStatus[1] = (unsigned char)( ( appStatus >> 16 ) & 0xFF );
+        close.appStatus[2] = (unsigned char)( ( appStatus >> 8 ) & 0xFF );
+        close.appStatus[3] = (unsigned char)( appStatus & 0xFF );
+        close.protocolStatus = FCGI_RECORD_COMPLETE;
+
+        iov[iovcnt].iov_base = &close;
+        iov[iovcnt++].iov_len = sizeof( close );
+    }
+
+    if ( ( result == EOK ) && ( iovcnt > 0 ) )
+    {
+        result = WriteAll( pResponse, iov, iovcnt, 0 );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WriteAll                                                                  */
+/*!
+    Write a gathered buffer list to the FastCGI connection
+
+    The WriteAll function writes all the buffers, continuing after
+    partial writes and interrupted system calls.  SIGPIPE is suppressed
+    if the web server has closed the connection.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        iov
+            array of buffers to write.  The array is modified.
+
+    @param[in]
+        iovcnt
+            number of buffers in the array
+
+    @param[in]
+        flags
+            additional sendmsg flags, eg MSG_MORE when more data follows
+
+    @retval EOK all the buffers were written
+    @retval other error from sendmsg
+
+==============================================================================*/
+static int WriteAll( Response *pResponse,
+                     struct iovec *iov,
+                     int iovcnt,
+                     int flags )
+{
+    int result = EOK;
+    struct msghdr msg;
+    ssize_t n;
+
+    while ( ( iovcnt > 0 ) && ( result == EOK ) )
+    {
+        memset( &msg, 0, sizeof( msg ) );
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        n = sendmsg( pResponse->pRequest->ipcFd, &msg, MSG_NOSIGNAL | flags );
+        pResponse->writes++;
+
+        if ( n < 0 )
+        {
+            if ( errno == ENOTSOCK )
+            {
+                n = writev( pResponse->pRequest->ipcFd, iov, iovcnt );
+            }
+
+            if ( n < 0 )
+            {
+                if ( errno != EINTR )
+                {
+                    result = errno;
+                }
+
+                continue;
+            }
+        }
+
+        pResponse->sent += n;
+
+        /* skip the buffers which were completely written */
+        while ( ( iovcnt > 0 ) && ( (size_t)n >= iov->iov_len ) )
+        {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if ( iovcnt > 0 )
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SpliceAll                                                                 */
+/*!
+    Move data from a pipe to the FastCGI connection
+
+    The SpliceAll function moves the specified number of bytes, which
+    must already be in the pipe, to the connection with splice.  If the
+    connection does not support splice (eg it is a terminal), the data
+    is copied through the response buffer instead, which must be empty.
+
+    @param[in]
+        pResponse
+            pointer to the response object
+
+    @param[in]
+        fd
+            read end of the pipe
+
+    @param[in]
+        len
+            number of bytes to move
+
+    @param[in,out]
+        pMoved
+            pointer to the count of bytes taken from the pipe, which is
+            increased by the number of bytes moved
+
+    @retval EOK the data was sent
+    @retval EIO the pipe held less data than expected
+    @retval other error from splice, read or the write
+
+==============================================================================*/
+static int SpliceAll( Response *pResponse,
+                      int fd,
+                      size_t len,
+                      size_t *pMoved )
+{
+    int result = EOK;
+    bool copy = false;
+    struct iovec iov;
+    ssize_t n;
+
+    while ( ( len > 0 ) && ( result == EOK ) )
+    {
+        if ( copy == false )
+        {
+            n = splice( fd,
+                        NULL,
+                        pResponse->pRequest->ipcFd,
+                        NULL,
+                        len,
+                        SPLICE_F_MOVE | SPLICE_F_MORE );
+            pResponse->writes++;
+            if ( n > 0 )
+            {
+                pResponse->sent += n;
+            }
+            else if ( ( n < 0 ) && ( errno == EINVAL ) )
+            {
+                copy = true;
+                continue;
+            }
+        }
+        else
+        {
+            n = read( fd,
+                      pResponse->buf,
+                      ( len < pResponse->size ) ? len : pResponse->size );
+            if ( n > 0 )
+            {
+                iov.iov_base = pResponse->buf;
+                iov.iov_len = n;
+                result = WriteAll( pResponse, &iov, 1, MSG_MORE );
+            }
+        }
+
+        if ( n > 0 )
+        {
+            len -= n;
+            *pMoved += n;
+        }
+        else if ( n == 0 )
+        {
+            result = EIO;
+        }
+        else if ( errno != EINTR )
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of response group */
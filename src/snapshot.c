@@ -0,0 +1,353 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup snapshot snapshot
+ * @brief Epoch based snapshot publication
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file snapshot.c
+
+    Snapshot Publication
+
+    The snapshot module publishes an immutable object, such as the
+    typed process table, to readers through an atomic pointer.
+    Readers never take a lock: a reader announces the current epoch,
+    then loads the pointer, and may use the object until it exits.
+
+    A writer prepares the next object in a spare, publishes it, and
+    retires the object it replaces, tagged with the epoch in which it
+    was published.  A retired object is only reused once every reader
+    is idle or has announced a later epoch, so no reader can still
+    hold it.  Writers must be serialized by the caller.
+
+    All operations use sequentially consistent atomics, so a reader
+    whose announcement is not seen by a writer is guaranteed to load
+    the newly published pointer.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include "snapshot.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static bool Reachable( Snapshot *pSnapshot, uint64_t epoch );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Snapshot_Init                                                             */
+/*!
+    Initialize a snapshot
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot to initialize
+
+    @param[in]
+        current
+            pointer to the initially published object
+
+==============================================================================*/
+void Snapshot_Init( Snapshot *pSnapshot, void *current )
+{
+    if ( pSnapshot != NULL )
+    {
+        memset( pSnapshot, 0, sizeof( Snapshot ) );
+        pSnapshot->current = current;
+        pSnapshot->epoch = 1;
+    }
+}
+
+/*============================================================================*/
+/*  Snapshot_Add                                                              */
+/*!
+    Add a spare object
+
+    The Snapshot_Add function adds an object which is not visible to
+    readers to the objects available to the writer, eg an initial spare
+    or a prepared object which was not published.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        spare
+            pointer to the spare object
+
+    @retval EOK the object was added
+    @retval ENOSPC too many objects are awaiting reuse
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Snapshot_Add( Snapshot *pSnapshot, void *spare )
+{
+    int result = EINVAL;
+
+    if ( ( pSnapshot != NULL ) && ( spare != NULL ) )
+    {
+        if ( pSnapshot->numRetired < SNAPSHOT_MAX_RETIRED )
+        {
+            /* no reader announces epoch 0, so it is free at once */
+            pSnapshot->retired[pSnapshot->numRetired] = spare;
+            pSnapshot->retiredEpoch[pSnapshot->numRetired++] = 0;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOSPC;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Snapshot_Enter                                                            */
+/*!
+    Start reading the published object
+
+    The Snapshot_Enter function announces the reader in the current
+    epoch and returns the published object, which remains valid until
+    the reader calls Snapshot_Exit.  Entering again refreshes the
+    object.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        reader
+            index of the reader, less than SNAPSHOT_MAX_READERS
+
+    @retval pointer to the published object
+    @retval NULL invalid arguments
+
+==============================================================================*/
+const void *Snapshot_Enter( Snapshot *pSnapshot, size_t reader )
+{
+    const void *current = NULL;
+
+    if ( ( pSnapshot != NULL ) && ( reader < SNAPSHOT_MAX_READERS ) )
+    {
+        __atomic_store_n( &pSnapshot->readers[reader],
+                          __atomic_load_n( &pSnapshot->epoch,
+                                           __ATOMIC_SEQ_CST ),
+                          __ATOMIC_SEQ_CST );
+        current = __atomic_load_n( &pSnapshot->current, __ATOMIC_SEQ_CST );
+    }
+
+    return current;
+}
+
+/*============================================================================*/
+/*  Snapshot_Exit                                                             */
+/*!
+    Stop reading the published object
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        reader
+            index of the reader
+
+==============================================================================*/
+void Snapshot_Exit( Snapshot *pSnapshot, size_t reader )
+{
+    if ( ( pSnapshot != NULL ) && ( reader < SNAPSHOT_MAX_READERS ) )
+    {
+        __atomic_store_n( &pSnapshot->readers[reader], 0, __ATOMIC_SEQ_CST );
+    }
+}
+
+/*============================================================================*/
+/*  Snapshot_Current                                                          */
+/*!
+    Get the published object for the writer
+
+    The Snapshot_Current function returns the published object to the
+    writer, eg to prepare the next object from it.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @retval pointer to the published object
+    @retval NULL invalid arguments
+
+==============================================================================*/
+void *Snapshot_Current( Snapshot *pSnapshot )
+{
+    return ( pSnapshot != NULL )
+            ? __atomic_load_n( &pSnapshot->current, __ATOMIC_SEQ_CST )
+            : NULL;
+}
+
+/*============================================================================*/
+/*  Snapshot_Reclaim                                                          */
+/*!
+    Reclaim a retired object
+
+    The Snapshot_Reclaim function removes and returns a retired object
+    which no reader can still hold, for the writer to prepare the next
+    object in.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @retval pointer to the reclaimed object
+    @retval NULL every retired object may still be in use
+
+==============================================================================*/
+void *Snapshot_Reclaim( Snapshot *pSnapshot )
+{
+    void *object = NULL;
+    size_t i;
+
+    if ( pSnapshot != NULL )
+    {
+        for ( i = 0; i < pSnapshot->numRetired; i++ )
+        {
+            if ( Reachable( pSnapshot, pSnapshot->retiredEpoch[i] ) == false )
+            {
+                object = pSnapshot->retired[i];
+
+                pSnapshot->numRetired--;
+                pSnapshot->retired[i] =
+                    pSnapshot->retired[pSnapshot->numRetired];
+                pSnapshot->retiredEpoch[i] =
+                    pSnapshot->retiredEpoch[pSnapshot->numRetired];
+                break;
+            }
+        }
+    }
+
+    return object;
+}
+
+/*============================================================================*/
+/*  Snapshot_Publish                                                          */
+/*!
+    Publish the next object
+
+    The Snapshot_Publish function makes the next object visible to
+    readers which enter from now on, and retires the object it
+    replaces.  The next object must have been obtained from
+    Snapshot_Reclaim, so there is always room to retire the old one.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        next
+            pointer to the next object
+
+==============================================================================*/
+void Snapshot_Publish( Snapshot *pSnapshot, void *next )
+{
+    void *previous;
+    uint64_t epoch;
+
+    if ( ( pSnapshot != NULL ) &&
+         ( next != NULL ) &&
+         ( pSnapshot->numRetired < SNAPSHOT_MAX_RETIRED ) )
+    {
+        previous = __atomic_exchange_n( &pSnapshot->current,
+                                        next,
+                                        __ATOMIC_SEQ_CST );
+        epoch = __atomic_fetch_add( &pSnapshot->epoch, 1, __ATOMIC_SEQ_CST );
+
+        /* readers which announced this epoch or earlier may hold it */
+        pSnapshot->retired[pSnapshot->numRetired] = previous;
+        pSnapshot->retiredEpoch[pSnapshot->numRetired++] = epoch;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Reachable                                                                 */
+/*!
+    Check if readers may hold an object retired in an epoch
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        epoch
+            epoch in which the object was last published
+
+    @retval true a reader announced the epoch or an earlier one
+    @retval false no reader can hold the object
+
+==============================================================================*/
+static bool Reachable( Snapshot *pSnapshot, uint64_t epoch )
+{
+    bool reachable = false;
+    uint64_t announced;
+    size_t i;
+
+    for ( i = 0; ( i < SNAPSHOT_MAX_READERS ) && ( reachable == false ); i++ )
+    {
+        announced = __atomic_load_n( &pSnapshot->readers[i],
+                                     __ATOMIC_SEQ_CST );
+        reachable = ( announced != 0 ) && ( announced <= epoch );
+    }
+
+    return reachable;
+}
+
+/*! @}
+ * end of snapshot group */
@@ -0,0 +1,236 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup spawn spawn
+ * @brief Command execution
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file spawn.c
+
+    Command Execution
+
+    The spawn module runs a command with its standard output connected
+    to a pipe, and waits for it to exit.  It is shared by the procmon
+    invocations for requests, batch actions and backends.
+
+    The command is started with vfork, which suspends the caller until
+    the child has called exec, so a command is started quickly however
+    large fcgi_proc is.  The vfork is made from a small function of its
+    own which is never inlined, so the locals of the callers cannot be
+    clobbered by the child.  Only the calling thread is suspended, so
+    commands may be started from any thread.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "spawn.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static pid_t Exec( char * const argv[], int fd ) __attribute__(( noinline ));
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Spawn_Command                                                             */
+/*!
+    Run a command with its output connected to a pipe
+
+    The Spawn_Command function runs a command directly (without a shell)
+    with its standard output connected to a new pipe, and returns the
+    read end of the pipe.  The read end is blocking and close-on-exec.
+    The pipe can be enlarged before the command is started, so that the
+    command can write its output without waiting for it to be read.
+
+    @param[in]
+        argv
+            NULL terminated argument vector of the command.  argv[0] is
+            the full path of the command.
+
+    @param[in]
+        pipeSize
+            requested capacity of the pipe, or 0 for the default.  The
+            pipe keeps its default size if it cannot be enlarged.
+
+    @param[out]
+        pPid
+            pointer to the location to store the process id of the
+            command, which must be reaped with Spawn_Wait
+
+    @param[out]
+        pFd
+            pointer to the location to store the read end of the pipe
+
+    @retval EOK the command was started
+    @retval ENOENT the command could not be started
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Spawn_Command( char * const argv[], int pipeSize, pid_t *pPid, int *pFd )
+{
+    int result = EINVAL;
+    int fd[2];
+    pid_t pid;
+
+    if ( ( argv != NULL ) &&
+         ( argv[0] != NULL ) &&
+         ( pPid != NULL ) &&
+         ( pFd != NULL ) )
+    {
+        result = ENOENT;
+
+        if ( pipe2( fd, O_CLOEXEC ) == 0 )
+        {
+            if ( pipeSize > 0 )
+            {
+                fcntl( fd[0], F_SETPIPE_SZ, pipeSize );
+            }
+
+            pid = Exec( argv, fd[1] );
+
+            /* the parent only reads from the pipe */
+            close( fd[1] );
+
+            if ( pid > 0 )
+            {
+                *pPid = pid;
+                *pFd = fd[0];
+                result = EOK;
+            }
+            else
+            {
+                close( fd[0] );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Spawn_Wait                                                                */
+/*!
+    Wait for a command to exit
+
+    @param[in]
+        pid
+            process id of the command
+
+    @retval the wait status of the command
+    @retval -1 the command could not be waited for
+
+==============================================================================*/
+int Spawn_Wait( pid_t pid )
+{
+    int status = -1;
+
+    while ( ( waitpid( pid, &status, 0 ) < 0 ) && ( errno == EINTR ) );
+
+    return status;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Exec                                                                      */
+/*!
+    Start a command with its standard output connected to a descriptor
+
+    The Exec function is kept apart from its callers, and has no locals
+    other than the process id, so the vfork child cannot clobber state
+    the parent uses after it resumes.
+
+    @param[in]
+        argv
+            NULL terminated argument vector of the command
+
+    @param[in]
+        fd
+            close-on-exec descriptor to connect to standard output
+
+    @retval process id of the command
+    @retval -1 the command could not be started
+
+==============================================================================*/
+static pid_t Exec( char * const argv[], int fd )
+{
+    pid_t pid = vfork();
+
+    if ( pid == 0 )
+    {
+        /* child: the server ignores SIGPIPE, which the command would
+         * otherwise inherit */
+        signal( SIGPIPE, SIG_DFL );
+
+        /* connect stdout to the pipe and run the command */
+        if ( fd == STDOUT_FILENO )
+        {
+            fcntl( fd, F_SETFD, 0 );
+            execv( argv[0], argv );
+        }
+        else if ( dup2( fd, STDOUT_FILENO ) != -1 )
+        {
+            execv( argv[0], argv );
+        }
+
+        _exit( 127 );
+    }
+
+    return pid;
+}
+
+/*! @}
+ * end of spawn group */
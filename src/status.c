@@ -0,0 +1,721 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup status status
+ * @brief Internal status reporting
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file status.c
+
+    Internal Status
+
+    The status module tracks what each request worker is doing, the
+    procmon children in flight, and the high-water marks of the
+    preallocated request buffers.
+
+    Each record is protected by its own sequence lock.  Writers never
+    block, and the status report takes a consistent snapshot of each
+    record without stopping the workers.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "status.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! maximum number of procmon children tracked */
+#define STATUS_MAX_CHILDREN     32
+
+/*! maximum length of a tracked name */
+#define STATUS_MAX_NAME_LEN     32
+
+/*! maximum length of a tracked command */
+#define STATUS_MAX_CMD_LEN      128
+
+/*! maximum length of a formatted status record */
+#define STATUS_MAX_RECORD_LEN   512
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! worker activity */
+typedef struct _WorkerInfo
+{
+    /*! true while the worker is processing a request */
+    bool busy;
+
+    /*! identifier of the current request */
+    uint64_t reqid;
+
+    /*! time the current request started (ms) */
+    uint64_t since;
+
+    /*! query action of the current request */
+    char action[STATUS_MAX_NAME_LEN];
+
+    /*! process name of the current request */
+    char procname[STATUS_MAX_NAME_LEN];
+
+} WorkerInfo;
+
+/*! sequence locked worker record */
+typedef struct _WorkerSlot
+{
+    /*! sequence number, odd while the record is being written */
+    uint32_t seq;
+
+    /*! worker activity */
+    WorkerInfo info;
+
+} WorkerSlot;
+
+/*! child process activity */
+typedef struct _ChildInfo
+{
+    /*! process id of the child, 0 if the slot is free */
+    pid_t pid;
+
+    /*! time the child was started (ms) */
+    uint64_t since;
+
+    /*! command line of the child */
+    char cmd[STATUS_MAX_CMD_LEN];
+
+} ChildInfo;
+
+/*! sequence locked child record */
+typedef struct _ChildSlot
+{
+    /*! sequence number, odd while the record is being written */
+    uint32_t seq;
+
+    /*! child process activity */
+    ChildInfo info;
+
+} ChildSlot;
+
+/*! preallocated buffer usage */
+typedef struct _BufferInfo
+{
+    /*! buffer size */
+    size_t size;
+
+    /*! largest number of bytes used */
+    size_t highWater;
+
+} BufferInfo;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static uint64_t NowMs( void );
+static void WriteBegin( uint32_t *pSeq );
+static void WriteEnd( uint32_t *pSeq );
+static void ReadSnapshot( uint32_t *pSeq, void *dst, const void *src, size_t len );
+static void CopyName( char *dst, const char *src, size_t len );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! names of the tracked buffers */
+static const char *bufferNames[STATUS_BUFFER_MAX] =
+{
+    "post",
+    "query",
+    "response"
+};
+
+/*! process start time (ms) */
+static uint64_t startTime;
+
+/*! worker records */
+static WorkerSlot *pWorkers = NULL;
+
+/*! number of worker records */
+static size_t nWorkers = 0;
+
+/*! child records */
+static ChildSlot children[STATUS_MAX_CHILDREN];
+
+/*! buffer usage */
+static BufferInfo buffers[STATUS_BUFFER_MAX];
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Status_Init                                                               */
+/*!
+    Initialize status tracking
+
+    The Status_Init function records the process start time and allocates
+    the worker records.
+
+    @param[in]
+        numWorkers
+            number of request workers
+
+    @retval EOK status tracking was initialized
+    @retval ENOMEM cannot allocate the worker records
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Status_Init( size_t numWorkers )
+{
+    int result = EINVAL;
+
+    if ( numWorkers > 0 )
+    {
+        startTime = NowMs();
+
+        pWorkers = calloc( numWorkers, sizeof( WorkerSlot ) );
+        if ( pWorkers != NULL )
+        {
+            nWorkers = numWorkers;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Status_SetBufferSize                                                      */
+/*!
+    Set the size of a tracked buffer
+
+    @param[in]
+        buffer
+            the tracked buffer
+
+    @param[in]
+        size
+            size of the buffer in bytes
+
+==============================================================================*/
+void Status_SetBufferSize( StatusBuffer buffer, size_t size )
+{
+    if ( buffer < STATUS_BUFFER_MAX )
+    {
+        __atomic_store_n( &buffers[buffer].size, size, __ATOMIC_RELAXED );
+    }
+}
+
+/*============================================================================*/
+/*  Status_BufferUsed                                                         */
+/*!
+    Record the use of a tracked buffer
+
+    The Status_BufferUsed function raises the high-water mark of the
+    buffer if more of it has been used than before.
+
+    @param[in]
+        buffer
+            the tracked buffer
+
+    @param[in]
+        used
+            number of bytes of the buffer used
+
+==============================================================================*/
+void Status_BufferUsed( StatusBuffer buffer, size_t used )
+{
+    size_t highWater;
+
+    if ( buffer < STATUS_BUFFER_MAX )
+    {
+        highWater = __atomic_load_n( &buffers[buffer].highWater,
+                                     __ATOMIC_RELAXED );
+        while ( ( used > highWater ) &&
+                ( __atomic_compare_exchange_n( &buffers[buffer].highWater,
+                                               &highWater,
+                                               used,
+                                               false,
+                                               __ATOMIC_RELAXED,
+                                               __ATOMIC_RELAXED ) == false ) );
+    }
+}
+
+/*============================================================================*/
+/*  Status_WorkerBusy                                                         */
+/*!
+    Mark a worker as processing a request
+
+    @param[in]
+        worker
+            index of the worker
+
+    @param[in]
+        reqid
+            identifier of the request being processed
+
+==============================================================================*/
+void Status_WorkerBusy( size_t worker, uint64_t reqid )
+{
+    WorkerSlot *pSlot;
+
+    if ( worker < nWorkers )
+    {
+        pSlot = &pWorkers[worker];
+
+        WriteBegin( &pSlot->seq );
+        pSlot->info.busy = true;
+        pSlot->info.reqid = reqid;
+        pSlot->info.since = NowMs();
+        pSlot->info.action[0] = 0;
+        pSlot->info.procname[0] = 0;
+        WriteEnd( &pSlot->seq );
+    }
+}
+
+/*============================================================================*/
+/*  Status_WorkerAction                                                       */
+/*!
+    Record the query action a worker is processing
+
+    @param[in]
+        worker
+            index of the worker
+
+    @param[in]
+        action
+            name of the query action
+
+    @param[in]
+        procname
+            name of the process the action applies to
+
+==============================================================================*/
+void Status_WorkerAction( size_t worker,
+                          const char *action,
+                          const char *procname )
+{
+    WorkerSlot *pSlot;
+
+    if ( worker < nWorkers )
+    {
+        pSlot = &pWorkers[worker];
+
+        WriteBegin( &pSlot->seq );
+        CopyName( pSlot->info.action, action, STATUS_MAX_NAME_LEN );
+        CopyName( pSlot->info.procname, procname, STATUS_MAX_NAME_LEN );
+        WriteEnd( &pSlot->seq );
+    }
+}
+
+/*============================================================================*/
+/*  Status_WorkerIdle                                                         */
+/*!
+    Mark a worker as waiting for a request
+
+    @param[in]
+        worker
+            index of the worker
+
+==============================================================================*/
+void Status_WorkerIdle( size_t worker )
+{
+    WorkerSlot *pSlot;
+
+    if ( worker < nWorkers )
+    {
+        pSlot = &pWorkers[worker];
+
+        WriteBegin( &pSlot->seq );
+        pSlot->info.busy = false;
+        pSlot->info.since = NowMs();
+        WriteEnd( &pSlot->seq );
+    }
+}
+
+/*============================================================================*/
+/*  Status_ChildStart                                                         */
+/*!
+    Track a procmon child process
+
+    The Status_ChildStart function records a child process in a free
+    child record.  Children are not tracked if all records are in use.
+
+    @param[in]
+        pid
+            process id of the child
+
+    @param[in]
+        argv
+            NULL terminated argument vector of the child
+
+==============================================================================*/
+void Status_ChildStart( pid_t pid, char * const argv[] )
+{
+    ChildSlot *pSlot;
+    pid_t expected;
+    size_t len = 0;
+    size_t i;
+
+    for ( i = 0; i < STATUS_MAX_CHILDREN; i++ )
+    {
+        pSlot = &children[i];
+        expected = 0;
+
+        /* claim a free slot */
+        if ( __atomic_compare_exchange_n( &pSlot->info.pid,
+                                          &expected,
+                                          pid,
+                                          false,
+                                          __ATOMIC_ACQUIRE,
+                                          __ATOMIC_RELAXED ) )
+        {
+            WriteBegin( &pSlot->seq );
+            pSlot->info.since = NowMs();
+            pSlot->info.cmd[0] = 0;
+            while ( ( argv != NULL ) &&
+                    ( *argv != NULL ) &&
+                    ( len < STATUS_MAX_CMD_LEN - 2 ) )
+            {
+                if ( len > 0 )
+                {
+                    pSlot->info.cmd[len++] = ' ';
+                }
+
+                CopyName( &pSlot->info.cmd[len],
+                          *argv++,
+                          STATUS_MAX_CMD_LEN - len );
+                len += strlen( &pSlot->info.cmd[len] );
+            }
+            WriteEnd( &pSlot->seq );
+            break;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Status_ChildEnd                                                           */
+/*!
+    Stop tracking a procmon child process
+
+    @param[in]
+        pid
+            process id of the child
+
+==============================================================================*/
+void Status_ChildEnd( pid_t pid )
+{
+    ChildSlot *pSlot;
+    size_t i;
+
+    for ( i = 0; i < STATUS_MAX_CHILDREN; i++ )
+    {
+        pSlot = &children[i];
+        if ( __atomic_load_n( &pSlot->info.pid, __ATOMIC_RELAXED ) == pid )
+        {
+            WriteBegin( &pSlot->seq );
+            __atomic_store_n( &pSlot->info.pid, 0, __ATOMIC_RELEASE );
+            WriteEnd( &pSlot->seq );
+            break;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Status_Output                                                             */
+/*!
+    Output the internal status
+
+    The Status_Output function outputs a JSON object containing the
+    uptime, the worker activity, the procmon children in flight and the
+    buffer high-water marks.  Each record is copied out of its sequence
+    lock before it is formatted.
+
+    @param[in]
+        fn
+            output function to send the status to
+
+    @param[in]
+        arg
+            opaque argument passed to the output function
+
+    @retval EOK the status was output
+    @retval EINVAL invalid arguments
+    @retval other error returned by the output function
+
+==============================================================================*/
+int Status_Output( OutputFn fn, void *arg )
+{
+    int result = EINVAL;
+    char buf[STATUS_MAX_RECORD_LEN];
+    WorkerInfo worker;
+    ChildInfo child;
+    uint64_t now;
+    size_t i;
+    int n;
+    const char *sep = "";
+
+    if ( fn != NULL )
+    {
+        now = NowMs();
+
+        n = snprintf( buf,
+                      sizeof( buf ),
+                      "{\"uptime\": %llu, \"workers\": [",
+                      (unsigned long long)( now - startTime ) / 1000ULL );
+        result = fn( arg, buf, n );
+
+        for ( i = 0; ( i < nWorkers ) && ( result == EOK ); i++ )
+        {
+            ReadSnapshot( &pWorkers[i].seq,
+                          &worker,
+                          &pWorkers[i].info,
+                          sizeof( worker ) );
+
+            n = snprintf( buf,
+                          sizeof( buf ),
+                          "%s{\"id\": %zu, \"state\": \"%s\", "
+                          "\"request\": %llu, \"action\": \"%s\", "
+                          "\"name\": \"%s\", \"age_ms\": %llu}",
+                          ( i > 0 ) ? ", " : "",
+                          i,
+                          worker.busy ? "busy" : "idle",
+                          (unsigned long long)worker.reqid,
+                          worker.busy ? worker.action : "",
+                          worker.busy ? worker.procname : "",
+                          (unsigned long long)( now - worker.since ) );
+            result = fn( arg, buf, n );
+        }
+
+        if ( result == EOK )
+        {
+            n = snprintf( buf, sizeof( buf ), "], \"children\": [" );
+            result = fn( arg, buf, n );
+        }
+
+        for ( i = 0; ( i < STATUS_MAX_CHILDREN ) && ( result == EOK ); i++ )
+        {
+            ReadSnapshot( &children[i].seq,
+                          &child,
+                          &children[i].info,
+                          sizeof( child ) );
+
+            if ( child.pid != 0 )
+            {
+                n = snprintf( buf,
+                              sizeof( buf ),
+                              "%s{\"pid\": %d, \"age_ms\": %llu, "
+                              "\"command\": \"%s\"}",
+                              sep,
+                              (int)child.pid,
+                              (unsigned long long)( now - child.since ),
+                              child.cmd );
+                result = fn( arg, buf, n );
+                sep = ", ";
+            }
+        }
+
+        if ( result == EOK )
+        {
+            n = snprintf( buf, sizeof( buf ), "], \"buffers\": [" );
+            result = fn( arg, buf, n );
+        }
+
+        for ( i = 0; ( i < STATUS_BUFFER_MAX ) && ( result == EOK ); i++ )
+        {
+            n = snprintf( buf,
+                          sizeof( buf ),
+                          "%s{\"name\": \"%s\", \"size\": %zu, "
+                          "\"high_water\": %zu}",
+                          ( i > 0 ) ? ", " : "",
+                          bufferNames[i],
+                          __atomic_load_n( &buffers[i].size,
+                                           __ATOMIC_RELAXED ),
+                          __atomic_load_n( &buffers[i].highWater,
+                                           __ATOMIC_RELAXED ) );
+            result = fn( arg, buf, n );
+        }
+
+        if ( result == EOK )
+        {
+            result = fn( arg, "]}", 2 );
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  NowMs                                                                     */
+/*!
+    Get the monotonic time in milliseconds
+
+    @retval current monotonic time in milliseconds
+
+==============================================================================*/
+static uint64_t NowMs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/*============================================================================*/
+/*  WriteBegin                                                                */
+/*!
+    Start writing a sequence locked record
+
+    @param[in]
+        pSeq
+            pointer to the sequence number of the record
+
+==============================================================================*/
+static void WriteBegin( uint32_t *pSeq )
+{
+    __atomic_fetch_add( pSeq, 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+/*============================================================================*/
+/*  WriteEnd                                                                  */
+/*!
+    Finish writing a sequence locked record
+
+    @param[in]
+        pSeq
+            pointer to the sequence number of the record
+
+==============================================================================*/
+static void WriteEnd( uint32_t *pSeq )
+{
+    __atomic_fetch_add( pSeq, 1, __ATOMIC_RELEASE );
+}
+
+/*============================================================================*/
+/*  ReadSnapshot                                                              */
+/*!
+    Take a consistent copy of a sequence locked record
+
+    The ReadSnapshot function copies the record, and retries if a writer
+    was active before or during the copy.
+
+    @param[in]
+        pSeq
+            pointer to the sequence number of the record
+
+    @param[out]
+        dst
+            pointer to the buffer to receive the copy
+
+    @param[in]
+        src
+            pointer to the record
+
+    @param[in]
+        len
+            size of the record
+
+==============================================================================*/
+static void ReadSnapshot( uint32_t *pSeq, void *dst, const void *src, size_t len )
+{
+    uint32_t before;
+    uint32_t after;
+
+    do
+    {
+        before = __atomic_load_n( pSeq, __ATOMIC_ACQUIRE );
+        memcpy( dst, src, len );
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+        after = __atomic_load_n( pSeq, __ATOMIC_RELAXED );
+    } while ( ( before & 1 ) || ( before != after ) );
+}
+
+/*============================================================================*/
+/*  CopyName                                                                  */
+/*!
+    Copy a name into a status record
+
+    The CopyName function copies a name, truncating it to fit and keeping
+    only characters which do not need escaping in a JSON string.
+
+    @param[out]
+        dst
+            pointer to the destination buffer
+
+    @param[in]
+        src
+            pointer to the name to copy (may be NULL)
+
+    @param[in]
+        len
+            size of the destination buffer
+
+==============================================================================*/
+static void CopyName( char *dst, const char *src, size_t len )
+{
+    size_t i = 0;
+    char c;
+
+    if ( src != NULL )
+    {
+        while ( ( i < len - 1 ) && ( ( c = *src++ ) != 0 ) )
+        {
+            if ( ( c >= 0x20 ) && ( c < 0x7f ) && ( c != '"' ) && ( c != '\\' ) )
+            {
+                dst[i++] = c;
+            }
+        }
+    }
+
+    dst[i] = 0;
+}
+
+/*! @}
+ * end of status group */
@@ -0,0 +1,505 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup trace trace
+ * @brief Chrome trace-event export of request spans
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file trace.c
+
+    Request Span Tracing
+
+    The trace module records timed spans of request processing and
+    writes them to a file in the Chrome trace-event JSON format,
+    which can be loaded into a trace viewer (chrome://tracing or
+    Perfetto).
+
+    Spans are buffered in a ring owned by the recording thread, and
+    the ring is written to the trace file in a single batch when it
+    fills, or at the end of a request once the flush interval has
+    elapsed.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of events buffered per thread before a batch is written */
+#define TRACE_RING_SIZE         256
+
+/*! maximum length of a span argument */
+#define TRACE_MAX_ARG           32
+
+/*! maximum length of a formatted event */
+#define TRACE_MAX_EVENT_LEN     256
+
+/*! interval after which a partially filled ring is written (us) */
+#define TRACE_FLUSH_INTERVAL_US 1000000ULL
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+/*! a single complete ("X" phase) trace event */
+typedef struct _TraceEvent
+{
+    /*! span name */
+    const char *name;
+
+    /*! request identifier */
+    uint64_t reqid;
+
+    /*! span start time (us) */
+    uint64_t ts;
+
+    /*! span duration (us) */
+    uint64_t dur;
+
+    /*! span argument */
+    char arg[TRACE_MAX_ARG];
+
+} TraceEvent;
+
+/*! per-thread event ring */
+typedef struct _TraceRing
+{
+    /*! buffered events */
+    TraceEvent events[TRACE_RING_SIZE];
+
+    /*! number of buffered events */
+    size_t count;
+
+    /*! kernel thread id of the owning thread */
+    pid_t tid;
+
+    /*! time of the last batch write (us) */
+    uint64_t lastFlush;
+
+    /*! formatting buffer for a batch write */
+    char buf[TRACE_RING_SIZE * TRACE_MAX_EVENT_LEN];
+
+    /*! pointer to the next ring in the list of all rings */
+    struct _TraceRing *pNext;
+
+} TraceRing;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static TraceRing *GetRing( void );
+static void FlushRing( TraceRing *pRing );
+static void CopyArg( char *dst, const char *src );
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! trace enabled flag */
+bool traceEnabled = false;
+
+/*! trace file descriptor */
+static int traceFd = -1;
+
+/*! process id recorded in the trace */
+static pid_t tracePid;
+
+/*! mutex protecting the trace file and the list of rings */
+static pthread_mutex_t traceMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*! list of all rings */
+static TraceRing *pRings = NULL;
+
+/*! event ring of the calling thread */
+static __thread TraceRing *pThreadRing = NULL;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Trace_Open                                                                */
+/*!
+    Enable span tracing to a file
+
+    The Trace_Open function creates (or truncates) the trace file, starts
+    the JSON event array and enables span recording.  The trace is
+    completed by Trace_Close, which is registered to run at exit.
+
+    @param[in]
+        path
+            pointer to the name of the trace file
+
+    @retval EOK tracing was enabled
+    @retval EALREADY tracing is already enabled
+    @retval EINVAL invalid arguments
+    @retval other error from open
+
+==============================================================================*/
+int Trace_Open( const char *path )
+{
+    int result = EINVAL;
+    char buf[TRACE_MAX_EVENT_LEN];
+    int n;
+
+    if ( traceFd != -1 )
+    {
+        result = EALREADY;
+    }
+    else if ( path != NULL )
+    {
+        traceFd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+        if ( traceFd != -1 )
+        {
+            tracePid = getpid();
+
+            n = snprintf( buf,
+                          sizeof( buf ),
+                          "[\n{\"name\":\"process_name\",\"ph\":\"M\","
+                          "\"pid\":%d,\"args\":{\"name\":\"fcgi_proc\"}},\n",
+                          tracePid );
+            if ( write( traceFd, buf, n ) == n )
+            {
+                traceEnabled = true;
+                atexit( Trace_Close );
+                result = EOK;
+            }
+            else
+            {
+                result = errno;
+                close( traceFd );
+                traceFd = -1;
+            }
+        }
+        else
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Trace_Close                                                               */
+/*!
+    Complete the trace file
+
+    The Trace_Close function writes out the events buffered by all
+    threads, terminates the JSON event array, and closes the trace file.
+    The rings of other threads are written without locking, so every
+    other thread which records spans must have been stopped and joined
+    (see Executor_Shutdown) before the trace is closed.
+
+==============================================================================*/
+void Trace_Close( void )
+{
+    TraceRing *pRing;
+    char buf[TRACE_MAX_EVENT_LEN];
+    int n;
+
+    if ( traceEnabled == true )
+    {
+        traceEnabled = false;
+
+        for ( pRing = pRings; pRing != NULL; pRing = pRing->pNext )
+        {
+            FlushRing( pRing );
+        }
+
+        /* terminate the event array with a final metadata event */
+        n = snprintf( buf,
+                      sizeof( buf ),
+                      "{\"name\":\"process_labels\",\"ph\":\"M\","
+                      "\"pid\":%d,\"args\":{\"labels\":\"fcgi_proc\"}}]\n",
+                      tracePid );
+        if ( write( traceFd, buf, n ) != n )
+        {
+            syslog( LOG_ERR, "cannot complete trace file" );
+        }
+
+        close( traceFd );
+        traceFd = -1;
+    }
+}
+
+/*============================================================================*/
+/*  Trace_Now                                                                 */
+/*!
+    Get the current trace timestamp
+
+    The Trace_Now function gets the monotonic time in microseconds,
+    which is the time base of the trace-event format.
+
+    @retval current time in microseconds
+
+==============================================================================*/
+uint64_t Trace_Now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/*============================================================================*/
+/*  Trace_Span                                                                */
+/*!
+    Record a completed span
+
+    The Trace_Span function records a span which started at the specified
+    time and ends now, in the ring of the calling thread.  A full ring is
+    written to the trace file before the span is recorded.
+
+    @param[in]
+        name
+            pointer to the span name.  This must be a string literal.
+
+    @param[in]
+        reqid
+            identifier of the request the span belongs to
+
+    @param[in]
+        start
+            span start time from TRACE_START()
+
+    @param[in]
+        arg
+            optional span argument (eg the query action)
+
+==============================================================================*/
+void Trace_Span( const char *name,
+                 uint64_t reqid,
+                 uint64_t start,
+                 const char *arg )
+{
+    TraceRing *pRing;
+    TraceEvent *pEvent;
+    uint64_t now;
+
+    if ( ( traceEnabled == true ) && ( name != NULL ) && ( start != 0 ) )
+    {
+        pRing = GetRing();
+        if ( pRing != NULL )
+        {
+            if ( pRing->count == TRACE_RING_SIZE )
+            {
+                FlushRing( pRing );
+            }
+
+            now = Trace_Now();
+
+            pEvent = &pRing->events[pRing->count++];
+            pEvent->name = name;
+            pEvent->reqid = reqid;
+            pEvent->ts = start;
+            pEvent->dur = now - start;
+            CopyArg( pEvent->arg, arg );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Trace_RequestDone                                                         */
+/*!
+    Notify the trace module that a request has completed
+
+    The Trace_RequestDone function writes the ring of the calling
+    thread to the trace file if the flush interval has elapsed,
+    so a lightly loaded server still produces a timely trace.
+
+==============================================================================*/
+void Trace_RequestDone( void )
+{
+    TraceRing *pRing = pThreadRing;
+
+    if ( ( traceEnabled == true ) &&
+         ( pRing != NULL ) &&
+         ( pRing->count > 0 ) &&
+         ( Trace_Now() - pRing->lastFlush >= TRACE_FLUSH_INTERVAL_US ) )
+    {
+        FlushRing( pRing );
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  GetRing                                                                   */
+/*!
+    Get the event ring of the calling thread
+
+    The GetRing function gets the event ring of the calling thread,
+    creating it and adding it to the list of all rings on first use.
+
+    @retval pointer to the ring of the calling thread
+    @retval NULL the ring could not be allocated
+
+==============================================================================*/
+static TraceRing *GetRing( void )
+{
+    TraceRing *pRing = pThreadRing;
+
+    if ( pRing == NULL )
+    {
+        pRing = calloc( 1, sizeof( TraceRing ) );
+        if ( pRing != NULL )
+        {
+            pRing->tid = syscall( SYS_gettid );
+            pRing->lastFlush = Trace_Now();
+
+            pthread_mutex_lock( &traceMutex );
+            pRing->pNext = pRings;
+            pRings = pRing;
+            pthread_mutex_unlock( &traceMutex );
+
+            pThreadRing = pRing;
+        }
+    }
+
+    return pRing;
+}
+
+/*============================================================================*/
+/*  FlushRing                                                                 */
+/*!
+    Write a batch of events to the trace file
+
+    The FlushRing function formats all the events buffered in the ring,
+    and writes them to the trace file with a single write.
+
+    @param[in]
+        pRing
+            pointer to the ring to flush
+
+==============================================================================*/
+static void FlushRing( TraceRing *pRing )
+{
+    TraceEvent *pEvent;
+    size_t len = 0;
+    size_t i;
+    int n;
+
+    for ( i = 0; i < pRing->count; i++ )
+    {
+        pEvent = &pRing->events[i];
+        n = snprintf( &pRing->buf[len],
+                      TRACE_MAX_EVENT_LEN,
+                      "{\"name\":\"%s\",\"cat\":\"fcgi_proc\",\"ph\":\"X\","
+                      "\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%d,"
+                      "\"args\":{\"req\":%llu,\"arg\":\"%s\"}},\n",
+                      pEvent->name,
+                      (unsigned long long)pEvent->ts,
+                      (unsigned long long)pEvent->dur,
+                      tracePid,
+                      pRing->tid,
+                      (unsigned long long)pEvent->reqid,
+                      pEvent->arg );
+        if ( ( n > 0 ) && ( n < TRACE_MAX_EVENT_LEN ) )
+        {
+            len += n;
+        }
+    }
+
+    if ( len > 0 )
+    {
+        pthread_mutex_lock( &traceMutex );
+        if ( write( traceFd, pRing->buf, len ) != (ssize_t)len )
+        {
+            syslog( LOG_ERR, "trace write failed: %s", strerror( errno ) );
+        }
+        pthread_mutex_unlock( &traceMutex );
+    }
+
+    pRing->count = 0;
+    pRing->lastFlush = Trace_Now();
+}
+
+/*============================================================================*/
+/*  CopyArg                                                                   */
+/*!
+    Copy a span argument
+
+    The CopyArg function copies a span argument into an event, keeping
+    only characters which do not need escaping in a JSON string.
+
+    @param[out]
+        dst
+            pointer to a TRACE_MAX_ARG sized destination buffer
+
+    @param[in]
+        src
+            pointer to the argument to copy (may be NULL)
+
+==============================================================================*/
+static void CopyArg( char *dst, const char *src )
+{
+    size_t i = 0;
+    char c;
+
+    if ( src != NULL )
+    {
+        while ( ( i < TRACE_MAX_ARG - 1 ) && ( ( c = *src++ ) != 0 ) )
+        {
+            if ( ( c >= 0x20 ) && ( c < 0x7f ) && ( c != '"' ) && ( c != '\\' ) )
+            {
+                dst[i++] = c;
+            }
+        }
+    }
+
+    dst[i] = 0;
+}
+
+/*! @}
+ * end of trace group */
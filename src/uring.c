@@ -0,0 +1,668 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup uring uring
+ * @brief Minimal io_uring submission and completion rings
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file uring.c
+
+    io_uring Rings
+
+    The uring module drives a single io_uring instance through the raw
+    system calls, so fcgi_proc does not depend on liburing.  It is used
+    by the coroutine runtime (see coro.c) to wait for file descriptors
+    when fcgi_proc is started with the -u option.
+
+    Requests are queued in the submission ring without a system call,
+    and every request queued since the last wait is submitted by the
+    same io_uring_enter call which waits for the next completion.  A
+    loop iteration which starts several waits therefore costs one
+    system call, where epoll costs one epoll_ctl per wait plus the
+    epoll_wait.  Where the kernel supports it, the ring descriptor is
+    registered so io_uring_enter does not look it up on every call, and
+    completion work is deferred until the ring is waited on.
+
+    The module is compiled in when the kernel headers provide
+    linux/io_uring.h.  Otherwise, or when the kernel does not support
+    io_uring (eg it is disabled by a seccomp policy), Uring_Init fails
+    and the caller keeps using epoll.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#endif
+#include "uring.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+#ifndef EOK
+#define EOK (0)
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H)
+
+#if defined(IORING_SETUP_DEFER_TASKRUN)
+/*! run completion work only when the ring is waited on (Linux 6.1) */
+#define URING_SETUP_FLAGS \
+    ( IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN )
+#else
+#define URING_SETUP_FLAGS   0
+#endif
+
+/*! io_uring instance */
+typedef struct _UringRing
+{
+    /*! ring file descriptor, or -1 */
+    int fd;
+
+    /*! descriptor passed to io_uring_enter: fd, or its registered index */
+    int enterFd;
+
+    /*! flags passed to every io_uring_enter call */
+    unsigned int enterFlags;
+
+    /*! submission ring head, advanced by the kernel */
+    unsigned int *sqHead;
+
+    /*! submission ring tail, advanced by the application */
+    unsigned int *sqTail;
+
+    /*! submission ring index array */
+    unsigned int *sqArray;
+
+    /*! submission ring index mask */
+    unsigned int sqMask;
+
+    /*! number of submission ring entries */
+    unsigned int sqEntries;
+
+    /*! submission queue entries */
+    struct io_uring_sqe *sqes;
+
+    /*! completion ring head, advanced by the application */
+    unsigned int *cqHead;
+
+    /*! completion ring tail, advanced by the kernel */
+    unsigned int *cqTail;
+
+    /*! completion ring index mask */
+    unsigned int cqMask;
+
+    /*! completion queue entries */
+    struct io_uring_cqe *cqes;
+
+    /*! number of queued entries not yet submitted */
+    unsigned int pending;
+
+} UringRing;
+
+#endif
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+#if defined(HAVE_LINUX_IO_URING_H)
+static int MapRing( struct io_uring_params *pParams );
+static void RegisterRing( void );
+static struct io_uring_sqe *NextSqe( void );
+static int Enter( unsigned int minComplete, int timeoutMs );
+#endif
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+#if defined(HAVE_LINUX_IO_URING_H)
+/*! the io_uring instance */
+static UringRing ring = { .fd = -1, .enterFd = -1 };
+#endif
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Uring_Init                                                                */
+/*!
+    Create the io_uring instance
+
+    @param[in]
+        entries
+            number of submission ring entries
+
+    @retval EOK the ring was created
+    @retval ENOSYS io_uring is not supported by the build or the kernel
+    @retval ENOTSUP the kernel does not support waits with a timeout
+            (Linux 5.11)
+    @retval EINVAL invalid arguments, or the ring already exists
+    @retval other error from io_uring_setup or mmap, eg EPERM
+
+==============================================================================*/
+int Uring_Init( unsigned int entries )
+{
+    int result = ENOSYS;
+
+#if defined(HAVE_LINUX_IO_URING_H)
+    struct io_uring_params params;
+
+    result = EINVAL;
+    if ( ( ring.fd == -1 ) && ( entries > 0 ) )
+    {
+        memset( &params, 0, sizeof( params ) );
+        params.flags = URING_SETUP_FLAGS;
+        ring.fd = syscall( SYS_io_uring_setup, entries, &params );
+        if ( ( ring.fd == -1 ) && ( errno == EINVAL ) && ( params.flags != 0 ) )
+        {
+            /* older kernels reject the setup flags */
+            memset( &params, 0, sizeof( params ) );
+            ring.fd = syscall( SYS_io_uring_setup, entries, &params );
+        }
+
+        if ( ring.fd == -1 )
+        {
+            result = errno;
+        }
+        else if ( ( params.features & IORING_FEAT_EXT_ARG ) == 0 )
+        {
+            result = ENOTSUP;
+        }
+        else
+        {
+            result = MapRing( &params );
+        }
+
+        if ( result == EOK )
+        {
+            ring.enterFd = ring.fd;
+            RegisterRing();
+        }
+        else if ( ring.fd != -1 )
+        {
+            close( ring.fd );
+            ring.fd = -1;
+        }
+    }
+#else
+    (void)entries;
+#endif
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Uring_PollAdd                                                             */
+/*!
+    Queue a one-shot wait for a file descriptor
+
+    The Uring_PollAdd function queues a request which completes once
+    the file descriptor is ready.  The request is submitted by the next
+    Uring_Wait.  Its completion result is the ready events, or a
+    negative error number, eg -ECANCELED when it was removed.
+
+    @param[in]
+        fd
+            file descriptor to wait for
+
+    @param[in]
+        events
+            poll events to wait for, eg POLLIN
+
+    @param[in]
+        userData
+            non-zero value identifying the completion
+
+    @retval EOK the request was queued
+    @retval EAGAIN the submission ring is full
+    @retval ENOSYS the ring was not created
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Uring_PollAdd( int fd, uint32_t events, uint64_t userData )
+{
+    int result = ENOSYS;
+
+#if defined(HAVE_LINUX_IO_URING_H)
+    struct io_uring_sqe *pSqe;
+
+    if ( ( fd < 0 ) || ( userData == 0 ) )
+    {
+        result = EINVAL;
+    }
+    else if ( ring.fd != -1 )
+    {
+        pSqe = NextSqe();
+        if ( pSqe != NULL )
+        {
+            pSqe->opcode = IORING_OP_POLL_ADD;
+            pSqe->fd = fd;
+#if __BYTE_ORDER == __BIG_ENDIAN
+            events = ( events << 16 ) | ( events >> 16 );
+#endif
+            pSqe->poll32_events = events;
+            pSqe->user_data = userData;
+            result = EOK;
+        }
+        else
+        {
+            result = EAGAIN;
+        }
+    }
+#else
+    (void)fd;
+    (void)events;
+    (void)userData;
+#endif
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Uring_PollRemove                                                          */
+/*!
+    Queue the removal of a wait for a file descriptor
+
+    The Uring_PollRemove function queues a request which cancels the
+    wait queued by Uring_PollAdd with the same user data.  The removal
+    itself completes with user data 0.
+
+    @param[in]
+        userData
+            user data of the wait to remove
+
+    @retval EOK the request was queued
+    @retval EAGAIN the submission ring is full
+    @retval ENOSYS the ring was not created
+
+==============================================================================*/
+int Uring_PollRemove( uint64_t userData )
+{
+    int result = ENOSYS;
+
+#if defined(HAVE_LINUX_IO_URING_H)
+    struct io_uring_sqe *pSqe;
+
+    if ( ring.fd != -1 )
+    {
+        pSqe = NextSqe();
+        if ( pSqe != NULL )
+        {
+            pSqe->opcode = IORING_OP_POLL_REMOVE;
+            pSqe->fd = -1;
+            pSqe->addr = userData;
+            pSqe->user_data = 0;
+            result = EOK;
+        }
+        else
+        {
+            result = EAGAIN;
+        }
+    }
+#else
+    (void)userData;
+#endif
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Uring_Wait                                                                */
+/*!
+    Submit the queued requests and wait for a completion
+
+    The Uring_Wait function submits every queued request and waits,
+    in the same system call, until at least one completion is available
+    or the timeout expires.  Completions are then read with Uring_Reap.
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or -1 for no limit
+
+    @retval EOK a completion is available, or the wait timed out or was
+            interrupted
+    @retval ENOSYS the ring was not created
+    @retval other error from io_uring_enter
+
+==============================================================================*/
+int Uring_Wait( int timeoutMs )
+{
+    int result = ENOSYS;
+
+#if defined(HAVE_LINUX_IO_URING_H)
+    if ( ring.fd != -1 )
+    {
+        result = Enter( 1, timeoutMs );
+    }
+#else
+    (void)timeoutMs;
+#endif
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Uring_Reap                                                                */
+/*!
+    Read the next completion
+
+    @param[out]
+        pUserData
+            pointer to the location to store the user data of the request
+
+    @param[out]
+        pRes
+            pointer to the location to store the result of the request
+
+    @retval EOK a completion was read
+    @retval ENOENT no completion is available
+    @retval ENOSYS the ring was not created
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int Uring_Reap( uint64_t *pUserData, int32_t *pRes )
+{
+    int result = ENOSYS;
+
+#if defined(HAVE_LINUX_IO_URING_H)
+    struct io_uring_cqe *pCqe;
+    unsigned int head;
+
+    if ( ( pUserData == NULL ) || ( pRes == NULL ) )
+    {
+        result = EINVAL;
+    }
+    else if ( ring.fd != -1 )
+    {
+        head = *ring.cqHead;
+        if ( head != __atomic_load_n( ring.cqTail, __ATOMIC_ACQUIRE ) )
+        {
+            pCqe = &ring.cqes[head & ring.cqMask];
+            *pUserData = pCqe->user_data;
+            *pRes = pCqe->res;
+
+            /* hand the entry back to the kernel once it has been read */
+            __atomic_store_n( ring.cqHead, head + 1, __ATOMIC_RELEASE );
+            result = EOK;
+        }
+        else
+        {
+            result = ENOENT;
+        }
+    }
+#else
+    (void)pUserData;
+    (void)pRes;
+#endif
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+#if defined(HAVE_LINUX_IO_URING_H)
+
+/*============================================================================*/
+/*  MapRing                                                                   */
+/*!
+    Map the rings of the io_uring instance
+
+    The submission and completion rings share one mapping, which every
+    kernel supporting timed waits provides (IORING_FEAT_SINGLE_MMAP).
+
+    @param[in]
+        pParams
+            pointer to the parameters returned by io_uring_setup
+
+    @retval EOK the rings were mapped
+    @retval other error from mmap
+
+==============================================================================*/
+static int MapRing( struct io_uring_params *pParams )
+{
+    int result = EOK;
+    size_t sqLen;
+    size_t cqLen;
+    size_t sqesLen;
+    uint8_t *pRings;
+    void *pSqes;
+
+    sqLen = pParams->sq_off.array +
+            ( pParams->sq_entries * sizeof( unsigned int ) );
+    cqLen = pParams->cq_off.cqes +
+            ( pParams->cq_entries * sizeof( struct io_uring_cqe ) );
+    sqesLen = pParams->sq_entries * sizeof( struct io_uring_sqe );
+    if ( cqLen > sqLen )
+    {
+        sqLen = cqLen;
+    }
+
+    pRings = mmap( NULL,
+                   sqLen,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE,
+                   ring.fd,
+                   IORING_OFF_SQ_RING );
+    if ( pRings == MAP_FAILED )
+    {
+        result = errno;
+    }
+    else
+    {
+        pSqes = mmap( NULL,
+                      sqesLen,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE,
+                      ring.fd,
+                      IORING_OFF_SQES );
+        if ( pSqes == MAP_FAILED )
+        {
+            result = errno;
+            munmap( pRings, sqLen );
+        }
+        else
+        {
+            ring.sqHead = (unsigned int *)( pRings + pParams->sq_off.head );
+            ring.sqTail = (unsigned int *)( pRings + pParams->sq_off.tail );
+            ring.sqArray = (unsigned int *)( pRings + pParams->sq_off.array );
+            ring.sqMask =
+                *(unsigned int *)( pRings + pParams->sq_off.ring_mask );
+            ring.sqEntries = pParams->sq_entries;
+            ring.sqes = pSqes;
+
+            ring.cqHead = (unsigned int *)( pRings + pParams->cq_off.head );
+            ring.cqTail = (unsigned int *)( pRings + pParams->cq_off.tail );
+            ring.cqMask =
+                *(unsigned int *)( pRings + pParams->cq_off.ring_mask );
+            ring.cqes =
+                (struct io_uring_cqe *)( pRings + pParams->cq_off.cqes );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RegisterRing                                                              */
+/*!
+    Register the ring descriptor, if the kernel supports it (Linux 5.18)
+
+    A registered ring is passed to io_uring_enter by its index, which
+    saves a file table lookup on every call.
+
+==============================================================================*/
+static void RegisterRing( void )
+{
+#if defined(IORING_ENTER_REGISTERED_RING)
+    struct io_uring_rsrc_update update;
+
+    memset( &update, 0, sizeof( update ) );
+    update.offset = -1U;
+    update.data = (uint64_t)ring.fd;
+
+    if ( syscall( SYS_io_uring_register,
+                  ring.fd,
+                  IORING_REGISTER_RING_FDS,
+                  &update,
+                  1 ) == 1 )
+    {
+        ring.enterFd = (int)update.offset;
+        ring.enterFlags = IORING_ENTER_REGISTERED_RING;
+    }
+#endif
+}
+
+/*============================================================================*/
+/*  NextSqe                                                                   */
+/*!
+    Queue the next submission queue entry
+
+    The NextSqe function adds a cleared entry to the submission ring,
+    submitting the queued entries first if the ring is full.  The kernel
+    reads the entry when it is submitted, so the caller fills it in
+    before the next Enter.
+
+    @retval pointer to the entry
+    @retval NULL the submission ring is full
+
+==============================================================================*/
+static struct io_uring_sqe *NextSqe( void )
+{
+    struct io_uring_sqe *pSqe = NULL;
+    unsigned int tail = *ring.sqTail;
+    unsigned int index;
+
+    if ( ( tail - __atomic_load_n( ring.sqHead, __ATOMIC_ACQUIRE ) ) >=
+         ring.sqEntries )
+    {
+        (void)Enter( 0, 0 );
+    }
+
+    if ( ( tail - __atomic_load_n( ring.sqHead, __ATOMIC_ACQUIRE ) ) <
+         ring.sqEntries )
+    {
+        index = tail & ring.sqMask;
+        pSqe = &ring.sqes[index];
+        memset( pSqe, 0, sizeof( *pSqe ) );
+        ring.sqArray[index] = index;
+
+        __atomic_store_n( ring.sqTail, tail + 1, __ATOMIC_RELEASE );
+        ring.pending++;
+    }
+
+    return pSqe;
+}
+
+/*============================================================================*/
+/*  Enter                                                                     */
+/*!
+    Submit the queued entries, and optionally wait for completions
+
+    @param[in]
+        minComplete
+            number of completions to wait for, or 0 to only submit
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or -1 for no limit
+
+    @retval EOK the entries were submitted, and the wait completed,
+            timed out, or was interrupted
+    @retval other error from io_uring_enter
+
+==============================================================================*/
+static int Enter( unsigned int minComplete, int timeoutMs )
+{
+    int result = EOK;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned int flags = ring.enterFlags;
+    void *pArg = NULL;
+    size_t argLen = 0;
+    long rc;
+
+    if ( minComplete > 0 )
+    {
+        memset( &arg, 0, sizeof( arg ) );
+        if ( timeoutMs >= 0 )
+        {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (long long)( timeoutMs % 1000 ) * 1000000LL;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        pArg = &arg;
+        argLen = sizeof( arg );
+    }
+
+    rc = syscall( SYS_io_uring_enter,
+                  ring.enterFd,
+                  ring.pending,
+                  minComplete,
+                  flags,
+                  pArg,
+                  argLen );
+    if ( rc >= 0 )
+    {
+        ring.pending -= ( (unsigned long)rc < ring.pending )
+                        ? (unsigned int)rc
+                        : ring.pending;
+    }
+    else if ( ( errno != ETIME ) &&
+              ( errno != EINTR ) &&
+              ( errno != EAGAIN ) &&
+              ( errno != EBUSY ) )
+    {
+        result = errno;
+    }
+
+    return result;
+}
+
+#endif
+
+/*! @}
+ * end of uring group */